@@ -68,6 +68,12 @@ void *suspend_iram_base;
 void (*suspend_in_iram)(void *sdclk_iomux_addr) = NULL;
 void __iomem *suspend_param1;
 
+/* the suspend code runs from here for good, so it has no reclaim */
+static struct iram_client suspend_iram = {
+	.name = "suspend",
+	.priority = IRAM_PRIO_HIGH,
+};
+
 #define TZIC_WAKEUP0_OFFSET            0x0E00
 #define TZIC_WAKEUP1_OFFSET            0x0E04
 #define TZIC_WAKEUP2_OFFSET            0x0E08
@@ -226,13 +232,21 @@ static int __init pm_init(void)
 	unsigned long iram_paddr, cpaddr;
 
 	pr_info("Static Power Management for Freescale i.MX5\n");
+	iram_client_register(&suspend_iram);
+	if (iram_request(&suspend_iram, SZ_4K)) {
+		printk(KERN_ERR "no iRAM for the suspend routine\n");
+		iram_client_unregister(&suspend_iram);
+		return -ENOMEM;
+	}
 	if (platform_driver_register(&mx5_pm_driver) != 0) {
 		printk(KERN_ERR "mx5_pm_driver register failed\n");
+		iram_client_unregister(&suspend_iram);
 		return -ENODEV;
 	}
 	suspend_set_ops(&mx5_suspend_ops);
 	/* Move suspend routine into iRAM */
-	cpaddr = iram_alloc(SZ_4K, &iram_paddr);
+	cpaddr = (unsigned long)suspend_iram.virt;
+	iram_paddr = suspend_iram.dma_addr;
 	/* Need to remap the area here since we want the memory region
 		 to be executable. */
 	suspend_iram_base = __arm_ioremap(iram_paddr, SZ_4K,
@@ -0,0 +1,485 @@
+/*
+ * Copyright (C) 2011 Freescale Semiconductor, Inc. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/*
+ * Pool of physically contiguous buffers for the IPU and VPU.
+ *
+ * Buffers come from a region reserved at boot (contig_reserve=<size>)
+ * while it lasts, and from dma_alloc_coherent() after that. Freed buffers
+ * of the latter kind are not returned right away but cached on per size
+ * class lists, since video clients free and reallocate the same frame
+ * sizes over and over. The cache is trimmed oldest first beyond
+ * contig_cache=<size>, and dropped entirely before an allocation is
+ * allowed to fail.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/slab.h>
+#include <linux/list.h>
+#include <linux/mutex.h>
+#include <linux/jiffies.h>
+#include <linux/genalloc.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/dma-mapping.h>
+#include <linux/mm.h>
+#include <linux/sched.h>
+#include <linux/contig_alloc.h>
+#include <asm/cacheflush.h>
+#include <asm/outercache.h>
+
+/* class n holds buffers of 2^n up to 2^(n+1) - 1 pages, the last one is open ended */
+#define CONTIG_CLASSES		12
+
+struct contig_buf {
+	struct list_head node;		/* busy list or its class free list */
+	struct list_head lru;		/* cached buffers, oldest first */
+	void *owner;
+	void *vaddr;
+	dma_addr_t paddr;
+	size_t size;			/* page aligned */
+	size_t used;			/* as requested, page aligned */
+	bool reserved;			/* carved from the boot reservation */
+};
+
+struct contig_stats {
+	unsigned long hits;		/* served from the cache */
+	unsigned long misses;
+	unsigned long reserved_allocs;
+	unsigned long fresh_allocs;	/* fell through to dma_alloc_coherent */
+	unsigned long flushes;		/* cache dropped to satisfy an allocation */
+	unsigned long failures;
+	unsigned long evictions;
+	size_t busy_bytes;
+	size_t slack_bytes;		/* handed out beyond what was asked for */
+	size_t cached_bytes;
+	size_t reserved_used;
+};
+
+static struct list_head contig_free_lists[CONTIG_CLASSES];
+static LIST_HEAD(contig_lru);
+static LIST_HEAD(contig_busy);
+static DEFINE_MUTEX(contig_lock);
+static struct contig_stats contig_stats;
+static bool contig_ready;
+
+static size_t contig_cache_max = SZ_32M;
+static size_t contig_reserve_size;
+static struct gen_pool *contig_pool;
+static void *contig_reserve_vaddr;
+static dma_addr_t contig_reserve_paddr;
+
+static int __init contig_reserve_setup(char *str)
+{
+	contig_reserve_size = PAGE_ALIGN(memparse(str, NULL));
+	return 1;
+}
+__setup("contig_reserve=", contig_reserve_setup);
+
+static int __init contig_cache_setup(char *str)
+{
+	contig_cache_max = memparse(str, NULL);
+	return 1;
+}
+__setup("contig_cache=", contig_cache_setup);
+
+static int contig_class(size_t size)
+{
+	int class = fls(size >> PAGE_SHIFT) - 1;
+
+	return min(class, CONTIG_CLASSES - 1);
+}
+
+static void contig_release(struct contig_buf *buf)
+{
+	if (buf->reserved) {
+		gen_pool_free(contig_pool, (unsigned long)buf->vaddr, buf->size);
+		contig_stats.reserved_used -= buf->size;
+	} else {
+		dma_free_coherent(NULL, buf->size, buf->vaddr, buf->paddr);
+	}
+	kfree(buf);
+}
+
+static void contig_uncache(struct contig_buf *buf)
+{
+	list_del(&buf->node);
+	list_del(&buf->lru);
+	contig_stats.cached_bytes -= buf->size;
+}
+
+static void contig_trim(size_t limit)
+{
+	struct contig_buf *buf;
+
+	while (contig_stats.cached_bytes > limit) {
+		buf = list_first_entry(&contig_lru, struct contig_buf, lru);
+		contig_uncache(buf);
+		contig_release(buf);
+		contig_stats.evictions++;
+	}
+}
+
+/*
+ * A cached buffer fits if it is large enough and wastes at most an eighth
+ * of the request; looking one class up catches sizes just over a boundary.
+ */
+static struct contig_buf *contig_lookup(size_t size)
+{
+	struct contig_buf *buf;
+	int class = contig_class(size);
+	int last = min(class + 1, CONTIG_CLASSES - 1);
+
+	for (; class <= last; class++) {
+		list_for_each_entry(buf, &contig_free_lists[class], node) {
+			if (buf->size >= size && buf->size - size <= size / 8)
+				return buf;
+		}
+	}
+	return NULL;
+}
+
+static struct contig_buf *contig_new(size_t size)
+{
+	struct contig_buf *buf;
+	unsigned long addr;
+
+	buf = kzalloc(sizeof(*buf), GFP_KERNEL);
+	if (!buf)
+		return NULL;
+	buf->size = size;
+
+	if (contig_pool) {
+		addr = gen_pool_alloc(contig_pool, size);
+		if (addr) {
+			buf->vaddr = (void *)addr;
+			buf->paddr = contig_reserve_paddr +
+				     (addr - (unsigned long)contig_reserve_vaddr);
+			buf->reserved = true;
+			contig_stats.reserved_allocs++;
+			contig_stats.reserved_used += size;
+			return buf;
+		}
+	}
+
+	buf->vaddr = dma_alloc_coherent(NULL, size, &buf->paddr,
+					GFP_DMA | GFP_KERNEL);
+	if (!buf->vaddr && contig_stats.cached_bytes) {
+		/* cached buffers may be what fragments the dma area, drop them */
+		contig_trim(0);
+		contig_stats.flushes++;
+		buf->vaddr = dma_alloc_coherent(NULL, size, &buf->paddr,
+						GFP_DMA | GFP_KERNEL);
+	}
+	if (!buf->vaddr) {
+		kfree(buf);
+		return NULL;
+	}
+	contig_stats.fresh_allocs++;
+	return buf;
+}
+
+/*!
+ * Allocate a physically contiguous, coherent buffer on behalf of owner.
+ *
+ * @param	owner		client cookie for contig_free_owner()
+ * @param	size		size in bytes
+ * @param	dma_addr	returns the physical address
+ *
+ * @return	kernel virtual address of the zeroed buffer, or NULL
+ */
+void *contig_alloc(void *owner, size_t size, dma_addr_t *dma_addr)
+{
+	struct contig_buf *buf;
+	bool dirty;
+
+	if (!size || !contig_ready)
+		return NULL;
+	size = PAGE_ALIGN(size);
+
+	mutex_lock(&contig_lock);
+
+	buf = contig_lookup(size);
+	if (buf) {
+		contig_uncache(buf);
+		contig_stats.hits++;
+		dirty = true;
+	} else {
+		contig_stats.misses++;
+		buf = contig_new(size);
+		if (!buf) {
+			contig_stats.failures++;
+			mutex_unlock(&contig_lock);
+			return NULL;
+		}
+		/* dma_alloc_coherent() clears, the reserved region does not */
+		dirty = buf->reserved;
+	}
+
+	buf->owner = owner;
+	buf->used = size;
+	list_add(&buf->node, &contig_busy);
+	contig_stats.busy_bytes += buf->size;
+	contig_stats.slack_bytes += buf->size - buf->used;
+
+	mutex_unlock(&contig_lock);
+
+	/*
+	 * The buffer may still hold another client's frames, and it is about
+	 * to be mapped into user space. Clear it outside the lock; nobody
+	 * else knows its address yet.
+	 */
+	if (dirty)
+		memset(buf->vaddr, 0, buf->size);
+
+	*dma_addr = buf->paddr;
+	return buf->vaddr;
+}
+EXPORT_SYMBOL(contig_alloc);
+
+static void contig_put(struct contig_buf *buf)
+{
+	list_del(&buf->node);
+	contig_stats.busy_bytes -= buf->size;
+	contig_stats.slack_bytes -= buf->size - buf->used;
+
+	/* reserved buffers go straight back so the region can coalesce */
+	if (buf->reserved || !contig_cache_max) {
+		contig_release(buf);
+		return;
+	}
+
+	buf->owner = NULL;
+	list_add(&buf->node, &contig_free_lists[contig_class(buf->size)]);
+	list_add_tail(&buf->lru, &contig_lru);
+	contig_stats.cached_bytes += buf->size;
+	contig_trim(contig_cache_max);
+}
+
+/*!
+ * Return a buffer from contig_alloc(). Any client may free any buffer, as
+ * with the dma_free_coherent() calls this replaces.
+ *
+ * @return	0, or -EINVAL if the buffer is not from this pool
+ */
+int contig_free(void *vaddr, dma_addr_t dma_addr, size_t size)
+{
+	struct contig_buf *buf;
+	int ret = -EINVAL;
+
+	mutex_lock(&contig_lock);
+	list_for_each_entry(buf, &contig_busy, node) {
+		if (buf->paddr == dma_addr && buf->vaddr == vaddr) {
+			contig_put(buf);
+			ret = 0;
+			break;
+		}
+	}
+	mutex_unlock(&contig_lock);
+
+	if (ret)
+		pr_warning("contig: free of unknown buffer 0x%08x\n", dma_addr);
+	return ret;
+}
+EXPORT_SYMBOL(contig_free);
+
+/*!
+ * Return every buffer owner still holds, for use on close.
+ */
+void contig_free_owner(void *owner)
+{
+	struct contig_buf *buf, *n;
+
+	mutex_lock(&contig_lock);
+	list_for_each_entry_safe(buf, n, &contig_busy, node) {
+		if (buf->owner == owner)
+			contig_put(buf);
+	}
+	mutex_unlock(&contig_lock);
+}
+EXPORT_SYMBOL(contig_free_owner);
+
+static void contig_cpu_access_run(unsigned long uaddr, phys_addr_t paddr,
+				  size_t size, bool begin)
+{
+	/* same order as the streaming dma api: outer first towards the cpu */
+	if (begin) {
+		outer_inv_range(paddr, paddr + size);
+		dmac_unmap_area((const void *)uaddr, size, DMA_FROM_DEVICE);
+	} else {
+		dmac_map_area((const void *)uaddr, size, DMA_TO_DEVICE);
+		outer_clean_range(paddr, paddr + size);
+	}
+}
+
+/*!
+ * Cache maintenance on a user range of a pfn mapping, by the caller's own
+ * virtual addresses so only the lines of that range are touched.
+ * Physically contiguous runs are handled in one go.
+ *
+ * @param	uaddr		start of the range in the current process
+ * @param	size		length in bytes
+ * @param	begin		true before the cpu reads or writes, false after
+ * @param	wrote		on end, whether the cpu wrote; nothing to do if not
+ *
+ * @return	0, or -EINVAL if the range is not a pfn mapping
+ */
+int contig_cpu_access(unsigned long uaddr, size_t size, bool begin, bool wrote)
+{
+	struct mm_struct *mm = current->mm;
+	struct vm_area_struct *vma = NULL;
+	unsigned long end = uaddr + size;
+	unsigned long addr, next, pfn;
+	unsigned long run_start = 0;
+	phys_addr_t run_pa = 0, pa;
+	size_t run_len = 0;
+	int ret = 0;
+
+	if (!size || end < uaddr)
+		return -EINVAL;
+	if (!begin && !wrote)
+		return 0;
+
+	down_read(&mm->mmap_sem);
+	for (addr = uaddr; addr < end; addr = next) {
+		if (!vma || addr >= vma->vm_end) {
+			vma = find_vma(mm, addr);
+			if (!vma || vma->vm_start > addr ||
+			    !(vma->vm_flags & VM_PFNMAP)) {
+				ret = -EINVAL;
+				break;
+			}
+		}
+		ret = follow_pfn(vma, addr, &pfn);
+		if (ret)
+			break;
+
+		next = min(end, (addr & PAGE_MASK) + PAGE_SIZE);
+		pa = __pfn_to_phys(pfn) + (addr & ~PAGE_MASK);
+
+		if (run_len && run_pa + run_len == pa) {
+			run_len += next - addr;
+			continue;
+		}
+		if (run_len)
+			contig_cpu_access_run(run_start, run_pa, run_len, begin);
+		run_start = addr;
+		run_pa = pa;
+		run_len = next - addr;
+	}
+	if (!ret && run_len)
+		contig_cpu_access_run(run_start, run_pa, run_len, begin);
+	up_read(&mm->mmap_sem);
+
+	return ret;
+}
+EXPORT_SYMBOL(contig_cpu_access);
+
+static int contig_stats_show(struct seq_file *s, void *unused)
+{
+	struct contig_stats stats;
+	struct contig_buf *buf;
+	unsigned int count[CONTIG_CLASSES];
+	int i;
+
+	memset(count, 0, sizeof(count));
+
+	mutex_lock(&contig_lock);
+	stats = contig_stats;
+	for (i = 0; i < CONTIG_CLASSES; i++)
+		list_for_each_entry(buf, &contig_free_lists[i], node)
+			count[i]++;
+	mutex_unlock(&contig_lock);
+
+	seq_printf(s, "hits:        %lu\n", stats.hits);
+	seq_printf(s, "misses:      %lu (%lu reserved, %lu fresh, %lu failed)\n",
+		   stats.misses, stats.reserved_allocs, stats.fresh_allocs,
+		   stats.failures);
+	seq_printf(s, "evictions:   %lu, flushes %lu\n",
+		   stats.evictions, stats.flushes);
+	seq_printf(s, "busy:        %zu KB, %zu KB slack\n",
+		   stats.busy_bytes >> 10, stats.slack_bytes >> 10);
+	seq_printf(s, "cached:      %zu KB of %zu KB\n",
+		   stats.cached_bytes >> 10, contig_cache_max >> 10);
+	seq_printf(s, "reserved:    %zu KB of %zu KB in use\n",
+		   stats.reserved_used >> 10, contig_reserve_size >> 10);
+	seq_printf(s, "cached by class (pages):\n");
+	for (i = 0; i < CONTIG_CLASSES; i++)
+		seq_printf(s, "  %5lu%c: %u\n", 1UL << i,
+			   (i == CONTIG_CLASSES - 1) ? '+' : ' ', count[i]);
+
+	return 0;
+}
+
+static int contig_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, contig_stats_show, inode->i_private);
+}
+
+static const struct file_operations contig_stats_fops = {
+	.owner = THIS_MODULE,
+	.open = contig_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int __init contig_init(void)
+{
+	int i;
+
+	for (i = 0; i < CONTIG_CLASSES; i++)
+		INIT_LIST_HEAD(&contig_free_lists[i]);
+
+	if (contig_reserve_size) {
+		contig_reserve_vaddr = dma_alloc_coherent(NULL,
+							  contig_reserve_size,
+							  &contig_reserve_paddr,
+							  GFP_DMA | GFP_KERNEL);
+		contig_pool = gen_pool_create(PAGE_SHIFT, -1);
+		if (!contig_reserve_vaddr || !contig_pool ||
+		    gen_pool_add(contig_pool, (unsigned long)contig_reserve_vaddr,
+				 contig_reserve_size, -1)) {
+			printk(KERN_ERR "contig: unable to reserve %zu KB\n",
+			       contig_reserve_size >> 10);
+			if (contig_pool)
+				gen_pool_destroy(contig_pool);
+			if (contig_reserve_vaddr)
+				dma_free_coherent(NULL, contig_reserve_size,
+						  contig_reserve_vaddr,
+						  contig_reserve_paddr);
+			contig_pool = NULL;
+			contig_reserve_size = 0;
+		} else {
+			pr_info("contig: %zu KB reserved at 0x%08x\n",
+				contig_reserve_size >> 10, contig_reserve_paddr);
+		}
+	}
+
+	contig_ready = true;
+
+	debugfs_create_file("contig_alloc", S_IRUGO, NULL, NULL,
+			    &contig_stats_fops);
+
+	return 0;
+}
+/* early enough to find unfragmented memory, late enough for the dma area */
+fs_initcall(contig_init);
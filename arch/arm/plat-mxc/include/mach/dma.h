@@ -12,6 +12,7 @@
 #include <linux/scatterlist.h>
 #include <linux/device.h>
 #include <linux/dmaengine.h>
+#include <linux/ktime.h>
 
 /*
  * This enumerates peripheral types. Used for SDMA.
@@ -51,6 +52,7 @@ struct imx_dma_data {
 	int dma_request; /* DMA request line */
 	enum sdma_peripheral_type peripheral_type;
 	int priority;
+	int num_bd; /* descriptors to reserve up front, 0 for one page */
 };
 
 struct imx_pcm_dma_params {
@@ -71,4 +73,36 @@ static inline int imx_dma_is_general_purpose(struct dma_chan *chan)
 		!strcmp(dev_name(chan->device->dev), "imx-dma");
 }
 
+static inline int imx_dma_is_sdma(struct dma_chan *chan)
+{
+	return !strcmp(dev_name(chan->device->dev), "imx-sdma");
+}
+
+/*
+ * Progress of a cyclic SDMA transfer: period is the index of the most
+ * recently completed period, count the periods completed since the
+ * transfer was prepared and stamp the time its interrupt was serviced.
+ */
+struct imx_dma_period_stamp {
+	unsigned int period;
+	unsigned int count;
+	ktime_t stamp;
+};
+
+/*
+ * Built-in callers cannot link against a modular imx-sdma; they get the
+ * stub and fall back to whatever they do on other engines.
+ */
+#if defined(CONFIG_IMX_SDMA) || \
+	(defined(CONFIG_IMX_SDMA_MODULE) && defined(MODULE))
+int imx_sdma_get_period_stamp(struct dma_chan *chan,
+		struct imx_dma_period_stamp *ps);
+#else
+static inline int imx_sdma_get_period_stamp(struct dma_chan *chan,
+		struct imx_dma_period_stamp *ps)
+{
+	return -ENODEV;
+}
+#endif
+
 #endif
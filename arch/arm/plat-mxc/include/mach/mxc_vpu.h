@@ -44,6 +44,31 @@ struct vpu_mem_desc {
 	u32 virt_uaddr;		/* virtual user space address */
 };
 
+/* range of a cached physmem mapping for VPU_IOC_CPU_ACCESS_BEGIN/END */
+struct vpu_cpu_access {
+	u32 virt_uaddr;
+	u32 size;
+	u32 flags;
+};
+
+#define VPU_CPU_ACCESS_WRITE	0x1	/* on end: the cpu wrote, clean */
+
+/*
+ * VPU_IOC_SCHED_REQUEST: ask for the vpu for this instance. While an
+ * instance holds it, VPU_IOC_WAIT4INT and poll() only report that
+ * instance's interrupts; VPU_IOC_SCHED_RELEASE hands it to the next one.
+ * Higher priority goes first, equal priorities take turns, and priorities
+ * above VPU_SCHED_PRIO_NORMAL need CAP_SYS_NICE.
+ */
+struct vpu_sched_req {
+	u32 priority;
+	u32 flags;
+};
+
+#define VPU_SCHED_PRIO_NORMAL	0
+#define VPU_SCHED_PRIO_MAX	7
+#define VPU_SCHED_NONBLOCK	0x1	/* -EAGAIN if not granted at once */
+
 #define VPU_IOC_MAGIC  'V'
 
 #define VPU_IOC_PHYMEM_ALLOC	_IO(VPU_IOC_MAGIC, 0)
@@ -59,6 +84,11 @@ struct vpu_mem_desc {
 #define VPU_IOC_GET_USER_DATA_ADDR   _IO(VPU_IOC_MAGIC, 10)
 #define VPU_IOC_SYS_SW_RESET	_IO(VPU_IOC_MAGIC, 11)
 #define VPU_IOC_GET_SHARE_MEM   _IO(VPU_IOC_MAGIC, 12)
+#define VPU_IOC_SET_MMAP_CACHED	_IO(VPU_IOC_MAGIC, 13)
+#define VPU_IOC_CPU_ACCESS_BEGIN	_IO(VPU_IOC_MAGIC, 14)
+#define VPU_IOC_CPU_ACCESS_END	_IO(VPU_IOC_MAGIC, 15)
+#define VPU_IOC_SCHED_REQUEST	_IO(VPU_IOC_MAGIC, 16)
+#define VPU_IOC_SCHED_RELEASE	_IO(VPU_IOC_MAGIC, 17)
 
 #define BIT_CODE_RUN			0x000
 #define BIT_CODE_DOWN			0x004
@@ -22,11 +22,25 @@
 #include <linux/module.h>
 #include <linux/spinlock.h>
 #include <linux/genalloc.h>
+#include <linux/mm.h>
+#include <linux/mutex.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/iram_alloc.h>
 #include <mach/iram.h>
 
 static unsigned long iram_phys_base;
 static void __iomem *iram_virt_base;
 static struct gen_pool *iram_pool;
+static unsigned long iram_size;
+
+/* iram_alloc() users keep their memory for good */
+static atomic_t iram_pinned = ATOMIC_INIT(0);
+
+/* registered iram_request() users, in grant order */
+static DEFINE_MUTEX(iram_lock);
+static LIST_HEAD(iram_clients);
+static unsigned long iram_granted;
 
 static inline void __iomem *iram_phys_to_virt(unsigned long p)
 {
@@ -42,6 +56,7 @@ void __iomem *iram_alloc(unsigned int size, unsigned long *dma_addr)
 	pr_debug("iram alloc - %dB@0x%lX\n", size, *dma_addr);
 	if (!*dma_addr)
 		return NULL;
+	atomic_add(PAGE_ALIGN(size), &iram_pinned);
 	return iram_phys_to_virt(*dma_addr);
 }
 EXPORT_SYMBOL(iram_alloc);
@@ -52,12 +67,160 @@ void iram_free(unsigned long addr, unsigned int size)
 		return;
 
 	gen_pool_free(iram_pool, addr, size);
+	atomic_sub(PAGE_ALIGN(size), &iram_pinned);
 }
 EXPORT_SYMBOL(iram_free);
 
+void iram_client_register(struct iram_client *client)
+{
+	client->size = 0;
+	mutex_lock(&iram_lock);
+	list_add_tail(&client->list, &iram_clients);
+	mutex_unlock(&iram_lock);
+}
+EXPORT_SYMBOL(iram_client_register);
+
+static void __iram_release(struct iram_client *client)
+{
+	gen_pool_free(iram_pool, client->dma_addr, client->size);
+	iram_granted -= client->size;
+	client->size = 0;
+	client->dma_addr = 0;
+	client->virt = NULL;
+}
+
+void iram_client_unregister(struct iram_client *client)
+{
+	mutex_lock(&iram_lock);
+	if (client->size)
+		__iram_release(client);
+	list_del(&client->list);
+	mutex_unlock(&iram_lock);
+}
+EXPORT_SYMBOL(iram_client_unregister);
+
+/*
+ * The client to evict for a request at prio: the lowest priority one below
+ * it, the longest holder among equals.
+ */
+static struct iram_client *iram_pick_victim(int prio)
+{
+	struct iram_client *client, *victim = NULL;
+
+	list_for_each_entry(client, &iram_clients, list) {
+		if (!client->size || !client->reclaim ||
+		    client->priority >= prio)
+			continue;
+		if (!victim || client->priority < victim->priority)
+			victim = client;
+	}
+	return victim;
+}
+
+int iram_request(struct iram_client *client, unsigned int size)
+{
+	struct iram_client *victim;
+	unsigned long addr;
+
+	if (!iram_pool)
+		return -ENODEV;
+
+	size = PAGE_ALIGN(size);
+
+	mutex_lock(&iram_lock);
+	if (client->size) {
+		mutex_unlock(&iram_lock);
+		return -EBUSY;
+	}
+
+	client->requests++;
+	while (!(addr = gen_pool_alloc(iram_pool, size))) {
+		victim = iram_pick_victim(client->priority);
+		if (!victim)
+			break;
+
+		pr_debug("iram: %s evicts %s (%uB)\n", client->name,
+			 victim->name, victim->size);
+		victim->reclaim(victim);
+		victim->evictions++;
+		__iram_release(victim);
+	}
+	if (!addr) {
+		client->failures++;
+		mutex_unlock(&iram_lock);
+		return -ENOMEM;
+	}
+
+	client->dma_addr = addr;
+	client->virt = iram_phys_to_virt(addr);
+	client->size = size;
+	iram_granted += size;
+	/* keep grant order, the oldest holder is evicted first */
+	list_move_tail(&client->list, &iram_clients);
+	mutex_unlock(&iram_lock);
+
+	pr_debug("iram: %s got %uB@0x%lX\n", client->name, size, addr);
+	return 0;
+}
+EXPORT_SYMBOL(iram_request);
+
+void iram_release(struct iram_client *client)
+{
+	mutex_lock(&iram_lock);
+	if (client->size)
+		__iram_release(client);
+	mutex_unlock(&iram_lock);
+}
+EXPORT_SYMBOL(iram_release);
+
+static int iram_stats_show(struct seq_file *s, void *unused)
+{
+	struct iram_client *client;
+	unsigned long pinned = atomic_read(&iram_pinned);
+
+	mutex_lock(&iram_lock);
+	seq_printf(s, "size:    %lu KB, %lu KB pinned, %lu KB granted, "
+		   "%lu KB free\n", iram_size >> 10, pinned >> 10,
+		   iram_granted >> 10,
+		   (iram_size - pinned - iram_granted) >> 10);
+	seq_printf(s, "%-16s %4s %8s %8s %8s %9s\n", "client", "prio",
+		   "size", "requests", "failures", "evictions");
+	list_for_each_entry(client, &iram_clients, list)
+		seq_printf(s, "%-16s %4d %8u %8lu %8lu %9lu\n",
+			   client->name, client->priority, client->size,
+			   client->requests, client->failures,
+			   client->evictions);
+	mutex_unlock(&iram_lock);
+
+	return 0;
+}
+
+static int iram_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, iram_stats_show, inode->i_private);
+}
+
+static const struct file_operations iram_stats_fops = {
+	.owner = THIS_MODULE,
+	.open = iram_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int __init iram_debugfs_init(void)
+{
+	if (iram_pool)
+		debugfs_create_file("iram", S_IRUGO, NULL, NULL,
+				    &iram_stats_fops);
+	return 0;
+}
+late_initcall(iram_debugfs_init);
+
 int __init iram_init(unsigned long base, unsigned long size)
 {
 	iram_phys_base = base;
+	iram_size = size;
 
 	iram_pool = gen_pool_create(PAGE_SHIFT, -1);
 	if (!iram_pool)
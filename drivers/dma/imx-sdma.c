@@ -18,6 +18,7 @@
  */
 
 #include <linux/init.h>
+#include <linux/delay.h>
 #include <linux/types.h>
 #include <linux/mm.h>
 #include <linux/interrupt.h>
@@ -32,6 +33,9 @@
 #include <linux/slab.h>
 #include <linux/platform_device.h>
 #include <linux/dmaengine.h>
+#include <linux/ktime.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include <asm/irq.h>
 #include <mach/sdma.h>
@@ -223,6 +227,14 @@ struct sdma_context_data {
 } __attribute__ ((packed));
 
 #define NUM_BD (int)(PAGE_SIZE / sizeof(struct sdma_buffer_descriptor))
+/*
+ * The SDMA walks the descriptors of a channel contiguously from
+ * base_bd_ptr, so a transfer may use more than one page of them.
+ */
+#define SDMA_MAX_BD_PAGES	16
+#define SDMA_MAX_BD		(NUM_BD * SDMA_MAX_BD_PAGES)
+/* largest memcpy chunk per descriptor that keeps 32bit alignment */
+#define SDMA_BD_MAX_CNT		0xfffc
 
 struct sdma_engine;
 
@@ -238,7 +250,21 @@ struct sdma_engine;
  * @word_size		peripheral access size
  * @buf_tail		ID of the buffer that was processed
  * @done		channel completion
- * @num_bd		max NUM_BD. number of descriptors currently handling
+ * @num_bd		number of descriptors currently handling
+ * @bd_size		size of the descriptor array in bytes, at least a page
+ * @bd_old		array replaced while interrupts were off, freed later
+ * @bd_old_phys		its bus address
+ * @bd_old_size		its size in bytes
+ * @period_last		index of the last completed period (cyclic only)
+ * @period_count	periods completed since the cyclic transfer was set up
+ * @period_stamp	time the SDMA interrupt reported @period_last
+ * @priority		priority the client asked for
+ * @hw_priority		priority currently programmed, 0 while unused
+ * @bytes		bytes transferred since the channel was allocated
+ * @bds			descriptors completed since the channel was allocated
+ * @irqs		interrupts handled since the channel was allocated
+ * @lat_total_us	sum of the interrupt to callback latencies
+ * @lat_max_us		worst interrupt to callback latency
  */
 struct sdma_channel {
 	struct sdma_engine		*sdma;
@@ -253,7 +279,12 @@ struct sdma_channel {
 	unsigned int			num_bd;
 	struct sdma_buffer_descriptor	*bd;
 	dma_addr_t			bd_phys;
+	size_t				bd_size;
+	struct sdma_buffer_descriptor	*bd_old;
+	dma_addr_t			bd_old_phys;
+	size_t				bd_old_size;
 	unsigned int			pc_from_device, pc_to_device;
+	unsigned int			pc_to_pc;
 	unsigned long			flags;
 	dma_addr_t			per_address;
 	u32				event_mask0, event_mask1;
@@ -264,6 +295,16 @@ struct sdma_channel {
 	struct dma_async_tx_descriptor	desc;
 	dma_cookie_t			last_completed;
 	enum dma_status			status;
+	unsigned int			period_last;
+	unsigned int			period_count;
+	ktime_t				period_stamp;
+	unsigned int			priority;
+	unsigned int			hw_priority;
+	u64				bytes;
+	unsigned long			bds;
+	unsigned long			irqs;
+	u64				lat_total_us;
+	unsigned int			lat_max_us;
 };
 
 #define IMX_DMA_SG_LOOP		(1 << 0)
@@ -272,6 +313,12 @@ struct sdma_channel {
 #define MXC_SDMA_DEFAULT_PRIORITY 1
 #define MXC_SDMA_MIN_PRIORITY 1
 #define MXC_SDMA_MAX_PRIORITY 7
+/*
+ * Cyclic channels feed isochronous peripherals (audio) which underrun when
+ * bulk channels hold the engine, so they run above any client priority.
+ * 7 stays reserved for channel 0.
+ */
+#define MXC_SDMA_ISOC_PRIORITY 6
 
 #define SDMA_FIRMWARE_MAGIC 0x414d4453
 
@@ -309,6 +356,7 @@ struct sdma_engine {
 	unsigned int			num_events;
 	struct sdma_context_data	*context;
 	dma_addr_t			context_phys;
+	spinlock_t			channel_0_lock;
 	struct dma_device		dma_device;
 	struct clk			*clk;
 	struct sdma_script_start_addrs	*script_addrs;
@@ -363,21 +411,41 @@ static int sdma_config_ownership(struct sdma_channel *sdmac,
 }
 
 /*
- * sdma_run_channel - run a channel and wait till it's done
+ * sdma_run_channel0 - run channel 0 and busy-wait till it's done
+ *
+ * Channel 0 loads contexts from the prep callbacks, which may be called in
+ * atomic context, so poll its interrupt bit instead of sleeping on it. The
+ * caller holds channel_0_lock, which also covers bd0 and sdma->context.
  */
-static int sdma_run_channel(struct sdma_channel *sdmac)
+static int sdma_run_channel0(struct sdma_engine *sdma)
 {
-	struct sdma_engine *sdma = sdmac->sdma;
-	int channel = sdmac->channel;
-	int ret;
+	unsigned int timeout = 500;
+	u32 stat;
 
-	init_completion(&sdmac->done);
+	__raw_writel(1, sdma->regs + SDMA_H_START);
 
-	__raw_writel(1 << channel, sdma->regs + SDMA_H_START);
+	while (!(stat = __raw_readl(sdma->regs + SDMA_H_INTR) & 1)) {
+		if (!timeout--)
+			break;
+		udelay(1);
+	}
+
+	if (!stat) {
+		/*
+		 * Stop the channel and drop a completion that raced the
+		 * timeout. The interrupt handler leaves bit 0 to us, so a
+		 * stale one would keep the line asserted and let the next
+		 * load return before it has run.
+		 */
+		__raw_writel(1, sdma->regs + SDMA_H_STATSTOP);
+		__raw_writel(1, sdma->regs + SDMA_H_INTR);
+		dev_err(sdma->dev, "timeout waiting for channel 0\n");
+		return -ETIMEDOUT;
+	}
 
-	ret = wait_for_completion_timeout(&sdmac->done, HZ);
+	__raw_writel(stat, sdma->regs + SDMA_H_INTR);
 
-	return ret ? 0 : -ETIMEDOUT;
+	return 0;
 }
 
 static int sdma_load_script(struct sdma_engine *sdma, void *buf, int size,
@@ -386,6 +454,7 @@ static int sdma_load_script(struct sdma_engine *sdma, void *buf, int size,
 	struct sdma_buffer_descriptor *bd0 = sdma->channel[0].bd;
 	void *buf_virt;
 	dma_addr_t buf_phys;
+	unsigned long flags;
 	int ret;
 
 	buf_virt = dma_alloc_coherent(NULL,
@@ -394,6 +463,8 @@ static int sdma_load_script(struct sdma_engine *sdma, void *buf, int size,
 	if (!buf_virt)
 		return -ENOMEM;
 
+	spin_lock_irqsave(&sdma->channel_0_lock, flags);
+
 	bd0->mode.command = C0_SETPM;
 	bd0->mode.status = BD_DONE | BD_INTR | BD_WRAP | BD_EXTD;
 	bd0->mode.count = size / 2;
@@ -402,7 +473,9 @@ static int sdma_load_script(struct sdma_engine *sdma, void *buf, int size,
 
 	memcpy(buf_virt, buf, size);
 
-	ret = sdma_run_channel(&sdma->channel[0]);
+	ret = sdma_run_channel0(sdma);
+
+	spin_unlock_irqrestore(&sdma->channel_0_lock, flags);
 
 	dma_free_coherent(NULL, size, buf_virt, buf_phys);
 
@@ -433,7 +506,23 @@ static void sdma_event_disable(struct sdma_channel *sdmac, unsigned int event)
 	__raw_writel(val, sdma->regs + chnenbl);
 }
 
-static void sdma_handle_channel_loop(struct sdma_channel *sdmac)
+/*
+ * sdma_account_callback - latency from the interrupt to calling back
+ */
+static void sdma_account_callback(struct sdma_channel *sdmac, ktime_t stamp)
+{
+	unsigned int lat = ktime_us_delta(ktime_get(), stamp);
+
+	spin_lock(&sdmac->lock);
+	sdmac->irqs++;
+	sdmac->lat_total_us += lat;
+	if (lat > sdmac->lat_max_us)
+		sdmac->lat_max_us = lat;
+	spin_unlock(&sdmac->lock);
+}
+
+static void sdma_handle_channel_loop(struct sdma_channel *sdmac,
+		ktime_t stamp)
 {
 	struct sdma_buffer_descriptor *bd;
 
@@ -453,18 +542,31 @@ static void sdma_handle_channel_loop(struct sdma_channel *sdmac)
 			sdmac->status = DMA_IN_PROGRESS;
 
 		bd->mode.status |= BD_DONE;
+
+		spin_lock(&sdmac->lock);
+		sdmac->period_last = sdmac->buf_tail;
+		sdmac->period_count++;
+		sdmac->period_stamp = stamp;
+		sdmac->bytes += bd->mode.count;
+		sdmac->bds++;
+		spin_unlock(&sdmac->lock);
+
 		sdmac->buf_tail++;
 		sdmac->buf_tail %= sdmac->num_bd;
 
+		sdma_account_callback(sdmac, stamp);
+
 		if (sdmac->desc.callback)
 			sdmac->desc.callback(sdmac->desc.callback_param);
 	}
 }
 
-static void mxc_sdma_handle_channel_normal(struct sdma_channel *sdmac)
+static void mxc_sdma_handle_channel_normal(struct sdma_channel *sdmac,
+		ktime_t stamp)
 {
 	struct sdma_buffer_descriptor *bd;
 	int i, error = 0;
+	u32 bytes = 0;
 
 	/*
 	 * non loop mode. Iterate over all descriptors, collect
@@ -475,6 +577,7 @@ static void mxc_sdma_handle_channel_normal(struct sdma_channel *sdmac)
 
 		 if (bd->mode.status & (BD_DONE | BD_RROR))
 			error = -EIO;
+		bytes += bd->mode.count;
 	}
 
 	if (error)
@@ -482,12 +585,20 @@ static void mxc_sdma_handle_channel_normal(struct sdma_channel *sdmac)
 	else
 		sdmac->status = DMA_SUCCESS;
 
+	spin_lock(&sdmac->lock);
+	sdmac->bytes += bytes;
+	sdmac->bds += sdmac->num_bd;
+	spin_unlock(&sdmac->lock);
+
+	sdma_account_callback(sdmac, stamp);
+
 	if (sdmac->desc.callback)
 		sdmac->desc.callback(sdmac->desc.callback_param);
 	sdmac->last_completed = sdmac->desc.cookie;
 }
 
-static void mxc_sdma_handle_channel(struct sdma_channel *sdmac)
+static void mxc_sdma_handle_channel(struct sdma_channel *sdmac,
+		ktime_t stamp)
 {
 	complete(&sdmac->done);
 
@@ -496,24 +607,26 @@ static void mxc_sdma_handle_channel(struct sdma_channel *sdmac)
 		return;
 
 	if (sdmac->flags & IMX_DMA_SG_LOOP)
-		sdma_handle_channel_loop(sdmac);
+		sdma_handle_channel_loop(sdmac, stamp);
 	else
-		mxc_sdma_handle_channel_normal(sdmac);
+		mxc_sdma_handle_channel_normal(sdmac, stamp);
 }
 
 static irqreturn_t sdma_int_handler(int irq, void *dev_id)
 {
 	struct sdma_engine *sdma = dev_id;
+	ktime_t stamp = ktime_get();
 	u32 stat;
 
-	stat = __raw_readl(sdma->regs + SDMA_H_INTR);
+	/* channel 0 is polled by sdma_run_channel0, leave its bit alone */
+	stat = __raw_readl(sdma->regs + SDMA_H_INTR) & ~1;
 	__raw_writel(stat, sdma->regs + SDMA_H_INTR);
 
 	while (stat) {
 		int channel = fls(stat) - 1;
 		struct sdma_channel *sdmac = &sdma->channel[channel];
 
-		mxc_sdma_handle_channel(sdmac);
+		mxc_sdma_handle_channel(sdmac, stamp);
 
 		stat &= ~(1 << channel);
 	}
@@ -537,6 +650,7 @@ static void sdma_get_pc(struct sdma_channel *sdmac,
 
 	sdmac->pc_from_device = 0;
 	sdmac->pc_to_device = 0;
+	sdmac->pc_to_pc = 0;
 
 	switch (peripheral_type) {
 	case IMX_DMATYPE_MEMORY:
@@ -602,6 +716,7 @@ static void sdma_get_pc(struct sdma_channel *sdmac,
 
 	sdmac->pc_from_device = per_2_emi;
 	sdmac->pc_to_device = emi_2_per;
+	sdmac->pc_to_pc = emi_2_emi;
 }
 
 static int sdma_load_context(struct sdma_channel *sdmac)
@@ -611,9 +726,12 @@ static int sdma_load_context(struct sdma_channel *sdmac)
 	int load_address;
 	struct sdma_context_data *context = sdma->context;
 	struct sdma_buffer_descriptor *bd0 = sdma->channel[0].bd;
+	unsigned long flags;
 	int ret;
 
-	if (sdmac->direction == DMA_FROM_DEVICE) {
+	if (sdmac->peripheral_type == IMX_DMATYPE_MEMORY) {
+		load_address = sdmac->pc_to_pc;
+	} else if (sdmac->direction == DMA_FROM_DEVICE) {
 		load_address = sdmac->pc_from_device;
 	} else {
 		load_address = sdmac->pc_to_device;
@@ -629,6 +747,8 @@ static int sdma_load_context(struct sdma_channel *sdmac)
 	dev_dbg(sdma->dev, "event_mask0 = 0x%08x\n", sdmac->event_mask0);
 	dev_dbg(sdma->dev, "event_mask1 = 0x%08x\n", sdmac->event_mask1);
 
+	spin_lock_irqsave(&sdma->channel_0_lock, flags);
+
 	memset(context, 0, sizeof(*context));
 	context->channel_state.pc = load_address;
 
@@ -647,7 +767,9 @@ static int sdma_load_context(struct sdma_channel *sdmac)
 	bd0->buffer_addr = sdma->context_phys;
 	bd0->ext_buffer_addr = 2048 + (sizeof(*context) / 4) * channel;
 
-	ret = sdma_run_channel(&sdma->channel[0]);
+	ret = sdma_run_channel0(sdma);
+
+	spin_unlock_irqrestore(&sdma->channel_0_lock, flags);
 
 	return ret;
 }
@@ -725,16 +847,31 @@ static int sdma_set_channel_priority(struct sdma_channel *sdmac,
 	struct sdma_engine *sdma = sdmac->sdma;
 	int channel = sdmac->channel;
 
-	if (priority < MXC_SDMA_MIN_PRIORITY
-	    || priority > MXC_SDMA_MAX_PRIORITY) {
+	/* priority 0 keeps a released channel from being scheduled */
+	if (priority > MXC_SDMA_MAX_PRIORITY)
 		return -EINVAL;
-	}
 
 	__raw_writel(priority, sdma->regs + SDMA_CHNPRI_0 + 4 * channel);
+	sdmac->hw_priority = priority;
 
 	return 0;
 }
 
+/*
+ * sdma_update_priority - apply the client priority, raised for cyclic use
+ */
+static void sdma_update_priority(struct sdma_channel *sdmac)
+{
+	unsigned int priority = sdmac->priority;
+
+	if (sdmac->flags & IMX_DMA_SG_LOOP)
+		priority = max_t(unsigned int, priority,
+				 MXC_SDMA_ISOC_PRIORITY);
+
+	if (priority != sdmac->hw_priority)
+		sdma_set_channel_priority(sdmac, priority);
+}
+
 static int sdma_request_channel(struct sdma_channel *sdmac)
 {
 	struct sdma_engine *sdma = sdmac->sdma;
@@ -748,13 +885,16 @@ static int sdma_request_channel(struct sdma_channel *sdmac)
 	}
 
 	memset(sdmac->bd, 0, PAGE_SIZE);
+	sdmac->bd_size = PAGE_SIZE;
 
 	sdma->channel_control[channel].base_bd_ptr = sdmac->bd_phys;
 	sdma->channel_control[channel].current_bd_ptr = sdmac->bd_phys;
 
 	clk_enable(sdma->clk);
 
-	sdma_set_channel_priority(sdmac, MXC_SDMA_DEFAULT_PRIORITY);
+	if (!sdmac->priority)
+		sdmac->priority = MXC_SDMA_DEFAULT_PRIORITY;
+	sdma_set_channel_priority(sdmac, sdmac->priority);
 
 	init_completion(&sdmac->done);
 
@@ -766,6 +906,70 @@ out:
 	return ret;
 }
 
+static void sdma_free_old_bd(struct sdma_channel *sdmac)
+{
+	if (!sdmac->bd_old)
+		return;
+
+	dma_free_coherent(NULL, sdmac->bd_old_size, sdmac->bd_old,
+			sdmac->bd_old_phys);
+	sdmac->bd_old = NULL;
+}
+
+/*
+ * sdma_alloc_bd - make room for num_bd descriptors on an idle channel
+ *
+ * The prep callbacks pass GFP_NOWAIT, clients that know their worst case
+ * reserve it up front through imx_dma_data.num_bd instead. The ARM
+ * dma_free_coherent() must not run with interrupts off, so an array
+ * replaced then is kept until the next call that can free it.
+ */
+static int sdma_alloc_bd(struct sdma_channel *sdmac, int num_bd, gfp_t gfp)
+{
+	struct sdma_engine *sdma = sdmac->sdma;
+	int channel = sdmac->channel;
+	size_t size = PAGE_ALIGN(num_bd * sizeof(struct sdma_buffer_descriptor));
+	struct sdma_buffer_descriptor *bd;
+	dma_addr_t bd_phys;
+
+	if (size <= sdmac->bd_size)
+		return 0;
+
+	if (num_bd > SDMA_MAX_BD) {
+		dev_err(sdma->dev, "SDMA channel %d: maximum number of descriptors exceeded: %d > %d\n",
+				channel, num_bd, SDMA_MAX_BD);
+		return -EINVAL;
+	}
+
+	if (!irqs_disabled())
+		sdma_free_old_bd(sdmac);
+	else if (sdmac->bd_old)
+		return -ENOMEM;
+
+	bd = dma_alloc_coherent(NULL, size, &bd_phys, gfp);
+	if (!bd)
+		return -ENOMEM;
+
+	memset(bd, 0, size);
+
+	if (irqs_disabled()) {
+		sdmac->bd_old = sdmac->bd;
+		sdmac->bd_old_phys = sdmac->bd_phys;
+		sdmac->bd_old_size = sdmac->bd_size;
+	} else
+		dma_free_coherent(NULL, sdmac->bd_size, sdmac->bd,
+				sdmac->bd_phys);
+
+	sdmac->bd = bd;
+	sdmac->bd_phys = bd_phys;
+	sdmac->bd_size = size;
+
+	sdma->channel_control[channel].base_bd_ptr = bd_phys;
+	sdma->channel_control[channel].current_bd_ptr = bd_phys;
+
+	return 0;
+}
+
 static void sdma_enable_channel(struct sdma_engine *sdma, int channel)
 {
 	__raw_writel(1 << channel, sdma->regs + SDMA_H_START);
@@ -811,10 +1015,20 @@ static int sdma_alloc_chan_resources(struct dma_chan *chan)
 {
 	struct sdma_channel *sdmac = to_sdma_chan(chan);
 	struct imx_dma_data *data = chan->private;
+	struct imx_dma_data mem_data;
 	int prio, ret;
 
-	if (!data)
-		return -EINVAL;
+	/*
+	 * Channels requested without platform data (dmatest and other
+	 * DMA_MEMCPY users) are memory to memory channels.
+	 */
+	if (!data) {
+		mem_data.dma_request = 0;
+		mem_data.peripheral_type = IMX_DMATYPE_MEMORY;
+		mem_data.priority = DMA_PRIO_MEDIUM;
+		mem_data.num_bd = 0;
+		data = &mem_data;
+	}
 
 	switch (data->priority) {
 	case DMA_PRIO_HIGH:
@@ -831,14 +1045,31 @@ static int sdma_alloc_chan_resources(struct dma_chan *chan)
 
 	sdmac->peripheral_type = data->peripheral_type;
 	sdmac->event_id0 = data->dma_request;
-	ret = sdma_set_channel_priority(sdmac, prio);
-	if (ret)
-		return ret;
+	sdmac->priority = prio;
+	sdmac->flags = 0;
+
+	sdmac->bytes = 0;
+	sdmac->bds = 0;
+	sdmac->irqs = 0;
+	sdmac->lat_total_us = 0;
+	sdmac->lat_max_us = 0;
 
 	ret = sdma_request_channel(sdmac);
 	if (ret)
 		return ret;
 
+	ret = sdma_alloc_bd(sdmac, data->num_bd, GFP_KERNEL);
+	if (!ret && sdmac->peripheral_type == IMX_DMATYPE_MEMORY)
+		ret = sdma_config_channel(sdmac);
+	if (ret) {
+		sdma_set_channel_priority(sdmac, 0);
+		dma_free_coherent(NULL, sdmac->bd_size, sdmac->bd,
+				sdmac->bd_phys);
+		sdmac->bd = NULL;
+		clk_disable(sdmac->sdma->clk);
+		return ret;
+	}
+
 	dma_async_tx_descriptor_init(&sdmac->desc, chan);
 	sdmac->desc.tx_submit = sdma_tx_submit;
 	/* txd.flags will be overwritten in prep funcs */
@@ -863,8 +1094,11 @@ static void sdma_free_chan_resources(struct dma_chan *chan)
 	sdmac->event_id1 = 0;
 
 	sdma_set_channel_priority(sdmac, 0);
+	sdmac->priority = 0;
 
-	dma_free_coherent(NULL, PAGE_SIZE, sdmac->bd, sdmac->bd_phys);
+	dma_free_coherent(NULL, sdmac->bd_size, sdmac->bd, sdmac->bd_phys);
+	sdmac->bd = NULL;
+	sdma_free_old_bd(sdmac);
 
 	clk_disable(sdma->clk);
 }
@@ -885,6 +1119,7 @@ static struct dma_async_tx_descriptor *sdma_prep_slave_sg(
 	sdmac->status = DMA_IN_PROGRESS;
 
 	sdmac->flags = 0;
+	sdma_update_priority(sdmac);
 
 	dev_dbg(sdma->dev, "setting up %d entries for channel %d.\n",
 			sg_len, channel);
@@ -894,12 +1129,9 @@ static struct dma_async_tx_descriptor *sdma_prep_slave_sg(
 	if (ret)
 		goto err_out;
 
-	if (sg_len > NUM_BD) {
-		dev_err(sdma->dev, "SDMA channel %d: maximum number of sg exceeded: %d > %d\n",
-				channel, sg_len, NUM_BD);
-		ret = -EINVAL;
+	ret = sdma_alloc_bd(sdmac, sg_len, GFP_NOWAIT);
+	if (ret)
 		goto err_out;
-	}
 
 	for_each_sg(sgl, sg, sg_len, i) {
 		struct sdma_buffer_descriptor *bd = &sdmac->bd[i];
@@ -984,16 +1216,14 @@ static struct dma_async_tx_descriptor *sdma_prep_dma_cyclic(
 	sdmac->status = DMA_IN_PROGRESS;
 
 	sdmac->flags |= IMX_DMA_SG_LOOP;
+	sdma_update_priority(sdmac);
 	sdmac->direction = direction;
 	ret = sdma_load_context(sdmac);
 	if (ret)
 		goto err_out;
 
-	if (num_periods > NUM_BD) {
-		dev_err(sdma->dev, "SDMA channel %d: maximum number of sg exceeded: %d > %d\n",
-				channel, num_periods, NUM_BD);
+	if (sdma_alloc_bd(sdmac, num_periods, GFP_NOWAIT))
 		goto err_out;
-	}
 
 	if (period_len > 0xffff) {
 		dev_err(sdma->dev, "SDMA channel %d: maximum period size exceeded: %d > %d\n",
@@ -1034,6 +1264,10 @@ static struct dma_async_tx_descriptor *sdma_prep_dma_cyclic(
 	}
 
 	sdmac->num_bd = num_periods;
+	sdmac->buf_tail = 0;
+	sdmac->period_last = num_periods - 1;
+	sdmac->period_count = 0;
+	sdmac->period_stamp = ktime_set(0, 0);
 	sdma->channel_control[channel].current_bd_ptr = sdmac->bd_phys;
 
 	return &sdmac->desc;
@@ -1042,6 +1276,107 @@ err_out:
 	return NULL;
 }
 
+static struct dma_async_tx_descriptor *sdma_prep_dma_memcpy(
+		struct dma_chan *chan, dma_addr_t dest, dma_addr_t src,
+		size_t len, unsigned long flags)
+{
+	struct sdma_channel *sdmac = to_sdma_chan(chan);
+	struct sdma_engine *sdma = sdmac->sdma;
+	int channel = sdmac->channel;
+	int ret, i, num_bd, command;
+
+	if (!len || sdmac->peripheral_type != IMX_DMATYPE_MEMORY)
+		return NULL;
+
+	if (sdmac->status == DMA_IN_PROGRESS)
+		return NULL;
+	sdmac->status = DMA_IN_PROGRESS;
+
+	sdmac->flags = 0;
+	sdma_update_priority(sdmac);
+
+	num_bd = DIV_ROUND_UP(len, SDMA_BD_MAX_CNT);
+
+	dev_dbg(sdma->dev, "memcpy %zu bytes in %d entries on channel %d.\n",
+			len, num_bd, channel);
+
+	ret = sdma_load_context(sdmac);
+	if (ret)
+		goto err_out;
+
+	ret = sdma_alloc_bd(sdmac, num_bd, GFP_NOWAIT);
+	if (ret)
+		goto err_out;
+
+	/* the ap_2_ap script copies in the widest unit all addresses allow */
+	if (!((dest | src | len) & 3))
+		command = 0;
+	else if (!((dest | src | len) & 1))
+		command = 2;
+	else
+		command = 1;
+
+	for (i = 0; i < num_bd; i++) {
+		struct sdma_buffer_descriptor *bd = &sdmac->bd[i];
+		size_t count = min_t(size_t, len, SDMA_BD_MAX_CNT);
+		int param;
+
+		bd->buffer_addr = src;
+		bd->ext_buffer_addr = dest;
+		bd->mode.count = count;
+		bd->mode.command = command;
+
+		param = BD_DONE | BD_EXTD | BD_CONT;
+
+		if (i + 1 == num_bd) {
+			param |= BD_INTR;
+			param |= BD_LAST;
+			param &= ~BD_CONT;
+		}
+
+		bd->mode.status = param;
+
+		src += count;
+		dest += count;
+		len -= count;
+	}
+
+	sdmac->num_bd = num_bd;
+	sdmac->desc.flags = flags;
+	sdma->channel_control[channel].current_bd_ptr = sdmac->bd_phys;
+
+	return &sdmac->desc;
+err_out:
+	sdmac->status = DMA_ERROR;
+	return NULL;
+}
+
+/*
+ * imx_sdma_get_period_stamp - completion time of the last period
+ *
+ * Only valid for a cyclic transfer on an SDMA channel. The stamp is taken
+ * when the SDMA interrupt is serviced, so a consumer can extrapolate its
+ * position in the buffer from it rather than from when it got to run.
+ */
+int imx_sdma_get_period_stamp(struct dma_chan *chan,
+		struct imx_dma_period_stamp *ps)
+{
+	struct sdma_channel *sdmac = to_sdma_chan(chan);
+	unsigned long flags;
+
+	if (!(sdmac->flags & IMX_DMA_SG_LOOP))
+		return -EINVAL;
+
+	spin_lock_irqsave(&sdmac->lock, flags);
+	ps->period = sdmac->period_last;
+	ps->count = sdmac->period_count;
+	ps->stamp = sdmac->period_stamp;
+	spin_unlock_irqrestore(&sdmac->lock, flags);
+
+	return 0;
+}
+EXPORT_SYMBOL(imx_sdma_get_period_stamp);
+
 static int sdma_control(struct dma_chan *chan, enum dma_ctrl_cmd cmd,
 		unsigned long arg)
 {
@@ -1091,6 +1426,62 @@ static void sdma_issue_pending(struct dma_chan *chan)
 	 */
 }
 
+static int sdma_stats_show(struct seq_file *s, void *unused)
+{
+	struct sdma_engine *sdma = s->private;
+	int i;
+
+	seq_printf(s, "%-3s %4s %5s %4s %4s %6s %12s %8s %8s %7s %7s\n",
+		   "ch", "type", "event", "prio", "hw", "mode", "bytes",
+		   "bds", "irqs", "lat_avg", "lat_max");
+
+	for (i = 1; i < MAX_DMA_CHANNELS; i++) {
+		struct sdma_channel *sdmac = &sdma->channel[i];
+		unsigned long flags;
+		u64 bytes, lat_avg;
+		unsigned long bds, irqs;
+		unsigned int lat_max;
+
+		if (!sdmac->bd)
+			continue;
+
+		spin_lock_irqsave(&sdmac->lock, flags);
+		bytes = sdmac->bytes;
+		bds = sdmac->bds;
+		irqs = sdmac->irqs;
+		lat_avg = sdmac->lat_total_us;
+		lat_max = sdmac->lat_max_us;
+		spin_unlock_irqrestore(&sdmac->lock, flags);
+
+		if (irqs)
+			do_div(lat_avg, irqs);
+
+		seq_printf(s, "%-3d %4d %5d %4u %4u %6s %12llu %8lu %8lu %5lluus %5uus\n",
+			   i, sdmac->peripheral_type, sdmac->event_id0,
+			   sdmac->priority, sdmac->hw_priority,
+			   sdmac->flags & IMX_DMA_SG_LOOP ? "cyclic" :
+			   sdmac->peripheral_type == IMX_DMATYPE_MEMORY ?
+			   "memcpy" : "sg",
+			   (unsigned long long)bytes, bds, irqs,
+			   (unsigned long long)lat_avg, lat_max);
+	}
+
+	return 0;
+}
+
+static int sdma_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, sdma_stats_show, inode->i_private);
+}
+
+static const struct file_operations sdma_stats_fops = {
+	.owner = THIS_MODULE,
+	.open = sdma_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 #define SDMA_SCRIPT_ADDRS_ARRAY_SIZE_V1	34
 
 static void sdma_add_scripts(struct sdma_engine *sdma,
@@ -1252,6 +1643,8 @@ static int __init sdma_probe(struct platform_device *pdev)
 	if (!sdma)
 		return -ENOMEM;
 
+	spin_lock_init(&sdma->channel_0_lock);
+
 	sdma->dev = &pdev->dev;
 
 	iores = platform_get_resource(pdev, IORESOURCE_MEM, 0);
@@ -1290,6 +1683,13 @@ static int __init sdma_probe(struct platform_device *pdev)
 
 	dma_cap_set(DMA_SLAVE, sdma->dma_device.cap_mask);
 	dma_cap_set(DMA_CYCLIC, sdma->dma_device.cap_mask);
+	dma_cap_set(DMA_MEMCPY, sdma->dma_device.cap_mask);
+	/*
+	 * Memcpy channels are handed out through dma_request_channel() only.
+	 * A public memcpy device is claimed channel by channel by the
+	 * async_tx/net_dma pool, which leaves nothing for slave users.
+	 */
+	dma_cap_set(DMA_PRIVATE, sdma->dma_device.cap_mask);
 
 	INIT_LIST_HEAD(&sdma->dma_device.channels);
 	/* Initialize channel parameters */
@@ -1328,6 +1728,7 @@ static int __init sdma_probe(struct platform_device *pdev)
 	sdma->dma_device.device_tx_status = sdma_tx_status;
 	sdma->dma_device.device_prep_slave_sg = sdma_prep_slave_sg;
 	sdma->dma_device.device_prep_dma_cyclic = sdma_prep_dma_cyclic;
+	sdma->dma_device.device_prep_dma_memcpy = sdma_prep_dma_memcpy;
 	sdma->dma_device.device_control = sdma_control;
 	sdma->dma_device.device_issue_pending = sdma_issue_pending;
 	sdma->dma_device.dev->dma_parms = &sdma->dma_parms;
@@ -1339,6 +1740,8 @@ static int __init sdma_probe(struct platform_device *pdev)
 		goto err_init;
 	}
 
+	debugfs_create_file("imx-sdma", S_IRUGO, NULL, sdma, &sdma_stats_fops);
+
 	dev_info(sdma->dev, "initialized\n");
 
 	return 0;
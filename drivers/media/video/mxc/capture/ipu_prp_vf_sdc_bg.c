@@ -26,6 +26,12 @@
 
 static int buffer_num;
 static int buffer_ready;
+static bool prpvf_linked;
+static u32 prpvf_bg_buf;
+
+/* largest frame the PRP VF resizer writes in one go */
+#define PRPVF_LINK_MAX_WIDTH	1024
+#define PRPVF_LINK_MAX_HEIGHT	1024
 
 /*
  * Function definitions
@@ -41,10 +47,13 @@ static int buffer_ready;
  */
 static irqreturn_t prpvf_sdc_vsync_callback(int irq, void *dev_id)
 {
+	cam_data *cam = (cam_data *) dev_id;
+
 	pr_debug("buffer_ready %d buffer_num %d\n", buffer_ready, buffer_num);
 	if (buffer_ready > 0) {
 		ipu_select_buffer(MEM_ROT_VF_MEM, IPU_OUTPUT_BUFFER, 0);
 		buffer_ready--;
+		cam->vf_displayed++;
 	}
 
 	return IRQ_HANDLED;
@@ -60,8 +69,11 @@ static irqreturn_t prpvf_sdc_vsync_callback(int irq, void *dev_id)
  */
 static irqreturn_t prpvf_vf_eof_callback(int irq, void *dev_id)
 {
+	cam_data *cam = (cam_data *) dev_id;
+
 	pr_debug("buffer_ready %d buffer_num %d\n", buffer_ready, buffer_num);
 
+	cam->vf_captured++;
 	ipu_select_buffer(MEM_ROT_VF_MEM, IPU_INPUT_BUFFER, buffer_num);
 
 	buffer_num = (buffer_num == 0) ? 1 : 0;
@@ -71,6 +83,317 @@ static irqreturn_t prpvf_vf_eof_callback(int irq, void *dev_id)
 	return IRQ_HANDLED;
 }
 
+/*!
+ * Linked path frame done callback, the IC or rotator finished a frame.
+ *
+ * @param irq       int irq line
+ * @param dev_id    void * device id
+ *
+ * @return status   IRQ_HANDLED for handled
+ */
+static irqreturn_t prpvf_link_eof_callback(int irq, void *dev_id)
+{
+	cam_data *cam = (cam_data *) dev_id;
+
+	cam->vf_captured++;
+	return IRQ_HANDLED;
+}
+
+/*!
+ * Linked path V-Sync callback, counts the frames the display moved on to.
+ *
+ * @param irq       int irq line
+ * @param dev_id    void * device id
+ *
+ * @return status   IRQ_HANDLED for handled
+ */
+static irqreturn_t prpvf_link_vsync_callback(int irq, void *dev_id)
+{
+	cam_data *cam = (cam_data *) dev_id;
+	u32 buf = ipu_get_cur_buffer_idx(MEM_BG_SYNC, IPU_INPUT_BUFFER);
+
+	if (buf != prpvf_bg_buf) {
+		prpvf_bg_buf = buf;
+		cam->vf_displayed++;
+	}
+	return IRQ_HANDLED;
+}
+
+/*!
+ * Free the frames the vf task allocated.
+ *
+ * @param cam       cam_data * mxc v4l2 main structure
+ */
+static void prpvf_free_bufs(cam_data *cam)
+{
+	int i;
+
+	for (i = 0; i < 2; i++) {
+		if (cam->vf_bufs_vaddr[i]) {
+			dma_free_coherent(0, cam->vf_bufs_size[i],
+					  cam->vf_bufs_vaddr[i],
+					  cam->vf_bufs[i]);
+			cam->vf_bufs_vaddr[i] = NULL;
+			cam->vf_bufs[i] = 0;
+		}
+	}
+}
+
+/*!
+ * Point the background display back at the frame buffer's own content.
+ *
+ * @param cam       cam_data * mxc v4l2 main structure
+ */
+static void prpvf_restore_fb(cam_data *cam)
+{
+	struct fb_info *fbi = cam->overlay_fb;
+	dma_addr_t base = fbi->fix.smem_start +
+			  fbi->fix.line_length * fbi->var.yoffset;
+
+	ipu_update_channel_buffer(MEM_BG_SYNC, IPU_INPUT_BUFFER, 0, base);
+	ipu_update_channel_buffer(MEM_BG_SYNC, IPU_INPUT_BUFFER, 1, base);
+}
+
+/*!
+ * Whether the preview window can be scanned out straight from the IC: it
+ * must cover the whole background frame buffer, which needs room for two
+ * frames, and fit the resizer.
+ *
+ * @param cam       cam_data * mxc v4l2 main structure
+ *
+ * @return  true if CSI -> PRP_VF (-> ROT_VF) -> MEM_BG_SYNC can be linked
+ */
+static bool prpvf_can_link(cam_data *cam)
+{
+	struct fb_info *fbi = cam->overlay_fb;
+	u32 width = cam->win.w.width, height = cam->win.w.height;
+
+	if (!cam->vf_link || !fbi)
+		return false;
+	if (cam->win.w.left || cam->win.w.top ||
+	    (width != fbi->var.xres) || (height != fbi->var.yres) ||
+	    (fbi->var.yres_virtual < 2 * fbi->var.yres))
+		return false;
+	if (cam->vf_rotation >= IPU_ROTATE_90_RIGHT) {
+		width = cam->win.w.height;
+		height = cam->win.w.width;
+	}
+	return (width <= PRPVF_LINK_MAX_WIDTH) &&
+	       (height <= PRPVF_LINK_MAX_HEIGHT);
+}
+
+/*!
+ * prpvf_start_link - start the vf task with the display linked to the IC
+ *
+ * The IC (and the rotator behind it if needed) writes straight into two
+ * frames of the background frame buffer and the display flips between them
+ * in hardware, so no frame goes through memory twice or waits for an irq.
+ *
+ * @param cam       cam_data * mxc v4l2 main structure
+ * @param format    frame buffer pixel format
+ *
+ * @return  status
+ */
+static int prpvf_start_link(cam_data *cam, u32 format)
+{
+	struct fb_info *fbi = cam->overlay_fb;
+	ipu_channel_params_t vf;
+	ipu_channel_t disp_src = CSI_PRP_VF_MEM;
+	dma_addr_t fb0 = fbi->fix.smem_start;
+	dma_addr_t fb1 = fb0 + fbi->fix.line_length * fbi->var.yres;
+	u32 size, irq;
+	int err;
+
+	memset(&vf, 0, sizeof(ipu_channel_params_t));
+	ipu_csi_get_window_size(&vf.csi_prp_vf_mem.in_width,
+				&vf.csi_prp_vf_mem.in_height, cam->csi);
+	vf.csi_prp_vf_mem.in_pixel_fmt = IPU_PIX_FMT_UYVY;
+	vf.csi_prp_vf_mem.out_width = cam->win.w.width;
+	vf.csi_prp_vf_mem.out_height = cam->win.w.height;
+	vf.csi_prp_vf_mem.csi = cam->csi;
+	if (cam->vf_rotation >= IPU_ROTATE_90_RIGHT) {
+		vf.csi_prp_vf_mem.out_width = cam->win.w.height;
+		vf.csi_prp_vf_mem.out_height = cam->win.w.width;
+	}
+	vf.csi_prp_vf_mem.out_pixel_fmt = format;
+
+	err = ipu_init_channel(CSI_PRP_VF_MEM, &vf);
+	if (err != 0)
+		return err;
+
+	ipu_csi_enable_mclk_if(CSI_MCLK_VF, cam->csi, true, true);
+
+	if (cam->vf_rotation == IPU_ROTATE_NONE) {
+		err = ipu_init_channel_buffer(CSI_PRP_VF_MEM, IPU_OUTPUT_BUFFER,
+					      format,
+					      vf.csi_prp_vf_mem.out_width,
+					      vf.csi_prp_vf_mem.out_height,
+					      fbi->fix.line_length,
+					      IPU_ROTATE_NONE, fb1, fb0,
+					      0, 0, 0);
+		if (err != 0) {
+			printk(KERN_ERR "Error initializing CSI_PRP_VF_MEM\n");
+			goto out_3;
+		}
+		irq = IPU_IRQ_PRP_VF_OUT_EOF;
+	} else {
+		/* the IRT needs its own pair of frames in front of it */
+		size = PAGE_ALIGN(vf.csi_prp_vf_mem.out_width *
+				  vf.csi_prp_vf_mem.out_height *
+				  bytes_per_pixel(format));
+		cam->vf_bufs_size[0] = size;
+		cam->vf_bufs_vaddr[0] = dma_alloc_coherent(0, size,
+							   &cam->vf_bufs[0],
+							   GFP_DMA |
+							   GFP_KERNEL);
+		cam->vf_bufs_size[1] = size;
+		cam->vf_bufs_vaddr[1] = dma_alloc_coherent(0, size,
+							   &cam->vf_bufs[1],
+							   GFP_DMA |
+							   GFP_KERNEL);
+		if (!cam->vf_bufs_vaddr[0] || !cam->vf_bufs_vaddr[1]) {
+			printk(KERN_ERR "Error to allocate vf buffer\n");
+			err = -ENOMEM;
+			goto out_3;
+		}
+
+		err = ipu_init_channel_buffer(CSI_PRP_VF_MEM, IPU_OUTPUT_BUFFER,
+					      format,
+					      vf.csi_prp_vf_mem.out_width,
+					      vf.csi_prp_vf_mem.out_height,
+					      vf.csi_prp_vf_mem.out_width,
+					      IPU_ROTATE_NONE,
+					      cam->vf_bufs[0], cam->vf_bufs[1],
+					      0, 0, 0);
+		if (err != 0) {
+			printk(KERN_ERR "Error initializing CSI_PRP_VF_MEM\n");
+			goto out_3;
+		}
+
+		err = ipu_init_channel(MEM_ROT_VF_MEM, NULL);
+		if (err != 0) {
+			printk(KERN_ERR "Error MEM_ROT_VF_MEM channel\n");
+			goto out_3;
+		}
+		err = ipu_init_channel_buffer(MEM_ROT_VF_MEM, IPU_INPUT_BUFFER,
+					      format,
+					      vf.csi_prp_vf_mem.out_width,
+					      vf.csi_prp_vf_mem.out_height,
+					      vf.csi_prp_vf_mem.out_width,
+					      cam->vf_rotation,
+					      cam->vf_bufs[0], cam->vf_bufs[1],
+					      0, 0, 0);
+		if (err == 0)
+			err = ipu_init_channel_buffer(MEM_ROT_VF_MEM,
+						      IPU_OUTPUT_BUFFER, format,
+						      cam->win.w.width,
+						      cam->win.w.height,
+						      fbi->fix.line_length,
+						      IPU_ROTATE_NONE, fb1, fb0,
+						      0, 0, 0);
+		if (err != 0) {
+			printk(KERN_ERR "Error MEM_ROT_VF_MEM buffer\n");
+			goto out_2;
+		}
+
+		err = ipu_link_channels(CSI_PRP_VF_MEM, MEM_ROT_VF_MEM);
+		if (err < 0) {
+			printk(KERN_ERR
+			       "Error link CSI_PRP_VF_MEM-MEM_ROT_VF_MEM\n");
+			goto out_2;
+		}
+		disp_src = MEM_ROT_VF_MEM;
+		irq = IPU_IRQ_PRP_VF_ROT_OUT_EOF;
+	}
+
+	/* scan out the preview frames, the fb content comes back on stop */
+	ipu_update_channel_buffer(MEM_BG_SYNC, IPU_INPUT_BUFFER, 0, fb1);
+	ipu_update_channel_buffer(MEM_BG_SYNC, IPU_INPUT_BUFFER, 1, fb0);
+
+	err = ipu_link_channels(disp_src, MEM_BG_SYNC);
+	if (err < 0) {
+		printk(KERN_ERR "Error linking ipu channels\n");
+		goto out_1;
+	}
+
+	ipu_clear_irq(irq);
+	err = ipu_request_irq(irq, prpvf_link_eof_callback, 0,
+			      "Mxc Camera", cam);
+	if (err != 0) {
+		printk(KERN_ERR "Error registering vf eof irq.\n");
+		goto out_0;
+	}
+	prpvf_bg_buf = ipu_get_cur_buffer_idx(MEM_BG_SYNC, IPU_INPUT_BUFFER);
+	ipu_clear_irq(IPU_IRQ_BG_SF_END);
+	err = ipu_request_irq(IPU_IRQ_BG_SF_END, prpvf_link_vsync_callback,
+			      0, "Mxc Camera", cam);
+	if (err != 0) {
+		printk(KERN_ERR "Error registering IPU_IRQ_BG_SF_END irq.\n");
+		ipu_free_irq(irq, cam);
+		goto out_0;
+	}
+
+	ipu_enable_channel(CSI_PRP_VF_MEM);
+	ipu_select_buffer(CSI_PRP_VF_MEM, IPU_OUTPUT_BUFFER, 0);
+	ipu_select_buffer(CSI_PRP_VF_MEM, IPU_OUTPUT_BUFFER, 1);
+	if (disp_src == MEM_ROT_VF_MEM) {
+		ipu_enable_channel(MEM_ROT_VF_MEM);
+		ipu_select_buffer(MEM_ROT_VF_MEM, IPU_OUTPUT_BUFFER, 0);
+		ipu_select_buffer(MEM_ROT_VF_MEM, IPU_OUTPUT_BUFFER, 1);
+	}
+
+	prpvf_linked = true;
+	cam->overlay_active = true;
+	return 0;
+
+      out_0:
+	ipu_unlink_channels(disp_src, MEM_BG_SYNC);
+      out_1:
+	if (disp_src == MEM_ROT_VF_MEM)
+		ipu_unlink_channels(CSI_PRP_VF_MEM, MEM_ROT_VF_MEM);
+	prpvf_restore_fb(cam);
+      out_2:
+	if (cam->vf_rotation != IPU_ROTATE_NONE)
+		ipu_uninit_channel(MEM_ROT_VF_MEM);
+      out_3:
+	ipu_uninit_channel(CSI_PRP_VF_MEM);
+	ipu_csi_enable_mclk_if(CSI_MCLK_VF, cam->csi, false, false);
+	prpvf_free_bufs(cam);
+	return err;
+}
+
+/*!
+ * prpvf_stop_link - stop the linked vf task
+ *
+ * @param cam       cam_data * mxc v4l2 main structure
+ */
+static void prpvf_stop_link(cam_data *cam)
+{
+	bool rot = (cam->vf_rotation != IPU_ROTATE_NONE);
+
+	ipu_free_irq(IPU_IRQ_BG_SF_END, cam);
+	ipu_free_irq(rot ? IPU_IRQ_PRP_VF_ROT_OUT_EOF : IPU_IRQ_PRP_VF_OUT_EOF,
+		     cam);
+
+	if (rot) {
+		ipu_unlink_channels(MEM_ROT_VF_MEM, MEM_BG_SYNC);
+		ipu_unlink_channels(CSI_PRP_VF_MEM, MEM_ROT_VF_MEM);
+	} else
+		ipu_unlink_channels(CSI_PRP_VF_MEM, MEM_BG_SYNC);
+
+	ipu_disable_channel(CSI_PRP_VF_MEM, true);
+	if (rot)
+		ipu_disable_channel(MEM_ROT_VF_MEM, true);
+	ipu_uninit_channel(CSI_PRP_VF_MEM);
+	if (rot)
+		ipu_uninit_channel(MEM_ROT_VF_MEM);
+	ipu_csi_enable_mclk_if(CSI_MCLK_VF, cam->csi, false, false);
+
+	prpvf_restore_fb(cam);
+	prpvf_free_bufs(cam);
+	prpvf_linked = false;
+}
+
 /*!
  * prpvf_start - start the vf task
  *
@@ -112,6 +435,11 @@ static int prpvf_start(void *private)
 		return -EINVAL;
 	}
 
+	cam->vf_captured = 0;
+	cam->vf_displayed = 0;
+	if (prpvf_can_link(cam))
+		return prpvf_start_link(cam, format);
+
 	offset = cam->v4l2_fb.fmt.bytesperline * cam->win.w.top +
 	    size * cam->win.w.left;
 
@@ -241,7 +569,7 @@ static int prpvf_start(void *private)
 
 	ipu_clear_irq(IPU_IRQ_BG_SF_END);
 	err = ipu_request_irq(IPU_IRQ_BG_SF_END, prpvf_sdc_vsync_callback,
-			      0, "Mxc Camera", NULL);
+			      0, "Mxc Camera", cam);
 	if (err != 0) {
 		printk(KERN_ERR "Error registering IPU_IRQ_BG_SF_END irq.\n");
 		goto out_1;
@@ -258,7 +586,7 @@ static int prpvf_start(void *private)
 	return err;
 
       out_1:
-	ipu_free_irq(IPU_IRQ_PRP_VF_OUT_EOF, NULL);
+	ipu_free_irq(IPU_IRQ_PRP_VF_OUT_EOF, cam);
       out_2:
 	ipu_uninit_channel(MEM_ROT_VF_MEM);
       out_3:
@@ -306,7 +634,13 @@ static int prpvf_stop(void *private)
 	if (cam->overlay_active == false)
 		return 0;
 
-	ipu_free_irq(IPU_IRQ_BG_SF_END, NULL);
+	if (prpvf_linked) {
+		prpvf_stop_link(cam);
+		cam->overlay_active = false;
+		return 0;
+	}
+
+	ipu_free_irq(IPU_IRQ_BG_SF_END, cam);
 
 	ipu_free_irq(IPU_IRQ_PRP_VF_OUT_EOF, cam);
 
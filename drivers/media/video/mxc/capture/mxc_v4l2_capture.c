@@ -880,6 +880,9 @@ static int mxc_v4l2_g_ctrl(cam_data *cam, struct v4l2_control *c)
 		/* This is handled in the ipu. */
 		c->value = cam->rotation;
 		break;
+	case V4L2_CID_MXC_VF_LINK:
+		c->value = cam->vf_link;
+		break;
 	case V4L2_CID_BRIGHTNESS:
 		if (cam->sensor) {
 			c->value = cam->bright;
@@ -1143,6 +1146,10 @@ static int mxc_v4l2_s_ctrl(cam_data *cam, struct v4l2_control *c)
 		ipu_csi_flash_strobe(true);
 #endif
 		break;
+	case V4L2_CID_MXC_VF_LINK:
+		/* taken into account on the next preview start */
+		cam->vf_link = !!c->value;
+		break;
 	default:
 		pr_debug("   default case\n");
 		ret = -EINVAL;
@@ -2567,6 +2574,20 @@ static ssize_t show_overlay(struct device *dev,
 }
 static DEVICE_ATTR(fsl_v4l2_overlay_property, S_IRUGO, show_overlay, NULL);
 
+static ssize_t show_preview_stats(struct device *dev,
+			struct device_attribute *attr, char *buf)
+{
+	struct video_device *video_dev = container_of(dev,
+						struct video_device, dev);
+	cam_data *g_cam = video_get_drvdata(video_dev);
+	u32 captured = g_cam->vf_captured, displayed = g_cam->vf_displayed;
+
+	return sprintf(buf, "captured %u\ndisplayed %u\ndropped %u\n",
+		       captured, displayed,
+		       (captured > displayed) ? captured - displayed : 0);
+}
+static DEVICE_ATTR(fsl_v4l2_preview_stats, S_IRUGO, show_preview_stats, NULL);
+
 /*!
  * This function is called to probe the devices if registered.
  *
@@ -2612,6 +2633,11 @@ static int mxc_v4l2_probe(struct platform_device *pdev)
 		dev_err(&pdev->dev, "Error on creating sysfs file"
 			" for overlay\n");
 
+	if (device_create_file(&g_cam->video_dev->dev,
+			&dev_attr_fsl_v4l2_preview_stats))
+		dev_err(&pdev->dev, "Error on creating sysfs file"
+			" for preview stats\n");
+
 	return 0;
 }
 
@@ -2635,6 +2661,8 @@ static int mxc_v4l2_remove(struct platform_device *pdev)
 			&dev_attr_fsl_v4l2_capture_property);
 		device_remove_file(&g_cam->video_dev->dev,
 			&dev_attr_fsl_v4l2_overlay_property);
+		device_remove_file(&g_cam->video_dev->dev,
+			&dev_attr_fsl_v4l2_preview_stats);
 
 		pr_info("V4L2 freeing image input device\n");
 		v4l2_int_device_unregister(&mxc_v4l2_int_device);
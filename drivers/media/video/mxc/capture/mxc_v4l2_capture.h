@@ -140,6 +140,9 @@ typedef struct _cam_data {
 	int output;
 	struct fb_info *overlay_fb;
 	int fb_origin_std;
+	bool vf_link;		/* V4L2_CID_MXC_VF_LINK */
+	u32 vf_captured;	/* preview frames the IPU wrote */
+	u32 vf_displayed;	/* preview frames the display moved on to */
 
 	/* v4l2 format */
 	struct v4l2_format v2f;
@@ -18,13 +18,98 @@
 
 #include <linux/sched.h>
 #include <linux/slab.h>
+#include <linux/spinlock.h>
 
 #include "gsl.h"
 #include "gsl_hal.h"
 #include "gsl_cmdstream.h"
 
+#define CREATE_TRACE_POINTS
+#include "gsl_trace.h"
+
 // functions
 
+static void
+kgsl_cmdstream_latency_submit(gsl_device_t *device, gsl_timestamp_t timestamp)
+{
+    gsl_latency_t  *latency = &device->latency;
+    unsigned long  flags;
+    unsigned int   slot;
+
+    spin_lock_irqsave(&device->latency_lock, flags);
+
+    if (latency->count < GSL_LATENCY_INFLIGHT_MAX)
+    {
+        slot = (latency->head + latency->count) % GSL_LATENCY_INFLIGHT_MAX;
+        latency->timestamp[slot] = timestamp;
+        latency->submitted[slot] = ktime_get();
+        latency->count++;
+    }
+    else
+    {
+        latency->dropped++;
+    }
+
+    spin_unlock_irqrestore(&device->latency_lock, flags);
+}
+
+//----------------------------------------------------------------------------
+
+static void
+kgsl_cmdstream_latency_retire(gsl_device_t *device)
+{
+    gsl_latency_t    *latency = &device->latency;
+    gsl_timestamp_t  ts_processed, timestamp;
+    unsigned long    flags;
+    ktime_t          retired, submitted;
+    s64              delta;
+    unsigned int     latency_us;
+    int              bucket;
+
+    if (latency->count == 0)
+    {
+        return;
+    }
+    // the memstore read may sleep so do it unlocked
+    ts_processed = kgsl_cmdstream_readtimestamp0(device->id, GSL_TIMESTAMP_RETIRED);
+
+    spin_lock_irqsave(&device->latency_lock, flags);
+
+    while (latency->count)
+    {
+        timestamp = latency->timestamp[latency->head];
+        if (!(((ts_processed - timestamp) >= 0) || ((ts_processed - timestamp) < -GSL_TIMESTAMP_EPSILON)))
+        {
+            break;
+        }
+        submitted = latency->submitted[latency->head];
+        latency->head = (latency->head + 1) % GSL_LATENCY_INFLIGHT_MAX;
+        latency->count--;
+
+        // the interrupt time is stale when the retire was found without one, e.g. from the memfree path
+        retired = latency->retired;
+        if (ktime_to_ns(ktime_sub(retired, submitted)) < 0)
+        {
+            retired = ktime_get();
+        }
+        delta      = ktime_us_delta(retired, submitted);
+        latency_us = (delta > UINT_MAX) ? UINT_MAX : (unsigned int)delta;
+
+        bucket = fls(latency_us);
+        if (bucket >= GSL_LATENCY_BUCKETS)
+        {
+            bucket = GSL_LATENCY_BUCKETS - 1;
+        }
+        latency->histogram[bucket]++;
+
+        trace_kgsl_retire(device->id, timestamp, latency_us);
+    }
+
+    spin_unlock_irqrestore(&device->latency_lock, flags);
+}
+
+//----------------------------------------------------------------------------
+
 int kgsl_cmdstream_init(gsl_device_t *device)
 {
 	return GSL_SUCCESS;
@@ -66,35 +151,76 @@ gsl_timestamp_t kgsl_cmdstream_readtimestamp0(gsl_deviceid_t device_id, gsl_time
 gsl_timestamp_t
 kgsl_cmdstream_readtimestamp(gsl_deviceid_t device_id, gsl_timestamp_type_t type)
 {
-	gsl_timestamp_t timestamp = -1;
+	// timestamps live in the memstore, reading them needs no lock
+	return kgsl_cmdstream_readtimestamp0(device_id, type);
+}
 
-	mutex_lock(&gsl_driver.lock);
+//----------------------------------------------------------------------------
 
-	timestamp = kgsl_cmdstream_readtimestamp0(device_id, type);
+int
+kgsl_cmdstream_issueibcmds(gsl_deviceid_t device_id, int drawctxt_index, gpuaddr_t ibaddr, int sizedwords, gsl_timestamp_t *timestamp, unsigned int flags)
+{
+    gsl_device_t* device  = &gsl_driver.device[device_id-1];
+    int status = GSL_FAILURE;
 
-	mutex_unlock(&gsl_driver.lock);
+    mutex_lock(&device->lock);
 
-	return timestamp;
+    kgsl_device_active(device);
+
+    if (device->ftbl.cmdstream_issueibcmds)
+    {
+        status = device->ftbl.cmdstream_issueibcmds(device, drawctxt_index, ibaddr, sizedwords, timestamp, flags);
+    }
+
+    if (status == GSL_SUCCESS)
+    {
+        kgsl_cmdstream_latency_submit(device, *timestamp);
+        trace_kgsl_issueibcmds(device_id, drawctxt_index, 1, *timestamp);
+    }
+
+    mutex_unlock(&device->lock);
+
+    return status;
 }
 
 //----------------------------------------------------------------------------
 
 int
-kgsl_cmdstream_issueibcmds(gsl_deviceid_t device_id, int drawctxt_index, gpuaddr_t ibaddr, int sizedwords, gsl_timestamp_t *timestamp, unsigned int flags)
+kgsl_cmdstream_issueibcmds_multi(gsl_deviceid_t device_id, int drawctxt_index, const gsl_ibdesc_t *ibdesc, int numibs, gsl_timestamp_t *timestamp, gsl_flags_t flags)
 {
     gsl_device_t* device  = &gsl_driver.device[device_id-1];
     int status = GSL_FAILURE;
+    int i;
+
+    if (numibs < 1 || numibs > GSL_IBDESC_MAX)
+    {
+        return GSL_FAILURE_BADPARAM;
+    }
 
-    mutex_lock(&gsl_driver.lock);
+    mutex_lock(&device->lock);
 
     kgsl_device_active(device);
 
-    if (device->ftbl.cmdstream_issueibcmds)
+    if (device->ftbl.cmdstream_issueibcmds_multi)
     {
-        status = device->ftbl.cmdstream_issueibcmds(device, drawctxt_index, ibaddr, sizedwords, timestamp, flags);
+        status = device->ftbl.cmdstream_issueibcmds_multi(device, drawctxt_index, ibdesc, numibs, timestamp, flags);
+    }
+    else if (device->ftbl.cmdstream_issueibcmds)
+    {
+        // no batching in the core, submit one by one but under a single lock; the last timestamp covers the batch
+        for (i = 0, status = GSL_SUCCESS; i < numibs && status == GSL_SUCCESS; i++)
+        {
+            status = device->ftbl.cmdstream_issueibcmds(device, drawctxt_index, ibdesc[i].ibaddr, ibdesc[i].sizedwords, timestamp, flags);
+        }
+    }
+
+    if (status == GSL_SUCCESS)
+    {
+        kgsl_cmdstream_latency_submit(device, *timestamp);
+        trace_kgsl_issueibcmds(device_id, drawctxt_index, numibs, *timestamp);
     }
 
-    mutex_unlock(&gsl_driver.lock);
+    mutex_unlock(&device->lock);
 
     return status;
 }
@@ -120,18 +246,28 @@ kgsl_cmdstream_memqueue_drain(gsl_device_t *device)
     gsl_memnode_t     *memnode, *nextnode, *freehead;
     gsl_timestamp_t   timestamp, ts_processed;
     gsl_memqueue_t    *memqueue = &device->memqueue;
+    unsigned int      nodes = 0, bytes = 0, latency, latency_total = 0, latency_max = 0;
 
     // check head
     if (memqueue->head == NULL)
     {
         return;
     }
-    // get current EOP timestamp
+    // get current EOP timestamp, the memstore read may sleep so do it unlocked
     ts_processed = kgsl_cmdstream_readtimestamp0(device->id, GSL_TIMESTAMP_RETIRED);
+
+    spin_lock(&device->memqueue_lock);
+
+    if (memqueue->head == NULL)
+    {
+        spin_unlock(&device->memqueue_lock);
+        return;
+    }
     timestamp = memqueue->head->timestamp;
     // check head timestamp
     if (!(((ts_processed - timestamp) >= 0) || ((ts_processed - timestamp) < -GSL_TIMESTAMP_EPSILON)))
     {
+        spin_unlock(&device->memqueue_lock);
         return;
     }
     memnode  = memqueue->head;
@@ -157,28 +293,125 @@ kgsl_cmdstream_memqueue_drain(gsl_device_t *device)
         }
         memnode = nextnode;
     }
-    // free nodes
+
+    spin_unlock(&device->memqueue_lock);
+
+    // free nodes outside the queue lock, the arena takes its own lock
     while (freehead)
     {
         memnode  = freehead;
         freehead = memnode->next;
-        kgsl_sharedmem_free0(&memnode->memdesc, memnode->pid);
+
+        nodes++;
+        bytes         += memnode->memdesc.size;
+        latency        = jiffies_to_usecs(jiffies - memnode->queued);
+        latency_total += latency;
+        latency_max    = max(latency_max, latency);
+
+        if (memnode->release)
+        {
+            memnode->release(memnode->priv);
+        }
+        else
+        {
+            kgsl_sharedmem_free0(&memnode->memdesc, memnode->pid);
+        }
         kfree(memnode);
     }
 
+    spin_lock(&device->memqueue_lock);
+
+    device->memqueue_stats.queued_bytes     -= bytes;
+    device->memqueue_stats.queued_nodes     -= nodes;
+    device->memqueue_stats.reclaimed_bytes  += bytes;
+    device->memqueue_stats.reclaimed_nodes  += nodes;
+    device->memqueue_stats.reclaim_passes++;
+    device->memqueue_stats.latency_total_us += latency_total;
+    if (latency_max > device->memqueue_stats.latency_max_us)
+    {
+        device->memqueue_stats.latency_max_us = latency_max;
+    }
+
+    spin_unlock(&device->memqueue_lock);
+}
+
+//----------------------------------------------------------------------------
+
+void
+kgsl_cmdstream_retire_work(struct work_struct *work)
+{
+    gsl_device_t *device = container_of(work, gsl_device_t, retire_work);
+
+    kgsl_cmdstream_latency_retire(device);
+    kgsl_cmdstream_memqueue_drain(device);
+}
+
+//----------------------------------------------------------------------------
+
+void
+kgsl_cmdstream_retire_schedule(gsl_device_t *device)
+{
+    unsigned long flags;
+    unsigned int  pending;
+
+    // called from the timestamp interrupt paths, note the time here since the work itself may sleep
+    spin_lock_irqsave(&device->latency_lock, flags);
+    device->latency.retired = ktime_get();
+    pending = device->latency.count;
+    spin_unlock_irqrestore(&device->latency_lock, flags);
+
+    if (pending || device->memqueue.head != NULL)
+    {
+        schedule_work(&device->retire_work);
+    }
+}
+
+//----------------------------------------------------------------------------
+
+gsl_timestamp_t
+kgsl_cmdstream_lastissued(gsl_deviceid_t device_id)
+{
+    gsl_device_t    *device = &gsl_driver.device[device_id-1];
+    gsl_timestamp_t timestamp = 0;
+
+    // everything submitted so far has retired once this timestamp has
+    mutex_lock(&device->lock);
+#ifdef GSL_BLD_YAMATO
+    if (device->id == GSL_DEVICE_YAMATO)
+    {
+        timestamp = device->ringbuffer.timestamp;
+    }
+#endif // GSL_BLD_YAMATO
+#ifdef GSL_BLD_G12
+    if (device->id == GSL_DEVICE_G12)
+    {
+        timestamp = device->current_timestamp;
+    }
+#endif // GSL_BLD_G12
+    mutex_unlock(&device->lock);
+
+    return timestamp;
 }
 
 //----------------------------------------------------------------------------
 
 int
 kgsl_cmdstream_freememontimestamp(gsl_deviceid_t device_id, gsl_memdesc_t *memdesc, gsl_timestamp_t timestamp, gsl_timestamp_type_t type)
+{
+    (void)type; // unref. For now just use EOP timestamp
+
+    return kgsl_cmdstream_releaseontimestamp(device_id, memdesc, timestamp, NULL, NULL);
+}
+
+//----------------------------------------------------------------------------
+
+// queue memdesc until timestamp retires, then free it or hand it to release
+int
+kgsl_cmdstream_releaseontimestamp(gsl_deviceid_t device_id, gsl_memdesc_t *memdesc, gsl_timestamp_t timestamp, void (*release)(void *priv), void *priv)
 {
     gsl_memnode_t  *memnode;
     gsl_device_t   *device = &gsl_driver.device[device_id-1];
     gsl_memqueue_t *memqueue;
-    (void)type; // unref. For now just use EOP timestamp
-
-    mutex_lock(&gsl_driver.lock);
 
     memqueue = &device->memqueue;
     memnode  = kmalloc(sizeof(gsl_memnode_t), GFP_KERNEL);
@@ -186,15 +419,19 @@ kgsl_cmdstream_freememontimestamp(gsl_deviceid_t device_id, gsl_memdesc_t *memde
     if (!memnode)
     {
         // other solution is to idle and free which given that the upper level driver probably wont check, probably a better idea
-	mutex_unlock(&gsl_driver.lock);
         return (GSL_FAILURE);
     }
 
     memnode->timestamp = timestamp;
     memnode->pid       = current->tgid;
+    memnode->queued    = jiffies;
+    memnode->release   = release;
+    memnode->priv      = priv;
     memnode->next      = NULL;
     memcpy(&memnode->memdesc, memdesc, sizeof(gsl_memdesc_t));
 
+    spin_lock(&device->memqueue_lock);
+
     // add to end of queue
     if (memqueue->tail != NULL)
     {
@@ -208,7 +445,13 @@ kgsl_cmdstream_freememontimestamp(gsl_deviceid_t device_id, gsl_memdesc_t *memde
         memqueue->tail = memnode;
     }
 
-    mutex_unlock(&gsl_driver.lock);
+    device->memqueue_stats.queued_bytes += memnode->memdesc.size;
+    device->memqueue_stats.queued_nodes++;
+
+    spin_unlock(&device->memqueue_lock);
+
+    // the timestamp may already have retired with no interrupt left to come
+    schedule_work(&device->retire_work);
 
     return (GSL_SUCCESS);
 }
@@ -124,9 +124,10 @@ kgsl_cmdwindow_write0(gsl_deviceid_t device_id, gsl_cmdwindow_t target, unsigned
 int
 kgsl_cmdwindow_write(gsl_deviceid_t device_id, gsl_cmdwindow_t target, unsigned int addr, unsigned int data)
 {
+	gsl_device_t *device = &gsl_driver.device[device_id-1];
 	int status = GSL_SUCCESS;
-	mutex_lock(&gsl_driver.lock);
+	mutex_lock(&device->lock);
 	status = kgsl_cmdwindow_write0(device_id, target, addr, data);
-	mutex_unlock(&gsl_driver.lock);
+	mutex_unlock(&device->lock);
 	return status;
 }
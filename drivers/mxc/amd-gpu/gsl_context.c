@@ -29,7 +29,7 @@ kgsl_context_create(gsl_deviceid_t device_id, gsl_context_type_t type, unsigned
     gsl_device_t* device  = &gsl_driver.device[device_id-1];
     int status;
 
-    mutex_lock(&gsl_driver.lock);
+    mutex_lock(&device->lock);
 
     if (device->ftbl.context_create)
     {
@@ -40,7 +40,7 @@ kgsl_context_create(gsl_deviceid_t device_id, gsl_context_type_t type, unsigned
         status = GSL_FAILURE;
     }
 
-    mutex_unlock(&gsl_driver.lock);
+    mutex_unlock(&device->lock);
 
     return status;
 }
@@ -53,7 +53,7 @@ kgsl_context_destroy(gsl_deviceid_t device_id, unsigned int drawctxt_id)
     gsl_device_t* device  = &gsl_driver.device[device_id-1];
     int status;
 
-    mutex_lock(&gsl_driver.lock);
+    mutex_lock(&device->lock);
 
     if (device->ftbl.context_destroy)
     {
@@ -64,7 +64,7 @@ kgsl_context_destroy(gsl_deviceid_t device_id, unsigned int drawctxt_id)
         status = GSL_FAILURE;
     }
 
-    mutex_unlock(&gsl_driver.lock);
+    mutex_unlock(&device->lock);
 
     return status;
 }
@@ -74,6 +74,21 @@ kgsl_device_init(gsl_device_t *device, gsl_deviceid_t device_id)
     }
 
     memset(device, 0, sizeof(gsl_device_t));
+    mutex_init(&device->lock);
+    spin_lock_init(&device->memqueue_lock);
+    spin_lock_init(&device->latency_lock);
+    INIT_WORK(&device->retire_work, kgsl_cmdstream_retire_work);
+
+#ifdef GSL_BLD_YAMATO
+    {
+        int i;
+
+        for (i = 0; i < GSL_CONTEXT_MAX; i++)
+        {
+            mutex_init(&device->drawctxt[i].lock);
+        }
+    }
+#endif // GSL_BLD_YAMATO
 
     // if device configuration is present
     if (kgsl_hal_getdevconfig(device_id, &config) == GSL_SUCCESS)
@@ -167,9 +182,7 @@ kgsl_device_close(gsl_device_t *device)
        kgsl_device_close is only called for last running caller process
     */
     while (device->refcnt > 0) {
-	mutex_unlock(&gsl_driver.lock);
 	kgsl_device_stop(device->id);
-	mutex_lock(&gsl_driver.lock);
     }
 
     // close cmdstream
@@ -180,6 +193,9 @@ kgsl_device_close(gsl_device_t *device)
 	status = device->ftbl.device_close(device);
     }
 
+    // interrupts are gone, make sure no reclaim still reads the memstore
+    cancel_work_sync(&device->retire_work);
+
     // DumpX allocates memstore from MMU aperture
     if ((device->refcnt == 0) && device->memstore.hostptr
 	&& !(gsl_driver.flags_debug & GSL_DBGFLAGS_DUMPX))
@@ -233,9 +249,13 @@ kgsl_device_attachcallback(gsl_device_t *device, unsigned int pid)
     {
         if (kgsl_driver_getcallerprocessindex(pid, &pindex) == GSL_SUCCESS)
         {
+            mutex_lock(&device->lock);
+
             device->callerprocess[pindex] = pid;
 
             status = kgsl_mmu_attachcallback(&device->mmu, pid);
+
+            mutex_unlock(&device->lock);
         }
     }
 
@@ -265,9 +285,13 @@ kgsl_device_detachcallback(gsl_device_t *device, unsigned int pid)
     {
         if (kgsl_driver_getcallerprocessindex(pid, &pindex) == GSL_SUCCESS)
         {
+            mutex_lock(&device->lock);
+
             status |= kgsl_mmu_detachcallback(&device->mmu, pid);
 
             device->callerprocess[pindex] = 0;
+
+            mutex_unlock(&device->lock);
         }
     }
 
@@ -383,10 +407,10 @@ kgsl_device_setproperty(gsl_deviceid_t device_id, gsl_property_type_t type, void
 
     DEBUG_ASSERT(value);
 
-    mutex_lock(&gsl_driver.lock);
-
     device = &gsl_driver.device[device_id-1];       // device_id is 1 based
 
+    mutex_lock(&device->lock);
+
     if (device->flags & GSL_FLAGS_INITIALIZED)
     {
         if (device->ftbl.device_setproperty)
@@ -395,7 +419,7 @@ kgsl_device_setproperty(gsl_deviceid_t device_id, gsl_property_type_t type, void
         }
     }
 
-    mutex_unlock(&gsl_driver.lock);
+    mutex_unlock(&device->lock);
 
     kgsl_log_write( KGSL_LOG_GROUP_DEVICE | KGSL_LOG_LEVEL_TRACE, "<-- kgsl_device_setproperty. Return value %B\n", status );
 
@@ -414,25 +438,23 @@ kgsl_device_start(gsl_deviceid_t device_id, gsl_flags_t flags)
     kgsl_log_write( KGSL_LOG_GROUP_DEVICE | KGSL_LOG_LEVEL_TRACE,
                     "--> int kgsl_device_start(gsl_deviceid_t device_id=%D, gsl_flags_t flags=%d)\n", device_id, flags );
 
-    mutex_lock(&gsl_driver.lock);
-
     if ((GSL_DEVICE_G12 == device_id) && !(hal->has_z160)) {
-	mutex_unlock(&gsl_driver.lock);
 	return GSL_FAILURE_NOTSUPPORTED;
     }
 
     if ((GSL_DEVICE_YAMATO == device_id) && !(hal->has_z430)) {
-	mutex_unlock(&gsl_driver.lock);
 	return GSL_FAILURE_NOTSUPPORTED;
     }
 
     device = &gsl_driver.device[device_id-1];       // device_id is 1 based
-    
+
+    mutex_lock(&device->lock);
+
     kgsl_device_active(device);
     
     if (!(device->flags & GSL_FLAGS_INITIALIZED))
     {
-        mutex_unlock(&gsl_driver.lock);
+        mutex_unlock(&device->lock);
 
         kgsl_log_write( KGSL_LOG_GROUP_DEVICE | KGSL_LOG_LEVEL_ERROR, "ERROR: Trying to start uninitialized device.\n" );
         kgsl_log_write( KGSL_LOG_GROUP_DEVICE | KGSL_LOG_LEVEL_TRACE, "<-- kgsl_device_start. Return value %B\n", GSL_FAILURE );
@@ -443,7 +465,7 @@ kgsl_device_start(gsl_deviceid_t device_id, gsl_flags_t flags)
 
     if (device->flags & GSL_FLAGS_STARTED)
     {
-        mutex_unlock(&gsl_driver.lock);
+        mutex_unlock(&device->lock);
         kgsl_log_write( KGSL_LOG_GROUP_DEVICE | KGSL_LOG_LEVEL_TRACE, "<-- kgsl_device_start. Return value %B\n", GSL_SUCCESS );
         return (GSL_SUCCESS);
     }
@@ -460,7 +482,7 @@ kgsl_device_start(gsl_deviceid_t device_id, gsl_flags_t flags)
         status = device->ftbl.device_start(device, flags);
     }
 
-    mutex_unlock(&gsl_driver.lock);
+    mutex_unlock(&device->lock);
 
     kgsl_log_write( KGSL_LOG_GROUP_DEVICE | KGSL_LOG_LEVEL_TRACE, "<-- kgsl_device_start. Return value %B\n", status );
 
@@ -478,10 +500,10 @@ kgsl_device_stop(gsl_deviceid_t device_id)
     kgsl_log_write( KGSL_LOG_GROUP_DEVICE | KGSL_LOG_LEVEL_TRACE,
                     "--> int kgsl_device_stop(gsl_deviceid_t device_id=%D)\n", device_id );
 
-    mutex_lock(&gsl_driver.lock);
-
     device = &gsl_driver.device[device_id-1];       // device_id is 1 based
 
+    mutex_lock(&device->lock);
+
     if (device->flags & GSL_FLAGS_STARTED)
     {
         DEBUG_ASSERT(device->refcnt);
@@ -501,7 +523,7 @@ kgsl_device_stop(gsl_deviceid_t device_id)
         }
     }
 
-    mutex_unlock(&gsl_driver.lock);
+    mutex_unlock(&device->lock);
 
     kgsl_log_write( KGSL_LOG_GROUP_DEVICE | KGSL_LOG_LEVEL_TRACE, "<-- kgsl_device_stop. Return value %B\n", status );
 
@@ -519,10 +541,10 @@ kgsl_device_idle(gsl_deviceid_t device_id, unsigned int timeout)
     kgsl_log_write( KGSL_LOG_GROUP_DEVICE | KGSL_LOG_LEVEL_TRACE,
                     "--> int kgsl_device_idle(gsl_deviceid_t device_id=%D, unsigned int timeout=%d)\n", device_id, timeout );
 
-    mutex_lock(&gsl_driver.lock);
-
     device = &gsl_driver.device[device_id-1];       // device_id is 1 based
 
+    mutex_lock(&device->lock);
+
     kgsl_device_active(device);
     
     if (device->ftbl.device_idle)
@@ -530,7 +552,7 @@ kgsl_device_idle(gsl_deviceid_t device_id, unsigned int timeout)
         status = device->ftbl.device_idle(device, timeout);
     }
 
-    mutex_unlock(&gsl_driver.lock);
+    mutex_unlock(&device->lock);
 
     kgsl_log_write( KGSL_LOG_GROUP_DEVICE | KGSL_LOG_LEVEL_TRACE, "<-- kgsl_device_idle. Return value %B\n", status );
 
@@ -563,10 +585,10 @@ kgsl_device_regread(gsl_deviceid_t device_id, unsigned int offsetwords, unsigned
                         "--> int kgsl_device_regread(gsl_deviceid_t device_id=%D, unsigned int offsetwords=%R, unsigned int *value=0x%08x)\n", device_id, offsetwords, value );
 #endif
 
-    mutex_lock(&gsl_driver.lock);
-
     device = &gsl_driver.device[device_id-1];       // device_id is 1 based
 
+    mutex_lock(&device->lock);
+
     DEBUG_ASSERT(value);
     DEBUG_ASSERT(offsetwords < device->regspace.sizebytes);
 
@@ -575,7 +597,7 @@ kgsl_device_regread(gsl_deviceid_t device_id, unsigned int offsetwords, unsigned
         status = device->ftbl.device_regread(device, offsetwords, value);
     }
 
-    mutex_unlock(&gsl_driver.lock);
+    mutex_unlock(&device->lock);
 
 #ifdef GSL_LOG
     if( offsetwords != mmRBBM_STATUS && offsetwords != mmCP_RB_RPTR )
@@ -596,10 +618,10 @@ kgsl_device_regwrite(gsl_deviceid_t device_id, unsigned int offsetwords, unsigne
     kgsl_log_write( KGSL_LOG_GROUP_DEVICE | KGSL_LOG_LEVEL_TRACE,
                     "--> int kgsl_device_regwrite(gsl_deviceid_t device_id=%D, unsigned int offsetwords=%R, uint value=0x%08x)\n", device_id, offsetwords, value );
 
-    mutex_lock(&gsl_driver.lock);
-
     device = &gsl_driver.device[device_id-1];       // device_id is 1 based
 
+    mutex_lock(&device->lock);
+
     DEBUG_ASSERT(offsetwords < device->regspace.sizebytes);
 
     if (device->ftbl.device_regwrite)
@@ -607,7 +629,7 @@ kgsl_device_regwrite(gsl_deviceid_t device_id, unsigned int offsetwords, unsigne
         status = device->ftbl.device_regwrite(device, offsetwords, value);
     }
 
-    mutex_unlock(&gsl_driver.lock);
+    mutex_unlock(&device->lock);
 
     kgsl_log_write( KGSL_LOG_GROUP_DEVICE | KGSL_LOG_LEVEL_TRACE, "<-- kgsl_device_regwrite. Return value %B\n", status );
 
@@ -630,9 +652,6 @@ kgsl_device_runpending(gsl_device_t *device)
         }
     }
 
-    // free any pending freeontimestamps
-    kgsl_cmdstream_memqueue_drain(device);
-
     kgsl_log_write( KGSL_LOG_GROUP_DEVICE | KGSL_LOG_LEVEL_TRACE, "<-- kgsl_device_runpending. Return value %B\n", status );
 
     return (status);
@@ -1507,6 +1507,8 @@ kgsl_drawctxt_destroy(gsl_device_t* device, unsigned int drawctxt_id)
 
         device->ftbl.device_idle(device, GSL_TIMEOUT_DEFAULT);
 
+        mutex_lock(&drawctxt->lock);
+
         // destroy state shadow, if allocated
         if (drawctxt->flags & CTXT_FLAGS_STATE_SHADOW)
             kgsl_sharedmem_free0(&drawctxt->gpustate, current->tgid);
@@ -1522,6 +1524,8 @@ kgsl_drawctxt_destroy(gsl_device_t* device, unsigned int drawctxt_id)
         drawctxt->flags = CTXT_FLAGS_NOT_IN_USE;
 		drawctxt->pid   = 0;
 
+        mutex_unlock(&drawctxt->lock);
+
         device->drawctxt_count--;
         DEBUG_ASSERT(device->drawctxt_count >= 0);
     }
@@ -1558,7 +1562,8 @@ int kgsl_drawctxt_bind_gmem_shadow(gsl_deviceid_t device_id, unsigned int drawct
     gmem_shadow_t  *shadow = &drawctxt->user_gmem_shadow[buffer_id];
     unsigned int    i;
 
-    mutex_lock(&gsl_driver.lock);
+    // only this context's shadow state changes, submission on the device can proceed
+    mutex_lock(&drawctxt->lock);
 
 	if( !shadow_buffer->enabled )
     {
@@ -1629,7 +1634,7 @@ int kgsl_drawctxt_bind_gmem_shadow(gsl_deviceid_t device_id, unsigned int drawct
         }
     }
 
-    mutex_unlock(&gsl_driver.lock);
+    mutex_unlock(&drawctxt->lock);
 
     return (GSL_SUCCESS);
 }
@@ -1647,6 +1652,7 @@ kgsl_drawctxt_switch(gsl_device_t *device, gsl_drawctxt_t *drawctxt, gsl_flags_t
 
 	if (drawctxt != GSL_CONTEXT_NONE)
 	{
+		mutex_lock(&drawctxt->lock);
 		if( flags & GSL_CONTEXT_SAVE_GMEM )
 		{
 			// Set the flag in context so that the save is done when this context is switched out.
@@ -1657,6 +1663,7 @@ kgsl_drawctxt_switch(gsl_device_t *device, gsl_drawctxt_t *drawctxt, gsl_flags_t
 			// Remove GMEM saving flag from the context
 			drawctxt->flags &= ~CTXT_FLAGS_GMEM_SAVE;
 		}
+		mutex_unlock(&drawctxt->lock);
 	}
 
     // already current?
@@ -1668,6 +1675,8 @@ kgsl_drawctxt_switch(gsl_device_t *device, gsl_drawctxt_t *drawctxt, gsl_flags_t
     // save old context, when not running in safe mode
     if (active_ctxt != GSL_CONTEXT_NONE && !(device->flags & GSL_FLAGS_SAFEMODE))
     {
+        mutex_lock(&active_ctxt->lock);
+
         // save registers and constants.
         kgsl_ringbuffer_issuecmds(device, 0, active_ctxt->reg_save, 3, active_ctxt->pid);
 
@@ -1709,6 +1718,8 @@ kgsl_drawctxt_switch(gsl_device_t *device, gsl_drawctxt_t *drawctxt, gsl_flags_t
 
             active_ctxt->flags |= CTXT_FLAGS_GMEM_RESTORE;
         }
+
+        mutex_unlock(&active_ctxt->lock);
     }
 
     device->drawctxt_active = drawctxt;
@@ -1716,6 +1727,8 @@ kgsl_drawctxt_switch(gsl_device_t *device, gsl_drawctxt_t *drawctxt, gsl_flags_t
     // restore new context, when not running in safe mode
     if (drawctxt != GSL_CONTEXT_NONE && !(device->flags & GSL_FLAGS_SAFEMODE))
     {
+        mutex_lock(&drawctxt->lock);
+
         KGSL_DEBUG(GSL_DBGFLAGS_DUMPX, KGSL_DEBUG_DUMPX(BB_DUMP_MEMWRITE, drawctxt->gpustate.gpuaddr, (unsigned int)drawctxt->gpustate.hostptr, LCC_SHADOW_SIZE + REG_SHADOW_SIZE + CMD_BUFFER_SIZE + TEX_SHADOW_SIZE , "kgsl_drawctxt_switch"));
 
         // restore gmem.  (note: changes shader.  shader must not already be restored.)
@@ -1753,6 +1766,8 @@ kgsl_drawctxt_switch(gsl_device_t *device, gsl_drawctxt_t *drawctxt, gsl_flags_t
         {
 			kgsl_ringbuffer_issuecmds(device, 0, drawctxt->shader_restore, 3, drawctxt->pid);
         }
+
+        mutex_unlock(&drawctxt->lock);
     }
 }
 
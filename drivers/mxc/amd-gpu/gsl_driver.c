@@ -51,6 +51,7 @@ int
 kgsl_driver_init0(gsl_flags_t flags, gsl_flags_t flags_debug)
 {
     int  status = GSL_SUCCESS;
+    int  i;
 
     if (!(gsl_driver_initialized & GSL_FLAGS_INITIALIZED0))
     {
@@ -60,6 +61,14 @@ kgsl_driver_init0(gsl_flags_t flags, gsl_flags_t flags_debug)
 #endif
         memset(&gsl_driver, 0, sizeof(gsl_driver_t));
 	mutex_init(&gsl_driver.lock);
+
+	// device locks must be valid even for devices that never initialize
+	for (i = 0; i < GSL_DEVICE_MAX; i++)
+	{
+	    mutex_init(&gsl_driver.device[i].lock);
+	    spin_lock_init(&gsl_driver.device[i].memqueue_lock);
+	    spin_lock_init(&gsl_driver.device[i].latency_lock);
+	}
     }
 
 #ifdef _DEBUG
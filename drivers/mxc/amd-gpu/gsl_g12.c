@@ -245,6 +245,7 @@ static void kgsl_g12_irqtask(struct work_struct *work)
 	gsl_device_t *device = &gsl_driver.device[GSL_DEVICE_G12-1];
 	kgsl_g12_updatetimestamp(device);
 	wake_up_interruptible_all(&device->timestamp_waitq);
+	kgsl_cmdstream_retire_schedule(device);
 }
 
 static void kgsl_g12_irqerr(struct work_struct *work)
@@ -35,6 +35,15 @@
 #include <linux/mm.h>
 #include <linux/mutex.h>
 #include <linux/cdev.h>
+#include <linux/anon_inodes.h>
+#include <linux/poll.h>
+#include <linux/file.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/sched.h>
+#include <linux/pagemap.h>
+#include <linux/dma-mapping.h>
 
 #include <linux/platform_device.h>
 #include <linux/vmalloc.h>
@@ -63,12 +72,22 @@ static int gsl_kmod_mmap(struct file *fd, struct vm_area_struct *vma);
 static int gsl_kmod_fault(struct vm_area_struct *vma, struct vm_fault *vmf);
 static int gsl_kmod_open(struct inode *inode, struct file *fd);
 static int gsl_kmod_release(struct inode *inode, struct file *fd);
+static unsigned int gsl_kmod_fence_poll(struct file *fd, poll_table *wait);
+static int gsl_kmod_fence_release(struct inode *inode, struct file *fd);
+static int gsl_kmod_import(struct file *fd, const kgsl_sharedmem_import_t *param, gsl_memdesc_t *memdesc);
+static struct gsl_kmod_import *gsl_kmod_unimport_take(struct file *fd, gpuaddr_t gpuaddr);
+static void gsl_kmod_import_release(void *priv);
+static int gsl_kmod_unimport(struct gsl_kmod_import *import, gsl_timestamp_t timestamp);
+static void gsl_kmod_unimport_all(struct file *fd);
+static int gsl_kmod_import_cacheop(struct file *fd, const gsl_memdesc_t *memdesc, unsigned int offsetbytes, unsigned int sizebytes, unsigned int operation);
 static irqreturn_t z160_irq_handler(int irq, void *dev_id);
 static irqreturn_t z430_irq_handler(int irq, void *dev_id);
 
 static int gsl_kmod_major;
 static struct class *gsl_kmod_class;
-DEFINE_MUTEX(gsl_mutex);
+static struct dentry *gsl_kmod_debugfs;
+static struct device *gsl_kmod_dev;
+static DEFINE_MUTEX(gsl_mutex);      // serializes open/release, device work uses per-device locks
 
 static const struct file_operations gsl_kmod_fops =
 {
@@ -86,6 +105,39 @@ static struct vm_operations_struct gsl_kmod_vmops =
 	.fault = gsl_kmod_fault,
 };
 
+/* a fence file becomes readable once the device retires its timestamp */
+struct gsl_kmod_fence
+{
+    gsl_deviceid_t device_id;
+    gsl_timestamp_t timestamp;
+};
+
+/*
+ * a user buffer the gpu accesses in place. it stays mapped and pinned until
+ * the timestamp it was freed on retires, or until the device idles when the
+ * fd closes.
+ */
+struct gsl_kmod_import
+{
+    struct list_head node;
+    gsl_deviceid_t device_id;
+    gsl_memdesc_t memdesc;          /* as returned by kgsl_sharedmem_map */
+    gpuaddr_t gpuaddr;              /* gpu address of the first byte handed to user space */
+    unsigned int offset;            /* offset of that byte into the first page */
+    unsigned int sizebytes;
+    unsigned int npages;
+    struct page **pages;            /* NULL for pfn mappings, nothing is pinned then */
+    int writable;
+    unsigned int pid;               /* importer tgid, the release may run from a kworker */
+};
+
+static const struct file_operations gsl_kmod_fence_fops =
+{
+    .owner = THIS_MODULE,
+    .poll = gsl_kmod_fence_poll,
+    .release = gsl_kmod_fence_release
+};
+
 static ssize_t gsl_kmod_read(struct file *fd, char __user *buf, size_t len, loff_t *ptr)
 {
     return 0;
@@ -269,6 +321,59 @@ static long gsl_kmod_ioctl(struct file *fd, unsigned int cmd, unsigned long arg)
             }
             break;
         }
+    case IOCTL_KGSL_CMDSTREAM_ISSUEIBCMDS_MULTI:
+        {
+            kgsl_cmdstream_issueibcmds_multi_t param;
+            gsl_ibdesc_t *ibdesc;
+            gsl_timestamp_t tmp;
+#if defined(GSL_IOCTL_DEBUG)
+	    printk(KERN_INFO "--> %s: IOCTL_KGSL_CMDSTREAM_ISSUEIBCMDS_MULTI\n", __func__);
+#endif
+            if (copy_from_user(&param, (void __user *)arg, sizeof(kgsl_cmdstream_issueibcmds_multi_t)))
+            {
+                printk(KERN_ERR "%s: copy_from_user error\n", __func__);
+                kgslStatus = GSL_FAILURE;
+                break;
+            }
+            if (param.numibs < 1 || param.numibs > GSL_IBDESC_MAX)
+            {
+                kgslStatus = GSL_FAILURE_BADPARAM;
+                break;
+            }
+            /* the core indexes device[] and drawctxt[] with these unchecked */
+            if (param.device_id <= GSL_DEVICE_ANY || param.device_id > GSL_DEVICE_MAX ||
+                param.drawctxt_index < 0 || param.drawctxt_index >= GSL_CONTEXT_MAX)
+            {
+                kgslStatus = -EINVAL;
+                break;
+            }
+            ibdesc = kmalloc(param.numibs * sizeof(gsl_ibdesc_t), GFP_KERNEL);
+            if (!ibdesc)
+            {
+                printk(KERN_ERR "%s:kmalloc error\n", __func__);
+                kgslStatus = GSL_FAILURE;
+                break;
+            }
+            if (copy_from_user(ibdesc, (void __user *)param.ibdesc, param.numibs * sizeof(gsl_ibdesc_t)))
+            {
+                printk(KERN_ERR "%s: copy_from_user error\n", __func__);
+                kgslStatus = GSL_FAILURE;
+                kfree(ibdesc);
+                break;
+            }
+            kgslStatus = kgsl_cmdstream_issueibcmds_multi(param.device_id, param.drawctxt_index, ibdesc, param.numibs, &tmp, param.flags);
+            kfree(ibdesc);
+            if (kgslStatus == GSL_SUCCESS)
+            {
+                if (copy_to_user(param.timestamp, &tmp, sizeof(gsl_timestamp_t)))
+                {
+                    printk(KERN_ERR "%s: copy_to_user error\n", __func__);
+                    kgslStatus = GSL_FAILURE;
+                    break;
+                }
+            }
+            break;
+        }
     case IOCTL_KGSL_CMDSTREAM_READTIMESTAMP:
         {
             kgsl_cmdstream_readtimestamp_t param;
@@ -296,6 +401,8 @@ static long gsl_kmod_ioctl(struct file *fd, unsigned int cmd, unsigned long arg)
         {
             int err;
             kgsl_cmdstream_freememontimestamp_t param;
+            gsl_memdesc_t tmp;
+            struct gsl_kmod_import *import;
 #if defined(GSL_IOCTL_DEBUG)
 	    printk(KERN_INFO "--> %s: IOCTL_KGSL_CMDSTREAM_FREEMEMONTIMESTAMP\n", __func__);
 #endif
@@ -305,6 +412,18 @@ static long gsl_kmod_ioctl(struct file *fd, unsigned int cmd, unsigned long arg)
                 kgslStatus = GSL_FAILURE;
                 break;
             }
+            if (copy_from_user(&tmp, (void __user *)param.memdesc, sizeof(gsl_memdesc_t)))
+            {
+                printk(KERN_ERR "%s: copy_from_user error\n", __func__);
+                kgslStatus = GSL_FAILURE;
+                break;
+            }
+            import = gsl_kmod_unimport_take(fd, tmp.gpuaddr);
+            if (import)
+            {
+                kgslStatus = gsl_kmod_unimport(import, param.timestamp);
+                break;
+            }
             err = del_memblock_from_allocated_list(fd, param.memdesc);
             if(err)
             {
@@ -338,6 +457,66 @@ static long gsl_kmod_ioctl(struct file *fd, unsigned int cmd, unsigned long arg)
             rmb();
             break;
         }
+    case IOCTL_KGSL_CMDSTREAM_CREATEFENCE:
+        {
+            kgsl_cmdstream_createfence_t param;
+            struct gsl_kmod_fence *fence;
+            struct file *fencefile;
+            int fencefd;
+#if defined(GSL_IOCTL_DEBUG)
+	    printk(KERN_INFO "--> %s: IOCTL_KGSL_CMDSTREAM_CREATEFENCE\n", __func__);
+#endif
+            if (copy_from_user(&param, (void __user *)arg, sizeof(kgsl_cmdstream_createfence_t)))
+            {
+                printk(KERN_ERR "%s: copy_from_user error\n", __func__);
+                kgslStatus = GSL_FAILURE;
+                break;
+            }
+            if (param.device_id <= GSL_DEVICE_ANY || param.device_id > GSL_DEVICE_MAX ||
+                !(gsl_driver.device[param.device_id-1].flags & GSL_FLAGS_INITIALIZED))
+            {
+                kgslStatus = GSL_FAILURE_BADPARAM;
+                break;
+            }
+            fence = kmalloc(sizeof(struct gsl_kmod_fence), GFP_KERNEL);
+            if (!fence)
+            {
+                printk(KERN_ERR "%s:kmalloc error\n", __func__);
+                kgslStatus = GSL_FAILURE;
+                break;
+            }
+            fence->device_id = param.device_id;
+            fence->timestamp = param.timestamp;
+            fencefd = get_unused_fd_flags(O_CLOEXEC);
+            if (fencefd < 0)
+            {
+                printk(KERN_ERR "%s: get_unused_fd_flags error\n", __func__);
+                kfree(fence);
+                kgslStatus = GSL_FAILURE;
+                break;
+            }
+            fencefile = anon_inode_getfile("kgsl-fence", &gsl_kmod_fence_fops, fence, O_RDONLY);
+            if (IS_ERR(fencefile))
+            {
+                printk(KERN_ERR "%s: anon_inode_getfile error\n", __func__);
+                put_unused_fd(fencefd);
+                kfree(fence);
+                kgslStatus = GSL_FAILURE;
+                break;
+            }
+            /* the fd only becomes visible to the process once it has been handed out */
+            if (copy_to_user(param.fd, &fencefd, sizeof(int)))
+            {
+                printk(KERN_ERR "%s: copy_to_user error\n", __func__);
+                put_unused_fd(fencefd);
+                fput(fencefile);
+                kgslStatus = GSL_FAILURE;
+                break;
+            }
+            fd_install(fencefd, fencefile);
+            kgslStatus = GSL_SUCCESS;
+            break;
+        }
     case IOCTL_KGSL_CMDWINDOW_WRITE:
         {
             kgsl_cmdwindow_write_t param;
@@ -437,22 +616,27 @@ static long gsl_kmod_ioctl(struct file *fd, unsigned int cmd, unsigned long arg)
                 kgslStatus = GSL_FAILURE;
                 break;
             }
+            /* refuse early so one process cannot drain the arena for everyone else */
+            kgslStatus = kgsl_sharedmem_charge(current->tgid, param.flags, param.sizebytes);
+            if (kgslStatus != GSL_SUCCESS)
+            {
+                break;
+            }
             kgslStatus = kgsl_sharedmem_alloc(param.device_id, param.flags, param.sizebytes, &tmp);
             if (kgslStatus == GSL_SUCCESS)
             {
-                if (copy_to_user(param.memdesc, &tmp, sizeof(gsl_memdesc_t)))
+                if (copy_to_user(param.memdesc, &tmp, sizeof(gsl_memdesc_t)) ||
+                    add_memblock_to_allocated_list(fd, &tmp, param.flags, param.sizebytes))
                 {
                     tmpStatus = kgsl_sharedmem_free(&tmp);
                     DEBUG_ASSERT(tmpStatus == GSL_SUCCESS);
-                    printk(KERN_ERR "%s: copy_to_user error\n", __func__);
+                    kgsl_sharedmem_uncharge(current->tgid, param.flags, param.sizebytes);
+                    printk(KERN_ERR "%s: copy_to_user or tracking error\n", __func__);
                     kgslStatus = GSL_FAILURE;
                     break;
                 }
-                else
-                {
-                    add_memblock_to_allocated_list(fd, &tmp);
-                }
             } else {
+		kgsl_sharedmem_uncharge(current->tgid, param.flags, param.sizebytes);
 		pr_err("amd-gpu: kgsl_sharedmem_alloc ioctl failed!\n");
 	    }
 
@@ -462,6 +646,7 @@ static long gsl_kmod_ioctl(struct file *fd, unsigned int cmd, unsigned long arg)
         {
             kgsl_sharedmem_free_t param;
             gsl_memdesc_t tmp;
+            struct gsl_kmod_import *import;
             int err;
 #if defined(GSL_IOCTL_DEBUG)
 	    printk(KERN_INFO "--> %s: IOCTL_KGSL_SHAREDMEM_FREE\n", __func__);
@@ -478,6 +663,19 @@ static long gsl_kmod_ioctl(struct file *fd, unsigned int cmd, unsigned long arg)
                 kgslStatus = GSL_FAILURE;
                 break;
             }
+            import = gsl_kmod_unimport_take(fd, tmp.gpuaddr);
+            if (import)
+            {
+                /* submitted ibs may still reference it, keep it until they retire */
+                kgslStatus = gsl_kmod_unimport(import, kgsl_cmdstream_lastissued(import->device_id));
+                memset(&tmp, 0, sizeof(gsl_memdesc_t));
+                if (copy_to_user(param.memdesc, &tmp, sizeof(gsl_memdesc_t)))
+                {
+                    printk(KERN_ERR "%s: copy_to_user error\n", __func__);
+                    kgslStatus = GSL_FAILURE;
+                }
+                break;
+            }
             err = del_memblock_from_allocated_list(fd, &tmp);
             if(err)
             {
@@ -599,6 +797,7 @@ static long gsl_kmod_ioctl(struct file *fd, unsigned int cmd, unsigned long arg)
         {
             kgsl_sharedmem_cacheoperation_t param;
             gsl_memdesc_t memdesc;
+            int err;
 #if defined(GSL_IOCTL_DEBUG)
 	    printk(KERN_INFO "--> %s: IOCTL_KGSL_SHAREDMEM_CACHEOPERATION\n", __func__);
 #endif
@@ -614,6 +813,12 @@ static long gsl_kmod_ioctl(struct file *fd, unsigned int cmd, unsigned long arg)
                 kgslStatus = GSL_FAILURE;
                 break;
             }
+            err = gsl_kmod_import_cacheop(fd, &memdesc, param.offsetbytes, param.sizebytes, param.operation);
+            if (err != -ENOENT)
+            {
+                kgslStatus = err ? GSL_FAILURE : GSL_SUCCESS;
+                break;
+            }
             kgslStatus = kgsl_sharedmem_cacheoperation(&memdesc, param.offsetbytes, param.sizebytes, param.operation);
             break;
         }
@@ -639,6 +844,38 @@ static long gsl_kmod_ioctl(struct file *fd, unsigned int cmd, unsigned long arg)
             kgslStatus = kgsl_sharedmem_fromhostpointer(param.device_id, &memdesc, param.hostptr);
             break;
         }
+    case IOCTL_KGSL_SHAREDMEM_IMPORT:
+        {
+            kgsl_sharedmem_import_t param;
+            gsl_memdesc_t tmp;
+#if defined(GSL_IOCTL_DEBUG)
+	    printk(KERN_INFO "--> %s: IOCTL_KGSL_SHAREDMEM_IMPORT\n", __func__);
+#endif
+            if (copy_from_user(&param, (void __user *)arg, sizeof(kgsl_sharedmem_import_t)))
+            {
+                printk(KERN_ERR "%s: copy_from_user error\n", __func__);
+                kgslStatus = GSL_FAILURE;
+                break;
+            }
+            if (param.device_id <= GSL_DEVICE_ANY || param.device_id > GSL_DEVICE_MAX ||
+                !(gsl_driver.device[param.device_id-1].flags & GSL_FLAGS_INITIALIZED))
+            {
+                kgslStatus = GSL_FAILURE_BADPARAM;
+                break;
+            }
+            kgslStatus = gsl_kmod_import(fd, &param, &tmp);
+            if (kgslStatus == GSL_SUCCESS)
+            {
+                if (copy_to_user(param.memdesc, &tmp, sizeof(gsl_memdesc_t)))
+                {
+                    /* user space never saw the address, nothing can reference it */
+                    gsl_kmod_import_release(gsl_kmod_unimport_take(fd, tmp.gpuaddr));
+                    printk(KERN_ERR "%s: copy_to_user error\n", __func__);
+                    kgslStatus = GSL_FAILURE;
+                }
+            }
+            break;
+        }
     default:
         kgslStatus = -ENOTTY;
         break;
@@ -683,6 +920,386 @@ static int gsl_kmod_fault(struct vm_area_struct *vma, struct vm_fault *vmf)
     return VM_FAULT_SIGBUS;
 }
 
+static unsigned int gsl_kmod_fence_poll(struct file *fd, poll_table *wait)
+{
+    struct gsl_kmod_fence *fence = (struct gsl_kmod_fence *)fd->private_data;
+    gsl_device_t *device = &gsl_driver.device[fence->device_id-1];
+
+    /* the cp and g12 interrupt handlers wake this queue as timestamps retire */
+    poll_wait(fd, &device->timestamp_waitq, wait);
+
+    /* a closed device never retires anything, do not leave the waiter hanging */
+    if (!(device->flags & GSL_FLAGS_INITIALIZED) || !device->memstore.hostptr)
+    {
+        return POLLERR | POLLHUP;
+    }
+
+    if (kgsl_cmdstream_check_timestamp(fence->device_id, fence->timestamp))
+    {
+        return POLLIN | POLLRDNORM;
+    }
+
+    return 0;
+}
+
+static int gsl_kmod_fence_release(struct inode *inode, struct file *fd)
+{
+    kfree(fd->private_data);
+
+    return 0;
+}
+
+static int gsl_kmod_import_pin(struct gsl_kmod_import *import, unsigned long start, unsigned int *phys)
+{
+    struct mm_struct *mm = current->mm;
+    struct vm_area_struct *vma;
+    unsigned long addr, pfn;
+    unsigned int i;
+    int pinned;
+    int err = 0;
+
+    down_read(&mm->mmap_sem);
+
+    vma = find_vma(mm, start);
+    if (vma && vma->vm_start <= start && (vma->vm_flags & (VM_IO | VM_PFNMAP)))
+    {
+        /* frames mmap'ed from the vpu or camera drivers have no struct page to pin */
+        for (i = 0, addr = start; i < import->npages; i++, addr += PAGE_SIZE)
+        {
+            if (addr >= vma->vm_end)
+            {
+                vma = find_vma(mm, addr);
+            }
+            if (!vma || vma->vm_start > addr || (import->writable && !(vma->vm_flags & VM_WRITE)))
+            {
+                err = -EFAULT;
+                break;
+            }
+            err = follow_pfn(vma, addr, &pfn);
+            if (err)
+            {
+                break;
+            }
+            phys[i] = pfn << PAGE_SHIFT;
+        }
+    }
+    else
+    {
+        import->pages = kcalloc(import->npages, sizeof(struct page *), GFP_KERNEL);
+        if (!import->pages)
+        {
+            err = -ENOMEM;
+        }
+        else
+        {
+            pinned = get_user_pages(current, mm, start, import->npages, import->writable, 0, import->pages, NULL);
+            for (i = 0; i < import->npages && (int)i < pinned; i++)
+            {
+                phys[i] = page_to_phys(import->pages[i]);
+            }
+            if (pinned != import->npages)
+            {
+                while (pinned > 0)
+                {
+                    page_cache_release(import->pages[--pinned]);
+                }
+                kfree(import->pages);
+                import->pages = NULL;
+                err = -EFAULT;
+            }
+        }
+    }
+
+    up_read(&mm->mmap_sem);
+
+    return err;
+}
+
+static void gsl_kmod_import_unpin(struct gsl_kmod_import *import)
+{
+    unsigned int i;
+
+    if (!import->pages)
+    {
+        return;
+    }
+
+    for (i = 0; i < import->npages; i++)
+    {
+        if (import->writable)
+        {
+            set_page_dirty_lock(import->pages[i]);
+        }
+        page_cache_release(import->pages[i]);
+    }
+
+    kfree(import->pages);
+    import->pages = NULL;
+}
+
+static int gsl_kmod_import(struct file *fd, const kgsl_sharedmem_import_t *param, gsl_memdesc_t *memdesc)
+{
+    struct gsl_kmod_per_fd_data *datp = (struct gsl_kmod_per_fd_data *)fd->private_data;
+    struct gsl_kmod_import *import;
+    gsl_scatterlist_t scatterlist;
+    unsigned long start = (unsigned long)param->hostptr & PAGE_MASK;
+    unsigned int offset = (unsigned long)param->hostptr & ~PAGE_MASK;
+    unsigned int i;
+    int status;
+
+    if (param->sizebytes == 0 || param->sizebytes > INT_MAX - PAGE_SIZE ||
+        !access_ok(VERIFY_READ, param->hostptr, param->sizebytes))
+    {
+        return GSL_FAILURE_BADPARAM;
+    }
+
+    import = kzalloc(sizeof(struct gsl_kmod_import), GFP_KERNEL);
+    if (!import)
+    {
+        return GSL_FAILURE_OUTOFMEM;
+    }
+
+    import->device_id = param->device_id;
+    import->pid = current->tgid;
+    import->offset = offset;
+    import->sizebytes = param->sizebytes;
+    import->npages = PAGE_ALIGN(offset + param->sizebytes) >> PAGE_SHIFT;
+    import->writable = (param->flags & GSL_MEMFLAGS_GPUAP_MASK) != GSL_MEMFLAGS_GPUREADONLY;
+
+    scatterlist.num = import->npages;
+    scatterlist.pages = kcalloc(import->npages, sizeof(unsigned int), GFP_KERNEL);
+    if (!scatterlist.pages)
+    {
+        kfree(import);
+        return GSL_FAILURE_OUTOFMEM;
+    }
+
+    if (gsl_kmod_import_pin(import, start, scatterlist.pages))
+    {
+        kfree(scatterlist.pages);
+        kfree(import);
+        return GSL_FAILURE;
+    }
+
+    scatterlist.contiguous = 1;
+    for (i = 1; i < scatterlist.num; i++)
+    {
+        if (scatterlist.pages[i] != scatterlist.pages[i-1] + PAGE_SIZE)
+        {
+            scatterlist.contiguous = 0;
+            break;
+        }
+    }
+
+    /* the page table holds the addresses from here on */
+    status = kgsl_sharedmem_map(param->device_id, param->flags, &scatterlist, &import->memdesc);
+    kfree(scatterlist.pages);
+
+    if (status != GSL_SUCCESS)
+    {
+        gsl_kmod_import_unpin(import);
+        kfree(import);
+        return status;
+    }
+
+    import->gpuaddr = import->memdesc.gpuaddr + offset;
+
+    *memdesc = import->memdesc;
+    memdesc->hostptr = param->hostptr;
+    memdesc->gpuaddr = import->gpuaddr;
+    memdesc->size = param->sizebytes;
+
+    mutex_lock(&datp->lock);
+    list_add_tail(&import->node, &datp->imported_blocks_head);
+    mutex_unlock(&datp->lock);
+
+    return GSL_SUCCESS;
+}
+
+/* memqueue release callback, the gpu no longer references the buffer */
+static void gsl_kmod_import_release(void *priv)
+{
+    struct gsl_kmod_import *import = priv;
+
+    kgsl_sharedmem_unmap0(&import->memdesc, import->pid);
+    gsl_kmod_import_unpin(import);
+    kfree(import);
+}
+
+/* unlink an import from the fd, the caller owns it afterwards */
+static struct gsl_kmod_import *gsl_kmod_unimport_take(struct file *fd, gpuaddr_t gpuaddr)
+{
+    struct gsl_kmod_per_fd_data *datp = (struct gsl_kmod_per_fd_data *)fd->private_data;
+    struct gsl_kmod_import *import;
+
+    mutex_lock(&datp->lock);
+    list_for_each_entry(import, &datp->imported_blocks_head, node)
+    {
+        if (import->gpuaddr == gpuaddr)
+        {
+            list_del(&import->node);
+            mutex_unlock(&datp->lock);
+            return import;
+        }
+    }
+    mutex_unlock(&datp->lock);
+
+    return NULL;
+}
+
+/* unmap and unpin once timestamp retires, through the device memqueue like any other free */
+static int gsl_kmod_unimport(struct gsl_kmod_import *import, gsl_timestamp_t timestamp)
+{
+    if (kgsl_cmdstream_releaseontimestamp(import->device_id, &import->memdesc, timestamp,
+                                          gsl_kmod_import_release, import) == GSL_SUCCESS)
+    {
+        return GSL_SUCCESS;
+    }
+
+    /* no memory for the queue node, wait it out instead */
+    kgsl_cmdstream_waittimestamp(import->device_id, timestamp, GSL_TIMEOUT_DEFAULT);
+    gsl_kmod_import_release(import);
+
+    return GSL_SUCCESS;
+}
+
+/*
+ * release a list of imports, batching the gpu unmaps of each importer so the
+ * page tables are walked and the tlb flush decided once per batch.
+ */
+static void gsl_kmod_import_release_list(struct list_head *list)
+{
+    struct gsl_kmod_import *import, *next;
+    gsl_memdesc_t **memdesc;
+    unsigned int pid;
+    int count, batched;
+
+    while (!list_empty(list))
+    {
+        pid = list_first_entry(list, struct gsl_kmod_import, node)->pid;
+
+        count = 0;
+        list_for_each_entry(import, list, node)
+        {
+            count += (import->pid == pid);
+        }
+
+        memdesc = kmalloc(count * sizeof(gsl_memdesc_t *), GFP_KERNEL);
+        batched = (memdesc != NULL);
+        if (batched)
+        {
+            count = 0;
+            list_for_each_entry(import, list, node)
+            {
+                if (import->pid == pid)
+                {
+                    memdesc[count++] = &import->memdesc;
+                }
+            }
+            kgsl_sharedmem_unmap_multi(memdesc, count, pid);
+            kfree(memdesc);
+        }
+
+        list_for_each_entry_safe(import, next, list, node)
+        {
+            if (import->pid != pid)
+            {
+                continue;
+            }
+            list_del(&import->node);
+            if (batched)
+            {
+                gsl_kmod_import_unpin(import);
+                kfree(import);
+            }
+            else
+            {
+                gsl_kmod_import_release(import);
+            }
+        }
+    }
+}
+
+/*
+ * the fd is going away and the devices may be shut down with it, so wait for
+ * everything submitted to retire and release synchronously rather than leave
+ * pinned pages on a memqueue that nobody drains any more.
+ */
+static void gsl_kmod_unimport_all(struct file *fd)
+{
+    struct gsl_kmod_per_fd_data *datp = (struct gsl_kmod_per_fd_data *)fd->private_data;
+    gsl_deviceid_t device_id;
+    LIST_HEAD(released);
+
+    for (device_id = GSL_DEVICE_ANY + 1; device_id <= GSL_DEVICE_MAX; device_id++)
+    {
+        if (!(gsl_driver.device[device_id-1].flags & GSL_FLAGS_INITIALIZED))
+        {
+            continue;
+        }
+        kgsl_cmdstream_waittimestamp(device_id, kgsl_cmdstream_lastissued(device_id), GSL_TIMEOUT_DEFAULT);
+        kgsl_cmdstream_memqueue_drain(&gsl_driver.device[device_id-1]);
+    }
+
+    /* the release takes device and arena locks, don't nest them inside the fd lock */
+    mutex_lock(&datp->lock);
+    list_splice_init(&datp->imported_blocks_head, &released);
+    mutex_unlock(&datp->lock);
+
+    gsl_kmod_import_release_list(&released);
+}
+
+static int gsl_kmod_import_cacheop(struct file *fd, const gsl_memdesc_t *memdesc, unsigned int offsetbytes, unsigned int sizebytes, unsigned int operation)
+{
+    struct gsl_kmod_per_fd_data *datp = (struct gsl_kmod_per_fd_data *)fd->private_data;
+    struct gsl_kmod_import *import;
+    enum dma_data_direction dir;
+    dma_addr_t handle;
+    unsigned int pos, end, len;
+    int err = -ENOENT;
+
+    if (operation & GSL_CACHEFLAGS_INVALIDATE)
+    {
+        dir = (operation & (GSL_CACHEFLAGS_CLEAN | GSL_CACHEFLAGS_WRITECLEAN)) ? DMA_BIDIRECTIONAL : DMA_FROM_DEVICE;
+    }
+    else
+    {
+        dir = DMA_TO_DEVICE;
+    }
+
+    mutex_lock(&datp->lock);
+    list_for_each_entry(import, &datp->imported_blocks_head, node)
+    {
+        if (import->gpuaddr != memdesc->gpuaddr)
+        {
+            continue;
+        }
+
+        err = 0;
+
+        /* pfn mappings belong to drivers that map them uncached */
+        if (!import->pages || offsetbytes >= import->sizebytes)
+        {
+            break;
+        }
+
+        /* only the range the caller touched, not the whole buffer */
+        pos = import->offset + offsetbytes;
+        end = import->offset + ((sizebytes < import->sizebytes - offsetbytes) ? offsetbytes + sizebytes : import->sizebytes);
+        while (pos < end)
+        {
+            len = min((unsigned int)(PAGE_SIZE - (pos & ~PAGE_MASK)), end - pos);
+            handle = dma_map_page(gsl_kmod_dev, import->pages[pos >> PAGE_SHIFT], pos & ~PAGE_MASK, len, dir);
+            dma_unmap_page(gsl_kmod_dev, handle, len, dir);
+            pos += len;
+        }
+        break;
+    }
+    mutex_unlock(&datp->lock);
+
+    return err;
+}
+
 static int gsl_kmod_open(struct inode *inode, struct file *fd)
 {
     gsl_flags_t flags = 0;
@@ -707,8 +1324,10 @@ static int gsl_kmod_open(struct inode *inode, struct file *fd)
                                              GFP_KERNEL);
         if(datp)
         {
+            mutex_init(&datp->lock);
             init_created_contexts_array(datp->created_contexts_array[0]);
             INIT_LIST_HEAD(&datp->allocated_blocks_head);
+            INIT_LIST_HEAD(&datp->imported_blocks_head);
 
             fd->private_data = (void *)datp;
         }
@@ -736,6 +1355,9 @@ static int gsl_kmod_release(struct inode *inode, struct file *fd)
     /* make sure contexts are destroyed */
     del_all_devices_contexts(fd);
 
+    /* and imported user buffers unpinned */
+    gsl_kmod_unimport_all(fd);
+
     if (kgsl_driver_exit() != GSL_SUCCESS)
     {
         printk(KERN_INFO "%s: kgsl_driver_exit error\n", __func__);
@@ -757,6 +1379,223 @@ static int gsl_kmod_release(struct inode *inode, struct file *fd)
 
 static struct class *gsl_kmod_class;
 
+static int gsl_kmod_memqueue_show(struct seq_file *s, void *unused)
+{
+    gsl_memqueue_stats_t stats;
+    gsl_device_t *device;
+    int i;
+
+    for (i = 0; i < GSL_DEVICE_MAX; i++)
+    {
+        device = &gsl_driver.device[i];
+
+        spin_lock(&device->memqueue_lock);
+        stats = device->memqueue_stats;
+        spin_unlock(&device->memqueue_lock);
+
+        seq_printf(s, "device %d\n", i + 1);
+        seq_printf(s, "  queued:    %lld bytes in %lld blocks\n", stats.queued_bytes, stats.queued_nodes);
+        seq_printf(s, "  reclaimed: %lld bytes in %lld blocks, %lld passes\n",
+                   stats.reclaimed_bytes, stats.reclaimed_nodes, stats.reclaim_passes);
+        seq_printf(s, "  latency:   avg %lld us, max %lld us\n",
+                   stats.reclaimed_nodes ? div64_s64(stats.latency_total_us, stats.reclaimed_nodes) : 0,
+                   stats.latency_max_us);
+    }
+
+    return 0;
+}
+
+static int gsl_kmod_memqueue_open(struct inode *inode, struct file *file)
+{
+    return single_open(file, gsl_kmod_memqueue_show, inode->i_private);
+}
+
+static const struct file_operations gsl_kmod_memqueue_fops =
+{
+    .owner = THIS_MODULE,
+    .open = gsl_kmod_memqueue_open,
+    .read = seq_read,
+    .llseek = seq_lseek,
+    .release = single_release
+};
+
+static int gsl_kmod_latency_show(struct seq_file *s, void *unused)
+{
+    unsigned int histogram[GSL_LATENCY_BUCKETS];
+    unsigned int inflight, dropped;
+    unsigned long flags;
+    gsl_device_t *device;
+    int i, b;
+
+    for (i = 0; i < GSL_DEVICE_MAX; i++)
+    {
+        device = &gsl_driver.device[i];
+
+        spin_lock_irqsave(&device->latency_lock, flags);
+        memcpy(histogram, device->latency.histogram, sizeof(histogram));
+        inflight = device->latency.count;
+        dropped  = device->latency.dropped;
+        spin_unlock_irqrestore(&device->latency_lock, flags);
+
+        seq_printf(s, "device %d: %u in flight, %u untracked\n", i + 1, inflight, dropped);
+        for (b = 0; b < GSL_LATENCY_BUCKETS; b++)
+        {
+            if (b < GSL_LATENCY_BUCKETS - 1)
+            {
+                seq_printf(s, "  < %8u us: %u\n", 1U << b, histogram[b]);
+            }
+            else
+            {
+                seq_printf(s, "  >=%8u us: %u\n", 1U << (b - 1), histogram[b]);
+            }
+        }
+    }
+
+    return 0;
+}
+
+static int gsl_kmod_latency_open(struct inode *inode, struct file *file)
+{
+    return single_open(file, gsl_kmod_latency_show, inode->i_private);
+}
+
+static const struct file_operations gsl_kmod_latency_fops =
+{
+    .owner = THIS_MODULE,
+    .open = gsl_kmod_latency_open,
+    .read = seq_read,
+    .llseek = seq_lseek,
+    .release = single_release
+};
+
+static int gsl_kmod_mmu_show(struct seq_file *s, void *unused)
+{
+    gsl_mmustats_t stats;
+    gsl_device_t *device;
+    int status;
+    int i;
+
+    for (i = 0; i < GSL_DEVICE_MAX; i++)
+    {
+        device = &gsl_driver.device[i];
+
+        mutex_lock(&device->lock);
+        status = kgsl_mmu_querystats(&device->mmu, &stats);
+        mutex_unlock(&device->lock);
+
+        if (status != GSL_SUCCESS)
+        {
+            continue;
+        }
+
+        seq_printf(s, "device %d\n", i + 1);
+        seq_printf(s, "  maps:       %lld, unmaps %lld in %lld batches\n",
+                   stats.pt.maps, stats.pt.unmaps, stats.pt.batches);
+        seq_printf(s, "  ptes:       %lld written, %lld empty superptes skipped\n",
+                   stats.pt.ptewrites, stats.pt.superptesskipped);
+        seq_printf(s, "  tlbflushes: %lld issued, %lld requested\n",
+                   stats.tlbflushes, stats.tlbflushrequests);
+    }
+
+    return 0;
+}
+
+static int gsl_kmod_mmu_open(struct inode *inode, struct file *file)
+{
+    return single_open(file, gsl_kmod_mmu_show, inode->i_private);
+}
+
+static const struct file_operations gsl_kmod_mmu_fops =
+{
+    .owner = THIS_MODULE,
+    .open = gsl_kmod_mmu_open,
+    .read = seq_read,
+    .llseek = seq_lseek,
+    .release = single_release
+};
+
+static int gsl_kmod_procmem_show(struct seq_file *s, void *unused)
+{
+    gsl_sharedmem_procstats_t stats;
+    int i;
+
+    seq_printf(s, "limit %u bytes per process%s\n", kgsl_sharedmem_getproclimit(),
+               kgsl_sharedmem_getproclimit() ? "" : " (unlimited)");
+    seq_printf(s, "table %d processes, %lld allocations refused while full\n",
+               GSL_CALLER_PROCESS_MAX, kgsl_sharedmem_getprocfull());
+    seq_printf(s, "%8s %12s %12s %12s %10s\n", "pid", "emem", "phys", "peak", "overlimit");
+
+    for (i = 0; kgsl_sharedmem_getprocstats(i, &stats) == GSL_SUCCESS; i++)
+    {
+        if (!stats.pid)
+        {
+            continue;
+        }
+
+        seq_printf(s, "%8u %12lld %12lld %12lld %10lld\n", stats.pid,
+                   stats.bytes[GSL_APERTURE_EMEM], stats.bytes[GSL_APERTURE_PHYS],
+                   stats.bytes_max, stats.allocs_overlimit);
+    }
+
+    return 0;
+}
+
+static int gsl_kmod_procmem_open(struct inode *inode, struct file *file)
+{
+    return single_open(file, gsl_kmod_procmem_show, inode->i_private);
+}
+
+static const struct file_operations gsl_kmod_procmem_fops =
+{
+    .owner = THIS_MODULE,
+    .open = gsl_kmod_procmem_open,
+    .read = seq_read,
+    .llseek = seq_lseek,
+    .release = single_release
+};
+
+static int gsl_kmod_proclimit_get(void *data, u64 *val)
+{
+    *val = kgsl_sharedmem_getproclimit();
+    return 0;
+}
+
+static int gsl_kmod_proclimit_set(void *data, u64 val)
+{
+    if (val > UINT_MAX)
+    {
+        return -EINVAL;
+    }
+
+    kgsl_sharedmem_setproclimit((unsigned int)val);
+    return 0;
+}
+
+DEFINE_SIMPLE_ATTRIBUTE(gsl_kmod_proclimit_fops, gsl_kmod_proclimit_get, gsl_kmod_proclimit_set, "%llu\n");
+
+static void gsl_kmod_debugfs_init(void)
+{
+    /* debugfs is a debugging aid, the driver works without it */
+    gsl_kmod_debugfs = debugfs_create_dir("gsl_kmod", NULL);
+    if (IS_ERR_OR_NULL(gsl_kmod_debugfs))
+    {
+        gsl_kmod_debugfs = NULL;
+        return;
+    }
+
+    debugfs_create_file("memqueue", S_IRUGO, gsl_kmod_debugfs, NULL, &gsl_kmod_memqueue_fops);
+    debugfs_create_file("latency", S_IRUGO, gsl_kmod_debugfs, NULL, &gsl_kmod_latency_fops);
+    debugfs_create_file("mmu", S_IRUGO, gsl_kmod_debugfs, NULL, &gsl_kmod_mmu_fops);
+    debugfs_create_file("procmem", S_IRUGO, gsl_kmod_debugfs, NULL, &gsl_kmod_procmem_fops);
+    debugfs_create_file("proclimit", S_IRUGO | S_IWUSR, gsl_kmod_debugfs, NULL, &gsl_kmod_proclimit_fops);
+}
+
+static void gsl_kmod_debugfs_exit(void)
+{
+    debugfs_remove_recursive(gsl_kmod_debugfs);
+    gsl_kmod_debugfs = NULL;
+}
+
 static irqreturn_t z160_irq_handler(int irq, void *dev_id)
 {
     kgsl_intr_isr(&gsl_driver.device[GSL_DEVICE_G12-1]);
@@ -882,6 +1721,8 @@ static int gpu_probe(struct platform_device *pdev)
     if (!IS_ERR(dev))
     {
     //    gsl_kmod_data.device = dev;
+        gsl_kmod_dev = &pdev->dev;
+        gsl_kmod_debugfs_init();
         return 0;
     }
 
@@ -917,6 +1758,7 @@ nodev:
 
 static int gpu_remove(struct platform_device *pdev)
 {
+    gsl_kmod_debugfs_exit();
     device_destroy(gsl_kmod_class, MKDEV(gsl_kmod_major, 0));
     class_destroy(gsl_kmod_class);
     unregister_chrdev(gsl_kmod_major, "gsl_kmod");
@@ -21,6 +21,7 @@
 
 #include <linux/kernel.h>
 #include <linux/fs.h>
+#include <linux/sched.h>
 
 /*
  * Local helper functions to check and convert device/context id's (1 based)
@@ -78,7 +79,9 @@ static s8 *find_first_entry_with(s8 *subarray, s8 context_id)
  * NOTE! gsl_memdesc_ts are COPIED so user space should NOT change them.
  */
 int add_memblock_to_allocated_list(struct file *fd,
-                                   gsl_memdesc_t *allocated_block)
+                                   gsl_memdesc_t *allocated_block,
+                                   gsl_flags_t flags,
+                                   int charged)
 {
     int err = 0;
     struct gsl_kmod_per_fd_data *datp;
@@ -97,16 +100,23 @@ int add_memblock_to_allocated_list(struct file *fd,
     if(lisp)
     {
         INIT_LIST_HEAD(&lisp->node);
+        memcpy(&lisp->allocated_block, allocated_block, sizeof(gsl_memdesc_t));
+        lisp->pid = current->tgid;
+        lisp->flags = flags;
+        lisp->charged = charged;
+
+        mutex_lock(&datp->lock);
 
         /* builds FIFO (list_add() would build LIFO) */
         list_add_tail(&lisp->node, head);
-        memcpy(&lisp->allocated_block, allocated_block, sizeof(gsl_memdesc_t));
         lisp->allocation_number = datp->maximum_number_of_blocks;
 //        printk(KERN_DEBUG "List entry #%u allocated\n", lisp->allocation_number);
 
         datp->maximum_number_of_blocks++;
         datp->number_of_allocated_blocks++;
 
+        mutex_unlock(&datp->lock);
+
         err = 0;
     }
     else
@@ -134,6 +144,8 @@ int del_memblock_from_allocated_list(struct file *fd,
     head = &datp->allocated_blocks_head;
     DEBUG_ASSERT(head);
 
+    mutex_lock(&datp->lock);
+
     DEBUG_ASSERT(datp->number_of_allocated_blocks > 0);
 
     if(!list_empty(head))
@@ -147,12 +159,15 @@ int del_memblock_from_allocated_list(struct file *fd,
 
                 list_del(&cursor->node);
 //                printk(KERN_DEBUG "List entry #%u freed\n", cursor->allocation_number);
+                kgsl_sharedmem_uncharge(cursor->pid, cursor->flags, cursor->charged);
                 kfree(cursor);
                 datp->number_of_allocated_blocks--;
+                mutex_unlock(&datp->lock);
                 return 0;
             }
         }
     }
+    mutex_unlock(&datp->lock);
     return -EINVAL; // tried to free entry not existing or from empty list.
 }
 
@@ -168,6 +183,8 @@ int del_all_memblocks_from_allocated_list(struct file *fd)
     head = &datp->allocated_blocks_head;
     DEBUG_ASSERT(head);
 
+    mutex_lock(&datp->lock);
+
     if(!list_empty(head))
     {
         printk(KERN_INFO "Not all allocated memory blocks were freed. Doing it now.\n");
@@ -175,6 +192,7 @@ int del_all_memblocks_from_allocated_list(struct file *fd)
         {
             printk(KERN_INFO "Freeing list entry #%u, gpuaddr=%x\n", (u32)cursor->allocation_number, cursor->allocated_block.gpuaddr);
             kgsl_sharedmem_free(&cursor->allocated_block);
+            kgsl_sharedmem_uncharge(cursor->pid, cursor->flags, cursor->charged);
             list_del(&cursor->node);
             kfree(cursor);
         }
@@ -183,6 +201,8 @@ int del_all_memblocks_from_allocated_list(struct file *fd)
     DEBUG_ASSERT(list_empty(head));
     datp->number_of_allocated_blocks = 0;
 
+    mutex_unlock(&datp->lock);
+
     return 0;
 }
 
@@ -203,6 +223,8 @@ void add_device_context_to_array(struct file *fd,
 
     datp = get_fd_private_data(fd);
 
+    mutex_lock(&datp->lock);
+
     subarray = datp->created_contexts_array[device_index];
     entry = find_first_entry_with(subarray, EMPTY_ENTRY);
 
@@ -210,7 +232,12 @@ void add_device_context_to_array(struct file *fd,
     DEBUG_ASSERT((datp->created_contexts_array[device_index] <= entry) &&
                (entry < datp->created_contexts_array[device_index] + GSL_CONTEXT_MAX));
     DEBUG_ASSERT(context_id < 127);
-    *entry = (s8)context_id;
+    if(entry)
+    {
+        *entry = (s8)context_id;
+    }
+
+    mutex_unlock(&datp->lock);
 }
 
 void del_device_context_from_array(struct file *fd, 
@@ -225,12 +252,20 @@ void del_device_context_from_array(struct file *fd,
     datp = get_fd_private_data(fd);
 
     DEBUG_ASSERT(context_id < 127);
+
+    mutex_lock(&datp->lock);
+
     subarray = &(datp->created_contexts_array[device_index][0]);
     entry = find_first_entry_with(subarray, context_id);
     DEBUG_ASSERT(entry);
     DEBUG_ASSERT((datp->created_contexts_array[device_index] <= entry) &&
                (entry < datp->created_contexts_array[device_index] + GSL_CONTEXT_MAX));
-    *entry = EMPTY_ENTRY;
+    if(entry)
+    {
+        *entry = EMPTY_ENTRY;
+    }
+
+    mutex_unlock(&datp->lock);
 }
 
 void del_all_devices_contexts(struct file *fd)
@@ -244,6 +279,8 @@ void del_all_devices_contexts(struct file *fd)
     
     datp = get_fd_private_data(fd);
 
+    mutex_lock(&datp->lock);
+
     /* device_id is 1 based */
     for(id = GSL_DEVICE_ANY + 1; id <= GSL_DEVICE_MAX; id++)
     {
@@ -265,5 +302,7 @@ void del_all_devices_contexts(struct file *fd)
             }
         }
     }
+
+    mutex_unlock(&datp->lock);
 }
 
@@ -34,6 +34,7 @@
 #include <linux/slab.h>
 #include <linux/fs.h>
 #include <linux/list.h>
+#include <linux/mutex.h>
 
 #if (GSL_CONTEXT_MAX > 127)
     #error created_contexts_array supports context numbers only 127 or less.
@@ -48,12 +49,17 @@ struct gsl_kmod_alloc_list
     struct list_head node;
     gsl_memdesc_t allocated_block;
     u32 allocation_number;
+    u32 pid;                                // process the block is charged to
+    gsl_flags_t flags;
+    int charged;                            // bytes charged, as requested
 };
 
 /* A structure to hold abovementioned list of blocks. Contain per fd data. */
 struct gsl_kmod_per_fd_data
 {
+    struct mutex lock;                      // threads may share one fd
     struct list_head allocated_blocks_head; // list head
+    struct list_head imported_blocks_head;  // user buffers mapped in place
     u32 maximum_number_of_blocks;
     u32 number_of_allocated_blocks;
     s8 created_contexts_array[GSL_DEVICE_MAX][GSL_CONTEXT_MAX];
@@ -66,7 +72,9 @@ struct gsl_kmod_per_fd_data
 
 /* allocated memory block tracking */
 int add_memblock_to_allocated_list(struct file *fd,
-                                   gsl_memdesc_t *allocated_block);
+                                   gsl_memdesc_t *allocated_block,
+                                   gsl_flags_t flags,
+                                   int charged);
 
 int del_memblock_from_allocated_list(struct file *fd,
                                      gsl_memdesc_t *freed_block);
@@ -16,31 +16,99 @@
  *
  */
 
-#include <linux/list.h>
-#include <linux/mutex.h>
+#include <linux/rbtree.h>
+#include <linux/rwsem.h>
 #include <linux/vmalloc.h>
 #include <linux/mm.h>
 #include <linux/slab.h>
+#include <asm/atomic.h>
 #include <asm/uaccess.h>
 
 #include "gsl_linux_map.h"
 
 struct gsl_linux_map
 {
-	struct list_head list;
+	struct rb_node node;
 	unsigned int gpu_addr;
 	void *kernel_virtual_addr;
 	unsigned int size;
+	atomic_t refcount;
 };
 
-static LIST_HEAD(gsl_linux_map_list);
-static DEFINE_MUTEX(gsl_linux_map_mutex);
+/*
+ * mappings never overlap, so a tree ordered by gpu address finds the one
+ * covering an offset. lookups are far more common than map/unmap, so readers
+ * share the semaphore. the tree holds one reference and every reader takes
+ * another before dropping the semaphore: a user copy may fault and take
+ * mmap_sem, and gsl_kmod_mmap() comes in here with mmap_sem held, so the
+ * semaphore must never be held across one.
+ */
+static struct rb_root gsl_linux_map_tree = RB_ROOT;
+static DECLARE_RWSEM(gsl_linux_map_sem);
+
+static struct gsl_linux_map *gsl_linux_map_lookup(unsigned int gpuoffset)
+{
+	struct rb_node *n = gsl_linux_map_tree.rb_node;
+	struct gsl_linux_map *map;
+
+	while (n) {
+		map = rb_entry(n, struct gsl_linux_map, node);
+		if (gpuoffset < map->gpu_addr)
+			n = n->rb_left;
+		else if (gpuoffset >= map->gpu_addr + map->size)
+			n = n->rb_right;
+		else
+			return map;
+	}
+
+	return NULL;
+}
+
+static struct gsl_linux_map *gsl_linux_map_get(unsigned int gpuoffset)
+{
+	struct gsl_linux_map *map;
+
+	down_read(&gsl_linux_map_sem);
+	map = gsl_linux_map_lookup(gpuoffset);
+	if (map)
+		atomic_inc(&map->refcount);
+	up_read(&gsl_linux_map_sem);
+
+	return map;
+}
+
+static void gsl_linux_map_put(struct gsl_linux_map *map)
+{
+	if (atomic_dec_and_test(&map->refcount)) {
+		vfree(map->kernel_virtual_addr);
+		kfree(map);
+	}
+}
+
+static void gsl_linux_map_insert(struct gsl_linux_map *new)
+{
+	struct rb_node **link = &gsl_linux_map_tree.rb_node;
+	struct rb_node *parent = NULL;
+	struct gsl_linux_map *map;
+
+	while (*link) {
+		parent = *link;
+		map = rb_entry(parent, struct gsl_linux_map, node);
+		if (new->gpu_addr < map->gpu_addr)
+			link = &parent->rb_left;
+		else
+			link = &parent->rb_right;
+	}
+
+	rb_link_node(&new->node, parent, link);
+	rb_insert_color(&new->node, &gsl_linux_map_tree);
+}
 
 int gsl_linux_map_init()
 {
-	mutex_lock(&gsl_linux_map_mutex);
-	INIT_LIST_HEAD(&gsl_linux_map_list);
-	mutex_unlock(&gsl_linux_map_mutex);
+	down_write(&gsl_linux_map_sem);
+	gsl_linux_map_tree = RB_ROOT;
+	up_write(&gsl_linux_map_sem);
 
 	return 0;
 }
@@ -48,174 +116,146 @@ int gsl_linux_map_init()
 void *gsl_linux_map_alloc(unsigned int gpu_addr, unsigned int size)
 {
 	struct gsl_linux_map * map;
-	struct list_head *p;
 	void *va;
 
-	mutex_lock(&gsl_linux_map_mutex);
+	down_write(&gsl_linux_map_sem);
 
-	list_for_each(p, &gsl_linux_map_list){
-		map = list_entry(p, struct gsl_linux_map, list);
-		if(map->gpu_addr == gpu_addr){
-			mutex_unlock(&gsl_linux_map_mutex);
-			return map->kernel_virtual_addr;
-		}
+	map = gsl_linux_map_lookup(gpu_addr);
+	if(map && map->gpu_addr == gpu_addr){
+		up_write(&gsl_linux_map_sem);
+		return map->kernel_virtual_addr;
 	}
 
 	va = __vmalloc(size, GFP_KERNEL, pgprot_writecombine(pgprot_kernel));
 	if(va == NULL){
-		mutex_unlock(&gsl_linux_map_mutex);
+		up_write(&gsl_linux_map_sem);
 		return NULL;
 	}
 
 	map = (struct gsl_linux_map *)kmalloc(sizeof(*map), GFP_KERNEL);
+	if(map == NULL){
+		vfree(va);
+		up_write(&gsl_linux_map_sem);
+		return NULL;
+	}
 	map->gpu_addr = gpu_addr;
 	map->kernel_virtual_addr = va;
 	map->size = size;
+	atomic_set(&map->refcount, 1);
 
-	INIT_LIST_HEAD(&map->list);
-	list_add_tail(&map->list, &gsl_linux_map_list);
+	gsl_linux_map_insert(map);
 
-	mutex_unlock(&gsl_linux_map_mutex);
+	up_write(&gsl_linux_map_sem);
 	return va;
 }
 
 void gsl_linux_map_free(unsigned int gpu_addr)
 {
-	int found = 0;
 	struct gsl_linux_map * map;
-	struct list_head *p;
 
-	mutex_lock(&gsl_linux_map_mutex);
+	down_write(&gsl_linux_map_sem);
 
-	list_for_each(p, &gsl_linux_map_list){
-		map = list_entry(p, struct gsl_linux_map, list);
-		if(map->gpu_addr == gpu_addr){
-			found = 1;
-			break;
-		}
-	}
+	map = gsl_linux_map_lookup(gpu_addr);
+	if(map && map->gpu_addr == gpu_addr)
+		rb_erase(&map->node, &gsl_linux_map_tree);
+	else
+		map = NULL;
 
-	if(found){
-		vfree(map->kernel_virtual_addr);
-		list_del(&map->list);
-		kfree(map);
-	}
+	up_write(&gsl_linux_map_sem);
 
-	mutex_unlock(&gsl_linux_map_mutex);
+	if (map)
+		gsl_linux_map_put(map);
 }
 
 void *gsl_linux_map_find(unsigned int gpu_addr)
 {
 	struct gsl_linux_map * map;
-	struct list_head *p;
+	void *va = NULL;
 
-	mutex_lock(&gsl_linux_map_mutex);
+	down_read(&gsl_linux_map_sem);
 
-	list_for_each(p, &gsl_linux_map_list){
-		map = list_entry(p, struct gsl_linux_map, list);
-		if(map->gpu_addr == gpu_addr){
-			mutex_unlock(&gsl_linux_map_mutex);
-			return map->kernel_virtual_addr;
-		}
-	}
+	map = gsl_linux_map_lookup(gpu_addr);
+	if(map && map->gpu_addr == gpu_addr)
+		va = map->kernel_virtual_addr;
 
-	mutex_unlock(&gsl_linux_map_mutex);
-	return NULL;
+	up_read(&gsl_linux_map_sem);
+	return va;
 }
 
 void *gsl_linux_map_read(void *dst, unsigned int gpuoffset, unsigned int sizebytes, unsigned int touserspace)
 {
 	struct gsl_linux_map * map;
-	struct list_head *p;
-
-	mutex_lock(&gsl_linux_map_mutex);
-
-	list_for_each(p, &gsl_linux_map_list){
-		map = list_entry(p, struct gsl_linux_map, list);
-		if(map->gpu_addr <= gpuoffset &&
-			(map->gpu_addr +  map->size) > gpuoffset){
-			void *src = map->kernel_virtual_addr + (gpuoffset - map->gpu_addr);
-			mutex_unlock(&gsl_linux_map_mutex);
-                        if (touserspace)
-                        {
-                            return (void *)copy_to_user(dst, map->kernel_virtual_addr + gpuoffset - map->gpu_addr, sizebytes);
-                        }
-                        else
-                        {
-	                    return memcpy(dst, src, sizebytes);
-                        }
-		}
+	void *ret = NULL;
+
+	map = gsl_linux_map_get(gpuoffset);
+	if(map){
+		void *src = map->kernel_virtual_addr + (gpuoffset - map->gpu_addr);
+                if (touserspace)
+                {
+                    ret = (void *)copy_to_user(dst, src, sizebytes);
+                }
+                else
+                {
+                    ret = memcpy(dst, src, sizebytes);
+                }
+		gsl_linux_map_put(map);
 	}
 
-	mutex_unlock(&gsl_linux_map_mutex);
-	return NULL;
+	return ret;
 }
 
 void *gsl_linux_map_write(void *src, unsigned int gpuoffset, unsigned int sizebytes, unsigned int fromuserspace)
 {
 	struct gsl_linux_map * map;
-	struct list_head *p;
-
-	mutex_lock(&gsl_linux_map_mutex);
-
-	list_for_each(p, &gsl_linux_map_list){
-		map = list_entry(p, struct gsl_linux_map, list);
-		if(map->gpu_addr <= gpuoffset &&
-			(map->gpu_addr +  map->size) > gpuoffset){
-			void *dst = map->kernel_virtual_addr + (gpuoffset - map->gpu_addr);
-			mutex_unlock(&gsl_linux_map_mutex);
-                        if (fromuserspace)
-                        {
-                            return (void *)copy_from_user(map->kernel_virtual_addr + gpuoffset - map->gpu_addr, src, sizebytes);
-                        }
-                        else
-                        {
-                            return memcpy(dst, src, sizebytes);
-                        }
-		}
+	void *ret = NULL;
+
+	map = gsl_linux_map_get(gpuoffset);
+	if(map){
+		void *dst = map->kernel_virtual_addr + (gpuoffset - map->gpu_addr);
+                if (fromuserspace)
+                {
+                    ret = (void *)copy_from_user(dst, src, sizebytes);
+                }
+                else
+                {
+                    ret = memcpy(dst, src, sizebytes);
+                }
+		gsl_linux_map_put(map);
 	}
 
-	mutex_unlock(&gsl_linux_map_mutex);
-	return NULL;
+	return ret;
 }
 
 void *gsl_linux_map_set(unsigned int gpuoffset, unsigned int value, unsigned int sizebytes)
 {
 	struct gsl_linux_map * map;
-	struct list_head *p;
-
-	mutex_lock(&gsl_linux_map_mutex);
-
-	list_for_each(p, &gsl_linux_map_list){
-		map = list_entry(p, struct gsl_linux_map, list);
-		if(map->gpu_addr <= gpuoffset &&
-			(map->gpu_addr +  map->size) > gpuoffset){
-			void *ptr = map->kernel_virtual_addr + (gpuoffset - map->gpu_addr);
-			mutex_unlock(&gsl_linux_map_mutex);
-			return memset(ptr, value, sizebytes);
-		}
+	void *ret = NULL;
+
+	down_read(&gsl_linux_map_sem);
+
+	map = gsl_linux_map_lookup(gpuoffset);
+	if(map){
+		void *ptr = map->kernel_virtual_addr + (gpuoffset - map->gpu_addr);
+		ret = memset(ptr, value, sizebytes);
 	}
 
-	mutex_unlock(&gsl_linux_map_mutex);
-	return NULL;
+	up_read(&gsl_linux_map_sem);
+	return ret;
 }
 
 int gsl_linux_map_destroy()
 {
 	struct gsl_linux_map * map;
-	struct list_head *p, *tmp;
+	struct rb_node *n;
 
-	mutex_lock(&gsl_linux_map_mutex);
+	down_write(&gsl_linux_map_sem);
 
-	list_for_each_safe(p, tmp, &gsl_linux_map_list){
-		map = list_entry(p, struct gsl_linux_map, list);
-		vfree(map->kernel_virtual_addr);
-		list_del(&map->list);
-		kfree(map);
+	while ((n = rb_first(&gsl_linux_map_tree)) != NULL) {
+		map = rb_entry(n, struct gsl_linux_map, node);
+		rb_erase(&map->node, &gsl_linux_map_tree);
+		gsl_linux_map_put(map);
 	}
 
-	INIT_LIST_HEAD(&gsl_linux_map_list);
-
-	mutex_unlock(&gsl_linux_map_mutex);
+	up_write(&gsl_linux_map_sem);
 	return 0;
 }
@@ -262,11 +262,138 @@ kgsl_memarena_releasememblknode(gsl_memarena_t *memarena, memblk_t *memblk)
 
 //----------------------------------------------------------------------------
 
+static void
+kgsl_memarena_insertaddr(gsl_memarena_t *memarena, memblk_t *memblk)
+{
+    struct rb_node  **link   = &memarena->freelist.addrtree.rb_node;
+    struct rb_node  *parent  = NULL;
+    memblk_t        *p;
+
+    while (*link)
+    {
+        parent = *link;
+        p      = rb_entry(parent, memblk_t, addrnode);
+
+        if (memblk->blkaddr < p->blkaddr)
+        {
+            link = &parent->rb_left;
+        }
+        else
+        {
+            link = &parent->rb_right;
+        }
+    }
+
+    rb_link_node(&memblk->addrnode, parent, link);
+    rb_insert_color(&memblk->addrnode, &memarena->freelist.addrtree);
+}
+
+//----------------------------------------------------------------------------
+
+static void
+kgsl_memarena_insertsize(gsl_memarena_t *memarena, memblk_t *memblk)
+{
+    struct rb_node  **link   = &memarena->freelist.sizetree.rb_node;
+    struct rb_node  *parent  = NULL;
+    memblk_t        *p;
+
+    // equal sizes are ordered by address so best fit prefers the lowest block
+    while (*link)
+    {
+        parent = *link;
+        p      = rb_entry(parent, memblk_t, sizenode);
+
+        if (memblk->blksize < p->blksize ||
+            (memblk->blksize == p->blksize && memblk->blkaddr < p->blkaddr))
+        {
+            link = &parent->rb_left;
+        }
+        else
+        {
+            link = &parent->rb_right;
+        }
+    }
+
+    rb_link_node(&memblk->sizenode, parent, link);
+    rb_insert_color(&memblk->sizenode, &memarena->freelist.sizetree);
+}
+
+//----------------------------------------------------------------------------
+
+static __inline void
+kgsl_memarena_removeblock(gsl_memarena_t *memarena, memblk_t *memblk)
+{
+    rb_erase(&memblk->addrnode, &memarena->freelist.addrtree);
+    rb_erase(&memblk->sizenode, &memarena->freelist.sizetree);
+    memarena->freelist.numblocks--;
+
+    kgsl_memarena_releasememblknode(memarena, memblk);
+}
+
+//----------------------------------------------------------------------------
+
+static memblk_t*
+kgsl_memarena_findsize(gsl_memarena_t *memarena, unsigned int blksize)
+{
+    struct rb_node  *node = memarena->freelist.sizetree.rb_node;
+    memblk_t        *best = NULL;
+    memblk_t        *p;
+
+    // smallest free block of at least blksize bytes
+    while (node)
+    {
+        p = rb_entry(node, memblk_t, sizenode);
+
+        if (p->blksize >= blksize)
+        {
+            best = p;
+            node = node->rb_left;
+        }
+        else
+        {
+            node = node->rb_right;
+        }
+    }
+
+    return (best);
+}
+
+//----------------------------------------------------------------------------
+
+static memblk_t*
+kgsl_memarena_findaddr(gsl_memarena_t *memarena, unsigned int blkaddr)
+{
+    struct rb_node  *node = memarena->freelist.addrtree.rb_node;
+    memblk_t        *prev = NULL;
+    memblk_t        *p;
+
+    // free block with the highest address below blkaddr
+    while (node)
+    {
+        p = rb_entry(node, memblk_t, addrnode);
+
+        if (p->blkaddr < blkaddr)
+        {
+            prev = p;
+            node = node->rb_right;
+        }
+        else
+        {
+            node = node->rb_left;
+        }
+    }
+
+    return (prev);
+}
+
+//----------------------------------------------------------------------------
+
 gsl_memarena_t*
 kgsl_memarena_create(int mmu_virtualized, unsigned int hostbaseaddr, gpuaddr_t gpubaseaddr, int sizebytes)
 {
     static int      count = 0;
     gsl_memarena_t  *memarena;
+    memblk_t        *p;
 
     kgsl_log_write( KGSL_LOG_GROUP_MEMORY | KGSL_LOG_LEVEL_TRACE,
                     "--> gsl_memarena_t* kgsl_memarena_create(gpuaddr_t gpubaseaddr=0x%08x, int sizebytes=%d)\n", gpubaseaddr, sizebytes );
@@ -293,14 +420,26 @@ kgsl_memarena_create(int mmu_virtualized, unsigned int hostbaseaddr, gpuaddr_t g
     memarena->gpubaseaddr  = gpubaseaddr;
     memarena->sizebytes    = sizebytes;
 
+    memarena->freelist.addrtree = RB_ROOT;
+    memarena->freelist.sizetree = RB_ROOT;
+
     // allocate a memory block in free list which represents all memory in arena
-    memarena->freelist.head          = kgsl_memarena_getmemblknode(memarena);
-    memarena->freelist.head->blkaddr = 0;
-    memarena->freelist.head->blksize = memarena->sizebytes;
-    memarena->freelist.head->next    = memarena->freelist.head;
-    memarena->freelist.head->prev    = memarena->freelist.head;
-    memarena->freelist.allocrover    = memarena->freelist.head;
-    memarena->freelist.freerover     = memarena->freelist.head;
+    p = kgsl_memarena_getmemblknode(memarena);
+    if (!p)
+    {
+        kgsl_log_write( KGSL_LOG_GROUP_MEMORY | KGSL_LOG_LEVEL_ERROR,
+                        "ERROR: Memarena allocation failed.\n" );
+        kfree((void *)memarena);
+        kgsl_log_write( KGSL_LOG_GROUP_MEMORY | KGSL_LOG_LEVEL_ERROR, "<-- kgsl_memarena_create. Return value: 0x%08x\n", NULL );
+        return (NULL);
+    }
+
+    p->blkaddr = 0;
+    p->blksize = memarena->sizebytes;
+
+    kgsl_memarena_insertaddr(memarena, p);
+    kgsl_memarena_insertsize(memarena, p);
+    memarena->freelist.numblocks = 1;
 
     count++;
 
@@ -314,39 +453,33 @@ kgsl_memarena_create(int mmu_virtualized, unsigned int hostbaseaddr, gpuaddr_t g
 int
 kgsl_memarena_destroy(gsl_memarena_t *memarena)
 {
-    int       status = GSL_SUCCESS;
-    int	      err;
-    memblk_t  *p, *next;
+    int             status = GSL_SUCCESS;
+    struct rb_node  *node;
 
     kgsl_log_write( KGSL_LOG_GROUP_MEMORY | KGSL_LOG_LEVEL_TRACE,
                     "--> int kgsl_memarena_destroy(gsl_memarena_t *memarena=0x%08x)\n", memarena );
 
     GSL_MEMARENA_VALIDATE(memarena);
 
-    err = mutex_lock_interruptible(&memarena->lock);
-    if (err == -EINTR) {
-	kgsl_log_write( KGSL_LOG_GROUP_MEMORY | KGSL_LOG_LEVEL_FATAL,
-			"WARNING: memarena mutex lock was interrupted\n");
-    }
+    mutex_lock(&memarena->lock);
 
 #ifdef _DEBUG
     // memory leak check
-    if (memarena->freelist.head->blksize != memarena->sizebytes)
+    node = rb_first(&memarena->freelist.addrtree);
+    if (memarena->freelist.numblocks != 1 || rb_entry(node, memblk_t, addrnode)->blksize != memarena->sizebytes)
     {
             // external memory leak detected
             kgsl_log_write( KGSL_LOG_GROUP_MEMORY | KGSL_LOG_LEVEL_FATAL,
                             "ERROR: External memory leak detected.\n" );
+            mutex_unlock(&memarena->lock);
             return (GSL_FAILURE);
     }
 #endif // _DEBUG
 
-    p = memarena->freelist.head;
-    do
+    while ((node = rb_first(&memarena->freelist.addrtree)) != NULL)
     {
-        next = p->next;
-        kgsl_memarena_releasememblknode(memarena, p);
-        p = next;
-    } while (p != memarena->freelist.head);
+        kgsl_memarena_removeblock(memarena, rb_entry(node, memblk_t, addrnode));
+    }
 
     mutex_unlock(&memarena->lock);
 
@@ -371,30 +504,38 @@ kgsl_memarena_isvirtualized(gsl_memarena_t *memarena)
 int
 kgsl_memarena_checkconsistency(gsl_memarena_t *memarena)
 {
-    memblk_t *p;
+    struct rb_node  *node;
+    memblk_t        *p, *next;
+    unsigned int    numblocks = 0;
 
     kgsl_log_write( KGSL_LOG_GROUP_MEMORY | KGSL_LOG_LEVEL_TRACE,
                     "--> int kgsl_memarena_checkconsistency(gsl_memarena_t *memarena=0x%08x)\n", memarena );
 
     // go through list of free blocks and make sure there are no detectable errors
+    // free blocks must be non-empty, ordered, and never overlap or touch (touching blocks are coalesced)
 
-    p = memarena->freelist.head;
-    do
+    for (node = rb_first(&memarena->freelist.addrtree); node; node = rb_next(node))
     {
-        if (p->next->blkaddr != memarena->freelist.head->blkaddr)
+        p = rb_entry(node, memblk_t, addrnode);
+
+        numblocks++;
+
+        if (p->blksize == 0 ||
+            p->blkaddr + p->blksize > memarena->sizebytes ||
+            (rb_next(node) && (next = rb_entry(rb_next(node), memblk_t, addrnode), p->blkaddr + p->blksize >= next->blkaddr)))
         {
-            if (p->prev->next->blkaddr  != p->blkaddr ||
-                p->next->prev->blkaddr  != p->blkaddr ||
-                p->blkaddr + p->blksize >= p->next->blkaddr)
-            {
-                DEBUG_ASSERT(0);
-                kgsl_log_write( KGSL_LOG_GROUP_MEMORY | KGSL_LOG_LEVEL_TRACE, "<-- kgsl_memarena_checkconsistency. Return value: %B\n", GSL_FAILURE );
-                return (GSL_FAILURE);
-            }
+            DEBUG_ASSERT(0);
+            kgsl_log_write( KGSL_LOG_GROUP_MEMORY | KGSL_LOG_LEVEL_TRACE, "<-- kgsl_memarena_checkconsistency. Return value: %B\n", GSL_FAILURE );
+            return (GSL_FAILURE);
         }
-        p = p->next;
+    }
 
-    } while (p != memarena->freelist.head);
+    if (numblocks != memarena->freelist.numblocks)
+    {
+        DEBUG_ASSERT(0);
+        kgsl_log_write( KGSL_LOG_GROUP_MEMORY | KGSL_LOG_LEVEL_TRACE, "<-- kgsl_memarena_checkconsistency. Return value: %B\n", GSL_FAILURE );
+        return (GSL_FAILURE);
+    }
 
     kgsl_log_write( KGSL_LOG_GROUP_MEMORY | KGSL_LOG_LEVEL_TRACE, "<-- kgsl_memarena_checkconsistency. Return value: %B\n", GSL_SUCCESS );
 
@@ -410,8 +551,13 @@ kgsl_memarena_querystats(gsl_memarena_t *memarena, gsl_memarena_stats_t *stats)
     DEBUG_ASSERT(stats);
     GSL_MEMARENA_VALIDATE(memarena);
 
+    mutex_lock(&memarena->lock);
+
+    memarena->stats.freeblocks = memarena->freelist.numblocks;
     memcpy(stats, &memarena->stats, sizeof(gsl_memarena_stats_t));
 
+    mutex_unlock(&memarena->lock);
+
     return (GSL_SUCCESS);
 #else
     // unreferenced formal parameters
@@ -427,8 +573,8 @@ kgsl_memarena_querystats(gsl_memarena_t *memarena, gsl_memarena_stats_t *stats)
 int
 kgsl_memarena_checkfreeblock(gsl_memarena_t *memarena, int bytesneeded)
 {
-    memblk_t  *p;
-    int err;
+    struct rb_node  *node;
+    int             status = GSL_FAILURE;
 
     kgsl_log_write( KGSL_LOG_GROUP_MEMORY | KGSL_LOG_LEVEL_TRACE,
                     "--> int kgsl_memarena_checkfreeblock(gsl_memarena_t *memarena=0x%08x, int bytesneeded=%d)\n", memarena, bytesneeded );
@@ -443,29 +589,20 @@ kgsl_memarena_checkfreeblock(gsl_memarena_t *memarena, int bytesneeded)
         return (GSL_FAILURE);
     }
 
-    err = mutex_lock_interruptible(&memarena->lock);
-    if (err == -EINTR) {
-	kgsl_log_write( KGSL_LOG_GROUP_MEMORY | KGSL_LOG_LEVEL_FATAL,
-			"WARNING: memarena mutex lock was interrupted\n");
-    }
+    mutex_lock(&memarena->lock);
 
-    p = memarena->freelist.head;
-    do
+    // the largest free block is the last one in size order
+    node = rb_last(&memarena->freelist.sizetree);
+    if (node && rb_entry(node, memblk_t, sizenode)->blksize >= (unsigned int)bytesneeded)
     {
-        if (p->blksize >= (unsigned int)bytesneeded)
-        {
-            kgsl_log_write( KGSL_LOG_GROUP_MEMORY | KGSL_LOG_LEVEL_TRACE, "<-- kgsl_memarena_checkfreeblock. Return value: %B\n", GSL_SUCCESS );
-            return (GSL_SUCCESS);
-        }
-
-        p = p->next;
-    } while (p != memarena->freelist.head);
+        status = GSL_SUCCESS;
+    }
 
     mutex_unlock(&memarena->lock);
 
-    kgsl_log_write( KGSL_LOG_GROUP_MEMORY | KGSL_LOG_LEVEL_TRACE, "<-- kgsl_memarena_checkfreeblock. Return value: %B\n", GSL_FAILURE );
+    kgsl_log_write( KGSL_LOG_GROUP_MEMORY | KGSL_LOG_LEVEL_TRACE, "<-- kgsl_memarena_checkfreeblock. Return value: %B\n", status );
 
-    return (GSL_FAILURE);
+    return (status);
 }
 
 //----------------------------------------------------------------------------
@@ -473,14 +610,12 @@ kgsl_memarena_checkfreeblock(gsl_memarena_t *memarena, int bytesneeded)
 int
 kgsl_memarena_alloc(gsl_memarena_t *memarena, gsl_flags_t flags, int size, gsl_memdesc_t *memdesc)
 {
-    int           result = GSL_FAILURE_OUTOFMEM;
-    memblk_t      *ptrfree, *ptrlast, *p;
-    unsigned int  blksize;
-    unsigned int  baseaddr, alignedbaseaddr, alignfragment;
-    int           freeblk, alignmentshift;
-    memblk_t *ptrbest = NULL;
-    unsigned int fitsize = ~0UL;
-    int		  err;
+    int             result = GSL_FAILURE_OUTOFMEM;
+    memblk_t        *ptrbest, *p = NULL;
+    struct rb_node  *node;
+    unsigned int    blksize;
+    unsigned int    baseaddr, alignedbaseaddr = 0, alignfragment = 0;
+    int             alignmentshift;
 
     kgsl_log_write( KGSL_LOG_GROUP_MEMORY | KGSL_LOG_LEVEL_TRACE,
                     "--> int kgsl_memarena_alloc(gsl_memarena_t *memarena=0x%08x, gsl_flags_t flags=%x, int size=%d, gsl_memdesc_t *memdesc=%M)\n", memarena, flags, size, memdesc );
@@ -496,23 +631,18 @@ kgsl_memarena_alloc(gsl_memarena_t *memarena, gsl_flags_t flags, int size, gsl_m
     }
 
     //
-    // go through the list of free blocks.  check to find block which can satisfy the alloc request
+    // free blocks are kept in two trees: one ordered by address, used to coalesce on free, and
+    // one ordered by size (then address), used to find the best fit in logarithmic time.
+    //
+    // the search starts at the smallest block that can hold the request and walks up in size
+    // order until the aligned request fits; the walk only continues past the first candidate
+    // when the alignment fragment does not fit in it.
     //
     // if no block can satisfy the alloc request this implies that the memory is too fragmented
     // and the requestor needs to free up other memory blocks and re-request the allocation
     //
-    // if we do find a block that can satisfy the alloc request then reduce the size of free block
-    // by blksize and return the address after allocating the memory.  if the free block size becomes
-    // 0 then remove this node from the free list
-    //
-    // there would be no node on the free list if all available memory were to be allocated.
-    // handling an empty list would require executing error checking code in the main branch which
-    // is not desired.  instead, the free list will have at least one node at all times. This node
-    // could have a block size of zero
-    //
-    // we use a next fit allocation mechanism that uses a roving pointer on a circular free block list.
-    // the pointer is advanced along the chain when searching for a fit. Thus each allocation begins
-    // looking where the previous one finished.
+    // the front of the chosen block that is skipped for alignment stays on the free list as a
+    // (small) free block of its own; the block is removed from the free list once it is used up.
     //
 
     // when allocating from external memory aperture, round up size of requested block to multiple of page size if needed
@@ -530,99 +660,78 @@ kgsl_memarena_alloc(gsl_memarena_t *memarena, gsl_flags_t flags, int size, gsl_m
     // adjust size of requested block to include alignment
     blksize = (unsigned int)((size + ((1 << alignmentshift) - 1)) >> alignmentshift) << alignmentshift;
 
-    err = mutex_lock_interruptible(&memarena->lock);
-    if (err == -EINTR) {
-	kgsl_log_write( KGSL_LOG_GROUP_MEMORY | KGSL_LOG_LEVEL_FATAL,
-			"WARNING: memarena mutex lock was interrupted\n");
-    }
+    // the arena lock is all that serializes allocations, never skip it
+    mutex_lock(&memarena->lock);
 
     // check consistency, debug only
     KGSL_DEBUG(GSL_DBGFLAGS_MEMMGR, kgsl_memarena_checkconsistency(memarena));
 
-    ptrfree = memarena->freelist.allocrover;
-    ptrlast = memarena->freelist.head->prev;
-    freeblk = 0;
-
-    do
+    for (ptrbest = kgsl_memarena_findsize(memarena, blksize); ptrbest; )
     {
-	int aba;
         // align base address
-        baseaddr = ptrfree->blkaddr + memarena->gpubaseaddr;
-	aba = gsl_memarena_alignaddr(baseaddr, alignmentshift);
-
-	if (((aba - baseaddr) == 0) && (ptrfree->blksize == blksize)) {
-		ptrbest = ptrfree;
-		alignfragment = aba - baseaddr;
-		alignedbaseaddr = aba;
-		result = GSL_SUCCESS;
-		break;
-	}
-
-        if ((ptrfree->blksize >= (blksize + aba - baseaddr)) &&
-	   (fitsize > ptrfree->blksize))
+        baseaddr        = ptrbest->blkaddr + memarena->gpubaseaddr;
+        alignedbaseaddr = gsl_memarena_alignaddr(baseaddr, alignmentshift);
+        alignfragment   = alignedbaseaddr - baseaddr;
+
+        if (ptrbest->blksize >= blksize + alignfragment)
         {
-	    fitsize = ptrfree->blksize;
-	    alignfragment = aba - baseaddr;
-	    alignedbaseaddr = aba;
-            result  = GSL_SUCCESS;
-	    ptrbest = ptrfree;
-	}
-
-	ptrfree = ptrfree->next;
-    } while (ptrfree != memarena->freelist.allocrover);
-
-   if (ptrbest) {
-            memdesc->gpuaddr = alignedbaseaddr;
-            memdesc->hostptr = kgsl_memarena_gethostptr(memarena, memdesc->gpuaddr);
-            memdesc->size    = blksize;
-
-            if (alignfragment > 0)
-            {
-                // insert new node to handle newly created (small) fragment
-                p = kgsl_memarena_getmemblknode(memarena);
-                p->blkaddr = ptrbest->blkaddr;
-                p->blksize = alignfragment;
+            break;
+        }
 
-                p->next = ptrbest;
-                p->prev = ptrbest->prev;
-                ptrbest->prev->next = p;
-                ptrbest->prev       = p;
+        node    = rb_next(&ptrbest->sizenode);
+        ptrbest = node ? rb_entry(node, memblk_t, sizenode) : NULL;
+    }
 
-                if (ptrbest == memarena->freelist.head)
-                {
-                    memarena->freelist.head = p;
-                }
-            }
+    if (ptrbest && alignfragment > 0)
+    {
+        // new node to handle newly created (small) fragment
+        p = kgsl_memarena_getmemblknode(memarena);
+        if (!p)
+        {
+            ptrbest = NULL;
+        }
+    }
 
-            ptrbest->blkaddr += alignfragment + blksize;
-            ptrbest->blksize -= alignfragment + blksize;
+    if (ptrbest)
+    {
+        memdesc->gpuaddr = alignedbaseaddr;
+        memdesc->hostptr = kgsl_memarena_gethostptr(memarena, memdesc->gpuaddr);
+        memdesc->size    = blksize;
 
-            memarena->freelist.allocrover = ptrbest;
+        rb_erase(&ptrbest->sizenode, &memarena->freelist.sizetree);
 
-            if ((ptrbest->blksize == 0) && (ptrbest != ptrlast))
-            {
-                ptrbest->prev->next = ptrbest->next;
-                ptrbest->next->prev = ptrbest->prev;
-                if (ptrbest == memarena->freelist.head)
-                {
-                    memarena->freelist.head = ptrbest->next;
-                }
-                if (ptrbest == memarena->freelist.allocrover)
-                {
-                    memarena->freelist.allocrover = ptrbest->next;
-                }
-                if (ptrbest == memarena->freelist.freerover)
-                {
-                    memarena->freelist.freerover = ptrbest->prev;
-                }
-                p       = ptrbest;
-                ptrfree = ptrbest->prev;
-                kgsl_memarena_releasememblknode(memarena, p);
-            }
+        // the block keeps its place in address order, it only shrinks from the front
+        if (p)
+        {
+            p->blkaddr = ptrbest->blkaddr;
+            p->blksize = alignfragment;
         }
 
-    mutex_unlock(&memarena->lock);
+        ptrbest->blkaddr += alignfragment + blksize;
+        ptrbest->blksize -= alignfragment + blksize;
+
+        if (p)
+        {
+            kgsl_memarena_insertaddr(memarena, p);
+            kgsl_memarena_insertsize(memarena, p);
+            memarena->freelist.numblocks++;
+        }
+
+        if (ptrbest->blksize == 0)
+        {
+            rb_erase(&ptrbest->addrnode, &memarena->freelist.addrtree);
+            memarena->freelist.numblocks--;
+            kgsl_memarena_releasememblknode(memarena, ptrbest);
+        }
+        else
+        {
+            kgsl_memarena_insertsize(memarena, ptrbest);
+        }
 
+        result = GSL_SUCCESS;
+    }
+
+    // the stats are arena state too, update them before dropping the lock
     if (result == GSL_SUCCESS)
     {
         GSL_MEMARENA_STATS(
@@ -643,6 +752,8 @@ kgsl_memarena_alloc(gsl_memarena_t *memarena, gsl_flags_t flags, int size, gsl_m
         GSL_MEMARENA_STATS(memarena->stats.allocs_fail++);
     }
 
+    mutex_unlock(&memarena->lock);
+
     kgsl_log_write( KGSL_LOG_GROUP_MEMORY | KGSL_LOG_LEVEL_TRACE, "<-- kgsl_memarena_alloc. Return value: %B\n", result );
 
     return (result);
@@ -657,13 +768,12 @@ kgsl_memarena_free(gsl_memarena_t *memarena, gsl_memdesc_t *memdesc)
     // request to free a malloc'ed block from the memory arena
     // add this block to the free list
     // adding a block to the free list requires the following:
-    // going through the list of free blocks to decide where to add this free block (based on address)
+    // looking up its neighbours in the address tree
     // coalesce free blocks
     //
-    memblk_t      *ptrfree, *ptrend, *p;
-    int           mallocfreeblk, clockwise;
-    unsigned int  addrtofree;
-    int           err;
+    memblk_t        *prev, *next, *p;
+    struct rb_node  *node;
+    unsigned int    addrtofree;
 
     kgsl_log_write( KGSL_LOG_GROUP_MEMORY | KGSL_LOG_LEVEL_TRACE,
                     "--> void kgsl_memarena_free(gsl_memarena_t *memarena=0x%08x, gsl_memdesc_t *memdesc=%M)\n", memarena, memdesc );
@@ -689,159 +799,67 @@ kgsl_memarena_free(gsl_memarena_t *memarena, gsl_memdesc_t *memdesc)
     DEBUG_ASSERT( memarena->gpubaseaddr <= memdesc->gpuaddr);
     DEBUG_ASSERT((memarena->gpubaseaddr + memarena->sizebytes) >= memdesc->gpuaddr + memdesc->size);
 
-    err = mutex_lock_interruptible(&memarena->lock);
-    if (err == -EINTR) {
-	kgsl_log_write( KGSL_LOG_GROUP_MEMORY | KGSL_LOG_LEVEL_FATAL,
-			"WARNING: memarena mutex lock was interrupted\n");
-    }
+    mutex_lock(&memarena->lock);
 
     // check consistency of memory map, debug only
     KGSL_DEBUG(GSL_DBGFLAGS_MEMMGR, kgsl_memarena_checkconsistency(memarena));
 
-    addrtofree    = memdesc->gpuaddr - memarena->gpubaseaddr;
-    mallocfreeblk = 1;
-
-    if (addrtofree < memarena->freelist.head->blkaddr)
-    {
-        // add node to head of free list
+    addrtofree = memdesc->gpuaddr - memarena->gpubaseaddr;
 
-        if (addrtofree + memdesc->size == memarena->freelist.head->blkaddr)
-        {
-            memarena->freelist.head->blkaddr  = addrtofree;
-            memarena->freelist.head->blksize += memdesc->size;
+    // free neighbours on either side of the block
+    prev = kgsl_memarena_findaddr(memarena, addrtofree);
+    node = prev ? rb_next(&prev->addrnode) : rb_first(&memarena->freelist.addrtree);
+    next = node ? rb_entry(node, memblk_t, addrnode) : NULL;
 
-            mallocfreeblk = 0;
-        }
+    DEBUG_ASSERT(!prev || prev->blkaddr + prev->blksize <= addrtofree);
+    DEBUG_ASSERT(!next || addrtofree + memdesc->size <= next->blkaddr);
 
-        ptrfree = memarena->freelist.head->prev;
-    }
-    else if (addrtofree >= memarena->freelist.head->prev->blkaddr)
+    if (prev && prev->blkaddr + prev->blksize == addrtofree)
     {
-        // add node to tail of free list
+        // grow the preceding block, and merge the following one into it if the gap is closed
+        rb_erase(&prev->sizenode, &memarena->freelist.sizetree);
 
-        ptrfree = memarena->freelist.head->prev;
+        prev->blksize += memdesc->size;
 
-        if (ptrfree->blkaddr + ptrfree->blksize == addrtofree)
+        if (next && prev->blkaddr + prev->blksize == next->blkaddr)
         {
-            ptrfree->blksize += memdesc->size;
+            prev->blksize += next->blksize;
 
-            mallocfreeblk = 0;
+            kgsl_memarena_removeblock(memarena, next);
         }
+
+        kgsl_memarena_insertsize(memarena, prev);
     }
-    else
+    else if (next && addrtofree + memdesc->size == next->blkaddr)
     {
-        // determine range of free list nodes to traverse and orientation in which to traverse them
-        // keep this code segment unrolled for performance reasons!
-        if (addrtofree > memarena->freelist.freerover->blkaddr)
-        {
-            if (addrtofree - memarena->freelist.freerover->blkaddr < memarena->freelist.head->prev->blkaddr - addrtofree)
-            {
-                ptrfree   = memarena->freelist.freerover;       // rover
-                ptrend    = memarena->freelist.head->prev;      // tail
-                clockwise = 1;
-            }
-            else
-            {
-                ptrfree   = memarena->freelist.head->prev->prev; // tail
-                ptrend    = memarena->freelist.freerover->prev;  // rover
-                clockwise = 0;
-            }
-        }
-        else
-        {
-            if (addrtofree - memarena->freelist.head->blkaddr < memarena->freelist.freerover->blkaddr - addrtofree)
-            {
-                ptrfree   = memarena->freelist.head;            // head
-                ptrend    = memarena->freelist.freerover;       // rover
-                clockwise = 1;
-            }
-            else
-            {
-                ptrfree   = memarena->freelist.freerover->prev; // rover
-                ptrend    = memarena->freelist.head->prev;      // head
-                clockwise = 0;
-            }
-        }
-
-        // traverse the nodes
-        do
-        {
-            if ((addrtofree >= ptrfree->blkaddr + ptrfree->blksize) &&
-                (addrtofree + memdesc->size <= ptrfree->next->blkaddr))
-            {
-                if (addrtofree == ptrfree->blkaddr + ptrfree->blksize)
-                {
-                    memblk_t  *next;
-
-                    ptrfree->blksize += memdesc->size;
-                    next              = ptrfree->next;
-
-                    if (ptrfree->blkaddr + ptrfree->blksize == next->blkaddr)
-                    {
-                        ptrfree->blksize += next->blksize;
-                        ptrfree->next     = next->next;
-                        next->next->prev  = ptrfree;
-
-                        if (next == memarena->freelist.allocrover)
-                        {
-                            memarena->freelist.allocrover = ptrfree;
-                        }
+        // grow the following block downwards, its address order does not change
+        rb_erase(&next->sizenode, &memarena->freelist.sizetree);
 
-                        kgsl_memarena_releasememblknode(memarena, next);
-                    }
-
-                    mallocfreeblk = 0;
-                }
-                else if (addrtofree + memdesc->size == ptrfree->next->blkaddr)
-                {
-                    ptrfree->next->blkaddr  = addrtofree;
-                    ptrfree->next->blksize += memdesc->size;
+        next->blkaddr  = addrtofree;
+        next->blksize += memdesc->size;
 
-                    mallocfreeblk  = 0;
-                }
-
-                break;
-            }
-
-            if (clockwise)
-            {
-                ptrfree = ptrfree->next;
-            }
-            else
-            {
-                ptrfree = ptrfree->prev;
-            }
-
-        } while (ptrfree != ptrend);
+        kgsl_memarena_insertsize(memarena, next);
     }
-
-    // this free block could not be coalesced, so create a new free block
-    // and add it to the free list in the memory arena
-    if (mallocfreeblk)
+    else
     {
+        // this free block could not be coalesced, so create a new free block
+        // and add it to the free list in the memory arena
         p = kgsl_memarena_getmemblknode(memarena);
-        p->blkaddr = addrtofree;
-        p->blksize = memdesc->size;
-
-        p->next             = ptrfree->next;
-        p->prev             = ptrfree;
-        ptrfree->next->prev = p;
-        ptrfree->next       = p;
+        if (p)
+        {
+            p->blkaddr = addrtofree;
+            p->blksize = memdesc->size;
 
-        if (p->blkaddr < memarena->freelist.head->blkaddr)
+            kgsl_memarena_insertaddr(memarena, p);
+            kgsl_memarena_insertsize(memarena, p);
+            memarena->freelist.numblocks++;
+        }
+        else
         {
-            memarena->freelist.head = p;
+            kgsl_log_write( KGSL_LOG_GROUP_MEMORY | KGSL_LOG_LEVEL_ERROR, "ERROR: Memblk allocation failed, block is lost.\n" );
         }
-
-        memarena->freelist.freerover = p;
-    }
-    else
-    {
-        memarena->freelist.freerover = ptrfree;
     }
 
-    mutex_unlock(&memarena->lock);
-
     GSL_MEMARENA_STATS(
     {
         int i = 0;
@@ -855,6 +873,8 @@ kgsl_memarena_free(gsl_memarena_t *memarena, gsl_memdesc_t *memdesc)
 
     GSL_MEMARENA_STATS(memarena->stats.frees++);
 
+    mutex_unlock(&memarena->lock);
+
     kgsl_log_write( KGSL_LOG_GROUP_MEMORY | KGSL_LOG_LEVEL_TRACE, "<-- kgsl_memarena_free.\n" );
 }
 
@@ -925,10 +945,10 @@ gpuaddr_t kgsl_memarena_getgpuaddr(gsl_memarena_t *memarena, void *hostptr)
 unsigned int
 kgsl_memarena_getlargestfreeblock(gsl_memarena_t *memarena, gsl_flags_t flags)
 {
-    memblk_t      *ptrfree;
-    unsigned int  blocksize, largestblocksize = 0;
-    int           alignmentshift;
-    int           err;
+    memblk_t        *ptrfree;
+    struct rb_node  *node;
+    unsigned int    blocksize, largestblocksize = 0;
+    int             alignmentshift;
 
     kgsl_log_write( KGSL_LOG_GROUP_MEMORY | KGSL_LOG_LEVEL_TRACE,
                     "--> unsigned int kgsl_memarena_getlargestfreeblock(gsl_memarena_t *memarena=0x%08x, gsl_flags_t flags=%x)\n", memarena, flags );
@@ -943,26 +963,25 @@ kgsl_memarena_getlargestfreeblock(gsl_memarena_t *memarena, gsl_flags_t flags)
     // determine shift count for alignment requested
     alignmentshift = gsl_memarena_alignmentshift(flags);
 
-    err = mutex_lock_interruptible(&memarena->lock);
-    if (err == -EINTR) {
-	kgsl_log_write( KGSL_LOG_GROUP_MEMORY | KGSL_LOG_LEVEL_FATAL,
-			"WARNING: memarena mutex lock was interrupted\n");
-    }
-
-    ptrfree = memarena->freelist.head;
+    mutex_lock(&memarena->lock);
 
-    do
+    // walk down from the largest block, a smaller block can not beat the best aligned size found
+    for (node = rb_last(&memarena->freelist.sizetree); node; node = rb_prev(node))
     {
+        ptrfree = rb_entry(node, memblk_t, sizenode);
+
+        if (ptrfree->blksize <= largestblocksize)
+        {
+            break;
+        }
+
         blocksize = ptrfree->blksize - (ptrfree->blkaddr - ((ptrfree->blkaddr >> alignmentshift) << alignmentshift));
 
         if (blocksize > largestblocksize)
         {
             largestblocksize = blocksize;
         }
-
-        ptrfree = ptrfree->next;
-
-    } while (ptrfree != memarena->freelist.head);
+    }
 
     mutex_unlock(&memarena->lock);
 
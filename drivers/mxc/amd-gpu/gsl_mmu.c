@@ -576,16 +576,43 @@ kgsl_mmu_init(gsl_device_t *device)
 
 //----------------------------------------------------------------------------
 
+static void
+kgsl_mmu_writeptes(gsl_pagetable_t *pagetable, unsigned int ptefirst, const gsl_scatterlist_t *scatterlist, unsigned int ap)
+{
+    //
+    // write one contiguous run of page table entries. a physically contiguous
+    // scatter list is written with a running address instead of a per page lookup.
+    //
+    unsigned int  *entry = ((unsigned int *) pagetable->base.hostptr) + ptefirst;
+    unsigned int  i, phyaddr;
+
+    phyaddr = scatterlist->pages[0];
+
+    for (i = 0; i < scatterlist->num; i++)
+    {
+        if (!scatterlist->contiguous)
+        {
+            phyaddr = scatterlist->pages[i];
+        }
+
+        entry[i] = (entry[i] & ~GSL_PT_PAGE_ADDR_MASK) | (phyaddr & GSL_PT_PAGE_ADDR_MASK) | (ap & GSL_PT_PAGE_AP_MASK);
+        phyaddr += GSL_PAGESIZE;
+
+        KGSL_DEBUG(GSL_DBGFLAGS_DUMPX, KGSL_DEBUG_DUMPX(BB_DUMP_SET_MMUTBL, ptefirst+i, entry[i], 0, "kgsl_mmu_map"));
+    }
+}
+
+//----------------------------------------------------------------------------
+
 int
 kgsl_mmu_map(gsl_mmu_t *mmu, gpuaddr_t gpubaseaddr, const gsl_scatterlist_t *scatterlist, gsl_flags_t flags, unsigned int pid)
 {
     //
     // map physical pages into the gpu page table
     //
-    int              status = GSL_SUCCESS;
-    unsigned int     i, phyaddr, ap;
-    unsigned int     pte, ptefirst, ptelast, superpte;
-    int              flushtlb;
+    unsigned int     i, ap;
+    unsigned int     ptefirst, ptelast, superpte;
+    int              flushtlb  = 0;
     gsl_pagetable_t  *pagetable;
 
     kgsl_log_write( KGSL_LOG_GROUP_MEMORY | KGSL_LOG_LEVEL_TRACE,
@@ -615,78 +642,64 @@ kgsl_mmu_map(gsl_mmu_t *mmu, gpuaddr_t gpubaseaddr, const gsl_scatterlist_t *sca
     KGSL_DEBUG(GSL_DBGFLAGS_MMU, kgsl_mmu_checkconsistency(pagetable));
 
     ptefirst = GSL_PT_ENTRY_GET(gpubaseaddr);
-    ptelast  = GSL_PT_ENTRY_GET(gpubaseaddr + (GSL_PAGESIZE * (scatterlist->num-1)));
-    flushtlb = 0;
+    ptelast  = ptefirst + scatterlist->num - 1;
 
-    if (!GSL_PT_MAP_GETADDR(ptefirst))
+    if (ptelast >= pagetable->max_entries || GSL_PT_MAP_GETADDR(ptefirst))
     {
-        // tlb needs to be flushed when the first and last pte are not at superpte boundaries
-        if ((ptefirst & (GSL_PT_SUPER_PTE-1)) != 0 || ((ptelast+1) & (GSL_PT_SUPER_PTE-1)) != 0)
+        // this should never happen
+        kgsl_log_write( KGSL_LOG_GROUP_MEMORY | KGSL_LOG_LEVEL_FATAL, "FATAL: This should never happen.\n" );
+        DEBUG_ASSERT(0);
+        kgsl_log_write( KGSL_LOG_GROUP_MEMORY | KGSL_LOG_LEVEL_TRACE, "<-- kgsl_mmu_map. Return value %B\n", GSL_FAILURE );
+        return (GSL_FAILURE);
+    }
+
+    // tlb needs to be flushed when the first and last pte are not at superpte boundaries
+    if ((ptefirst & (GSL_PT_SUPER_PTE-1)) != 0 || ((ptelast+1) & (GSL_PT_SUPER_PTE-1)) != 0)
+    {
+        flushtlb = 1;
+    }
+
+    // tlb needs to be flushed when a dirty superPTE gets backed, one check per superPTE
+    for (superpte = ptefirst; superpte <= ptelast && !flushtlb; superpte += GSL_PT_SUPER_PTE)
+    {
+        if (GSL_TLBFLUSH_FILTER_ISDIRTY(superpte / GSL_PT_SUPER_PTE))
         {
             flushtlb = 1;
         }
+    }
 
-        // create page table entries
-        for (pte = ptefirst; pte <= ptelast; pte++)
-        {
-            if (scatterlist->contiguous)
-            {
-                phyaddr = scatterlist->pages[0] + ((pte-ptefirst) * GSL_PAGESIZE);
-            }
-            else
-            {
-                phyaddr = scatterlist->pages[pte-ptefirst];
-            }
-
-            GSL_PT_MAP_SETADDR(pte, phyaddr);
-            GSL_PT_MAP_SETBITS(pte, ap);
+    // create page table entries
+    kgsl_mmu_writeptes(pagetable, ptefirst, scatterlist, ap);
 
-            // tlb needs to be flushed when a dirty superPTE gets backed
-            if ((pte & (GSL_PT_SUPER_PTE-1)) == 0)
-            {
-                if (GSL_TLBFLUSH_FILTER_ISDIRTY(pte / GSL_PT_SUPER_PTE))
-                {
-                    flushtlb = 1;
-                }
-            }
-
-            KGSL_DEBUG(GSL_DBGFLAGS_DUMPX, KGSL_DEBUG_DUMPX(BB_DUMP_SET_MMUTBL, pte , *(unsigned int*)(((char*)pagetable->base.hostptr) + (pte * GSL_PT_ENTRY_SIZEBYTES)), 0, "kgsl_mmu_map"));
-        }
+    // determine new last mapped superPTE
+    superpte = ptelast - (ptelast & (GSL_PT_SUPER_PTE-1));
+    if (superpte > pagetable->last_superpte)
+    {
+        pagetable->last_superpte = superpte;
+    }
 
-        mb();
+    mb();
 
-        if (flushtlb)
+    if (flushtlb)
+    {
+        // every device's tlb needs to be flushed because the current page table is shared among all devices
+        for (i = 0; i < GSL_DEVICE_MAX; i++)
         {
-            // every device's tlb needs to be flushed because the current page table is shared among all devices
-            for (i = 0; i < GSL_DEVICE_MAX; i++)
+            if (gsl_driver.device[i].flags & GSL_FLAGS_INITIALIZED)
             {
-                if (gsl_driver.device[i].flags & GSL_FLAGS_INITIALIZED)
-                {
-                    gsl_driver.device[i].mmu.flags |= GSL_MMUFLAGS_TLBFLUSH;
-                }
+                gsl_driver.device[i].mmu.flags |= GSL_MMUFLAGS_TLBFLUSH;
             }
         }
-
-        // determine new last mapped superPTE 
-        superpte = ptelast - (ptelast & (GSL_PT_SUPER_PTE-1));
-        if (superpte > pagetable->last_superpte)
-        {
-            pagetable->last_superpte = superpte;
-        }
-
-		GSL_MMU_STATS(mmu->stats.pt.maps++);
-    }
-    else
-    {
-        // this should never happen
-        kgsl_log_write( KGSL_LOG_GROUP_MEMORY | KGSL_LOG_LEVEL_FATAL, "FATAL: This should never happen.\n" );
-        DEBUG_ASSERT(0);
-        status = GSL_FAILURE;
     }
 
+    GSL_MMU_STATS(mmu->stats.pt.maps++);
+    GSL_MMU_STATS(mmu->stats.pt.ptewrites += scatterlist->num);
+    GSL_MMU_STATS(mmu->stats.pt.batches++);
+    GSL_MMU_STATS(mmu->stats.tlbflushrequests += flushtlb);
+
     kgsl_log_write( KGSL_LOG_GROUP_MEMORY | KGSL_LOG_LEVEL_TRACE, "<-- kgsl_mmu_map. Return value %B\n", GSL_SUCCESS );
 
-    return (status);
+    return (GSL_SUCCESS);
 }
 
 //----------------------------------------------------------------------------
@@ -695,41 +708,40 @@ static bool is_superpte_empty(gsl_pagetable_t  *pagetable, unsigned int superpte
 {
 	int i;
 	for (i = 0; i < GSL_PT_SUPER_PTE; i++) {
-		if (GSL_PT_MAP_GET(superpte+i))
+		if (GSL_PT_MAP_GETADDR(superpte+i))
 			return false;
 	}
 	return true;
 }
 
 int
-kgsl_mmu_unmap(gsl_mmu_t *mmu, gpuaddr_t gpubaseaddr, int range, unsigned int pid)
+kgsl_mmu_unmap_multi(gsl_mmu_t *mmu, const gsl_mmu_range_t *ranges, int count, unsigned int pid)
 {
     //
-    // remove mappings in the specified address range from the gpu page table
+    // remove a batch of address ranges from the gpu page table
     //
-    int              status = GSL_SUCCESS;
+    int              n;
     gsl_pagetable_t  *pagetable;
     unsigned int     numpages;
-    unsigned int     pte, ptefirst, ptelast, superpte;
+    unsigned int     pte, ptefirst, ptelast, ptenext, superpte;
+    unsigned int     superptemax = 0;
+    unsigned int     ptewrites   = 0;
+    unsigned int     skipped     = 0;
 
     kgsl_log_write( KGSL_LOG_GROUP_MEMORY | KGSL_LOG_LEVEL_TRACE,
-                    "--> int kgsl_mmu_unmap(gsl_mmu_t *mmu=0x%08x, gpuaddr_t gpubaseaddr=0x%08x, int range=%d, uint pid=0x%08x)\n",
-                    mmu, gpubaseaddr, range, pid );
+                    "--> int kgsl_mmu_unmap_multi(gsl_mmu_t *mmu=0x%08x, gsl_mmu_range_t *ranges=0x%08x, int count=%d, uint pid=0x%08x)\n",
+                    mmu, ranges, count, pid );
+
+    DEBUG_ASSERT(ranges);
 
-    if (range <= 0)
+    if (count <= 0)
     {
-        kgsl_log_write( KGSL_LOG_GROUP_MEMORY | KGSL_LOG_LEVEL_ERROR, "ERROR: Range is too small.\n" );
+        kgsl_log_write( KGSL_LOG_GROUP_MEMORY | KGSL_LOG_LEVEL_ERROR, "ERROR: num ranges is too small.\n" );
         DEBUG_ASSERT(0);
-        kgsl_log_write( KGSL_LOG_GROUP_MEMORY | KGSL_LOG_LEVEL_TRACE, "<-- kgsl_mmu_unmap. Return value %B\n", GSL_FAILURE );
+        kgsl_log_write( KGSL_LOG_GROUP_MEMORY | KGSL_LOG_LEVEL_TRACE, "<-- kgsl_mmu_unmap_multi. Return value %B\n", GSL_FAILURE );
         return (GSL_FAILURE);
     }
 
-    numpages = (range >> GSL_PAGESIZE_SHIFT);
-    if (range & (GSL_PAGESIZE-1))
-    {
-        numpages++;
-    }
-
     pagetable = kgsl_mmu_getpagetableobject(mmu, pid);
     if (!pagetable)
     {
@@ -739,59 +751,111 @@ kgsl_mmu_unmap(gsl_mmu_t *mmu, gpuaddr_t gpubaseaddr, int range, unsigned int pi
     // check consistency, debug only
     KGSL_DEBUG(GSL_DBGFLAGS_MMU, kgsl_mmu_checkconsistency(pagetable));
 
-    ptefirst = GSL_PT_ENTRY_GET(gpubaseaddr);
-    ptelast  = GSL_PT_ENTRY_GET(gpubaseaddr + (GSL_PAGESIZE * (numpages-1)));
-
-    if (GSL_PT_MAP_GETADDR(ptefirst))
+    // validate the whole batch first so a bad range leaves the page table untouched
+    for (n = 0; n < count; n++)
     {
-        superpte = ptefirst - (ptefirst & (GSL_PT_SUPER_PTE-1));
-        GSL_TLBFLUSH_FILTER_SETDIRTY(superpte / GSL_PT_SUPER_PTE);
+        if (ranges[n].range <= 0)
+        {
+            kgsl_log_write( KGSL_LOG_GROUP_MEMORY | KGSL_LOG_LEVEL_ERROR, "ERROR: Range is too small.\n" );
+            DEBUG_ASSERT(0);
+            kgsl_log_write( KGSL_LOG_GROUP_MEMORY | KGSL_LOG_LEVEL_TRACE, "<-- kgsl_mmu_unmap_multi. Return value %B\n", GSL_FAILURE );
+            return (GSL_FAILURE);
+        }
 
-        // remove page table entries
-        for (pte = ptefirst; pte <= ptelast; pte++)
+        numpages = (ranges[n].range + GSL_PAGESIZE - 1) >> GSL_PAGESIZE_SHIFT;
+        ptefirst = GSL_PT_ENTRY_GET(ranges[n].gpuaddr);
+        ptelast  = ptefirst + numpages - 1;
+
+        if (ptelast >= pagetable->max_entries || !GSL_PT_MAP_GETADDR(ptefirst))
         {
-            GSL_PT_MAP_RESET(pte);
+            // this should never happen
+            kgsl_log_write( KGSL_LOG_GROUP_MEMORY | KGSL_LOG_LEVEL_FATAL, "FATAL: This should never happen.\n" );
+            DEBUG_ASSERT(0);
+            kgsl_log_write( KGSL_LOG_GROUP_MEMORY | KGSL_LOG_LEVEL_TRACE, "<-- kgsl_mmu_unmap_multi. Return value %B\n", GSL_FAILURE );
+            return (GSL_FAILURE);
+        }
+    }
+
+    for (n = 0; n < count; n++)
+    {
+        numpages = (ranges[n].range + GSL_PAGESIZE - 1) >> GSL_PAGESIZE_SHIFT;
+        ptefirst = GSL_PT_ENTRY_GET(ranges[n].gpuaddr);
+        ptelast  = ptefirst + numpages - 1;
 
+        // remove page table entries one superPTE at a time
+        for (pte = ptefirst; pte <= ptelast; pte = ptenext)
+        {
             superpte = pte - (pte & (GSL_PT_SUPER_PTE-1));
-            if (pte == superpte)
+            ptenext  = superpte + GSL_PT_SUPER_PTE;
+            if (ptenext > ptelast+1)
+            {
+                ptenext = ptelast+1;
+            }
+
+            // a fully covered superPTE with no backing pages needs neither writes nor a dirty mark
+            if (pte == superpte && ptenext == superpte + GSL_PT_SUPER_PTE && is_superpte_empty(pagetable, superpte))
             {
-                GSL_TLBFLUSH_FILTER_SETDIRTY(superpte / GSL_PT_SUPER_PTE);
+                skipped++;
+                continue;
             }
 
-			KGSL_DEBUG(GSL_DBGFLAGS_DUMPX, KGSL_DEBUG_DUMPX(BB_DUMP_SET_MMUTBL, pte, *(unsigned int*)(((char*)pagetable->base.hostptr) + (pte * GSL_PT_ENTRY_SIZEBYTES)), 0, "kgsl_mmu_unmap, reset superPTE"));
+            GSL_TLBFLUSH_FILTER_SETDIRTY(superpte / GSL_PT_SUPER_PTE);
+
+            ptewrites += ptenext - pte;
+
+            for ( ; pte < ptenext; pte++)
+            {
+                GSL_PT_MAP_RESET(pte);
+
+                KGSL_DEBUG(GSL_DBGFLAGS_DUMPX, KGSL_DEBUG_DUMPX(BB_DUMP_SET_MMUTBL, pte, *(unsigned int*)(((char*)pagetable->base.hostptr) + (pte * GSL_PT_ENTRY_SIZEBYTES)), 0, "kgsl_mmu_unmap, reset superPTE"));
+            }
         }
 
-        // determine new last mapped superPTE 
         superpte = ptelast - (ptelast & (GSL_PT_SUPER_PTE-1));
-        if (superpte == pagetable->last_superpte && pagetable->last_superpte >= GSL_PT_SUPER_PTE)
+        if (superpte > superptemax)
         {
-            do
-            {
-		if (is_superpte_empty(pagetable, superpte))
-		    pagetable->last_superpte -= GSL_PT_SUPER_PTE;
-		else
-		    break;
-            } while (!GSL_PT_MAP_GETADDR(pagetable->last_superpte) && pagetable->last_superpte >= GSL_PT_SUPER_PTE);
+            superptemax = superpte;
         }
-
-		GSL_MMU_STATS(mmu->stats.pt.unmaps++);
     }
-    else
+
+    // determine new last mapped superPTE, once for the whole batch
+    if (superptemax >= pagetable->last_superpte)
     {
-        // this should never happen
-        kgsl_log_write( KGSL_LOG_GROUP_MEMORY | KGSL_LOG_LEVEL_FATAL, "FATAL: This should never happen.\n" );
-        DEBUG_ASSERT(0);
-        status = GSL_FAILURE;
+        while (pagetable->last_superpte >= GSL_PT_SUPER_PTE && is_superpte_empty(pagetable, pagetable->last_superpte))
+        {
+            pagetable->last_superpte -= GSL_PT_SUPER_PTE;
+        }
     }
 
+    GSL_MMU_STATS(mmu->stats.pt.unmaps += count);
+    GSL_MMU_STATS(mmu->stats.pt.ptewrites += ptewrites);
+    GSL_MMU_STATS(mmu->stats.pt.superptesskipped += skipped);
+    GSL_MMU_STATS(mmu->stats.pt.batches++);
+
     mb();
 
     // invalidate tlb, debug only
 	KGSL_DEBUG(GSL_DBGFLAGS_MMU, mmu->device->ftbl.mmu_tlbinvalidate(mmu->device, gsl_cfg_mmu_reg[mmu->device->id-1].INVALIDATE, pagetable->pid));
 
-    kgsl_log_write( KGSL_LOG_GROUP_MEMORY | KGSL_LOG_LEVEL_TRACE, "<-- kgsl_mmu_unmap. Return value %B\n", GSL_SUCCESS );
+    kgsl_log_write( KGSL_LOG_GROUP_MEMORY | KGSL_LOG_LEVEL_TRACE, "<-- kgsl_mmu_unmap_multi. Return value %B\n", GSL_SUCCESS );
 
-    return (status);
+    return (GSL_SUCCESS);
+}
+
+//----------------------------------------------------------------------------
+
+int
+kgsl_mmu_unmap(gsl_mmu_t *mmu, gpuaddr_t gpubaseaddr, int range, unsigned int pid)
+{
+    //
+    // remove mappings in the specified address range from the gpu page table
+    //
+    gsl_mmu_range_t  unmaprange;
+
+    unmaprange.gpuaddr = gpubaseaddr;
+    unmaprange.range   = range;
+
+    return (kgsl_mmu_unmap_multi(mmu, &unmaprange, 1, pid));
 }
 
 //----------------------------------------------------------------------------
@@ -22,6 +22,7 @@
 #include "gsl_hal.h"
 #include "gsl_cmdstream.h"
 #include "gsl_ringbuffer.h"
+#include "gsl_trace.h"
 
 #ifdef GSL_BLD_YAMATO
 
@@ -369,6 +370,8 @@ kgsl_ringbuffer_waitspace(gsl_ringbuffer_t *rb, unsigned int numcmds, int wptr_a
     int           nopcount;
     unsigned int  freecmds;
     unsigned int  *cmds;
+    ktime_t       start = ktime_set(0, 0);
+    int           waited = 0;
 
     kgsl_log_write( KGSL_LOG_GROUP_COMMAND | KGSL_LOG_LEVEL_TRACE,
                     "--> static int kgsl_ringbuffer_waitspace(gsl_ringbuffer_t *rb=0x%08x, unsigned int numcmds=%d, int wptr_ahead=%d)\n",
@@ -405,6 +408,17 @@ kgsl_ringbuffer_waitspace(gsl_ringbuffer_t *rb, unsigned int numcmds, int wptr_a
             break;
         }
 
+        // only stamp once the gpu has really fallen behind
+        if (!waited)
+        {
+            start  = ktime_get();
+            waited = 1;
+        }
+    }
+
+    if (waited)
+    {
+        trace_kgsl_waitspace(rb->device->id, numcmds, wptr_ahead, (unsigned int)ktime_us_delta(ktime_get(), start));
     }
 
     kgsl_log_write( KGSL_LOG_GROUP_COMMAND | KGSL_LOG_LEVEL_TRACE, "<-- kgsl_ringbuffer_waitspace. Return value %B\n", GSL_SUCCESS );
@@ -852,33 +866,51 @@ kgsl_ringbuffer_issuecmds(gsl_device_t *device, int pmodeoff, unsigned int *cmds
 int
 kgsl_ringbuffer_issueibcmds(gsl_device_t *device, int drawctxt_index, gpuaddr_t ibaddr, int sizedwords, gsl_timestamp_t *timestamp, gsl_flags_t flags)
 {
-    unsigned int  link[3];
-    int dumpx_swap;
+    gsl_ibdesc_t  ibdesc;
+
+    ibdesc.ibaddr     = ibaddr;
+    ibdesc.sizedwords = sizedwords;
+    ibdesc.flags      = GSL_IBDESC_FLAGS_NONE;
+
+    return (kgsl_ringbuffer_issueibcmds_multi(device, drawctxt_index, &ibdesc, 1, timestamp, flags));
+}
+
+//----------------------------------------------------------------------------
+int
+kgsl_ringbuffer_issueibcmds_multi(gsl_device_t *device, int drawctxt_index, const gsl_ibdesc_t *ibdesc, int numibs, gsl_timestamp_t *timestamp, gsl_flags_t flags)
+{
+    unsigned int  link[3*GSL_IBDESC_MAX];
+    int           i;
+    int dumpx_swap = 0;
     (void)dumpx_swap; // used only when BB_DUMPX is defined
 
     kgsl_log_write( KGSL_LOG_GROUP_COMMAND | KGSL_LOG_LEVEL_TRACE,
-                    "--> gsl_timestamp_t kgsl_ringbuffer_issueibcmds(gsl_device_t device=%0x%08x, int drawctxt_index=%d, gpuaddr_t ibaddr=0x%08x, int sizedwords=%d, gsl_timestamp_t *timestamp=0x%08x)\n",
-                     device, drawctxt_index, ibaddr, sizedwords, timestamp );
+                    "--> gsl_timestamp_t kgsl_ringbuffer_issueibcmds_multi(gsl_device_t device=%0x%08x, int drawctxt_index=%d, gsl_ibdesc_t *ibdesc=0x%08x, int numibs=%d, gsl_timestamp_t *timestamp=0x%08x)\n",
+                     device, drawctxt_index, ibdesc, numibs, timestamp );
 
-    if (!(device->ringbuffer.flags & GSL_FLAGS_STARTED))
+    if (!(device->ringbuffer.flags & GSL_FLAGS_STARTED) || numibs < 1 || numibs > GSL_IBDESC_MAX)
     {
-        kgsl_log_write( KGSL_LOG_GROUP_COMMAND | KGSL_LOG_LEVEL_TRACE, "<-- kgsl_ringbuffer_issueibcmds. Return value %B\n", GSL_FAILURE );
+        kgsl_log_write( KGSL_LOG_GROUP_COMMAND | KGSL_LOG_LEVEL_TRACE, "<-- kgsl_ringbuffer_issueibcmds_multi. Return value %B\n", GSL_FAILURE );
         return (GSL_FAILURE);
     }
 
-    DEBUG_ASSERT(ibaddr);
-    DEBUG_ASSERT(sizedwords);
+    // one IB packet per buffer, all of them land in the ring ahead of a single timestamp
+    for (i = 0; i < numibs; i++)
+    {
+        DEBUG_ASSERT(ibdesc[i].ibaddr);
+        DEBUG_ASSERT(ibdesc[i].sizedwords);
 
-    KGSL_DEBUG(GSL_DBGFLAGS_DUMPX, dumpx_swap = kgsl_dumpx_parse_ibs(ibaddr, sizedwords));
+        KGSL_DEBUG(GSL_DBGFLAGS_DUMPX, dumpx_swap |= kgsl_dumpx_parse_ibs(ibdesc[i].ibaddr, ibdesc[i].sizedwords));
+
+        link[3*i+0] = (ibdesc[i].flags & GSL_IBDESC_FLAGS_PREFETCH) ? PM4_HDR_INDIRECT_BUFFER : PM4_HDR_INDIRECT_BUFFER_PFD;
+        link[3*i+1] = ibdesc[i].ibaddr;
+        link[3*i+2] = ibdesc[i].sizedwords;
+    }
 
 	// context switch if needed
 	kgsl_drawctxt_switch(device, &device->drawctxt[drawctxt_index], flags);
 
-    link[0] = PM4_HDR_INDIRECT_BUFFER_PFD;
-    link[1] = ibaddr;
-    link[2] = sizedwords;
-
-	*timestamp = kgsl_ringbuffer_issuecmds(device, 0, &link[0], 3, current->tgid);
+	*timestamp = kgsl_ringbuffer_issuecmds(device, 0, &link[0], 3*numibs, current->tgid);
 
     // idle device when running in safe mode
     if (device->flags & GSL_FLAGS_SAFEMODE)
@@ -903,7 +935,9 @@ kgsl_ringbuffer_issueibcmds(gsl_device_t *device, int drawctxt_index, gpuaddr_t
         }
     });
 
-    kgsl_log_write( KGSL_LOG_GROUP_COMMAND | KGSL_LOG_LEVEL_TRACE, "<-- kgsl_ringbuffer_issueibcmds. Return value %B\n", GSL_SUCCESS );
+    GSL_RB_STATS(device->ringbuffer.stats.ibs += numibs);
+
+    kgsl_log_write( KGSL_LOG_GROUP_COMMAND | KGSL_LOG_LEVEL_TRACE, "<-- kgsl_ringbuffer_issueibcmds_multi. Return value %B\n", GSL_SUCCESS );
 
     return (GSL_SUCCESS);
 }
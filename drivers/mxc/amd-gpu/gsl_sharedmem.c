@@ -21,6 +21,7 @@
 
 #include "gsl.h"
 #include "gsl_hal.h"
+#include "gsl_trace.h"
 
 /////////////////////////////////////////////////////////////////////////////
 // macros
@@ -40,6 +41,23 @@
 #define GSL_MEMDESC_EXTALLOC_ISMARKED(memdesc)  \
     ((memdesc->priv & GSL_EXTALLOC_MASK) >> GSL_EXTALLOC_SHIFT)
 
+#define GSL_SHAREDMEM_APERTURE_GET(flags)       \
+    ((((flags) & GSL_MEMFLAGS_APERTURE_MASK) >> GSL_MEMFLAGS_APERTURE_SHIFT) < GSL_APERTURE_MAX ? \
+     (((flags) & GSL_MEMFLAGS_APERTURE_MASK) >> GSL_MEMFLAGS_APERTURE_SHIFT) : GSL_APERTURE_EMEM)
+
+
+//////////////////////////////////////////////////////////////////////////////
+// process accounting
+//////////////////////////////////////////////////////////////////////////////
+
+// kept outside gsl_sharedmem_t so the limit survives the arena being torn down and rebuilt
+// at most GSL_CALLER_PROCESS_MAX processes can hold memory at once, the same as can attach
+// to the driver, a process past that has its allocations refused rather than go uncharged
+static DEFINE_SPINLOCK(gsl_sharedmem_proclock);
+static gsl_sharedmem_procstats_t gsl_sharedmem_procstats[GSL_CALLER_PROCESS_MAX];
+static unsigned int gsl_sharedmem_proclimit;        // bytes per process, 0 is unlimited
+static __s64 gsl_sharedmem_procfull;                // allocations refused because the table was full
+
 
 
 //////////////////////////////////////////////////////////////////////////////
@@ -194,8 +212,24 @@ kgsl_sharedmem_alloc0(gsl_deviceid_t device_id, gsl_flags_t flags, int sizebytes
 
     result = kgsl_memarena_alloc(shmem->memarena, flags, sizebytes, memdesc);
 
+    // retired frees are normally reclaimed in the background, under pressure do it now and retry
+    if (result == GSL_FAILURE_OUTOFMEM)
+    {
+        for (tmp_id = GSL_DEVICE_ANY + 1; tmp_id <= GSL_DEVICE_MAX; tmp_id++)
+        {
+            if (gsl_driver.device[tmp_id-1].flags & GSL_FLAGS_INITIALIZED)
+            {
+                kgsl_cmdstream_memqueue_drain(&gsl_driver.device[tmp_id-1]);
+            }
+        }
+
+        result = kgsl_memarena_alloc(shmem->memarena, flags, sizebytes, memdesc);
+    }
+
     KGSL_DEBUG_TBDUMP_SETMEM( memdesc->gpuaddr, 0, memdesc->size );
 
+    trace_kgsl_mem_alloc(device_id, memdesc->gpuaddr, sizebytes, flags, result);
+
     kgsl_log_write( KGSL_LOG_GROUP_MEMORY | KGSL_LOG_LEVEL_TRACE, "<-- kgsl_sharedmem_alloc. Return value %B\n", result );
 
     return (result);
@@ -206,11 +240,8 @@ kgsl_sharedmem_alloc0(gsl_deviceid_t device_id, gsl_flags_t flags, int sizebytes
 int
 kgsl_sharedmem_alloc(gsl_deviceid_t device_id, gsl_flags_t flags, int sizebytes, gsl_memdesc_t *memdesc)
 {
-	int status = GSL_SUCCESS;
-	mutex_lock(&gsl_driver.lock);
-	status = kgsl_sharedmem_alloc0(device_id, flags, sizebytes, memdesc);
-	mutex_unlock(&gsl_driver.lock);
-	return status;
+	// the memarena serializes allocations with its own lock
+	return kgsl_sharedmem_alloc0(device_id, flags, sizebytes, memdesc);
 }
 
 //----------------------------------------------------------------------------
@@ -230,6 +261,8 @@ kgsl_sharedmem_free0(gsl_memdesc_t *memdesc, unsigned int pid)
 
     if (shmem->flags & GSL_FLAGS_INITIALIZED)
     {
+        trace_kgsl_mem_free(memdesc->gpuaddr, memdesc->size, pid);
+
         kgsl_memarena_free(shmem->memarena, memdesc);
 
         // clear descriptor
@@ -250,11 +283,8 @@ kgsl_sharedmem_free0(gsl_memdesc_t *memdesc, unsigned int pid)
 int
 kgsl_sharedmem_free(gsl_memdesc_t *memdesc)
 {
-	int status = GSL_SUCCESS;
-	mutex_lock(&gsl_driver.lock);
-	status = kgsl_sharedmem_free0(memdesc, current->tgid);
-	mutex_unlock(&gsl_driver.lock);
-	return status;
+	// the memarena serializes allocations with its own lock
+	return kgsl_sharedmem_free0(memdesc, current->tgid);
 }
 
 //----------------------------------------------------------------------------
@@ -311,11 +341,7 @@ kgsl_sharedmem_read0(const gsl_memdesc_t *memdesc, void *dst, unsigned int offse
 int
 kgsl_sharedmem_read(const gsl_memdesc_t *memdesc, void *dst, unsigned int offsetbytes, unsigned int sizebytes, unsigned int touserspace)
 {
-	int status = GSL_SUCCESS;
-	mutex_lock(&gsl_driver.lock);
-	status = kgsl_sharedmem_read0(memdesc, dst, offsetbytes, sizebytes, touserspace);
-	mutex_unlock(&gsl_driver.lock);
-	return status;
+	return kgsl_sharedmem_read0(memdesc, dst, offsetbytes, sizebytes, touserspace);
 }
 
 //----------------------------------------------------------------------------
@@ -368,11 +394,7 @@ kgsl_sharedmem_write0(const gsl_memdesc_t *memdesc, unsigned int offsetbytes, vo
 int
 kgsl_sharedmem_write(const gsl_memdesc_t *memdesc, unsigned int offsetbytes, void *src, unsigned int sizebytes, unsigned int fromuserspace)
 {
-	int status = GSL_SUCCESS;
-	mutex_lock(&gsl_driver.lock);
-	status = kgsl_sharedmem_write0(memdesc, offsetbytes, src, sizebytes, fromuserspace);
-	mutex_unlock(&gsl_driver.lock);
-	return status;
+	return kgsl_sharedmem_write0(memdesc, offsetbytes, src, sizebytes, fromuserspace);
 }
 
 //----------------------------------------------------------------------------
@@ -424,11 +446,7 @@ kgsl_sharedmem_set0(const gsl_memdesc_t *memdesc, unsigned int offsetbytes, unsi
 int
 kgsl_sharedmem_set(const gsl_memdesc_t *memdesc, unsigned int offsetbytes, unsigned int value, unsigned int sizebytes)
 {
-	int status = GSL_SUCCESS;
-	mutex_lock(&gsl_driver.lock);
-	status = kgsl_sharedmem_set0(memdesc, offsetbytes, value, sizebytes);
-	mutex_unlock(&gsl_driver.lock);
-	return status;
+	return kgsl_sharedmem_set0(memdesc, offsetbytes, value, sizebytes);
 }
 
 //----------------------------------------------------------------------------
@@ -448,22 +466,17 @@ kgsl_sharedmem_largestfreeblock(gsl_deviceid_t device_id, gsl_flags_t flags)
                     "--> int kgsl_sharedmem_largestfreeblock(gsl_deviceid_t device_id=%D, gsl_flags_t flags=%x)\n",
                     device_id, flags );
 
-    mutex_lock(&gsl_driver.lock);
-
     shmem = &gsl_driver.shmem;
 
     if (!(shmem->flags & GSL_FLAGS_INITIALIZED))
     {
         kgsl_log_write( KGSL_LOG_GROUP_MEMORY | KGSL_LOG_LEVEL_ERROR, "ERROR: Shared memory not initialized.\n" );
-        mutex_unlock(&gsl_driver.lock);
         kgsl_log_write( KGSL_LOG_GROUP_MEMORY | KGSL_LOG_LEVEL_TRACE, "<-- kgsl_sharedmem_largestfreeblock. Return value %d\n", 0 );
         return (0);
     }
 
     result = kgsl_memarena_getlargestfreeblock(shmem->memarena, flags);
 
-    mutex_unlock(&gsl_driver.lock);
-
     kgsl_log_write( KGSL_LOG_GROUP_MEMORY | KGSL_LOG_LEVEL_TRACE, "<-- kgsl_sharedmem_largestfreeblock. Return value %d\n", result );
 
     return (result);
@@ -537,13 +550,29 @@ kgsl_sharedmem_map(gsl_deviceid_t device_id, gsl_flags_t flags, const gsl_scatte
                 // mark descriptor's memory as externally allocated -- i.e. outside GSL
                 GSL_MEMDESC_EXTALLOC_SET(memdesc, 1);
 
+                mutex_lock(&gsl_driver.device[device_id-1].lock);
                 status = kgsl_mmu_map(&gsl_driver.device[device_id-1].mmu, memdesc->gpuaddr, scatterlist, flags, current->tgid);
+                mutex_unlock(&gsl_driver.device[device_id-1].lock);
                 if (status != GSL_SUCCESS)
                 {
                     kgsl_memarena_free(shmem->memarena, memdesc);
                 }
             }
         }
+        else if (scatterlist->contiguous)
+        {
+            // without address translation the gpu addresses physical memory directly,
+            // so a physically contiguous buffer can be used in place
+            memset(memdesc, 0, sizeof(gsl_memdesc_t));
+
+            memdesc->gpuaddr = scatterlist->pages[0];
+            memdesc->size    = scatterlist->num * GSL_PAGESIZE;
+
+            GSL_MEMDESC_DEVICE_SET(memdesc, device_id);
+            GSL_MEMDESC_EXTALLOC_SET(memdesc, 1);
+
+            status = GSL_SUCCESS;
+        }
     }
 
     kgsl_log_write( KGSL_LOG_GROUP_MEMORY | KGSL_LOG_LEVEL_TRACE, "<-- kgsl_sharedmem_map. Return value %B\n", status );
@@ -553,10 +582,114 @@ kgsl_sharedmem_map(gsl_deviceid_t device_id, gsl_flags_t flags, const gsl_scatte
 
 //----------------------------------------------------------------------------
 
+int
+kgsl_sharedmem_unmap0(gsl_memdesc_t *memdesc, unsigned int pid)
+{
+    int              status = GSL_FAILURE;
+    gsl_sharedmem_t  *shmem = &gsl_driver.shmem;
+    gsl_deviceid_t   device_id;
+
+    kgsl_log_write( KGSL_LOG_GROUP_MEMORY | KGSL_LOG_LEVEL_TRACE, "--> int kgsl_sharedmem_unmap(gsl_memdesc_t *memdesc=%M)\n", memdesc );
+
+    GSL_MEMDESC_DEVICE_GET(memdesc, device_id);
+
+    if ((shmem->flags & GSL_FLAGS_INITIALIZED) && GSL_MEMDESC_EXTALLOC_ISMARKED(memdesc))
+    {
+        if (kgsl_memarena_isvirtualized(shmem->memarena))
+        {
+            mutex_lock(&gsl_driver.device[device_id-1].lock);
+            kgsl_mmu_unmap(&gsl_driver.device[device_id-1].mmu, memdesc->gpuaddr, memdesc->size, pid);
+            mutex_unlock(&gsl_driver.device[device_id-1].lock);
+
+            status = kgsl_sharedmem_free0(memdesc, pid);
+        }
+        else
+        {
+            // used in place, there is neither a gpu mapping nor an arena block to release
+            memset(memdesc, 0, sizeof(gsl_memdesc_t));
+            status = GSL_SUCCESS;
+        }
+    }
+
+    kgsl_log_write( KGSL_LOG_GROUP_MEMORY | KGSL_LOG_LEVEL_TRACE, "<-- kgsl_sharedmem_unmap. Return value %B\n", status );
+
+    return (status);
+}
+
+//----------------------------------------------------------------------------
+
 int
 kgsl_sharedmem_unmap(gsl_memdesc_t *memdesc)
 {
-    return (kgsl_sharedmem_free0(memdesc, current->tgid));
+    return kgsl_sharedmem_unmap0(memdesc, current->tgid);
+}
+
+//----------------------------------------------------------------------------
+
+int
+kgsl_sharedmem_unmap_multi(gsl_memdesc_t **memdesc, int count, unsigned int pid)
+{
+    gsl_sharedmem_t  *shmem = &gsl_driver.shmem;
+    gsl_mmu_range_t  *ranges;
+    gsl_deviceid_t   device_id, id;
+    int              i, n;
+
+    kgsl_log_write( KGSL_LOG_GROUP_MEMORY | KGSL_LOG_LEVEL_TRACE, "--> int kgsl_sharedmem_unmap_multi(gsl_memdesc_t **memdesc=0x%08x, int count=%d, uint pid=0x%08x)\n", memdesc, count, pid );
+
+    ranges = NULL;
+    if ((shmem->flags & GSL_FLAGS_INITIALIZED) && kgsl_memarena_isvirtualized(shmem->memarena))
+    {
+        ranges = kmalloc(count * sizeof(gsl_mmu_range_t), GFP_KERNEL);
+    }
+
+    if (!ranges)
+    {
+        // nothing to batch, or no memory to batch with
+        for (i = 0; i < count; i++)
+        {
+            kgsl_sharedmem_unmap0(memdesc[i], pid);
+        }
+
+        kgsl_log_write( KGSL_LOG_GROUP_MEMORY | KGSL_LOG_LEVEL_TRACE, "<-- kgsl_sharedmem_unmap_multi. Return value %B\n", GSL_SUCCESS );
+        return (GSL_SUCCESS);
+    }
+
+    // one page table update per device, a single tlb flush decision covers the whole batch
+    for (device_id = GSL_DEVICE_ANY + 1; device_id <= GSL_DEVICE_MAX; device_id++)
+    {
+        n = 0;
+        for (i = 0; i < count; i++)
+        {
+            GSL_MEMDESC_DEVICE_GET(memdesc[i], id);
+            if (id == device_id && GSL_MEMDESC_EXTALLOC_ISMARKED(memdesc[i]))
+            {
+                ranges[n].gpuaddr = memdesc[i]->gpuaddr;
+                ranges[n].range   = memdesc[i]->size;
+                n++;
+            }
+        }
+
+        if (n)
+        {
+            mutex_lock(&gsl_driver.device[device_id-1].lock);
+            kgsl_mmu_unmap_multi(&gsl_driver.device[device_id-1].mmu, ranges, n, pid);
+            mutex_unlock(&gsl_driver.device[device_id-1].lock);
+        }
+    }
+
+    kfree(ranges);
+
+    for (i = 0; i < count; i++)
+    {
+        if (GSL_MEMDESC_EXTALLOC_ISMARKED(memdesc[i]))
+        {
+            kgsl_sharedmem_free0(memdesc[i], pid);
+        }
+    }
+
+    kgsl_log_write( KGSL_LOG_GROUP_MEMORY | KGSL_LOG_LEVEL_TRACE, "<-- kgsl_sharedmem_unmap_multi. Return value %B\n", GSL_SUCCESS );
+
+    return (GSL_SUCCESS);
 }
 
 //----------------------------------------------------------------------------
@@ -671,3 +804,197 @@ kgsl_sharedmem_fromhostpointer(gsl_deviceid_t device_id, gsl_memdesc_t *memdesc,
 
     return (status);
 }
+
+//----------------------------------------------------------------------------
+
+static gsl_sharedmem_procstats_t*
+kgsl_sharedmem_findprocslot(unsigned int pid)
+{
+    int  i;
+
+    // call this with the process accounting lock held, never claims a slot.
+    // pid 0 marks a free slot, so it has nothing to find
+    for (i = 0; i < GSL_CALLER_PROCESS_MAX && pid; i++)
+    {
+        if (gsl_sharedmem_procstats[i].pid == pid)
+        {
+            return (&gsl_sharedmem_procstats[i]);
+        }
+    }
+
+    return (NULL);
+}
+
+//----------------------------------------------------------------------------
+
+static gsl_sharedmem_procstats_t*
+kgsl_sharedmem_getprocslot(unsigned int pid)
+{
+    gsl_sharedmem_procstats_t  *empty = NULL;
+    gsl_sharedmem_procstats_t  *idle  = NULL;
+    int                        i, j;
+
+    // call this with the process accounting lock held
+    for (i = 0; i < GSL_CALLER_PROCESS_MAX; i++)
+    {
+        if (gsl_sharedmem_procstats[i].pid == pid)
+        {
+            return (&gsl_sharedmem_procstats[i]);
+        }
+
+        if (gsl_sharedmem_procstats[i].pid == 0)
+        {
+            if (!empty)
+            {
+                empty = &gsl_sharedmem_procstats[i];
+            }
+        }
+        else if (!idle)
+        {
+            for (j = 0; j < GSL_APERTURE_MAX && !gsl_sharedmem_procstats[i].bytes[j]; j++);
+
+            if (j == GSL_APERTURE_MAX)
+            {
+                idle = &gsl_sharedmem_procstats[i];
+            }
+        }
+    }
+
+    // slots of processes holding nothing keep their history until the table runs full
+    if (!empty)
+    {
+        empty = idle;
+    }
+
+    if (empty)
+    {
+        memset(empty, 0, sizeof(gsl_sharedmem_procstats_t));
+        empty->pid = pid;
+    }
+
+    return (empty);
+}
+
+//----------------------------------------------------------------------------
+
+int
+kgsl_sharedmem_charge(unsigned int pid, gsl_flags_t flags, int sizebytes)
+{
+    //
+    // account an allocation to the calling process, refused early when it would go over the limit
+    //
+    gsl_sharedmem_procstats_t  *procstats;
+    int                        status = GSL_SUCCESS;
+    __s64                      total;
+    int                        i;
+
+    spin_lock(&gsl_sharedmem_proclock);
+
+    procstats = kgsl_sharedmem_getprocslot(pid);
+    if (!procstats)
+    {
+        // every slot belongs to a process still holding memory
+        gsl_sharedmem_procfull++;
+        spin_unlock(&gsl_sharedmem_proclock);
+
+        if (printk_ratelimit())
+            printk(KERN_ERR "%s: pid %d refused, %d processes already hold gpu memory\n",
+                   __func__, pid, GSL_CALLER_PROCESS_MAX);
+        return (GSL_FAILURE_OUTOFMEM);
+    }
+
+    total = sizebytes;
+    for (i = 0; i < GSL_APERTURE_MAX; i++)
+    {
+        total += procstats->bytes[i];
+    }
+
+    if (gsl_sharedmem_proclimit && total > gsl_sharedmem_proclimit)
+    {
+        procstats->allocs_overlimit++;
+        status = GSL_FAILURE_OUTOFMEM;
+    }
+    else
+    {
+        procstats->bytes[GSL_SHAREDMEM_APERTURE_GET(flags)] += sizebytes;
+
+        if (total > procstats->bytes_max)
+        {
+            procstats->bytes_max = total;
+        }
+    }
+
+    spin_unlock(&gsl_sharedmem_proclock);
+
+    if (status != GSL_SUCCESS)
+    {
+        kgsl_log_write( KGSL_LOG_GROUP_MEMORY | KGSL_LOG_LEVEL_ERROR, "ERROR: Process %d over its shared memory limit.\n", pid );
+    }
+
+    return (status);
+}
+
+//----------------------------------------------------------------------------
+
+void
+kgsl_sharedmem_uncharge(unsigned int pid, gsl_flags_t flags, int sizebytes)
+{
+    gsl_sharedmem_procstats_t  *procstats;
+
+    spin_lock(&gsl_sharedmem_proclock);
+
+    // a charged process owns its slot, it cannot have been recycled. without
+    // one there was no charge to undo, and claiming a slot here would evict an
+    // idle process's history for nothing
+    procstats = kgsl_sharedmem_findprocslot(pid);
+    if (procstats)
+    {
+        procstats->bytes[GSL_SHAREDMEM_APERTURE_GET(flags)] -= sizebytes;
+        DEBUG_ASSERT(procstats->bytes[GSL_SHAREDMEM_APERTURE_GET(flags)] >= 0);
+    }
+
+    spin_unlock(&gsl_sharedmem_proclock);
+}
+
+//----------------------------------------------------------------------------
+
+int
+kgsl_sharedmem_getprocstats(int index, gsl_sharedmem_procstats_t *stats)
+{
+    if (index < 0 || index >= GSL_CALLER_PROCESS_MAX)
+    {
+        return (GSL_FAILURE);
+    }
+
+    spin_lock(&gsl_sharedmem_proclock);
+
+    memcpy(stats, &gsl_sharedmem_procstats[index], sizeof(gsl_sharedmem_procstats_t));
+
+    spin_unlock(&gsl_sharedmem_proclock);
+
+    return (GSL_SUCCESS);
+}
+
+//----------------------------------------------------------------------------
+
+void
+kgsl_sharedmem_setproclimit(unsigned int sizebytes)
+{
+    gsl_sharedmem_proclimit = sizebytes;
+}
+
+//----------------------------------------------------------------------------
+
+unsigned int
+kgsl_sharedmem_getproclimit(void)
+{
+    return (gsl_sharedmem_proclimit);
+}
+
+//----------------------------------------------------------------------------
+
+__s64
+kgsl_sharedmem_getprocfull(void)
+{
+    return (gsl_sharedmem_procfull);
+}
@@ -106,6 +106,7 @@ kgsl_yamato_cpintrcallback(gsl_intrid_t id, void *cookie)
     {
         case GSL_INTR_YDX_CP_RING_BUFFER:
 		wake_up_interruptible_all(&(device->timestamp_waitq));
+		kgsl_cmdstream_retire_schedule(device);
             break;
         default:
             break;
@@ -872,6 +873,7 @@ kgsl_yamato_getfunctable(gsl_functable_t *ftbl)
     ftbl->mmu_tlbinvalidate     = kgsl_yamato_tlbinvalidate;
     ftbl->mmu_setpagetable      = kgsl_yamato_setpagetable;
     ftbl->cmdstream_issueibcmds = kgsl_ringbuffer_issueibcmds;
+    ftbl->cmdstream_issueibcmds_multi = kgsl_ringbuffer_issueibcmds_multi;
     ftbl->context_create        = kgsl_drawctxt_create;
     ftbl->context_destroy       = kgsl_drawctxt_destroy;
 
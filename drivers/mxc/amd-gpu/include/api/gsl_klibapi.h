@@ -70,6 +70,7 @@ int                kgsl_device_regwrite(gsl_deviceid_t device_id, unsigned int o
 //  command API
 ////////////////////////////////////////////////////////////////////////////
 int                kgsl_cmdstream_issueibcmds(gsl_deviceid_t device_id, int drawctxt_index, gpuaddr_t ibaddr, int sizedwords, gsl_timestamp_t *timestamp, gsl_flags_t flags);
+int                kgsl_cmdstream_issueibcmds_multi(gsl_deviceid_t device_id, int drawctxt_index, const gsl_ibdesc_t *ibdesc, int numibs, gsl_timestamp_t *timestamp, gsl_flags_t flags);
 gsl_timestamp_t    kgsl_cmdstream_readtimestamp(gsl_deviceid_t device_id, gsl_timestamp_type_t type);
 int                kgsl_cmdstream_freememontimestamp(gsl_deviceid_t device_id, gsl_memdesc_t *memdesc, gsl_timestamp_t timestamp, gsl_timestamp_type_t type);
 int                kgsl_cmdstream_waittimestamp(gsl_deviceid_t device_id, gsl_timestamp_t timestamp, unsigned int timeout);
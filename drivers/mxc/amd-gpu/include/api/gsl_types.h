@@ -406,6 +406,9 @@ typedef struct _gsl_memnode_t {
     gsl_timestamp_t       timestamp;
     gsl_memdesc_t         memdesc;
     unsigned int          pid;
+    unsigned long         queued;       // jiffies when queued
+    void                  (*release)(void *priv);   // called instead of freeing memdesc when set
+    void                  *priv;
     struct _gsl_memnode_t *next;
 } gsl_memnode_t;
 
@@ -414,6 +417,20 @@ typedef struct _gsl_memqueue_t {
     gsl_memnode_t   *tail;
 } gsl_memqueue_t;
 
+// --------------------------
+// indirect buffer descriptor
+// --------------------------
+#define GSL_IBDESC_MAX              32          // max indirect buffers per batched submission
+
+#define GSL_IBDESC_FLAGS_NONE       0x00000000
+#define GSL_IBDESC_FLAGS_PREFETCH   0x00000001  // let the prefetch parser fetch the ib ahead (non-pipelined init)
+
+typedef struct _gsl_ibdesc_t {
+    gpuaddr_t     ibaddr;
+    int           sizedwords;
+    gsl_flags_t   flags;
+} gsl_ibdesc_t;
+
 // ------------
 // timestamp id
 // ------------
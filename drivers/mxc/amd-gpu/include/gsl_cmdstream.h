@@ -34,6 +34,10 @@
 
 gsl_timestamp_t kgsl_cmdstream_readtimestamp0(gsl_deviceid_t device_id, gsl_timestamp_type_t type);
 void kgsl_cmdstream_memqueue_drain(gsl_device_t *device);
+gsl_timestamp_t kgsl_cmdstream_lastissued(gsl_deviceid_t device_id);
+int kgsl_cmdstream_releaseontimestamp(gsl_deviceid_t device_id, gsl_memdesc_t *memdesc, gsl_timestamp_t timestamp, void (*release)(void *priv), void *priv);
+void kgsl_cmdstream_retire_work(struct work_struct *work);
+void kgsl_cmdstream_retire_schedule(gsl_device_t *device);
 int kgsl_cmdstream_init(gsl_device_t *device);
 int kgsl_cmdstream_close(gsl_device_t *device);
 
@@ -31,11 +31,43 @@
 
 #include <linux/wait.h>
 #include <linux/workqueue.h>
+#include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/ktime.h>
 
 //////////////////////////////////////////////////////////////////////////////
 //  types
 //////////////////////////////////////////////////////////////////////////////
 
+// -----------------
+// memfree queue stats
+// -----------------
+typedef struct _gsl_memqueue_stats_t {
+    __s64  queued_bytes;            // waiting for their timestamp right now
+    __s64  queued_nodes;
+    __s64  reclaimed_bytes;
+    __s64  reclaimed_nodes;
+    __s64  reclaim_passes;          // drains that released at least one node
+    __s64  latency_total_us;        // queued to released, summed over reclaimed nodes
+    __s64  latency_max_us;
+} gsl_memqueue_stats_t;
+
+// -----------------
+// submit-to-retire latency
+// -----------------
+#define GSL_LATENCY_INFLIGHT_MAX    64      // submissions tracked between retires, older ones are dropped
+#define GSL_LATENCY_BUCKETS         20      // bucket n counts latencies below 2^n us, the last one is open ended
+
+typedef struct _gsl_latency_t {
+    gsl_timestamp_t  timestamp[GSL_LATENCY_INFLIGHT_MAX];
+    ktime_t          submitted[GSL_LATENCY_INFLIGHT_MAX];
+    unsigned int     head;                  // oldest in-flight submission
+    unsigned int     count;
+    ktime_t          retired;               // time of the last timestamp interrupt
+    unsigned int     histogram[GSL_LATENCY_BUCKETS];
+    unsigned int     dropped;               // submissions not tracked because the ring was full
+} gsl_latency_t;
+
 // --------------
 // function table
 // --------------
@@ -56,6 +88,7 @@ typedef struct _gsl_functable_t {
 	int (*mmu_tlbinvalidate)      (gsl_device_t *device, unsigned int reg_invalidate, unsigned int pid);
 	int (*mmu_setpagetable)       (gsl_device_t *device, unsigned int reg_ptbase, gpuaddr_t ptbase, unsigned int pid);
 	int (*cmdstream_issueibcmds)  (gsl_device_t *device, int drawctxt_index, gpuaddr_t ibaddr, int sizedwords, gsl_timestamp_t *timestamp, gsl_flags_t flags);
+	int (*cmdstream_issueibcmds_multi) (gsl_device_t *device, int drawctxt_index, const gsl_ibdesc_t *ibdesc, int numibs, gsl_timestamp_t *timestamp, gsl_flags_t flags);
 	int (*context_create)         (gsl_device_t *device, gsl_context_type_t type, unsigned int *drawctxt_id, gsl_flags_t flags);
 	int (*context_destroy)        (gsl_device_t *device_id, unsigned int drawctxt_id);
 } gsl_functable_t;
@@ -72,6 +105,12 @@ struct _gsl_device_t {
 	gsl_intr_t        intr;
 	gsl_memdesc_t     memstore;
 	gsl_memqueue_t    memqueue; // queue of memfrees pending timestamp elapse
+	spinlock_t        memqueue_lock;    // protects memqueue and memqueue_stats
+	gsl_memqueue_stats_t memqueue_stats;
+	spinlock_t        latency_lock;     // protects latency, taken from the interrupt path
+	gsl_latency_t     latency;
+	struct work_struct retire_work;     // reclaims retired memqueue nodes and accounts latency off the interrupt path
+	struct mutex      lock;             // serializes submission and device state
 
 #ifdef  GSL_DEVICE_SHADOW_MEMSTORE_TO_USER
 	unsigned int      memstoreshadow[GSL_CALLER_PROCESS_MAX];
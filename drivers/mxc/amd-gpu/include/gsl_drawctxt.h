@@ -29,6 +29,8 @@
 #ifndef __GSL_DRAWCTXT_H
 #define __GSL_DRAWCTXT_H
 
+#include <linux/mutex.h>
+
 //////////////////////////////////////////////////////////////////////////////
 // Flags
 //////////////////////////////////////////////////////////////////////////////
@@ -89,6 +91,7 @@ typedef struct _gmem_shadow_t
 #define GSL_MAX_GMEM_SHADOW_BUFFERS 2
 
 typedef struct _gsl_drawctxt_t {
+    struct mutex        lock;       // protects flags and gmem shadow state
 	unsigned int        pid;
     gsl_flags_t         flags;
     gsl_context_type_t  type;
@@ -42,7 +42,7 @@ typedef struct _gsl_driver_t {
     gsl_flags_t      flags_debug;
     int              refcnt;
     unsigned int     callerprocess[GSL_CALLER_PROCESS_MAX]; // caller process table
-    struct mutex     lock;                                 // global API mutex
+    struct mutex     lock;                                 // process table and init/exit mutex
     void             *hal;
     gsl_sharedmem_t  shmem;
     gsl_device_t     device[GSL_DEVICE_MAX];
@@ -83,6 +83,15 @@ typedef struct _kgsl_cmdstream_issueibcmds_t {
     gsl_flags_t flags;
 } kgsl_cmdstream_issueibcmds_t;
 
+typedef struct _kgsl_cmdstream_issueibcmds_multi_t {
+    gsl_deviceid_t  device_id;
+    int     drawctxt_index;
+    const gsl_ibdesc_t  *ibdesc;
+    int     numibs;
+    gsl_timestamp_t *timestamp;
+    gsl_flags_t flags;
+} kgsl_cmdstream_issueibcmds_multi_t;
+
 typedef struct _kgsl_cmdstream_readtimestamp_t {
     gsl_deviceid_t  device_id;
     gsl_timestamp_type_t    type;
@@ -102,6 +111,12 @@ typedef struct _kgsl_cmdstream_waittimestamp_t {
     unsigned int    timeout;
 } kgsl_cmdstream_waittimestamp_t;
 
+typedef struct _kgsl_cmdstream_createfence_t {
+    gsl_deviceid_t  device_id;
+    gsl_timestamp_t timestamp;
+    int             *fd;
+} kgsl_cmdstream_createfence_t;
+
 typedef struct _kgsl_cmdwindow_write_t {
     gsl_deviceid_t  device_id;
     gsl_cmdwindow_t target;
@@ -182,6 +197,14 @@ typedef struct _kgsl_sharedmem_fromhostpointer_t {
     void        *hostptr;
 } kgsl_sharedmem_fromhostpointer_t;
 
+typedef struct _kgsl_sharedmem_import_t {
+    gsl_deviceid_t  device_id;
+    gsl_flags_t flags;
+    void        *hostptr;
+    unsigned int    sizebytes;
+    gsl_memdesc_t   *memdesc;
+} kgsl_sharedmem_import_t;
+
 //////////////////////////////////////////////////////////////////////////////
 // ioctl numbers
 //////////////////////////////////////////////////////////////////////////////
@@ -211,6 +234,9 @@ typedef struct _kgsl_sharedmem_fromhostpointer_t {
 #define IOCTL_KGSL_SHAREDMEM_CACHEOPERATION     _IOW(GSL_MAGIC, 0x37, struct _kgsl_sharedmem_cacheoperation_t)
 #define IOCTL_KGSL_SHAREDMEM_FROMHOSTPOINTER    _IOW(GSL_MAGIC, 0x38, struct _kgsl_sharedmem_fromhostpointer_t)
 #define IOCTL_KGSL_DRIVER_EXIT		        _IOWR(GSL_MAGIC, 0x3A, NULL)
+#define IOCTL_KGSL_CMDSTREAM_CREATEFENCE        _IOWR(GSL_MAGIC, 0x3B, struct _kgsl_cmdstream_createfence_t)
+#define IOCTL_KGSL_CMDSTREAM_ISSUEIBCMDS_MULTI  _IOWR(GSL_MAGIC, 0x3C, struct _kgsl_cmdstream_issueibcmds_multi_t)
+#define IOCTL_KGSL_SHAREDMEM_IMPORT             _IOWR(GSL_MAGIC, 0x3D, struct _kgsl_sharedmem_import_t)
 
 
 #endif
@@ -31,6 +31,7 @@
 
 
 #include <linux/mutex.h>
+#include <linux/rbtree.h>
 
 //////////////////////////////////////////////////////////////////////////////
 // defines
@@ -57,6 +58,7 @@ typedef struct _gsl_memarena_stats_t {
     __s64  frees;
     __s64  allocs_pagedistribution[GSL_MEMARENA_PAGE_DIST_MAX]; // 0=0--(4K-1), 1=4--(8K-1), 2=8--(16K-1),... max-1=(GSL_PAGESIZE<<(max-1))--infinity
     __s64  frees_pagedistribution[GSL_MEMARENA_PAGE_DIST_MAX];
+    __s64  freeblocks;                                                  // number of free blocks, a measure of fragmentation
 } gsl_memarena_stats_t;
 
 // ------------
@@ -65,8 +67,8 @@ typedef struct _gsl_memarena_stats_t {
 typedef struct _memblk_t {
     unsigned int      blkaddr;
     unsigned int      blksize;
-    struct _memblk_t  *next;
-    struct _memblk_t  *prev;
+    struct rb_node    addrnode;         // free list ordered by address, for coalescing
+    struct rb_node    sizenode;         // free list ordered by size then address, for best fit
     int               nodepoolindex;
 } memblk_t;
 
@@ -74,9 +76,9 @@ typedef struct _memblk_t {
 // memory block free list
 // ----------------------
 typedef struct _gsl_freelist_t {
-    memblk_t  *head;
-    memblk_t  *allocrover;
-    memblk_t  *freerover;
+    struct rb_root  addrtree;
+    struct rb_root  sizetree;
+    unsigned int    numblocks;
 } gsl_freelist_t;
 
 // ----------------------
@@ -100,6 +100,9 @@ typedef struct _gsl_ptstats_t {
     __s64  maps;
     __s64  unmaps;
 	__s64  switches;
+    __s64  batches;             // map/unmap calls, each covering one or more ranges
+    __s64  ptewrites;
+    __s64  superptesskipped;    // already empty superPTE's left untouched by unmap
 } gsl_ptstats_t;
 
 // ---------
@@ -108,8 +111,17 @@ typedef struct _gsl_ptstats_t {
 typedef struct _gsl_mmustats_t {
 	gsl_ptstats_t  pt;
 	__s64        tlbflushes;
+	__s64        tlbflushrequests;  // batches that flagged a flush, coalesced until the next pagetable switch
 } gsl_mmustats_t;
 
+// ------------------
+// mmu range of batch
+// ------------------
+typedef struct _gsl_mmu_range_t {
+    gpuaddr_t                gpuaddr;
+    int                      range;             // size in bytes
+} gsl_mmu_range_t;
+
 // -----------------
 // page table object
 // -----------------
@@ -176,6 +188,7 @@ int    kgsl_mmu_detachcallback(gsl_mmu_t *mmu, unsigned int pid);
 int    kgsl_mmu_setpagetable(gsl_device_t *device, unsigned int pid);
 int    kgsl_mmu_map(gsl_mmu_t *mmu, gpuaddr_t gpubaseaddr, const gsl_scatterlist_t *scatterlist, gsl_flags_t flags, unsigned int pid);
 int    kgsl_mmu_unmap(gsl_mmu_t *mmu, gpuaddr_t gpubaseaddr, int range, unsigned int pid);
+int    kgsl_mmu_unmap_multi(gsl_mmu_t *mmu, const gsl_mmu_range_t *ranges, int count, unsigned int pid);
 int    kgsl_mmu_getmap(gsl_mmu_t *mmu, gpuaddr_t gpubaseaddr, int range, gsl_scatterlist_t *scatterlist, unsigned int pid);
 int    kgsl_mmu_querystats(gsl_mmu_t *mmu, gsl_mmustats_t *stats);
 int    kgsl_mmu_bist(gsl_mmu_t *mmu);
@@ -126,6 +126,7 @@ typedef struct _gsl_rbmemptrs_t {
 typedef struct _gsl_rbstats_t {
     __s64  wraps;
     __s64  issues;
+    __s64  ibs;                 // indirect buffers, several may share one issue
     __s64  wordstotal;
 } gsl_rbstats_t;
 
@@ -226,6 +227,7 @@ int             kgsl_ringbuffer_start(gsl_ringbuffer_t *rb);
 int             kgsl_ringbuffer_stop(gsl_ringbuffer_t *rb);
 gsl_timestamp_t	kgsl_ringbuffer_issuecmds(gsl_device_t *device, int pmodeoff, unsigned int *cmdaddr, int sizedwords, unsigned int pid);
 int             kgsl_ringbuffer_issueibcmds(gsl_device_t *device, int drawctxt_index, gpuaddr_t ibaddr, int sizedwords, gsl_timestamp_t *timestamp, gsl_flags_t flags);
+int             kgsl_ringbuffer_issueibcmds_multi(gsl_device_t *device, int drawctxt_index, const gsl_ibdesc_t *ibdesc, int numibs, gsl_timestamp_t *timestamp, gsl_flags_t flags);
 void            kgsl_ringbuffer_watchdog(void);
 
 int             kgsl_ringbuffer_querystats(gsl_ringbuffer_t *rb, gsl_rbstats_t *stats);
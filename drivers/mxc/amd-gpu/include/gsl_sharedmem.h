@@ -50,6 +50,17 @@
 //  types
 //////////////////////////////////////////////////////////////////////////////
 
+// -----------------------------
+// per process memory accounting
+// -----------------------------
+typedef struct _gsl_sharedmem_procstats_t
+{
+    unsigned int    pid;                            // 0 when the slot is unused
+    __s64           bytes[GSL_APERTURE_MAX];        // currently charged, per aperture
+    __s64           bytes_max;                      // high water mark over all apertures
+    __s64           allocs_overlimit;               // allocations refused by the per process limit
+} gsl_sharedmem_procstats_t;
+
 // --------------------
 // shared memory object
 // --------------------
@@ -68,9 +79,17 @@ int             kgsl_sharedmem_init(gsl_sharedmem_t *shmem);
 int             kgsl_sharedmem_close(gsl_sharedmem_t *shmem);
 int             kgsl_sharedmem_alloc0(gsl_deviceid_t device_id, gsl_flags_t flags, int sizebytes, gsl_memdesc_t *memdesc);
 int             kgsl_sharedmem_free0(gsl_memdesc_t *memdesc, unsigned int pid);
+int             kgsl_sharedmem_unmap0(gsl_memdesc_t *memdesc, unsigned int pid);
+int             kgsl_sharedmem_unmap_multi(gsl_memdesc_t **memdesc, int count, unsigned int pid);
 int             kgsl_sharedmem_read0(const gsl_memdesc_t *memdesc, void *dst, unsigned int offsetbytes, unsigned int sizebytes, unsigned int touserspace);
 int             kgsl_sharedmem_write0(const gsl_memdesc_t *memdesc, unsigned int offsetbytes, void *src, unsigned int sizebytes, unsigned int fromuserspace);
 int             kgsl_sharedmem_set0(const gsl_memdesc_t *memdesc, unsigned int offsetbytes, unsigned int value, unsigned int sizebytes);
 unsigned int    kgsl_sharedmem_convertaddr(unsigned int addr, int type);
+int             kgsl_sharedmem_charge(unsigned int pid, gsl_flags_t flags, int sizebytes);
+void            kgsl_sharedmem_uncharge(unsigned int pid, gsl_flags_t flags, int sizebytes);
+int             kgsl_sharedmem_getprocstats(int index, gsl_sharedmem_procstats_t *stats);
+void            kgsl_sharedmem_setproclimit(unsigned int sizebytes);
+unsigned int    kgsl_sharedmem_getproclimit(void);
+__s64           kgsl_sharedmem_getprocfull(void);
 
 #endif // __GSL_SHAREDMEM_H
@@ -0,0 +1,158 @@
+/* Copyright (c) 2008-2010, Advanced Micro Devices. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM kgsl
+
+#if !defined(__GSL_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define __GSL_TRACE_H
+
+#include <linux/tracepoint.h>
+
+// submission accepted by the core, timestamp is the one handed back to the caller
+TRACE_EVENT(kgsl_issueibcmds,
+
+	TP_PROTO(unsigned int device_id, int drawctxt_index, int numibs, unsigned int timestamp),
+
+	TP_ARGS(device_id, drawctxt_index, numibs, timestamp),
+
+	TP_STRUCT__entry(
+		__field(unsigned int,	device_id)
+		__field(int,		drawctxt_index)
+		__field(int,		numibs)
+		__field(unsigned int,	timestamp)
+	),
+
+	TP_fast_assign(
+		__entry->device_id	= device_id;
+		__entry->drawctxt_index	= drawctxt_index;
+		__entry->numibs		= numibs;
+		__entry->timestamp	= timestamp;
+	),
+
+	TP_printk("device=%u ctx=%d ibs=%d ts=%u",
+		__entry->device_id, __entry->drawctxt_index,
+		__entry->numibs, __entry->timestamp)
+);
+
+// submission seen retired, latency runs from submit to the timestamp interrupt
+TRACE_EVENT(kgsl_retire,
+
+	TP_PROTO(unsigned int device_id, unsigned int timestamp, unsigned int latency_us),
+
+	TP_ARGS(device_id, timestamp, latency_us),
+
+	TP_STRUCT__entry(
+		__field(unsigned int,	device_id)
+		__field(unsigned int,	timestamp)
+		__field(unsigned int,	latency_us)
+	),
+
+	TP_fast_assign(
+		__entry->device_id	= device_id;
+		__entry->timestamp	= timestamp;
+		__entry->latency_us	= latency_us;
+	),
+
+	TP_printk("device=%u ts=%u latency=%uus",
+		__entry->device_id, __entry->timestamp, __entry->latency_us)
+);
+
+// ringbuffer full, the submitter spun until the cp consumed enough
+TRACE_EVENT(kgsl_waitspace,
+
+	TP_PROTO(unsigned int device_id, unsigned int numcmds, int wrapped, unsigned int wait_us),
+
+	TP_ARGS(device_id, numcmds, wrapped, wait_us),
+
+	TP_STRUCT__entry(
+		__field(unsigned int,	device_id)
+		__field(unsigned int,	numcmds)
+		__field(int,		wrapped)
+		__field(unsigned int,	wait_us)
+	),
+
+	TP_fast_assign(
+		__entry->device_id	= device_id;
+		__entry->numcmds	= numcmds;
+		__entry->wrapped	= wrapped;
+		__entry->wait_us	= wait_us;
+	),
+
+	TP_printk("device=%u numcmds=%u wrapped=%d wait=%uus",
+		__entry->device_id, __entry->numcmds,
+		__entry->wrapped, __entry->wait_us)
+);
+
+TRACE_EVENT(kgsl_mem_alloc,
+
+	TP_PROTO(unsigned int device_id, unsigned int gpuaddr, unsigned int size, unsigned int flags, int result),
+
+	TP_ARGS(device_id, gpuaddr, size, flags, result),
+
+	TP_STRUCT__entry(
+		__field(unsigned int,	device_id)
+		__field(unsigned int,	gpuaddr)
+		__field(unsigned int,	size)
+		__field(unsigned int,	flags)
+		__field(int,		result)
+	),
+
+	TP_fast_assign(
+		__entry->device_id	= device_id;
+		__entry->gpuaddr	= gpuaddr;
+		__entry->size		= size;
+		__entry->flags		= flags;
+		__entry->result		= result;
+	),
+
+	TP_printk("device=%u gpuaddr=0x%08x size=%u flags=0x%x result=%d",
+		__entry->device_id, __entry->gpuaddr, __entry->size,
+		__entry->flags, __entry->result)
+);
+
+TRACE_EVENT(kgsl_mem_free,
+
+	TP_PROTO(unsigned int gpuaddr, unsigned int size, unsigned int pid),
+
+	TP_ARGS(gpuaddr, size, pid),
+
+	TP_STRUCT__entry(
+		__field(unsigned int,	gpuaddr)
+		__field(unsigned int,	size)
+		__field(unsigned int,	pid)
+	),
+
+	TP_fast_assign(
+		__entry->gpuaddr	= gpuaddr;
+		__entry->size		= size;
+		__entry->pid		= pid;
+	),
+
+	TP_printk("gpuaddr=0x%08x size=%u pid=%u",
+		__entry->gpuaddr, __entry->size, __entry->pid)
+);
+
+#endif  // __GSL_TRACE_H
+
+// this part must be outside the header guard
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE gsl_trace
+#include <trace/define_trace.h>
@@ -32,6 +32,11 @@
 #include <linux/wait.h>
 #include <linux/dma-mapping.h>
 #include <linux/io.h>
+#include <linux/list.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
+#include <linux/completion.h>
+#include <linux/contig_alloc.h>
 #include <linux/ipu.h>
 #include <asm/cacheflush.h>
 
@@ -79,11 +84,716 @@ static irqreturn_t mxc_ipu_generic_handler(int irq, void *dev_id)
 	return IRQ_HANDLED;
 }
 
-static int mxc_ipu_open(struct inode *inode, struct file *file)
+/*
+ * Queued task interface. Tasks from all open files go through one
+ * ordered work queue since there is a single PP path; each file collects
+ * its completed tasks on its own list which poll() and IPU_DEQUEUE_TASK
+ * consume.
+ */
+#define IPU_TASK_MAX_PER_FILE	16
+#define IPU_TASK_TIMEOUT	(HZ)
+#define IPU_TASK_IC_MAX_WIDTH	1024
+#define IPU_TASK_IC_MAX_HEIGHT	1024
+
+struct ipu_task_file {
+	struct list_head done;
+	wait_queue_head_t waitq;
+	int outstanding;	/* queued, running or done but not dequeued */
+	int running;		/* queued or running */
+	bool mmap_cached;	/* later mmaps are cached, see IPU_CPU_ACCESS_* */
+	ipu_deinterlace di;	/* IPU_SET_DEINTERLACE */
+	ipu_task_buf di_last;	/* input of the last deinterlace task queued */
+};
+
+struct ipu_task_entry {
+	struct list_head node;
+	struct ipu_task_file *owner;
+	ipu_task task;
+	ipu_deinterlace di;	/* stream setup when queued */
+	ipu_task_buf di_prev;	/* frame holding the previous field */
+};
+
+static LIST_HEAD(ipu_task_list);
+static DEFINE_SPINLOCK(ipu_task_lock);
+static struct workqueue_struct *ipu_task_wq;
+static struct work_struct ipu_task_work;
+
+/* intermediate buffer between PP and the rotator, only grows */
+static void *ipu_task_rot_vaddr;
+static dma_addr_t ipu_task_rot_paddr;
+static size_t ipu_task_rot_size;
+
+static void ipu_task_fix_crop(ipu_task_buf *buf)
+{
+	if (!buf->crop.w || !buf->crop.h) {
+		buf->crop.x = 0;
+		buf->crop.y = 0;
+		buf->crop.w = buf->width;
+		buf->crop.h = buf->height;
+	}
+}
+
+static int ipu_task_check(ipu_task *t)
+{
+	ipu_task_buf *in = &t->input, *out = &t->output;
+
+	ipu_task_fix_crop(in);
+	ipu_task_fix_crop(out);
+
+	if (!in->paddr || !out->paddr ||
+	    !bytes_per_pixel(in->format) || !bytes_per_pixel(out->format))
+		return -EINVAL;
+	if ((in->crop.x + in->crop.w > in->width) ||
+	    (in->crop.y + in->crop.h > in->height) ||
+	    (out->crop.x + out->crop.w > out->width) ||
+	    (out->crop.y + out->crop.h > out->height))
+		return -EINVAL;
+	if (t->rotate > IPU_ROTATE_90_LEFT)
+		return -EINVAL;
+	/* larger outputs are split in two stripes per direction, no more */
+	if (((t->rotate >= IPU_ROTATE_90_RIGHT) ? out->crop.h : out->crop.w) >
+	    2 * IPU_TASK_IC_MAX_WIDTH)
+		return -EINVAL;
+	if (((t->rotate >= IPU_ROTATE_90_RIGHT) ? out->crop.w : out->crop.h) >
+	    2 * IPU_TASK_IC_MAX_HEIGHT)
+		return -EINVAL;
+
+	return 0;
+}
+
+/* the VDI reads fields, so keep crops on even lines and flips in place */
+static int ipu_task_vdi_check(ipu_task *t)
+{
+	ipu_task_buf *in = &t->input;
+
+	if ((in->format != IPU_PIX_FMT_UYVY) &&
+	    (in->format != IPU_PIX_FMT_YUYV) &&
+	    (in->format != IPU_PIX_FMT_YUV420P))
+		return -EINVAL;
+	if ((in->crop.y & 1) || (in->crop.h & 1))
+		return -EINVAL;
+	/* 4:2:0 chroma lines alternate fields too, and are half width */
+	if ((in->format == IPU_PIX_FMT_YUV420P) &&
+	    ((in->crop.y & 3) || (in->crop.h & 3) ||
+	     (in->crop.x & 1) || (in->crop.w & 1)))
+		return -EINVAL;
+	if (!ipu_can_rotate_in_place(t->rotate))
+		return -EINVAL;
+
+	return 0;
+}
+
+static dma_addr_t ipu_task_crop_addr(ipu_task_buf *buf)
+{
+	uint32_t bpp = bytes_per_pixel(buf->format);
+
+	/* for planar formats this is the Y plane, U/V follow via the offsets */
+	return buf->paddr + (buf->crop.y * buf->width + buf->crop.x) * bpp;
+}
+
+static bool ipu_task_fmt_planar(uint32_t fmt)
+{
+	switch (fmt) {
+	case IPU_PIX_FMT_YUV420P:
+	case IPU_PIX_FMT_YUV420P2:
+	case IPU_PIX_FMT_YVU420P:
+	case IPU_PIX_FMT_YUV422P:
+	case IPU_PIX_FMT_YVU422P:
+	case IPU_PIX_FMT_NV12:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/*
+ * The channel is set up on the crop alone, so planar chroma offsets always
+ * need redoing from the full frame height, even for a crop at the origin.
+ */
+static int ipu_task_init_buffer(ipu_channel_t ch, ipu_buffer_t type,
+				ipu_task_buf *buf, ipu_rotate_mode_t rot)
+{
+	dma_addr_t addr = ipu_task_crop_addr(buf);
+	uint32_t stride = buf->width * bytes_per_pixel(buf->format);
+	int ret;
+
+	ret = ipu_init_channel_buffer(ch, type, buf->format,
+				      buf->crop.w, buf->crop.h, stride, rot,
+				      addr, addr, 0, 0, 0);
+	if (ret < 0)
+		return ret;
+
+	if (buf->crop.x || buf->crop.y || ipu_task_fmt_planar(buf->format))
+		ret = ipu_update_channel_offset(ch, type, buf->format,
+						buf->width, buf->height, stride,
+						0, 0, buf->crop.y, buf->crop.x);
+	return ret;
+}
+
+/*
+ * Second field of buf, one line into the frame. Planar chroma of that field
+ * starts one chroma line in, not one luma stride, so give the offsets
+ * explicitly: ipu_update_channel_offset adds the crop position to them.
+ */
+static int ipu_task_init_field(ipu_channel_t ch, ipu_task_buf *buf)
+{
+	ipu_task_buf field = *buf;
+	uint32_t stride = buf->width * bytes_per_pixel(buf->format);
+	uint32_t u;
+	int ret;
+
+	field.paddr += stride;
+	ret = ipu_task_init_buffer(ch, IPU_INPUT_BUFFER, &field,
+				   IPU_ROTATE_NONE);
+	if ((ret < 0) || (buf->format != IPU_PIX_FMT_YUV420P))
+		return ret;
+
+	u = stride * buf->height + stride / 2 - stride;
+	return ipu_update_channel_offset(ch, IPU_INPUT_BUFFER, buf->format,
+					 buf->width, buf->height, stride,
+					 u, u + stride * buf->height / 4,
+					 buf->crop.y, buf->crop.x);
+}
+
+static irqreturn_t ipu_task_irq_handler(int irq, void *dev_id)
+{
+	complete((struct completion *)dev_id);
+	return IRQ_HANDLED;
+}
+
+/* run the channels set up by the caller, in_ch reads, eof_ch's EOF ends the pass */
+static int ipu_task_start_wait(ipu_channel_t in_ch, ipu_channel_t eof_ch,
+			       uint32_t irq)
+{
+	struct completion done;
+	int ret = 0;
+
+	init_completion(&done);
+	ipu_clear_irq(irq);
+	ret = ipu_request_irq(irq, ipu_task_irq_handler, 0, "ipu_task", &done);
+	if (ret < 0)
+		return ret;
+
+	if (eof_ch != in_ch) {
+		ipu_enable_channel(eof_ch);
+		ipu_select_buffer(eof_ch, IPU_OUTPUT_BUFFER, 0);
+	}
+	ipu_enable_channel(in_ch);
+	ipu_select_buffer(in_ch, IPU_OUTPUT_BUFFER, 0);
+	ipu_select_buffer(in_ch, IPU_INPUT_BUFFER, 0);
+
+	if (!wait_for_completion_timeout(&done, IPU_TASK_TIMEOUT))
+		ret = -ETIMEDOUT;
+
+	ipu_free_irq(irq, &done);
+	if (eof_ch != in_ch)
+		ipu_disable_channel(eof_ch, true);
+	ipu_disable_channel(in_ch, true);
+
+	return ret;
+}
+
+/* as ipu_task_start_wait for the VDI, with the previous/next field channels */
+static int ipu_task_vdi_start_wait(bool fields)
 {
+	struct completion done;
 	int ret = 0;
+
+	init_completion(&done);
+	ipu_clear_irq(IPU_IRQ_PRP_VF_OUT_EOF);
+	ret = ipu_request_irq(IPU_IRQ_PRP_VF_OUT_EOF, ipu_task_irq_handler, 0,
+			      "ipu_task", &done);
+	if (ret < 0)
+		return ret;
+
+	ipu_enable_channel(MEM_VDI_PRP_VF_MEM);
+	ipu_select_buffer(MEM_VDI_PRP_VF_MEM, IPU_OUTPUT_BUFFER, 0);
+	if (fields) {
+		ipu_enable_channel(MEM_VDI_PRP_VF_MEM_P);
+		ipu_enable_channel(MEM_VDI_PRP_VF_MEM_N);
+		ipu_select_multi_vdi_buffer(0);
+	} else
+		ipu_select_buffer(MEM_VDI_PRP_VF_MEM, IPU_INPUT_BUFFER, 0);
+
+	if (!wait_for_completion_timeout(&done, IPU_TASK_TIMEOUT))
+		ret = -ETIMEDOUT;
+
+	ipu_free_irq(IPU_IRQ_PRP_VF_OUT_EOF, &done);
+	if (fields) {
+		ipu_disable_channel(MEM_VDI_PRP_VF_MEM_P, true);
+		ipu_disable_channel(MEM_VDI_PRP_VF_MEM_N, true);
+	}
+	ipu_disable_channel(MEM_VDI_PRP_VF_MEM, true);
+
+	return ret;
+}
+
+/*
+ * One VDI pass: the current frame in, deinterlaced through PRP VF into out.
+ * Outside HIGH_MOTION the VDI also reads the second field of prev and of in,
+ * which start one line into their frames. Ratios are as for ipu_task_pass.
+ */
+static int ipu_task_vdi_pass(ipu_task_buf *in, ipu_task_buf *prev,
+			     ipu_task_buf *out, ipu_rotate_mode_t rotate,
+			     ipu_deinterlace *di, uint32_t outh_ratio,
+			     uint32_t outv_ratio)
+{
+	ipu_channel_params_t params;
+	bool fields = (di->motion != HIGH_MOTION);
+	int ret;
+
+	memset(&params, 0, sizeof(params));
+	params.mem_prp_vf_mem.in_width = in->crop.w;
+	params.mem_prp_vf_mem.in_height = in->crop.h;
+	params.mem_prp_vf_mem.in_pixel_fmt = in->format;
+	params.mem_prp_vf_mem.out_width = out->crop.w;
+	params.mem_prp_vf_mem.out_height = out->crop.h;
+	params.mem_prp_vf_mem.out_pixel_fmt = out->format;
+	params.mem_prp_vf_mem.outh_resize_ratio = outh_ratio;
+	params.mem_prp_vf_mem.outv_resize_ratio = outv_ratio;
+	params.mem_prp_vf_mem.motion_sel = di->motion;
+	params.mem_prp_vf_mem.field_fmt = di->field_fmt;
+
+	ret = ipu_init_channel(MEM_VDI_PRP_VF_MEM, &params);
+	if (ret < 0)
+		return ret;
+	if (fields) {
+		ret = ipu_init_channel(MEM_VDI_PRP_VF_MEM_P, &params);
+		if (ret < 0)
+			goto out_cur;
+		ret = ipu_init_channel(MEM_VDI_PRP_VF_MEM_N, &params);
+		if (ret < 0)
+			goto out_prev;
+	}
+
+	ret = ipu_task_init_buffer(MEM_VDI_PRP_VF_MEM, IPU_INPUT_BUFFER,
+				   in, IPU_ROTATE_NONE);
+	if (ret == 0)
+		ret = ipu_task_init_buffer(MEM_VDI_PRP_VF_MEM,
+					   IPU_OUTPUT_BUFFER, out, rotate);
+	if ((ret == 0) && fields)
+		ret = ipu_task_init_field(MEM_VDI_PRP_VF_MEM_P, prev);
+	if ((ret == 0) && fields)
+		ret = ipu_task_init_field(MEM_VDI_PRP_VF_MEM_N, in);
+	if (ret == 0)
+		ret = ipu_task_vdi_start_wait(fields);
+
+	if (fields)
+		ipu_uninit_channel(MEM_VDI_PRP_VF_MEM_N);
+out_prev:
+	if (fields)
+		ipu_uninit_channel(MEM_VDI_PRP_VF_MEM_P);
+out_cur:
+	ipu_uninit_channel(MEM_VDI_PRP_VF_MEM);
 	return ret;
 }
+
+/*
+ * One IC pass over the input crop into the output crop. Non-zero ratios
+ * override the ones the IC would derive, stripes need them to match. With
+ * rot_buf the IC writes there and the rotator, linked behind it, applies
+ * rotate on the way to out; otherwise rotate must be doable in place.
+ */
+static int ipu_task_pass(ipu_task_buf *in, ipu_task_buf *out,
+			 ipu_rotate_mode_t rotate, uint32_t outh_ratio,
+			 uint32_t outv_ratio, ipu_task_buf *rot_buf)
+{
+	ipu_channel_params_t params;
+	ipu_task_buf *pp_out = rot_buf ? rot_buf : out;
+	int ret;
+
+	memset(&params, 0, sizeof(params));
+	params.mem_pp_mem.in_width = in->crop.w;
+	params.mem_pp_mem.in_height = in->crop.h;
+	params.mem_pp_mem.in_pixel_fmt = in->format;
+	params.mem_pp_mem.out_width = pp_out->crop.w;
+	params.mem_pp_mem.out_height = pp_out->crop.h;
+	params.mem_pp_mem.out_pixel_fmt = pp_out->format;
+	params.mem_pp_mem.outh_resize_ratio = outh_ratio;
+	params.mem_pp_mem.outv_resize_ratio = outv_ratio;
+
+	ret = ipu_init_channel(MEM_PP_MEM, &params);
+	if (ret < 0)
+		return ret;
+
+	ret = ipu_task_init_buffer(MEM_PP_MEM, IPU_INPUT_BUFFER,
+				   in, IPU_ROTATE_NONE);
+	if (ret < 0)
+		goto out_pp;
+	ret = ipu_task_init_buffer(MEM_PP_MEM, IPU_OUTPUT_BUFFER, pp_out,
+				   rot_buf ? IPU_ROTATE_NONE : rotate);
+	if (ret < 0)
+		goto out_pp;
+
+	if (!rot_buf) {
+		ret = ipu_task_start_wait(MEM_PP_MEM, MEM_PP_MEM,
+					  IPU_IRQ_PP_OUT_EOF);
+		goto out_pp;
+	}
+
+	ret = ipu_init_channel(MEM_ROT_PP_MEM, NULL);
+	if (ret < 0)
+		goto out_pp;
+	ret = ipu_task_init_buffer(MEM_ROT_PP_MEM, IPU_INPUT_BUFFER,
+				   rot_buf, rotate);
+	if (ret < 0)
+		goto out_rot;
+	ret = ipu_task_init_buffer(MEM_ROT_PP_MEM, IPU_OUTPUT_BUFFER,
+				   out, IPU_ROTATE_NONE);
+	if (ret < 0)
+		goto out_rot;
+	ret = ipu_link_channels(MEM_PP_MEM, MEM_ROT_PP_MEM);
+	if (ret < 0)
+		goto out_rot;
+
+	ret = ipu_task_start_wait(MEM_PP_MEM, MEM_ROT_PP_MEM,
+				  IPU_IRQ_PP_ROT_OUT_EOF);
+
+	ipu_unlink_channels(MEM_PP_MEM, MEM_ROT_PP_MEM);
+out_rot:
+	ipu_uninit_channel(MEM_ROT_PP_MEM);
+out_pp:
+	ipu_uninit_channel(MEM_PP_MEM);
+	return ret;
+}
+
+/* rotator alone, for frames the IC had to write out in stripes first */
+static int ipu_task_rotate(ipu_task_buf *in, ipu_task_buf *out,
+			   ipu_rotate_mode_t rotate)
+{
+	int ret;
+
+	ret = ipu_init_channel(MEM_ROT_PP_MEM, NULL);
+	if (ret < 0)
+		return ret;
+
+	ret = ipu_task_init_buffer(MEM_ROT_PP_MEM, IPU_INPUT_BUFFER,
+				   in, rotate);
+	if (ret == 0)
+		ret = ipu_task_init_buffer(MEM_ROT_PP_MEM, IPU_OUTPUT_BUFFER,
+					   out, IPU_ROTATE_NONE);
+	if (ret == 0)
+		ret = ipu_task_start_wait(MEM_ROT_PP_MEM, MEM_ROT_PP_MEM,
+					  IPU_IRQ_PP_ROT_OUT_EOF);
+
+	ipu_uninit_channel(MEM_ROT_PP_MEM);
+	return ret;
+}
+
+/*
+ * The calculator trims the output to its write alignment, and its equal
+ * stripes can come out wider than the IC. Neither can be run as is.
+ * tools/testing/ipu-stripes checks the splits this lets through.
+ */
+static bool ipu_task_stripes_ok(struct stripe_param *s, unsigned int out,
+				unsigned int max)
+{
+	return (s[1].output_column + s[1].output_width == out) &&
+	       (s[0].output_width <= max) && (s[1].output_width <= max);
+}
+
+/*
+ * Split an IC pass whose output exceeds the IC line or height limit into
+ * two stripes per oversized direction and run them back to back. Stripes
+ * share one resize ratio so the seams line up; in place flips mirror the
+ * stripe positions in the output. With di the passes go through the VDI,
+ * prev cut the same way as in.
+ */
+static int ipu_task_stripes(ipu_task_buf *in, ipu_task_buf *out,
+			    ipu_rotate_mode_t rotate, ipu_task_buf *prev,
+			    ipu_deinterlace *di)
+{
+	struct stripe_param h[2], v[2];
+	ipu_task_buf sin, sout, sprev;
+	int nh = 1, nv = 1, i, j;
+	int ret;
+
+	memset(h, 0, sizeof(h));
+	memset(v, 0, sizeof(v));
+	h[0].input_width = in->crop.w;
+	h[0].output_width = out->crop.w;
+	v[0].input_width = in->crop.h;
+	v[0].output_width = out->crop.h;
+
+	if (out->crop.w > IPU_TASK_IC_MAX_WIDTH) {
+		if (ipu_calc_stripes_sizes(in->crop.w, out->crop.w,
+					   IPU_TASK_IC_MAX_WIDTH,
+					   ((unsigned long long)1) << 32, 1,
+					   in->format, out->format,
+					   &h[0], &h[1]) & 1)
+			return -EINVAL;
+		if (!ipu_task_stripes_ok(h, out->crop.w,
+					 IPU_TASK_IC_MAX_WIDTH))
+			return -EINVAL;
+		nh = 2;
+	}
+	if (out->crop.h > IPU_TASK_IC_MAX_HEIGHT) {
+		if (ipu_calc_stripes_sizes(in->crop.h, out->crop.h,
+					   IPU_TASK_IC_MAX_HEIGHT,
+					   ((unsigned long long)1) << 32, 1,
+					   in->format, out->format,
+					   &v[0], &v[1]) & 1)
+			return -EINVAL;
+		if (!ipu_task_stripes_ok(v, out->crop.h,
+					 IPU_TASK_IC_MAX_HEIGHT))
+			return -EINVAL;
+		/* a stripe starting on an odd line would swap the fields */
+		if (di && ((v[1].input_column | v[0].input_width) &
+			   ((in->format == IPU_PIX_FMT_YUV420P) ? 3 : 1)))
+			return -EINVAL;
+		nv = 2;
+	}
+
+	for (j = 0; j < nv; j++) {
+		for (i = 0; i < nh; i++) {
+			sin = *in;
+			sout = *out;
+
+			sin.crop.x += h[i].input_column;
+			sin.crop.w = h[i].input_width;
+			sin.crop.y += v[j].input_column;
+			sin.crop.h = v[j].input_width;
+
+			if (rotate & IPU_ROTATE_HORIZ_FLIP)
+				sout.crop.x += out->crop.w - h[i].output_column -
+					       h[i].output_width;
+			else
+				sout.crop.x += h[i].output_column;
+			sout.crop.w = h[i].output_width;
+			if (rotate & IPU_ROTATE_VERT_FLIP)
+				sout.crop.y += out->crop.h - v[j].output_column -
+					       v[j].output_width;
+			else
+				sout.crop.y += v[j].output_column;
+			sout.crop.h = v[j].output_width;
+
+			if (di) {
+				sprev = sin;
+				sprev.paddr = prev->paddr;
+				ret = ipu_task_vdi_pass(&sin, &sprev, &sout,
+						rotate, di,
+						(nh > 1) ? h[i].irr : 0,
+						(nv > 1) ? v[j].irr : 0);
+			} else
+				ret = ipu_task_pass(&sin, &sout, rotate,
+						    (nh > 1) ? h[i].irr : 0,
+						    (nv > 1) ? v[j].irr : 0,
+						    NULL);
+			if (ret < 0)
+				return ret;
+		}
+	}
+
+	return 0;
+}
+
+static int ipu_task_run(ipu_task *t)
+{
+	ipu_task_buf rot_buf;
+	bool rot = !ipu_can_rotate_in_place(t->rotate);
+	bool split;
+	size_t size;
+	int ret;
+
+	if (!rot) {
+		split = (t->output.crop.w > IPU_TASK_IC_MAX_WIDTH) ||
+			(t->output.crop.h > IPU_TASK_IC_MAX_HEIGHT);
+		if (split)
+			return ipu_task_stripes(&t->input, &t->output,
+						t->rotate, NULL, NULL);
+		return ipu_task_pass(&t->input, &t->output, t->rotate,
+				     0, 0, NULL);
+	}
+
+	/* the IC writes the unrotated frame, the rotator turns it into place */
+	memset(&rot_buf, 0, sizeof(rot_buf));
+	if (t->rotate >= IPU_ROTATE_90_RIGHT) {
+		rot_buf.width = t->output.crop.h;
+		rot_buf.height = t->output.crop.w;
+	} else {
+		rot_buf.width = t->output.crop.w;
+		rot_buf.height = t->output.crop.h;
+	}
+	rot_buf.format = t->output.format;
+	ipu_task_fix_crop(&rot_buf);
+
+	size = PAGE_ALIGN(rot_buf.width * rot_buf.height *
+			  bytes_per_pixel(rot_buf.format));
+	if (size > ipu_task_rot_size) {
+		if (ipu_task_rot_vaddr)
+			contig_free(ipu_task_rot_vaddr, ipu_task_rot_paddr,
+				    ipu_task_rot_size);
+		ipu_task_rot_size = 0;
+		ipu_task_rot_vaddr = contig_alloc(&ipu_task_rot_vaddr, size,
+						  &ipu_task_rot_paddr);
+		if (!ipu_task_rot_vaddr)
+			return -ENOMEM;
+		ipu_task_rot_size = size;
+	}
+	rot_buf.paddr = ipu_task_rot_paddr;
+
+	split = (rot_buf.width > IPU_TASK_IC_MAX_WIDTH) ||
+		(rot_buf.height > IPU_TASK_IC_MAX_HEIGHT);
+	if (!split)
+		return ipu_task_pass(&t->input, &t->output, t->rotate,
+				     0, 0, &rot_buf);
+
+	ret = ipu_task_stripes(&t->input, &rot_buf, IPU_ROTATE_NONE,
+			       NULL, NULL);
+	if (ret < 0)
+		return ret;
+	return ipu_task_rotate(&rot_buf, &t->output, t->rotate);
+}
+
+static int ipu_task_vdi_run(struct ipu_task_entry *entry)
+{
+	ipu_task *t = &entry->task;
+
+	if ((t->output.crop.w > IPU_TASK_IC_MAX_WIDTH) ||
+	    (t->output.crop.h > IPU_TASK_IC_MAX_HEIGHT))
+		return ipu_task_stripes(&t->input, &t->output, t->rotate,
+					&entry->di_prev, &entry->di);
+	return ipu_task_vdi_pass(&t->input, &entry->di_prev, &t->output,
+				 t->rotate, &entry->di, 0, 0);
+}
+
+static void ipu_task_worker(struct work_struct *work)
+{
+	struct ipu_task_entry *entry;
+	struct ipu_task_file *owner;
+	unsigned long flags;
+
+	for (;;) {
+		spin_lock_irqsave(&ipu_task_lock, flags);
+		if (list_empty(&ipu_task_list)) {
+			spin_unlock_irqrestore(&ipu_task_lock, flags);
+			break;
+		}
+		entry = list_first_entry(&ipu_task_list,
+					 struct ipu_task_entry, node);
+		list_del(&entry->node);
+		spin_unlock_irqrestore(&ipu_task_lock, flags);
+
+		if (entry->di.enable)
+			entry->task.status = ipu_task_vdi_run(entry);
+		else
+			entry->task.status = ipu_task_run(&entry->task);
+
+		/* wake under the lock, release() frees the owner once it can take it */
+		owner = entry->owner;
+		spin_lock_irqsave(&ipu_task_lock, flags);
+		list_add_tail(&entry->node, &owner->done);
+		owner->running--;
+		wake_up(&owner->waitq);
+		spin_unlock_irqrestore(&ipu_task_lock, flags);
+	}
+}
+
+static int ipu_queue_task(struct ipu_task_file *tf, ipu_task *t)
+{
+	struct ipu_task_entry *entry;
+	unsigned long flags;
+	int ret;
+
+	ret = ipu_task_check(t);
+	if ((ret == 0) && tf->di.enable)
+		ret = ipu_task_vdi_check(t);
+	if (ret < 0)
+		return ret;
+
+	entry = kzalloc(sizeof(*entry), GFP_KERNEL);
+	if (!entry)
+		return -ENOMEM;
+	entry->owner = tf;
+	entry->task = *t;
+	entry->task.status = 0;
+
+	spin_lock_irqsave(&ipu_task_lock, flags);
+	if (tf->outstanding >= IPU_TASK_MAX_PER_FILE) {
+		spin_unlock_irqrestore(&ipu_task_lock, flags);
+		kfree(entry);
+		return -EBUSY;
+	}
+	tf->outstanding++;
+	tf->running++;
+	if (tf->di.enable) {
+		/* the first frame or a new geometry has no usable previous field */
+		entry->di = tf->di;
+		entry->di_prev = t->input;
+		if (tf->di_last.paddr &&
+		    (tf->di_last.width == t->input.width) &&
+		    (tf->di_last.height == t->input.height) &&
+		    (tf->di_last.format == t->input.format) &&
+		    !memcmp(&tf->di_last.crop, &t->input.crop,
+			    sizeof(ipu_task_crop)))
+			entry->di_prev.paddr = tf->di_last.paddr;
+		tf->di_last = t->input;
+	}
+	list_add_tail(&entry->node, &ipu_task_list);
+	spin_unlock_irqrestore(&ipu_task_lock, flags);
+
+	queue_work(ipu_task_wq, &ipu_task_work);
+
+	return 0;
+}
+
+static struct ipu_task_entry *ipu_task_get_done(struct ipu_task_file *tf)
+{
+	struct ipu_task_entry *entry = NULL;
+	unsigned long flags;
+
+	spin_lock_irqsave(&ipu_task_lock, flags);
+	if (!list_empty(&tf->done)) {
+		entry = list_first_entry(&tf->done,
+					 struct ipu_task_entry, node);
+		list_del(&entry->node);
+		tf->outstanding--;
+	}
+	spin_unlock_irqrestore(&ipu_task_lock, flags);
+
+	return entry;
+}
+
+static int ipu_dequeue_task(struct file *file, ipu_task __user *arg)
+{
+	struct ipu_task_file *tf = file->private_data;
+	struct ipu_task_entry *entry;
+	int ret;
+
+	for (;;) {
+		entry = ipu_task_get_done(tf);
+		if (entry)
+			break;
+		if (file->f_flags & O_NONBLOCK)
+			return -EAGAIN;
+		ret = wait_event_interruptible(tf->waitq,
+					       !list_empty(&tf->done) ||
+					       !tf->outstanding);
+		if (ret < 0)
+			return ret;
+		if (!tf->outstanding)
+			return -ENODATA;
+	}
+
+	ret = copy_to_user(arg, &entry->task, sizeof(ipu_task)) ? -EFAULT : 0;
+	kfree(entry);
+
+	return ret;
+}
+
+static int mxc_ipu_open(struct inode *inode, struct file *file)
+{
+	struct ipu_task_file *tf;
+
+	tf = kzalloc(sizeof(*tf), GFP_KERNEL);
+	if (!tf)
+		return -ENOMEM;
+	INIT_LIST_HEAD(&tf->done);
+	init_waitqueue_head(&tf->waitq);
+	file->private_data = tf;
+
+	return 0;
+}
 static long mxc_ipu_ioctl(struct file *file,
 		unsigned int cmd, unsigned long arg)
 {
@@ -344,10 +1054,8 @@ static long mxc_ipu_ioctl(struct file *file,
 					 sizeof(ipu_mem_info)))
 				return -EFAULT;
 
-			info.vaddr = dma_alloc_coherent(0,
-					PAGE_ALIGN(info.size),
-					&info.paddr,
-					GFP_DMA | GFP_KERNEL);
+			info.vaddr = contig_alloc(file->private_data,
+					info.size, &info.paddr);
 			if (info.vaddr == 0) {
 				printk(KERN_ERR "dma alloc failed!\n");
 				return -ENOBUFS;
@@ -366,8 +1074,8 @@ static long mxc_ipu_ioctl(struct file *file,
 				return -EFAULT;
 
 			if (info.vaddr)
-				dma_free_coherent(0, PAGE_ALIGN(info.size),
-					info.vaddr, info.paddr);
+				ret = contig_free(info.vaddr, info.paddr,
+						  info.size);
 			else
 				return -EFAULT;
 		}
@@ -426,6 +1134,64 @@ static long mxc_ipu_ioctl(struct file *file,
 							offset_parm.horizontal_offset);
 		}
 		break;
+	case IPU_QUEUE_TASK:
+		{
+			ipu_task task;
+
+			if (copy_from_user(&task, (ipu_task *) arg,
+					   sizeof(ipu_task)))
+				return -EFAULT;
+			ret = ipu_queue_task(file->private_data, &task);
+		}
+		break;
+	case IPU_DEQUEUE_TASK:
+		ret = ipu_dequeue_task(file, (ipu_task __user *) arg);
+		break;
+	case IPU_SET_MMAP_CACHED:
+		{
+			struct ipu_task_file *tf = file->private_data;
+			uint32_t cached;
+
+			if (get_user(cached, (uint32_t __user *) arg))
+				return -EFAULT;
+			tf->mmap_cached = !!cached;
+		}
+		break;
+	case IPU_SET_DEINTERLACE:
+		{
+			struct ipu_task_file *tf = file->private_data;
+			ipu_deinterlace di;
+			unsigned long flags;
+
+			if (copy_from_user(&di, (ipu_deinterlace *) arg,
+					   sizeof(ipu_deinterlace)))
+				return -EFAULT;
+			if (di.enable &&
+			    ((di.motion > HIGH_MOTION) ||
+			     ((di.field_fmt != V4L2_FIELD_INTERLACED_TB) &&
+			      (di.field_fmt != V4L2_FIELD_INTERLACED_BT))))
+				return -EINVAL;
+			/* queued tasks keep their setup, the next one starts over */
+			spin_lock_irqsave(&ipu_task_lock, flags);
+			tf->di = di;
+			tf->di.enable = !!di.enable;
+			memset(&tf->di_last, 0, sizeof(tf->di_last));
+			spin_unlock_irqrestore(&ipu_task_lock, flags);
+		}
+		break;
+	case IPU_CPU_ACCESS_BEGIN:
+	case IPU_CPU_ACCESS_END:
+		{
+			ipu_cpu_access access;
+
+			if (copy_from_user(&access, (ipu_cpu_access *) arg,
+					   sizeof(ipu_cpu_access)))
+				return -EFAULT;
+			ret = contig_cpu_access(access.vaddr, access.size,
+					cmd == IPU_CPU_ACCESS_BEGIN,
+					access.flags & IPU_CPU_ACCESS_WRITE);
+		}
+		break;
 	case IPU_CSC_UPDATE:
 		{
 			int param[5][3];
@@ -447,7 +1213,10 @@ static long mxc_ipu_ioctl(struct file *file,
 
 static int mxc_ipu_mmap(struct file *file, struct vm_area_struct *vma)
 {
-	vma->vm_page_prot = pgprot_writecombine(vma->vm_page_prot);
+	struct ipu_task_file *tf = file->private_data;
+
+	if (!tf->mmap_cached)
+		vma->vm_page_prot = pgprot_writecombine(vma->vm_page_prot);
 
 	if (remap_pfn_range(vma, vma->vm_start, vma->vm_pgoff,
 				vma->vm_end - vma->vm_start,
@@ -459,8 +1228,54 @@ static int mxc_ipu_mmap(struct file *file, struct vm_area_struct *vma)
 	return 0;
 }
 
+static unsigned int mxc_ipu_poll(struct file *file, poll_table *wait)
+{
+	struct ipu_task_file *tf = file->private_data;
+	unsigned int mask = 0;
+	unsigned long flags;
+
+	poll_wait(file, &tf->waitq, wait);
+
+	spin_lock_irqsave(&ipu_task_lock, flags);
+	if (!list_empty(&tf->done))
+		mask |= POLLIN | POLLRDNORM;
+	spin_unlock_irqrestore(&ipu_task_lock, flags);
+
+	return mask;
+}
+
 static int mxc_ipu_release(struct inode *inode, struct file *file)
 {
+	struct ipu_task_file *tf = file->private_data;
+	struct ipu_task_entry *entry, *tmp;
+	unsigned long flags;
+	LIST_HEAD(done);
+
+	/* drop what has not started yet, then wait out the running one */
+	spin_lock_irqsave(&ipu_task_lock, flags);
+	list_for_each_entry_safe(entry, tmp, &ipu_task_list, node) {
+		if (entry->owner != tf)
+			continue;
+		list_move_tail(&entry->node, &tf->done);
+		tf->running--;
+	}
+	spin_unlock_irqrestore(&ipu_task_lock, flags);
+
+	wait_event(tf->waitq, !tf->running);
+
+	spin_lock_irqsave(&ipu_task_lock, flags);
+	list_splice_init(&tf->done, &done);
+	spin_unlock_irqrestore(&ipu_task_lock, flags);
+
+	list_for_each_entry_safe(entry, tmp, &done, node) {
+		list_del(&entry->node);
+		kfree(entry);
+	}
+
+	/* buffers from IPU_ALOC_MEM the client never freed */
+	contig_free_owner(tf);
+	kfree(tf);
+
 	return 0;
 }
 
@@ -475,6 +1290,7 @@ static struct file_operations mxc_ipu_fops = {
 	.owner = THIS_MODULE,
 	.open = mxc_ipu_open,
 	.mmap = mxc_ipu_mmap,
+	.poll = mxc_ipu_poll,
 	.release = mxc_ipu_release,
 	.unlocked_ioctl = mxc_ipu_ioctl,
 	.fsync = mxc_ipu_fsync
@@ -508,8 +1324,18 @@ int register_ipu_device()
 	}
 	spin_lock_init(&event_lock);
 
+	ipu_task_wq = create_singlethread_workqueue("ipu_task");
+	if (!ipu_task_wq) {
+		printk(KERN_ERR "Unable to create task queue for Mxc Ipu\n");
+		ret = -ENOMEM;
+		goto err3;
+	}
+	INIT_WORK(&ipu_task_work, ipu_task_worker);
+
 	return ret;
 
+err3:
+	device_destroy(mxc_ipu_class, MKDEV(mxc_ipu_major, 0));
 err2:
 	class_destroy(mxc_ipu_class);
 err1:
@@ -214,10 +214,15 @@ void _ipu_ic_init_prpvf(ipu_channel_params_t *params, bool src_is_csi)
 	ipu_color_space_t in_fmt, out_fmt;
 
 	/* Setup vertical resizing */
-	_calc_resize_coeffs(params->mem_prp_vf_mem.in_height,
-			    params->mem_prp_vf_mem.out_height,
-			    &resizeCoeff, &downsizeCoeff);
-	reg = (downsizeCoeff << 30) | (resizeCoeff << 16);
+	/* csi_prp_vf_mem has no ratio fields, don't read them through it */
+	if (src_is_csi || !(params->mem_prp_vf_mem.outv_resize_ratio)) {
+		_calc_resize_coeffs(params->mem_prp_vf_mem.in_height,
+				    params->mem_prp_vf_mem.out_height,
+				    &resizeCoeff, &downsizeCoeff);
+		reg = (downsizeCoeff << 30) | (resizeCoeff << 16);
+	} else {
+		reg = (params->mem_prp_vf_mem.outv_resize_ratio) << 16;
+	}
 
 	/* Setup horizontal resizing */
 	/* Upadeted for IC split case */
@@ -34,7 +34,14 @@
 #include <linux/clk.h>
 #include <linux/delay.h>
 #include <linux/workqueue.h>
+#include <linux/mutex.h>
 #include <linux/genalloc.h>
+#include <linux/contig_alloc.h>
+#include <linux/poll.h>
+#include <linux/sched.h>
+#include <linux/ktime.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include <asm/uaccess.h>
 #include <asm/io.h>
@@ -51,6 +58,30 @@ struct vpu_priv {
 	struct workqueue_struct *workqueue;
 };
 
+/* per open file, i.e. per codec instance */
+struct vpu_file {
+	bool mmap_cached;	/* later physmem mmaps are cached */
+
+	struct list_head list;	/* on vpu_files */
+	struct list_head wait;	/* on vpu_sched_wait while requesting */
+	wait_queue_head_t waitq;
+	int done;		/* interrupts routed here, not yet waited */
+	int priority;
+	int skipped;		/* grants that went elsewhere while waiting */
+	pid_t pid;
+	char comm[TASK_COMM_LEN];
+
+	/* a frame runs from the grant or the previous interrupt to the next */
+	ktime_t run_start;
+	u32 frames;
+	u32 frame_last_us;
+	u32 frame_max_us;
+	u64 busy_us;
+};
+
+/* a waiter gains one priority level per this many grants it was passed by */
+#define VPU_SCHED_AGING		4
+
 /* To track the allocated memory buffer */
 typedef struct memalloc_record {
 	struct list_head list;
@@ -62,9 +93,19 @@ struct iram_setting {
 	u32 end;
 };
 
-static DEFINE_SPINLOCK(vpu_lock);
+static DEFINE_MUTEX(vpu_lock);
 static LIST_HEAD(head);
 
+/* instance scheduling, see VPU_IOC_SCHED_REQUEST */
+static DEFINE_SPINLOCK(vpu_sched_lock);
+static LIST_HEAD(vpu_files);
+static LIST_HEAD(vpu_sched_wait);
+static struct vpu_file *vpu_owner;
+static u64 vpu_busy_us;
+static u64 vpu_busy_us_seen;
+static ktime_t vpu_stats_seen;
+static struct dentry *vpu_debugfs;
+
 static int vpu_major;
 static int vpu_clk_usercount;
 static struct class *vpu_class;
@@ -88,8 +129,12 @@ static struct gen_pool *vpu_pool;
 
 #define vpu_phys_to_virt(p) (vpu_reserved_virt + ((p) - vpu_reserved_phy))
 
-/* IRAM setting */
+/* IRAM setting, search ram is only held while the vpu is open */
 static struct iram_setting iram;
+static struct iram_client vpu_iram_client = {
+	.name = "vpu",
+	.priority = IRAM_PRIO_NORMAL,
+};
 
 /* implement the blocking ioctl */
 static int codec_done;
@@ -167,9 +212,8 @@ static int vpu_alloc_dma_buffer(struct vpu_mem_desc *mem, bool gen_pool)
 		pr_debug("vpu alloc - 0x%p/0x%p\n", (void*)mem->cpu_addr, (void*)mem->phy_addr);
 	} else {
 		mem->cpu_addr = (unsigned long)
-		    dma_alloc_coherent(NULL, PAGE_ALIGN(mem->size),
-				       (dma_addr_t *) (&mem->phy_addr),
-				       GFP_DMA | GFP_KERNEL);
+		    contig_alloc(&vpu_data, mem->size,
+				 (dma_addr_t *) (&mem->phy_addr));
 		pr_debug("[ALLOC] mem alloc cpu_addr = 0x%x\n", mem->cpu_addr);
 		pr_debug("vpu alloc - %dB@0x%p (0x%p)\n", mem->size, (void *)mem->cpu_addr, (void*)mem->phy_addr);
 		if ((void *)(mem->cpu_addr) == NULL) {
@@ -191,8 +235,8 @@ static void vpu_free_dma_buffer(struct vpu_mem_desc *mem, bool gen_pool)
 			gen_pool_free(vpu_pool, mem->cpu_addr, mem->size);
 	} else {
 		if (mem->cpu_addr != 0) {
-			dma_free_coherent(0, PAGE_ALIGN(mem->size),
-					  (void *)mem->cpu_addr, mem->phy_addr);
+			contig_free((void *)mem->cpu_addr, mem->phy_addr,
+				    mem->size);
 		}
 	}
 }
@@ -220,16 +264,76 @@ static int vpu_free_buffers(void)
 	return 0;
 }
 
+/*!
+ * Private function to hand the vpu to the most urgent waiter. Waiters are
+ * kept in request order, so equal priorities are served round robin and
+ * aging keeps low priorities from starving. Called with vpu_sched_lock.
+ */
+static void vpu_sched_next(void)
+{
+	struct vpu_file *vf, *best = NULL;
+
+	list_for_each_entry(vf, &vpu_sched_wait, wait) {
+		if (!best ||
+		    vf->priority + vf->skipped / VPU_SCHED_AGING >
+		    best->priority + best->skipped / VPU_SCHED_AGING)
+			best = vf;
+	}
+
+	vpu_owner = best;
+	if (!best)
+		return;
+
+	list_del_init(&best->wait);
+	list_for_each_entry(vf, &vpu_sched_wait, wait)
+		vf->skipped++;
+	best->skipped = 0;
+	best->run_start = ktime_get();
+	wake_up_interruptible(&best->waitq);
+}
+
+/*!
+ * Private function to charge a finished frame to its instance.
+ * Called with vpu_sched_lock.
+ */
+static void vpu_sched_account(struct vpu_file *vf)
+{
+	ktime_t now = ktime_get();
+	u32 us = (u32)ktime_us_delta(now, vf->run_start);
+
+	vf->run_start = now;
+	vf->frames++;
+	vf->frame_last_us = us;
+	if (us > vf->frame_max_us)
+		vf->frame_max_us = us;
+	vf->busy_us += us;
+	vpu_busy_us += us;
+}
+
 static inline void vpu_worker_callback(struct work_struct *w)
 {
 	struct vpu_priv *dev = container_of(w, struct vpu_priv,
 				work);
 
+	struct vpu_file *vf;
+
 	if (dev->async_queue)
 		kill_fasync(&dev->async_queue, SIGIO, POLL_IN);
 
-	codec_done = 1;
-	wake_up_interruptible(&vpu_queue);
+	/* the instance holding the vpu gets the interrupt, else everybody */
+	spin_lock(&vpu_sched_lock);
+	vf = vpu_owner;
+	if (vf) {
+		vpu_sched_account(vf);
+		vf->done = 1;
+		wake_up_interruptible(&vf->waitq);
+	}
+	spin_unlock(&vpu_sched_lock);
+
+	if (!vf) {
+		codec_done = 1;
+		wake_up_interruptible(&vpu_queue);
+	}
 
 	/*
 	 * Clock is gated on when dec/enc started, gate it off when
@@ -260,10 +364,33 @@ static irqreturn_t vpu_irq_handler(int irq, void *dev_id)
  */
 static int vpu_open(struct inode *inode, struct file *filp)
 {
-	spin_lock(&vpu_lock);
-	open_count++;
-	filp->private_data = (void *)(&vpu_data);
-	spin_unlock(&vpu_lock);
+	struct vpu_file *vf;
+
+	vf = kzalloc(sizeof(*vf), GFP_KERNEL);
+	if (!vf)
+		return -ENOMEM;
+
+	INIT_LIST_HEAD(&vf->wait);
+	init_waitqueue_head(&vf->waitq);
+	vf->pid = current->tgid;
+	get_task_comm(vf->comm, current);
+
+	spin_lock(&vpu_sched_lock);
+	list_add_tail(&vf->list, &vpu_files);
+	spin_unlock(&vpu_sched_lock);
+
+	mutex_lock(&vpu_lock);
+	if (!open_count++ && VPU_IRAM_SIZE) {
+		/* without it the library keeps search ram in external memory */
+		if (iram_request(&vpu_iram_client, VPU_IRAM_SIZE) == 0) {
+			iram.start = vpu_iram_client.dma_addr;
+			iram.end = iram.start + VPU_IRAM_SIZE - 1;
+		} else {
+			iram.start = iram.end = 0;
+		}
+	}
+	filp->private_data = vf;
+	mutex_unlock(&vpu_lock);
 	return 0;
 }
 
@@ -275,6 +402,7 @@ static int vpu_open(struct inode *inode, struct file *filp)
 static long vpu_ioctl(struct file *filp, u_int cmd,
 		     u_long arg)
 {
+	struct vpu_file *vf = filp->private_data;
 	int ret = 0;
 
 	switch (cmd) {
@@ -312,9 +440,9 @@ static long vpu_ioctl(struct file *filp, u_int cmd,
 				break;
 			}
 
-			spin_lock(&vpu_lock);
+			mutex_lock(&vpu_lock);
 			list_add(&rec->list, &head);
-			spin_unlock(&vpu_lock);
+			mutex_unlock(&vpu_lock);
 
 			break;
 		}
@@ -335,7 +463,7 @@ static long vpu_ioctl(struct file *filp, u_int cmd,
 				vpu_free_dma_buffer(&vpu_mem, true);
 			}
 
-			spin_lock(&vpu_lock);
+			mutex_lock(&vpu_lock);
 			list_for_each_entry_safe(rec, n, &head, list) {
 				if (rec->mem.cpu_addr == vpu_mem.cpu_addr) {
 					/* delete from list */
@@ -344,15 +472,24 @@ static long vpu_ioctl(struct file *filp, u_int cmd,
 					break;
 				}
 			}
-			spin_unlock(&vpu_lock);
+			mutex_unlock(&vpu_lock);
 
 			break;
 		}
 	case VPU_IOC_WAIT4INT:
 		{
 			u_long timeout = (u_long) arg;
+			wait_queue_head_t *wq = &vpu_queue;
+			int *done = &codec_done;
+
+			/* a scheduled instance only waits for its own */
+			if (vpu_owner == vf) {
+				wq = &vf->waitq;
+				done = &vf->done;
+			}
+
 			if (!wait_event_interruptible_timeout
-			    (vpu_queue, codec_done != 0,
+			    (*wq, *done != 0,
 			     msecs_to_jiffies(timeout))) {
 				printk(KERN_WARNING "VPU blocking: timeout.\n");
 				ret = -ETIME;
@@ -361,7 +498,7 @@ static long vpu_ioctl(struct file *filp, u_int cmd,
 				       "VPU interrupt received.\n");
 				ret = -ERESTARTSYS;
 			} else
-				codec_done = 0;
+				*done = 0;
 			break;
 		}
 	case VPU_IOC_IRAM_SETTING:
@@ -390,18 +527,18 @@ static long vpu_ioctl(struct file *filp, u_int cmd,
 		}
 	case VPU_IOC_GET_SHARE_MEM:
 		{
-			spin_lock(&vpu_lock);
+			mutex_lock(&vpu_lock);
 			if (share_mem.cpu_addr != 0) {
 				ret = copy_to_user((void __user *)arg,
 						   &share_mem,
 						   sizeof(struct vpu_mem_desc));
-				spin_unlock(&vpu_lock);
+				mutex_unlock(&vpu_lock);
 				break;
 			} else {
 				if (copy_from_user(&share_mem,
 						   (struct vpu_mem_desc *)arg,
 						 sizeof(struct vpu_mem_desc))) {
-					spin_unlock(&vpu_lock);
+					mutex_unlock(&vpu_lock);
 					return -EFAULT;
 				}
 				if (vpu_alloc_dma_buffer(&share_mem, false) == -1)
@@ -414,7 +551,7 @@ static long vpu_ioctl(struct file *filp, u_int cmd,
 						ret = -EFAULT;
 				}
 			}
-			spin_unlock(&vpu_lock);
+			mutex_unlock(&vpu_lock);
 			break;
 		}
 	case VPU_IOC_GET_WORK_ADDR:
@@ -448,6 +585,83 @@ static long vpu_ioctl(struct file *filp, u_int cmd,
 
 			break;
 		}
+	case VPU_IOC_SCHED_REQUEST:
+		{
+			struct vpu_sched_req req;
+
+			if (copy_from_user(&req, (struct vpu_sched_req *)arg,
+					   sizeof(struct vpu_sched_req)))
+				return -EFAULT;
+			if (req.priority > VPU_SCHED_PRIO_MAX)
+				return -EINVAL;
+			if (req.priority > VPU_SCHED_PRIO_NORMAL &&
+			    !capable(CAP_SYS_NICE))
+				return -EPERM;
+
+			spin_lock(&vpu_sched_lock);
+			if (vpu_owner != vf && list_empty(&vf->wait)) {
+				vf->priority = req.priority;
+				vf->skipped = 0;
+				list_add_tail(&vf->wait, &vpu_sched_wait);
+				if (!vpu_owner)
+					vpu_sched_next();
+			}
+			if (vpu_owner != vf && (req.flags & VPU_SCHED_NONBLOCK))
+				ret = -EAGAIN;
+			spin_unlock(&vpu_sched_lock);
+
+			if (ret || vpu_owner == vf)
+				break;
+
+			ret = wait_event_interruptible(vf->waitq,
+						       vpu_owner == vf);
+			if (ret) {
+				spin_lock(&vpu_sched_lock);
+				if (vpu_owner == vf)
+					ret = 0;
+				else
+					list_del_init(&vf->wait);
+				spin_unlock(&vpu_sched_lock);
+			}
+			break;
+		}
+	case VPU_IOC_SCHED_RELEASE:
+		{
+			spin_lock(&vpu_sched_lock);
+			if (vpu_owner == vf) {
+				vf->done = 0;
+				vpu_sched_next();
+			} else if (!list_empty(&vf->wait)) {
+				list_del_init(&vf->wait);
+			} else {
+				ret = -EINVAL;
+			}
+			spin_unlock(&vpu_sched_lock);
+			break;
+		}
+	case VPU_IOC_SET_MMAP_CACHED:
+		{
+			u32 cached;
+
+			if (get_user(cached, (u32 __user *) arg))
+				return -EFAULT;
+			vf->mmap_cached = !!cached;
+			break;
+		}
+	case VPU_IOC_CPU_ACCESS_BEGIN:
+	case VPU_IOC_CPU_ACCESS_END:
+		{
+			struct vpu_cpu_access access;
+
+			if (copy_from_user(&access,
+					   (struct vpu_cpu_access *)arg,
+					   sizeof(struct vpu_cpu_access)))
+				return -EFAULT;
+			ret = contig_cpu_access(access.virt_uaddr, access.size,
+					cmd == VPU_IOC_CPU_ACCESS_BEGIN,
+					access.flags & VPU_CPU_ACCESS_WRITE);
+			break;
+		}
 	case VPU_IOC_REG_DUMP:
 		break;
 	case VPU_IOC_PHYMEM_DUMP:
@@ -467,27 +681,69 @@ static long vpu_ioctl(struct file *filp, u_int cmd,
  */
 static int vpu_release(struct inode *inode, struct file *filp)
 {
-	spin_lock(&vpu_lock);
+	struct vpu_file *vf = filp->private_data;
+
+	spin_lock(&vpu_sched_lock);
+	list_del(&vf->list);
+	if (vpu_owner == vf)
+		vpu_sched_next();
+	else if (!list_empty(&vf->wait))
+		list_del(&vf->wait);
+	spin_unlock(&vpu_sched_lock);
+
+	mutex_lock(&vpu_lock);
 	if (open_count > 0 && !(--open_count)) {
 		vpu_free_buffers();
 
 		/* Free shared memory when vpu device is idle */
 		vpu_free_dma_buffer(&share_mem, false);
 		share_mem.cpu_addr = 0;
+
+		iram_release(&vpu_iram_client);
+		iram.start = iram.end = 0;
 	}
-	spin_unlock(&vpu_lock);
+	mutex_unlock(&vpu_lock);
+
+	kfree(vf);
 
 	return 0;
 }
 
+/*!
+ * @brief poll function for vpu file operation
+ *
+ * Readable when an interrupt is waiting for VPU_IOC_WAIT4INT, writable
+ * while this instance holds the vpu.
+ * @return  poll mask
+ */
+static unsigned int vpu_poll(struct file *filp, poll_table *wait)
+{
+	struct vpu_file *vf = filp->private_data;
+	unsigned int mask = 0;
+
+	poll_wait(filp, &vf->waitq, wait);
+	poll_wait(filp, &vpu_queue, wait);
+
+	spin_lock(&vpu_sched_lock);
+	if (vpu_owner == vf) {
+		if (vf->done)
+			mask |= POLLIN | POLLRDNORM;
+		mask |= POLLOUT | POLLWRNORM;
+	} else if (list_empty(&vf->wait) && codec_done) {
+		mask |= POLLIN | POLLRDNORM;
+	}
+	spin_unlock(&vpu_sched_lock);
+
+	return mask;
+}
+
 /*!
  * @brief fasync function for vpu file operation
  * @return  0 on success or negative error code on error
  */
 static int vpu_fasync(int fd, struct file *filp, int mode)
 {
-	struct vpu_priv *dev = (struct vpu_priv *)filp->private_data;
-	return fasync_helper(fd, filp, mode, &dev->async_queue);
+	return fasync_helper(fd, filp, mode, &vpu_data.async_queue);
 }
 
 /*!
@@ -521,7 +777,8 @@ static int vpu_map_mem(struct file *fp, struct vm_area_struct *vm)
 		 request_size);
 
 	vm->vm_flags |= VM_IO | VM_RESERVED;
-	vm->vm_page_prot = pgprot_writecombine(vm->vm_page_prot);
+	if (!((struct vpu_file *)fp->private_data)->mmap_cached)
+		vm->vm_page_prot = pgprot_writecombine(vm->vm_page_prot);
 
 	return remap_pfn_range(vm, vm->vm_start, vm->vm_pgoff,
 			       request_size, vm->vm_page_prot) ? -EAGAIN : 0;
@@ -547,6 +804,53 @@ struct file_operations vpu_fops = {
 	.release = vpu_release,
 	.fasync = vpu_fasync,
 	.mmap = vpu_mmap,
+	.poll = vpu_poll,
+};
+
+static int vpu_stats_show(struct seq_file *s, void *unused)
+{
+	struct vpu_file *vf;
+	ktime_t now = ktime_get();
+	u64 busy, window;
+
+	spin_lock(&vpu_sched_lock);
+
+	/* utilization since the previous read */
+	busy = vpu_busy_us - vpu_busy_us_seen;
+	window = ktime_us_delta(now, vpu_stats_seen);
+	vpu_busy_us_seen = vpu_busy_us;
+	vpu_stats_seen = now;
+	seq_printf(s, "busy: %llu us of %llu us (%llu%%)\n", busy, window,
+		   window ? div64_u64(busy * 100, window) : 0);
+	seq_printf(s, "owner: %d\n", vpu_owner ? vpu_owner->pid : 0);
+
+	seq_printf(s, "%6s %-16s %4s %-7s %8s %8s %8s %8s\n", "pid", "comm",
+		   "prio", "state", "frames", "last_us", "avg_us", "max_us");
+	list_for_each_entry(vf, &vpu_files, list) {
+		seq_printf(s, "%6d %-16s %4d %-7s %8u %8u %8llu %8u\n",
+			   vf->pid, vf->comm, vf->priority,
+			   vpu_owner == vf ? "running" :
+			   !list_empty(&vf->wait) ? "waiting" : "idle",
+			   vf->frames, vf->frame_last_us,
+			   vf->frames ? div_u64(vf->busy_us, vf->frames) : 0,
+			   vf->frame_max_us);
+	}
+
+	spin_unlock(&vpu_sched_lock);
+	return 0;
+}
+
+static int vpu_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, vpu_stats_show, inode->i_private);
+}
+
+static const struct file_operations vpu_stats_fops = {
+	.owner = THIS_MODULE,
+	.open = vpu_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
 };
 
 /*!
@@ -559,19 +863,9 @@ static int vpu_dev_probe(struct platform_device *pdev)
 	int err = 0;
 	struct device *temp_class;
 	struct resource *res;
-	unsigned long addr = 0;
 
 	vpu_plat = pdev->dev.platform_data;
 
-	if (VPU_IRAM_SIZE)
-		iram_alloc(VPU_IRAM_SIZE, &addr);
-
-	if (addr == 0)
-		iram.start = iram.end = 0;
-	else {
-		iram.start = addr;
-		iram.end = addr + VPU_IRAM_SIZE - 1;
-	}
 
 	res = platform_get_resource(pdev, IORESOURCE_MEM, 0);
 	if (!res) {
@@ -637,6 +931,14 @@ static int vpu_dev_probe(struct platform_device *pdev)
 
 	vpu_data.workqueue = create_workqueue("vpu_wq");
 	INIT_WORK(&vpu_data.work, vpu_worker_callback);
+
+	vpu_stats_seen = ktime_get();
+	vpu_debugfs = debugfs_create_file("mxc_vpu", S_IRUGO, NULL, NULL,
+					  &vpu_stats_fops);
+	iram.start = iram.end = 0;
+	if (VPU_IRAM_SIZE)
+		iram_client_register(&vpu_iram_client);
+
 	printk(KERN_INFO "VPU initialized\n");
 	goto out;
 
@@ -653,6 +955,7 @@ static int vpu_dev_probe(struct platform_device *pdev)
 
 static int vpu_dev_remove(struct platform_device *pdev)
 {
+	debugfs_remove(vpu_debugfs);
 	free_irq(vpu_irq, &vpu_data);
 	cancel_work_sync(&vpu_data.work);
 	flush_workqueue(vpu_data.workqueue);
@@ -661,7 +964,7 @@ static int vpu_dev_remove(struct platform_device *pdev)
 	iounmap(vpu_base);
 
 	if (VPU_IRAM_SIZE)
-		iram_free(iram.start, VPU_IRAM_SIZE);
+		iram_client_unregister(&vpu_iram_client);
 
 	return 0;
 }
@@ -37,6 +37,7 @@
 #include <linux/skbuff.h>
 #include <linux/spinlock.h>
 #include <linux/workqueue.h>
+#include <linux/hrtimer.h>
 #include <linux/bitops.h>
 #include <linux/io.h>
 #include <linux/irq.h>
@@ -102,22 +103,21 @@ MODULE_PARM_DESC(macaddr, "FEC Ethernet MAC address");
 #endif
 #endif /* CONFIG_M5272 */
 
-/* The number of Tx and Rx buffers.  These are allocated from the page
- * pool.  The code may assume these are power of two, so it it best
- * to keep them that size.
- * We don't need to allocate pages for the transmitter.  We just use
- * the skbuffer directly.
+/* The number of Tx and Rx buffers.  Every Rx descriptor owns an skb the
+ * controller receives into, which goes up the stack as is above
+ * rx_copybreak; Tx sends from the skb itself when it is aligned.  Both rings share the descriptor
+ * page, their sizes can be changed with ethtool -G while the interface
+ * is down.
  */
-#define FEC_ENET_RX_PAGES	8
 #define FEC_ENET_RX_FRSIZE	2048
-#define FEC_ENET_RX_FRPPG	(PAGE_SIZE / FEC_ENET_RX_FRSIZE)
-#define RX_RING_SIZE		(FEC_ENET_RX_FRPPG * FEC_ENET_RX_PAGES)
 #define FEC_ENET_TX_FRSIZE	2048
-#define FEC_ENET_TX_FRPPG	(PAGE_SIZE / FEC_ENET_TX_FRSIZE)
-#define TX_RING_SIZE		16	/* Must be power of two */
-#define TX_RING_MOD_MASK	15	/*   for this to work */
+#define FEC_RX_RING_DEFAULT	64
+#define FEC_TX_RING_DEFAULT	64
+#define FEC_RING_MIN		8
+#define FEC_RX_RING_MAX		256
+#define FEC_TX_RING_MAX		256
 
-#if (((RX_RING_SIZE + TX_RING_SIZE) * 8) > PAGE_SIZE)
+#if (((FEC_RX_RING_MAX + FEC_TX_RING_MAX) * 8) > PAGE_SIZE)
 #error "FEC: descriptor ring size constants too large"
 #endif
 
@@ -134,6 +134,12 @@ MODULE_PARM_DESC(macaddr, "FEC Ethernet MAC address");
 #define FEC_ENET_EBERR	((uint)0x00400000)	/* SDMA bus error */
 
 #define FEC_DEFAULT_IMASK (FEC_ENET_TXF | FEC_ENET_RXF | FEC_ENET_MII)
+/* While NAPI polls the rings only MII completions interrupt */
+#define FEC_NAPI_IMASK	FEC_ENET_MII
+
+#define FEC_NAPI_WEIGHT		64
+/* Longer holdoffs would let a burst of small frames overrun the rx ring */
+#define FEC_MAX_COALESCE_USECS	100
 
 /* The FEC stores dest/src/type, data, and checksum for receive packets.
  */
@@ -141,6 +147,16 @@ MODULE_PARM_DESC(macaddr, "FEC Ethernet MAC address");
 #define PKT_MINBUF_SIZE		64
 #define PKT_MAXBLR_SIZE		1520
 
+/*
+ * Frames up to rx_copybreak bytes are copied into an IP aligned skb and the
+ * ring skb stays in place. The FEC only receives into 16 byte aligned
+ * buffers, so a ring skb handed up has its IP header 2 bytes off and the
+ * stack takes unaligned accesses on it. By default every frame is copied;
+ * lower the limit only where that has been measured to be cheaper.
+ */
+static int rx_copybreak = PKT_MAXBUF_SIZE;
+module_param(rx_copybreak, int, 0644);
+MODULE_PARM_DESC(rx_copybreak, "Copy rx frames up to this size (bytes)");
 
 /*
  * The 5270/5271/5280/5282/532x RX control register also contains maximum frame
@@ -172,11 +188,11 @@ struct fec_enet_private {
 	struct clk *clk;
 
 	/* The saved address of a sent-in-place packet/buffer, for skfree(). */
-	unsigned char *tx_bounce[TX_RING_SIZE];
-	struct	sk_buff* tx_skbuff[TX_RING_SIZE];
-	struct	sk_buff* rx_skbuff[RX_RING_SIZE];
-	ushort	skb_cur;
-	ushort	skb_dirty;
+	unsigned char *tx_bounce[FEC_TX_RING_MAX];
+	struct	sk_buff* tx_skbuff[FEC_TX_RING_MAX];
+	struct	sk_buff* rx_skbuff[FEC_RX_RING_MAX];
+	int	rx_ring_size;
+	int	tx_ring_size;
 
 	/* CPM dual port RAM relative addresses */
 	dma_addr_t	bd_dma;
@@ -189,7 +205,8 @@ struct fec_enet_private {
 	struct bufdesc	*dirty_tx;
 
 	uint	tx_full;
-	/* hold while accessing the HW like ringbuffer for tx/rx but not MAC */
+	/* hold while accessing the HW like ringbuffer for tx but not MAC,
+	 * the rx ring is only touched from the NAPI poll */
 	spinlock_t hw_lock;
 
 	struct  platform_device *pdev;
@@ -205,11 +222,16 @@ struct fec_enet_private {
 	int	link;
 	int	full_duplex;
 	struct	completion mdio_done;
+
+	struct	napi_struct napi;
+	/* rx/tx interrupts stay masked this long after a poll that did work */
+	struct	hrtimer coalesce_timer;
+	u32	rx_coalesce_usecs;
 };
 
 static irqreturn_t fec_enet_interrupt(int irq, void * dev_id);
 static void fec_enet_tx(struct net_device *dev);
-static void fec_enet_rx(struct net_device *dev);
+static int fec_enet_rx(struct net_device *dev, int budget);
 static int fec_enet_close(struct net_device *dev);
 static void fec_restart(struct net_device *dev, int duplex);
 static void fec_stop(struct net_device *dev);
@@ -249,6 +271,7 @@ fec_enet_start_xmit(struct sk_buff *skb, struct net_device *dev)
 	void *bufaddr;
 	unsigned short	status;
 	unsigned long flags;
+	unsigned int index;
 
 	if (!fep->link) {
 		/* Link is down or autonegotiation is in progress. */
@@ -276,38 +299,38 @@ fec_enet_start_xmit(struct sk_buff *skb, struct net_device *dev)
 	/* Set buffer length and buffer pointer */
 	bufaddr = skb->data;
 	bdp->cbd_datlen = skb->len;
+	index = bdp - fep->tx_bd_base;
 
 	/*
 	 * On some FEC implementations data must be aligned on
 	 * 4-byte boundaries. Use bounce buffers to copy data
 	 * and get it aligned. Ugh.
-	 */
-	if (((unsigned long) bufaddr) & FEC_ALIGNMENT) {
-		unsigned int index;
-		index = bdp - fep->tx_bd_base;
-		memcpy(fep->tx_bounce[index], (void *)skb->data, skb->len);
-		bufaddr = fep->tx_bounce[index];
-	}
-
-	/*
+	 *
 	 * Some design made an incorrect assumption on endian mode of
 	 * the system that it's running on. As the result, driver has to
 	 * swap every frame going to and coming from the controller.
+	 * That is done on the bounce copy too, the skb may be shared.
+	 *
+	 * Anything else goes out of the skb data as is.
 	 */
-	if (id_entry->driver_data & FEC_QUIRK_SWAP_FRAME)
-		swap_buffer(bufaddr, skb->len);
+	if ((((unsigned long) bufaddr) & FEC_ALIGNMENT) ||
+	    (id_entry->driver_data & FEC_QUIRK_SWAP_FRAME)) {
+		memcpy(fep->tx_bounce[index], (void *)skb->data, skb->len);
+		bufaddr = fep->tx_bounce[index];
+		if (id_entry->driver_data & FEC_QUIRK_SWAP_FRAME)
+			swap_buffer(bufaddr, skb->len);
+	}
 
 	/* Save skb pointer */
-	fep->tx_skbuff[fep->skb_cur] = skb;
+	fep->tx_skbuff[index] = skb;
 
 	dev->stats.tx_bytes += skb->len;
-	fep->skb_cur = (fep->skb_cur+1) & TX_RING_MOD_MASK;
 
 	/* Push the data cache so the CPM does not get stale memory
 	 * data.
 	 */
 	bdp->cbd_bufaddr = dma_map_single(&dev->dev, bufaddr,
-			FEC_ENET_TX_FRSIZE, DMA_TO_DEVICE);
+			skb->len, DMA_TO_DEVICE);
 
 	/* Send it on its way.  Tell FEC it's ready, interrupt when done,
 	 * it's the last BD of the frame, and to put the CRC on the end.
@@ -357,21 +380,18 @@ fec_enet_interrupt(int irq, void * dev_id)
 	irqreturn_t ret = IRQ_NONE;
 
 	do {
-		int_events = readl(fep->hwp + FEC_IEVENT);
+		/* Leave masked events pending, the poll loop acks those */
+		int_events = readl(fep->hwp + FEC_IEVENT) &
+			     readl(fep->hwp + FEC_IMASK);
 		writel(int_events, fep->hwp + FEC_IEVENT);
 
-		if (int_events & FEC_ENET_RXF) {
-			ret = IRQ_HANDLED;
-			fec_enet_rx(dev);
-		}
-
-		/* Transmit OK, or non-fatal error. Update the buffer
-		 * descriptors. FEC handles all errors, we just discover
-		 * them as part of the transmit process.
+		/* Received frames and transmit completions, good or bad,
+		 * are handled by fec_enet_rx_napi() with both masked.
 		 */
-		if (int_events & FEC_ENET_TXF) {
+		if (int_events & (FEC_ENET_RXF | FEC_ENET_TXF)) {
 			ret = IRQ_HANDLED;
-			fec_enet_tx(dev);
+			writel(FEC_NAPI_IMASK, fep->hwp + FEC_IMASK);
+			napi_schedule(&fep->napi);
 		}
 
 		if (int_events & FEC_ENET_MII) {
@@ -391,19 +411,23 @@ fec_enet_tx(struct net_device *dev)
 	struct bufdesc *bdp;
 	unsigned short status;
 	struct	sk_buff	*skb;
+	unsigned long flags;
+	unsigned int index;
 
 	fep = netdev_priv(dev);
-	spin_lock(&fep->hw_lock);
+	spin_lock_irqsave(&fep->hw_lock, flags);
 	bdp = fep->dirty_tx;
 
 	while (((status = bdp->cbd_sc) & BD_ENET_TX_READY) == 0) {
 		if (bdp == fep->cur_tx && fep->tx_full == 0)
 			break;
 
-		dma_unmap_single(&dev->dev, bdp->cbd_bufaddr, FEC_ENET_TX_FRSIZE, DMA_TO_DEVICE);
+		dma_unmap_single(&dev->dev, bdp->cbd_bufaddr, bdp->cbd_datlen,
+				 DMA_TO_DEVICE);
 		bdp->cbd_bufaddr = 0;
 
-		skb = fep->tx_skbuff[fep->skb_dirty];
+		index = bdp - fep->tx_bd_base;
+		skb = fep->tx_skbuff[index];
 		/* Check for errors. */
 		if (status & (BD_ENET_TX_HB | BD_ENET_TX_LC |
 				   BD_ENET_TX_RL | BD_ENET_TX_UN |
@@ -434,8 +458,7 @@ fec_enet_tx(struct net_device *dev)
 
 		/* Free the sk buffer associated with this last transmit */
 		dev_kfree_skb_any(skb);
-		fep->tx_skbuff[fep->skb_dirty] = NULL;
-		fep->skb_dirty = (fep->skb_dirty + 1) & TX_RING_MOD_MASK;
+		fep->tx_skbuff[index] = NULL;
 
 		/* Update pointer to next buffer descriptor to be transmitted */
 		if (status & BD_ENET_TX_WRAP)
@@ -452,7 +475,7 @@ fec_enet_tx(struct net_device *dev)
 		}
 	}
 	fep->dirty_tx = bdp;
-	spin_unlock(&fep->hw_lock);
+	spin_unlock_irqrestore(&fep->hw_lock, flags);
 }
 
 
@@ -460,31 +483,38 @@ fec_enet_tx(struct net_device *dev)
  * When we update through the ring, if the next incoming buffer has
  * not been given to the system, we just set the empty indicator,
  * effectively tossing the packet.
+ * At most budget descriptors are handled, the count is returned.
  */
-static void
-fec_enet_rx(struct net_device *dev)
+static int
+fec_enet_rx(struct net_device *dev, int budget)
 {
 	struct	fec_enet_private *fep = netdev_priv(dev);
 	const struct platform_device_id *id_entry =
 				platform_get_device_id(fep->pdev);
 	struct bufdesc *bdp;
 	unsigned short status;
-	struct	sk_buff	*skb;
+	struct	sk_buff	*skb, *new_skb;
 	ushort	pkt_len;
 	__u8 *data;
+	int	pkt_received = 0;
+	unsigned int index;
 
 #ifdef CONFIG_M532x
 	flush_cache_all();
 #endif
 
-	spin_lock(&fep->hw_lock);
+	/* No hw_lock: only the NAPI poll touches the rx ring, and the stack
+	 * may transmit, which takes it, from napi_gro_receive().
+	 */
 
 	/* First, grab all of the stats for the incoming packet.
 	 * These get messed up if we get called due to a busy condition.
 	 */
 	bdp = fep->cur_rx;
 
-	while (!((status = bdp->cbd_sc) & BD_ENET_RX_EMPTY)) {
+	while (pkt_received < budget &&
+	       !((status = bdp->cbd_sc) & BD_ENET_RX_EMPTY)) {
+		pkt_received++;
 
 		/* Since we have allocated space to hold a complete frame,
 		 * the last indicator should be set.
@@ -525,35 +555,61 @@ fec_enet_rx(struct net_device *dev)
 		dev->stats.rx_packets++;
 		pkt_len = bdp->cbd_datlen;
 		dev->stats.rx_bytes += pkt_len;
-		data = (__u8*)__va(bdp->cbd_bufaddr);
+		index = bdp - fep->rx_bd_base;
+		data = fep->rx_skbuff[index]->data;
 
-	        dma_unmap_single(NULL, bdp->cbd_bufaddr, bdp->cbd_datlen,
-        			DMA_FROM_DEVICE);
+		dma_sync_single_for_cpu(&dev->dev, bdp->cbd_bufaddr, pkt_len,
+					DMA_FROM_DEVICE);
 
 		if (id_entry->driver_data & FEC_QUIRK_SWAP_FRAME)
 			swap_buffer(data, pkt_len);
 
-		/* This does 16 byte alignment, exactly what we need.
-		 * The packet length includes FCS, but we don't want to
+		/* The packet length includes FCS, but we don't want to
 		 * include that when passing upstream as it messes up
 		 * bridging applications.
+		 *
+		 * Frames up to rx_copybreak are copied into an IP aligned
+		 * skb, larger ones go up in the ring skb which a new one
+		 * replaces.
 		 */
-		skb = dev_alloc_skb(pkt_len - 4 + NET_IP_ALIGN);
+		skb = NULL;
+		new_skb = NULL;
+		if (pkt_len - 4 <= rx_copybreak) {
+			skb = dev_alloc_skb(pkt_len - 4 + NET_IP_ALIGN);
+			if (skb) {
+				skb_reserve(skb, NET_IP_ALIGN);
+				skb_copy_to_linear_data(skb, data,
+							pkt_len - 4);
+			}
+		} else {
+			new_skb = dev_alloc_skb(FEC_ENET_RX_FRSIZE);
+			if (new_skb) {
+				dma_unmap_single(&dev->dev, bdp->cbd_bufaddr,
+						 FEC_ENET_RX_FRSIZE,
+						 DMA_FROM_DEVICE);
+				skb = fep->rx_skbuff[index];
+				fep->rx_skbuff[index] = new_skb;
+				bdp->cbd_bufaddr = dma_map_single(&dev->dev,
+						new_skb->data,
+						FEC_ENET_RX_FRSIZE,
+						DMA_FROM_DEVICE);
+			}
+		}
+
+		/* The buffer stays in the ring, give it back to the FEC */
+		if (!new_skb)
+			dma_sync_single_for_device(&dev->dev, bdp->cbd_bufaddr,
+						   pkt_len, DMA_FROM_DEVICE);
 
 		if (unlikely(!skb)) {
 			printk("%s: Memory squeeze, dropping packet.\n",
 					dev->name);
 			dev->stats.rx_dropped++;
 		} else {
-			skb_reserve(skb, NET_IP_ALIGN);
 			skb_put(skb, pkt_len - 4);	/* Make room */
-			skb_copy_to_linear_data(skb, data, pkt_len - 4);
 			skb->protocol = eth_type_trans(skb, dev);
-			netif_rx(skb);
+			napi_gro_receive(&fep->napi, skb);
 		}
-
-        	bdp->cbd_bufaddr = dma_map_single(NULL, data, bdp->cbd_datlen,
-			DMA_FROM_DEVICE);
 rx_processing_done:
 		/* Clear the status flags for this buffer */
 		status &= ~BD_ENET_RX_STATS;
@@ -575,7 +631,52 @@ rx_processing_done:
 	}
 	fep->cur_rx = bdp;
 
-	spin_unlock(&fep->hw_lock);
+	return pkt_received;
+}
+
+/*
+ * NAPI poll: reap transmit completions, then receive up to budget frames.
+ * Once the ring is drained the rx/tx interrupts come back, straight away
+ * or, with rx coalescing set, after the holdoff; the timer polls again
+ * first so frames that arrived meanwhile are taken in one batch.
+ */
+static int
+fec_enet_rx_napi(struct napi_struct *napi, int budget)
+{
+	struct fec_enet_private *fep =
+		container_of(napi, struct fec_enet_private, napi);
+	struct net_device *dev = fep->netdev;
+	int pkts;
+
+	/* Ack before looking at the rings, later frames stay pending */
+	writel(FEC_ENET_RXF | FEC_ENET_TXF, fep->hwp + FEC_IEVENT);
+
+	fec_enet_tx(dev);
+	pkts = fec_enet_rx(dev, budget);
+
+	if (pkts < budget) {
+		napi_complete(napi);
+		if (pkts && fep->rx_coalesce_usecs)
+			hrtimer_start(&fep->coalesce_timer,
+				ns_to_ktime(fep->rx_coalesce_usecs *
+					    NSEC_PER_USEC),
+				HRTIMER_MODE_REL);
+		else
+			writel(FEC_DEFAULT_IMASK, fep->hwp + FEC_IMASK);
+	}
+
+	return pkts;
+}
+
+static enum hrtimer_restart
+fec_enet_coalesce_timer(struct hrtimer *timer)
+{
+	struct fec_enet_private *fep =
+		container_of(timer, struct fec_enet_private, coalesce_timer);
+
+	napi_schedule(&fep->napi);
+
+	return HRTIMER_NORESTART;
 }
 
 /* ------------------------------------------------------------------------- */
@@ -908,11 +1009,83 @@ static void fec_enet_get_drvinfo(struct net_device *dev,
 	strcpy(info->bus_info, dev_name(&dev->dev));
 }
 
+/*
+ * The FEC has no interrupt coalescing registers, so rx-usecs is done in
+ * software: after a poll that found frames, rx/tx interrupts stay masked
+ * for that long and the rings are polled again from a timer.
+ */
+static int fec_enet_get_coalesce(struct net_device *dev,
+				 struct ethtool_coalesce *ec)
+{
+	struct fec_enet_private *fep = netdev_priv(dev);
+
+	memset(ec, 0, sizeof(*ec));
+	ec->rx_coalesce_usecs = fep->rx_coalesce_usecs;
+
+	return 0;
+}
+
+static int fec_enet_set_coalesce(struct net_device *dev,
+				 struct ethtool_coalesce *ec)
+{
+	struct fec_enet_private *fep = netdev_priv(dev);
+
+	if (ec->rx_coalesce_usecs > FEC_MAX_COALESCE_USECS)
+		return -EINVAL;
+	if (ec->rx_max_coalesced_frames || ec->tx_coalesce_usecs ||
+	    ec->tx_max_coalesced_frames || ec->use_adaptive_rx_coalesce ||
+	    ec->use_adaptive_tx_coalesce)
+		return -EOPNOTSUPP;
+
+	fep->rx_coalesce_usecs = ec->rx_coalesce_usecs;
+
+	return 0;
+}
+
+static void fec_enet_get_ringparam(struct net_device *dev,
+				   struct ethtool_ringparam *ring)
+{
+	struct fec_enet_private *fep = netdev_priv(dev);
+
+	memset(ring, 0, sizeof(*ring));
+	ring->rx_max_pending = FEC_RX_RING_MAX;
+	ring->tx_max_pending = FEC_TX_RING_MAX;
+	ring->rx_pending = fep->rx_ring_size;
+	ring->tx_pending = fep->tx_ring_size;
+}
+
+/* The rings are laid out again on the next open, so only while down */
+static int fec_enet_set_ringparam(struct net_device *dev,
+				  struct ethtool_ringparam *ring)
+{
+	struct fec_enet_private *fep = netdev_priv(dev);
+
+	if (netif_running(dev))
+		return -EBUSY;
+	if (ring->rx_mini_pending || ring->rx_jumbo_pending)
+		return -EINVAL;
+	if ((ring->rx_pending < FEC_RING_MIN) ||
+	    (ring->rx_pending > FEC_RX_RING_MAX) ||
+	    (ring->tx_pending < FEC_RING_MIN) ||
+	    (ring->tx_pending > FEC_TX_RING_MAX))
+		return -EINVAL;
+
+	fep->rx_ring_size = ring->rx_pending;
+	fep->tx_ring_size = ring->tx_pending;
+	fep->tx_bd_base = fep->rx_bd_base + fep->rx_ring_size;
+
+	return 0;
+}
+
 static struct ethtool_ops fec_enet_ethtool_ops = {
 	.get_settings		= fec_enet_get_settings,
 	.set_settings		= fec_enet_set_settings,
 	.get_drvinfo		= fec_enet_get_drvinfo,
 	.get_link		= ethtool_op_get_link,
+	.get_coalesce		= fec_enet_get_coalesce,
+	.set_coalesce		= fec_enet_set_coalesce,
+	.get_ringparam		= fec_enet_get_ringparam,
+	.set_ringparam		= fec_enet_set_ringparam,
 };
 
 static int fec_enet_ioctl(struct net_device *dev, struct ifreq *rq, int cmd)
@@ -937,20 +1110,23 @@ static void fec_enet_free_buffers(struct net_device *dev)
 	struct bufdesc	*bdp;
 
 	bdp = fep->rx_bd_base;
-	for (i = 0; i < RX_RING_SIZE; i++) {
+	for (i = 0; i < fep->rx_ring_size; i++) {
 		skb = fep->rx_skbuff[i];
 
 		if (bdp->cbd_bufaddr)
 			dma_unmap_single(&dev->dev, bdp->cbd_bufaddr,
 					FEC_ENET_RX_FRSIZE, DMA_FROM_DEVICE);
+		bdp->cbd_bufaddr = 0;
 		if (skb)
 			dev_kfree_skb(skb);
+		fep->rx_skbuff[i] = NULL;
 		bdp++;
 	}
 
-	bdp = fep->tx_bd_base;
-	for (i = 0; i < TX_RING_SIZE; i++)
+	for (i = 0; i < fep->tx_ring_size; i++) {
 		kfree(fep->tx_bounce[i]);
+		fep->tx_bounce[i] = NULL;
+	}
 }
 
 static int fec_enet_alloc_buffers(struct net_device *dev)
@@ -961,7 +1137,7 @@ static int fec_enet_alloc_buffers(struct net_device *dev)
 	struct bufdesc	*bdp;
 
 	bdp = fep->rx_bd_base;
-	for (i = 0; i < RX_RING_SIZE; i++) {
+	for (i = 0; i < fep->rx_ring_size; i++) {
 		skb = dev_alloc_skb(FEC_ENET_RX_FRSIZE);
 		if (!skb) {
 			fec_enet_free_buffers(dev);
@@ -980,8 +1156,12 @@ static int fec_enet_alloc_buffers(struct net_device *dev)
 	bdp->cbd_sc |= BD_SC_WRAP;
 
 	bdp = fep->tx_bd_base;
-	for (i = 0; i < TX_RING_SIZE; i++) {
+	for (i = 0; i < fep->tx_ring_size; i++) {
 		fep->tx_bounce[i] = kmalloc(FEC_ENET_TX_FRSIZE, GFP_KERNEL);
+		if (!fep->tx_bounce[i]) {
+			fec_enet_free_buffers(dev);
+			return -ENOMEM;
+		}
 
 		bdp->cbd_sc = 0;
 		bdp->cbd_bufaddr = 0;
@@ -1015,6 +1195,7 @@ fec_enet_open(struct net_device *dev)
 		fec_enet_free_buffers(dev);
 		return ret;
 	}
+	napi_enable(&fep->napi);
 	phy_start(fep->phy_dev);
 	netif_start_queue(dev);
 	fep->opened = 1;
@@ -1029,6 +1210,8 @@ fec_enet_close(struct net_device *dev)
 	/* Don't know what to do yet. */
 	fep->opened = 0;
 	netif_stop_queue(dev);
+	napi_disable(&fep->napi);
+	hrtimer_cancel(&fep->coalesce_timer);
 	fec_stop(dev);
 
 	if (fep->phy_dev)
@@ -1178,17 +1361,23 @@ static int fec_enet_init(struct net_device *dev)
 	fec_get_mac(dev);
 
 	/* Set receive and transmit descriptor base. */
+	fep->rx_ring_size = FEC_RX_RING_DEFAULT;
+	fep->tx_ring_size = FEC_TX_RING_DEFAULT;
 	fep->rx_bd_base = cbd_base;
-	fep->tx_bd_base = cbd_base + RX_RING_SIZE;
+	fep->tx_bd_base = cbd_base + fep->rx_ring_size;
 
 	/* The FEC Ethernet specific entries in the device structure */
 	dev->watchdog_timeo = TX_TIMEOUT;
 	dev->netdev_ops = &fec_netdev_ops;
 	dev->ethtool_ops = &fec_enet_ethtool_ops;
 
+	netif_napi_add(dev, &fep->napi, fec_enet_rx_napi, FEC_NAPI_WEIGHT);
+	hrtimer_init(&fep->coalesce_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	fep->coalesce_timer.function = fec_enet_coalesce_timer;
+
 	/* Initialize the receive buffer descriptors. */
 	bdp = fep->rx_bd_base;
-	for (i = 0; i < RX_RING_SIZE; i++) {
+	for (i = 0; i < fep->rx_ring_size; i++) {
 
 		/* Initialize the BD for every fragment in the page. */
 		bdp->cbd_sc = 0;
@@ -1201,7 +1390,7 @@ static int fec_enet_init(struct net_device *dev)
 
 	/* ...and the same for transmit */
 	bdp = fep->tx_bd_base;
-	for (i = 0; i < TX_RING_SIZE; i++) {
+	for (i = 0; i < fep->tx_ring_size; i++) {
 
 		/* Initialize the BD for every fragment in the page. */
 		bdp->cbd_sc = 0;
@@ -1261,15 +1450,22 @@ fec_restart(struct net_device *dev, int duplex)
 
 	/* Set receive and transmit descriptor base. */
 	writel(fep->bd_dma, fep->hwp + FEC_R_DES_START);
-	writel((unsigned long)fep->bd_dma + sizeof(struct bufdesc) * RX_RING_SIZE,
+	writel((unsigned long)fep->bd_dma +
+			sizeof(struct bufdesc) * fep->rx_ring_size,
 			fep->hwp + FEC_X_DES_START);
 
 	fep->dirty_tx = fep->cur_tx = fep->tx_bd_base;
 	fep->cur_rx = fep->rx_bd_base;
 
 	/* Reset SKB transmit buffers. */
-	fep->skb_cur = fep->skb_dirty = 0;
-	for (i = 0; i <= TX_RING_MOD_MASK; i++) {
+	for (i = 0; i < fep->tx_ring_size; i++) {
+		struct bufdesc *bdp = fep->tx_bd_base + i;
+
+		if (bdp->cbd_bufaddr) {
+			dma_unmap_single(&dev->dev, bdp->cbd_bufaddr,
+					 bdp->cbd_datlen, DMA_TO_DEVICE);
+			bdp->cbd_bufaddr = 0;
+		}
 		if (fep->tx_skbuff[i]) {
 			dev_kfree_skb_any(fep->tx_skbuff[i]);
 			fep->tx_skbuff[i] = NULL;
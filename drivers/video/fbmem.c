@@ -21,6 +21,7 @@
 #include <linux/slab.h>
 #include <linux/mm.h>
 #include <linux/mman.h>
+#include <linux/poll.h>
 #include <linux/vt.h>
 #include <linux/init.h>
 #include <linux/linux_logo.h>
@@ -1404,6 +1405,17 @@ __releases(&info->lock)
 	return 0;
 }
 
+static unsigned int
+fb_poll(struct file *file, poll_table *wait)
+{
+	int fbidx = iminor(file->f_path.dentry->d_inode);
+	struct fb_info *info = registered_fb[fbidx];
+
+	if (!info || !info->fbops->fb_poll)
+		return DEFAULT_POLLMASK;
+	return info->fbops->fb_poll(info, file, wait);
+}
+
 static const struct file_operations fb_fops = {
 	.owner =	THIS_MODULE,
 	.read =		fb_read,
@@ -1413,6 +1425,7 @@ static const struct file_operations fb_fops = {
 	.compat_ioctl = fb_compat_ioctl,
 #endif
 	.mmap =		fb_mmap,
+	.poll =		fb_poll,
 	.open =		fb_open,
 	.release =	fb_release,
 #ifdef HAVE_ARCH_FB_UNMAPPED_AREA
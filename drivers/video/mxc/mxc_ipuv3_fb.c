@@ -41,11 +41,13 @@
 #include <linux/dma-mapping.h>
 #include <linux/clk.h>
 #include <linux/console.h>
+#include <linux/poll.h>
 #include <linux/io.h>
 #include <linux/ipu.h>
 #include <linux/mxcfb.h>
 #include <linux/uaccess.h>
 #include <linux/fsl_devices.h>
+#include <linux/contig_alloc.h>
 #include <asm/mach-types.h>
 #include <mach/ipu-v3.h>
 
@@ -56,9 +58,18 @@
 
 /* Display port number */
 #define MXCFB_PORT_NUM	2
+
+/* pending MXCFB_QUEUE_FLIP requests and unread flip events per fb */
+#define MXCFB_FLIP_QUEUE_LEN	4
+#define MXCFB_FLIP_EVENT_LEN	8
 /*!
  * Structure containing the MXC specific framebuffer information.
  */
+struct mxcfb_flip_entry {
+	struct mxcfb_flip flip;
+	unsigned long base;
+};
+
 struct mxcfb_info {
 	char *fb_mode_str;
 	int default_bpp;
@@ -83,9 +94,35 @@ struct mxcfb_info {
 	u32 pseudo_palette[16];
 
 	bool wait4vsync;
+	bool mmap_cached;
+	bool pan_busy;
 	struct semaphore flip_sem;
 	struct semaphore alpha_flip_sem;
 	struct completion vsync_complete;
+
+	/*
+	 * Flip queue. The eof irq latches one queued flip per frame while
+	 * holding flip_sem, so queued flips and pan_display never race for
+	 * the ipu buffers; completed flips become events for poll().
+	 */
+	spinlock_t flip_lock;
+	struct mxcfb_flip_entry flip_queue[MXCFB_FLIP_QUEUE_LEN];
+	int flip_head;
+	int flip_count;
+	struct mxcfb_flip_entry flip_latched;
+	bool flip_busy;
+	u32 flip_next_id;
+	struct mxcfb_flip_event flip_events[MXCFB_FLIP_EVENT_LEN];
+	int event_head;
+	int event_count;
+	wait_queue_head_t flip_wq;
+
+	/* MXCFB_SET_PLANES commit, applied by the background plane's eof */
+	struct mxcfb_planes planes;
+	unsigned long planes_base[2];
+	struct fb_info *planes_fg;
+	bool planes_pending;
+	struct completion planes_done;
 };
 
 struct mxcfb_mode {
@@ -109,6 +146,7 @@ enum {
 };
 
 static bool g_dp_in_use;
+static DEFINE_MUTEX(mxcfb_planes_mutex);
 LIST_HEAD(fb_alloc_list);
 static struct fb_info *mxcfb_info[3];
 static __initdata struct mxcfb_mode mxc_disp_mode[MXCFB_PORT_NUM];
@@ -201,6 +239,7 @@ static int mxcfb_blank(int blank, struct fb_info *info);
 static int mxcfb_map_video_memory(struct fb_info *fbi);
 static int mxcfb_unmap_video_memory(struct fb_info *fbi);
 static int mxcfb_option_setup(struct fb_info *info, char *options);
+static void mxcfb_flip_flush(struct mxcfb_info *mxc_fbi);
 
 /*
  * Set fixed framebuffer parameters based on variable settings.
@@ -305,6 +344,7 @@ static int _setup_disp_channel2(struct fb_info *fbi)
 	}
 
 	mxc_fbi->cur_ipu_buf = 2;
+	mxc_fbi->pan_busy = false;
 	sema_init(&mxc_fbi->flip_sem, 1);
 	if (mxc_fbi->alpha_chan_en) {
 		mxc_fbi->cur_ipu_alpha_buf = 1;
@@ -367,6 +407,7 @@ static int mxcfb_set_par(struct fb_info *fbi)
 	dev_dbg(fbi->device, "Reconfiguring framebuffer\n");
 
 	ipu_disable_irq(mxc_fbi->ipu_ch_irq);
+	mxcfb_flip_flush(mxc_fbi);
 	ipu_disable_channel(mxc_fbi->ipu_ch, true);
 	ipu_uninit_channel(mxc_fbi->ipu_ch);
 	ipu_clear_irq(mxc_fbi->ipu_ch_irq);
@@ -826,6 +867,339 @@ static int mxcfb_setcolreg(u_int regno, u_int red, u_int green, u_int blue,
 	return ret;
 }
 
+/*
+ * Queue a completed (or failed) flip as an event for MXCFB_GET_FLIP_EVENT.
+ * Called with flip_lock held; the oldest unread event is dropped when
+ * nobody is reading them.
+ */
+static void mxcfb_flip_post(struct mxcfb_info *mxc_fbi,
+			    struct mxcfb_flip_entry *entry, u32 flags)
+{
+	struct mxcfb_flip_event *event;
+	struct timespec ts;
+
+	if (mxc_fbi->event_count == MXCFB_FLIP_EVENT_LEN) {
+		mxc_fbi->event_head = (mxc_fbi->event_head + 1) %
+				      MXCFB_FLIP_EVENT_LEN;
+		mxc_fbi->event_count--;
+	}
+	event = &mxc_fbi->flip_events[(mxc_fbi->event_head +
+				       mxc_fbi->event_count) %
+				      MXCFB_FLIP_EVENT_LEN];
+	mxc_fbi->event_count++;
+
+	ktime_get_ts(&ts);
+	event->id = entry->flip.id;
+	event->flags = flags;
+	event->yoffset = entry->flip.yoffset;
+	event->timestamp_sec = ts.tv_sec;
+	event->timestamp_usec = ts.tv_nsec / NSEC_PER_USEC;
+
+	wake_up_interruptible(&mxc_fbi->flip_wq);
+}
+
+/*
+ * Hand the oldest queued flip to the ipu, the next eof switches the
+ * channel onto it. Called with flip_lock held and flip_sem taken; flip_sem
+ * is given back once there is nothing left to latch.
+ */
+static void mxcfb_flip_latch(struct fb_info *fbi)
+{
+	struct mxcfb_info *mxc_fbi = (struct mxcfb_info *)fbi->par;
+	struct mxcfb_flip_entry *entry;
+	u32 buf;
+
+	while (mxc_fbi->flip_count) {
+		entry = &mxc_fbi->flip_queue[mxc_fbi->flip_head];
+		mxc_fbi->flip_head = (mxc_fbi->flip_head + 1) %
+				     MXCFB_FLIP_QUEUE_LEN;
+		mxc_fbi->flip_count--;
+
+		buf = (mxc_fbi->cur_ipu_buf + 1) % 3;
+		if (ipu_update_channel_buffer(mxc_fbi->ipu_ch,
+					      IPU_INPUT_BUFFER, buf,
+					      entry->base) == 0) {
+			ipu_select_buffer(mxc_fbi->ipu_ch, IPU_INPUT_BUFFER,
+					  buf);
+			mxc_fbi->cur_ipu_buf = buf;
+			mxc_fbi->flip_latched = *entry;
+			mxc_fbi->flip_busy = true;
+			return;
+		}
+
+		dev_err(fbi->device, "Error latching flip %u to "
+			"address=0x%08lX, buf %d\n", entry->flip.id,
+			entry->base, buf);
+		mxcfb_flip_post(mxc_fbi, entry, MXCFB_FLIP_EVENT_ERROR);
+	}
+
+	up(&mxc_fbi->flip_sem);
+}
+
+/*
+ * Fail every pending flip, the channel is being torn down.
+ */
+static void mxcfb_flip_flush(struct mxcfb_info *mxc_fbi)
+{
+	unsigned long lock_flags;
+
+	spin_lock_irqsave(&mxc_fbi->flip_lock, lock_flags);
+	while (mxc_fbi->flip_count) {
+		mxcfb_flip_post(mxc_fbi,
+				&mxc_fbi->flip_queue[mxc_fbi->flip_head],
+				MXCFB_FLIP_EVENT_ERROR);
+		mxc_fbi->flip_head = (mxc_fbi->flip_head + 1) %
+				     MXCFB_FLIP_QUEUE_LEN;
+		mxc_fbi->flip_count--;
+	}
+	if (mxc_fbi->flip_busy) {
+		mxc_fbi->flip_busy = false;
+		mxcfb_flip_post(mxc_fbi, &mxc_fbi->flip_latched,
+				MXCFB_FLIP_EVENT_ERROR);
+		up(&mxc_fbi->flip_sem);
+	}
+	spin_unlock_irqrestore(&mxc_fbi->flip_lock, lock_flags);
+}
+
+/*
+ * Translate pan offsets into the physical address of the buffer to scan
+ * out, with the same limits as pan_display.
+ */
+static int mxcfb_offset_to_base(struct fb_info *fbi, u32 xoffset,
+				u32 yoffset, unsigned long *base)
+{
+	u_int y_bottom = yoffset;
+
+	if (!(fbi->var.vmode & FB_VMODE_YWRAP))
+		y_bottom += fbi->var.yres;
+	if (y_bottom > fbi->var.yres_virtual ||
+	    xoffset + fbi->var.xres > fbi->var.xres_virtual)
+		return -EINVAL;
+
+	*base = (yoffset * fbi->var.xres_virtual + xoffset);
+	*base = (fbi->var.bits_per_pixel) * *base / 8;
+	*base += fbi->fix.smem_start;
+	return 0;
+}
+
+/*
+ * Move a plane onto a new buffer for MXCFB_SET_PLANES. The committer holds
+ * the plane's flip_sem; setting pan_busy has the plane's own eof give it
+ * back, exactly as after pan_display.
+ */
+static void mxcfb_planes_flip(struct fb_info *fbi, unsigned long base)
+{
+	struct mxcfb_info *mxc_fbi = (struct mxcfb_info *)fbi->par;
+	u32 buf = (mxc_fbi->cur_ipu_buf + 1) % 3;
+
+	if (ipu_update_channel_buffer(mxc_fbi->ipu_ch, IPU_INPUT_BUFFER,
+				      buf, base) == 0) {
+		ipu_select_buffer(mxc_fbi->ipu_ch, IPU_INPUT_BUFFER, buf);
+		mxc_fbi->cur_ipu_buf = buf;
+	} else {
+		dev_err(fbi->device, "Error updating %s buf %d to "
+			"address=0x%08lX\n", fbi->fix.id, buf, base);
+	}
+	mxc_fbi->pan_busy = true;
+}
+
+/*
+ * Write a staged MXCFB_SET_PLANES commit. Called from the background
+ * plane's eof with its flip_lock held: the dp registers are shadowed and
+ * the buffers double buffered, so everything written here is picked up
+ * together at the start of the next frame.
+ */
+static void mxcfb_planes_apply(struct fb_info *bg_fbi)
+{
+	struct mxcfb_info *bg_mxcfbi = (struct mxcfb_info *)bg_fbi->par;
+	struct mxcfb_planes *planes = &bg_mxcfbi->planes;
+	struct fb_info *fg_fbi = bg_mxcfbi->planes_fg;
+	ipu_channel_t gw_ch;
+
+	gw_ch = (planes->gw_plane == MXCFB_PLANE_FG) ? MEM_FG_SYNC :
+						       MEM_BG_SYNC;
+	if (planes->flags & MXCFB_PLANES_ALPHA)
+		ipu_disp_set_global_alpha(gw_ch, (bool)planes->alpha.enable,
+					  planes->alpha.alpha);
+	if (planes->flags & MXCFB_PLANES_CLR_KEY)
+		ipu_disp_set_color_key(gw_ch, planes->key.enable,
+				       planes->key.color_key);
+	if (planes->flags & MXCFB_PLANES_FG_POS)
+		ipu_disp_set_window_pos(MEM_FG_SYNC, planes->fg_pos.x,
+					planes->fg_pos.y);
+
+	if (planes->flags & MXCFB_PLANES_BG_OFFSET) {
+		mxcfb_planes_flip(bg_fbi, bg_mxcfbi->planes_base[0]);
+		bg_fbi->var.xoffset = planes->bg_xoffset;
+		bg_fbi->var.yoffset = planes->bg_yoffset;
+	}
+	if (planes->flags & MXCFB_PLANES_FG_OFFSET) {
+		struct mxcfb_info *fg_mxcfbi =
+			(struct mxcfb_info *)fg_fbi->par;
+
+		spin_lock(&fg_mxcfbi->flip_lock);
+		mxcfb_planes_flip(fg_fbi, bg_mxcfbi->planes_base[1]);
+		fg_fbi->var.xoffset = planes->fg_xoffset;
+		fg_fbi->var.yoffset = planes->fg_yoffset;
+		ipu_clear_irq(fg_mxcfbi->ipu_ch_irq);
+		ipu_enable_irq(fg_mxcfbi->ipu_ch_irq);
+		spin_unlock(&fg_mxcfbi->flip_lock);
+	}
+}
+
+/*
+ * Stage a commit on the background plane and wait for its eof to apply
+ * it. Commits are serialized, and the flip_sem of every plane whose
+ * buffer changes is taken up front so pan_display and the flip queue
+ * keep off those buffers until the new one is on screen.
+ */
+static int mxcfb_set_planes(struct fb_info *fbi, struct mxcfb_planes *planes)
+{
+	struct fb_info *bg_fbi = NULL, *fg_fbi = NULL;
+	struct mxcfb_info *bg_mxcfbi, *fg_mxcfbi = NULL;
+	unsigned long bg_base = 0, fg_base = 0, lock_flags;
+	bool need_fg;
+	int i, ret;
+
+	for (i = 0; i < num_registered_fb; i++) {
+		struct mxcfb_info *mxcfbi =
+			(struct mxcfb_info *)(registered_fb[i]->par);
+
+		if (mxcfbi->ipu_ch == MEM_BG_SYNC)
+			bg_fbi = registered_fb[i];
+		else if (mxcfbi->ipu_ch == MEM_FG_SYNC)
+			fg_fbi = registered_fb[i];
+	}
+
+	need_fg = (planes->flags & (MXCFB_PLANES_FG_POS |
+				    MXCFB_PLANES_FG_OFFSET)) ||
+		  ((planes->flags & (MXCFB_PLANES_ALPHA |
+				     MXCFB_PLANES_CLR_KEY)) &&
+		   planes->gw_plane == MXCFB_PLANE_FG);
+	if (bg_fbi == NULL || (need_fg && fg_fbi == NULL)) {
+		dev_err(fbi->device, "Cannot find the display planes\n");
+		return -ENOENT;
+	}
+	if (planes->gw_plane != MXCFB_PLANE_BG &&
+	    planes->gw_plane != MXCFB_PLANE_FG)
+		return -EINVAL;
+
+	bg_mxcfbi = (struct mxcfb_info *)bg_fbi->par;
+	if (bg_mxcfbi->cur_blank != FB_BLANK_UNBLANK)
+		return -EINVAL;
+	if (need_fg)
+		fg_mxcfbi = (struct mxcfb_info *)fg_fbi->par;
+
+	if (planes->flags & MXCFB_PLANES_FG_POS) {
+		if (fg_fbi->var.xres + planes->fg_pos.x > bg_fbi->var.xres) {
+			if (bg_fbi->var.xres < fg_fbi->var.xres)
+				planes->fg_pos.x = 0;
+			else
+				planes->fg_pos.x = bg_fbi->var.xres -
+						   fg_fbi->var.xres;
+		}
+		if (fg_fbi->var.yres + planes->fg_pos.y > bg_fbi->var.yres) {
+			if (bg_fbi->var.yres < fg_fbi->var.yres)
+				planes->fg_pos.y = 0;
+			else
+				planes->fg_pos.y = bg_fbi->var.yres -
+						   fg_fbi->var.yres;
+		}
+	}
+	if ((planes->flags & MXCFB_PLANES_BG_OFFSET) &&
+	    mxcfb_offset_to_base(bg_fbi, planes->bg_xoffset,
+				 planes->bg_yoffset, &bg_base))
+		return -EINVAL;
+	if (planes->flags & MXCFB_PLANES_FG_OFFSET) {
+		if (fg_mxcfbi->cur_blank != FB_BLANK_UNBLANK ||
+		    mxcfb_offset_to_base(fg_fbi, planes->fg_xoffset,
+					 planes->fg_yoffset, &fg_base))
+			return -EINVAL;
+	}
+
+	mutex_lock(&mxcfb_planes_mutex);
+
+	if ((planes->flags & MXCFB_PLANES_BG_OFFSET) &&
+	    down_interruptible(&bg_mxcfbi->flip_sem)) {
+		ret = -ERESTARTSYS;
+		goto out;
+	}
+	if ((planes->flags & MXCFB_PLANES_FG_OFFSET) &&
+	    down_interruptible(&fg_mxcfbi->flip_sem)) {
+		if (planes->flags & MXCFB_PLANES_BG_OFFSET)
+			up(&bg_mxcfbi->flip_sem);
+		ret = -ERESTARTSYS;
+		goto out;
+	}
+
+	spin_lock_irqsave(&bg_mxcfbi->flip_lock, lock_flags);
+	bg_mxcfbi->planes = *planes;
+	bg_mxcfbi->planes_base[0] = bg_base;
+	bg_mxcfbi->planes_base[1] = fg_base;
+	bg_mxcfbi->planes_fg = fg_fbi;
+	init_completion(&bg_mxcfbi->planes_done);
+	bg_mxcfbi->planes_pending = true;
+	if (!bg_mxcfbi->flip_busy && !bg_mxcfbi->pan_busy &&
+	    !bg_mxcfbi->wait4vsync)
+		ipu_clear_irq(bg_mxcfbi->ipu_ch_irq);
+	ipu_enable_irq(bg_mxcfbi->ipu_ch_irq);
+	spin_unlock_irqrestore(&bg_mxcfbi->flip_lock, lock_flags);
+
+	ret = wait_for_completion_interruptible_timeout(
+		&bg_mxcfbi->planes_done, 1 * HZ);
+	if (ret > 0) {
+		/* as MXCFB_SET_GBL_ALPHA, global alpha replaces local alpha */
+		if ((planes->flags & MXCFB_PLANES_ALPHA) &&
+		    planes->alpha.enable) {
+			if (planes->gw_plane == MXCFB_PLANE_FG)
+				fg_mxcfbi->alpha_chan_en = false;
+			else
+				bg_mxcfbi->alpha_chan_en = false;
+		}
+		ret = 0;
+		goto out;
+	}
+
+	/* not applied yet, withdraw it unless the eof just got to it */
+	spin_lock_irqsave(&bg_mxcfbi->flip_lock, lock_flags);
+	if (bg_mxcfbi->planes_pending) {
+		bg_mxcfbi->planes_pending = false;
+		if (planes->flags & MXCFB_PLANES_BG_OFFSET)
+			up(&bg_mxcfbi->flip_sem);
+		if (planes->flags & MXCFB_PLANES_FG_OFFSET)
+			up(&fg_mxcfbi->flip_sem);
+		if (ret == 0) {
+			dev_err(fbi->device,
+				"MXCFB_SET_PLANES: timeout\n");
+			ret = -ETIME;
+		}
+	} else {
+		ret = 0;
+	}
+	spin_unlock_irqrestore(&bg_mxcfbi->flip_lock, lock_flags);
+out:
+	mutex_unlock(&mxcfb_planes_mutex);
+	return ret;
+}
+
+static bool mxcfb_is_blanked(struct mxcfb_info *mxc_fbi)
+{
+	if (mxc_fbi->ipu_ch == MEM_FG_SYNC) {
+		struct mxcfb_info *bg_mxcfbi = NULL;
+		int i;
+		for (i = 0; i < num_registered_fb; i++) {
+			bg_mxcfbi =
+				((struct mxcfb_info *)(registered_fb[i]->par));
+
+			if (bg_mxcfbi->ipu_ch == MEM_BG_SYNC)
+				break;
+		}
+		if (bg_mxcfbi->cur_blank != FB_BLANK_UNBLANK)
+			return true;
+	}
+	return mxc_fbi->cur_blank != FB_BLANK_UNBLANK;
+}
+
 /*
  * Function to handle custom ioctls for MXC framebuffer.
  *
@@ -1042,6 +1416,99 @@ static int mxcfb_ioctl(struct fb_info *fbi, unsigned int cmd, unsigned long arg)
 			}
 			break;
 		}
+	case MXCFB_QUEUE_FLIP:
+		{
+			struct mxcfb_flip flip;
+			struct mxcfb_flip_entry *entry;
+			unsigned long base, lock_flags;
+
+			if (copy_from_user(&flip, (void *)arg, sizeof(flip)))
+				return -EFAULT;
+
+			if (mxcfb_is_blanked(mxc_fbi)) {
+				retval = -EINVAL;
+				break;
+			}
+
+			if (mxcfb_offset_to_base(fbi, flip.xoffset,
+						 flip.yoffset, &base)) {
+				retval = -EINVAL;
+				break;
+			}
+
+			spin_lock_irqsave(&mxc_fbi->flip_lock, lock_flags);
+			if (mxc_fbi->flip_count == MXCFB_FLIP_QUEUE_LEN) {
+				spin_unlock_irqrestore(&mxc_fbi->flip_lock,
+						       lock_flags);
+				retval = -EAGAIN;
+				break;
+			}
+			flip.id = mxc_fbi->flip_next_id++;
+			entry = &mxc_fbi->flip_queue[(mxc_fbi->flip_head +
+						      mxc_fbi->flip_count) %
+						     MXCFB_FLIP_QUEUE_LEN];
+			entry->flip = flip;
+			entry->base = base;
+			mxc_fbi->flip_count++;
+
+			/*
+			 * Latch right away when the buffers are idle,
+			 * otherwise the eof irq picks it up.
+			 */
+			if (!mxc_fbi->flip_busy &&
+			    !down_trylock(&mxc_fbi->flip_sem)) {
+				mxcfb_flip_latch(fbi);
+				if (mxc_fbi->flip_busy) {
+					ipu_clear_irq(mxc_fbi->ipu_ch_irq);
+					ipu_enable_irq(mxc_fbi->ipu_ch_irq);
+				}
+			}
+			spin_unlock_irqrestore(&mxc_fbi->flip_lock,
+					       lock_flags);
+
+			if (copy_to_user((void *)arg, &flip, sizeof(flip)))
+				retval = -EFAULT;
+			break;
+		}
+	case MXCFB_SET_PLANES:
+		{
+			struct mxcfb_planes planes;
+
+			if (copy_from_user(&planes, (void *)arg,
+					   sizeof(planes))) {
+				retval = -EFAULT;
+				break;
+			}
+			retval = mxcfb_set_planes(fbi, &planes);
+			if (retval)
+				break;
+			if (copy_to_user((void *)arg, &planes, sizeof(planes)))
+				retval = -EFAULT;
+			break;
+		}
+	case MXCFB_GET_FLIP_EVENT:
+		{
+			struct mxcfb_flip_event event;
+			unsigned long lock_flags;
+
+			spin_lock_irqsave(&mxc_fbi->flip_lock, lock_flags);
+			if (!mxc_fbi->event_count) {
+				spin_unlock_irqrestore(&mxc_fbi->flip_lock,
+						       lock_flags);
+				retval = -EAGAIN;
+				break;
+			}
+			event = mxc_fbi->flip_events[mxc_fbi->event_head];
+			mxc_fbi->event_head = (mxc_fbi->event_head + 1) %
+					      MXCFB_FLIP_EVENT_LEN;
+			mxc_fbi->event_count--;
+			spin_unlock_irqrestore(&mxc_fbi->flip_lock,
+					       lock_flags);
+
+			if (copy_to_user((void *)arg, &event, sizeof(event)))
+				retval = -EFAULT;
+			break;
+		}
 	case FBIO_ALLOC:
 		{
 			int size;
@@ -1203,6 +1670,32 @@ static int mxcfb_ioctl(struct fb_info *fbi, unsigned int cmd, unsigned long arg)
 
 			break;
 		}
+	case MXCFB_SET_MMAP_CACHED:
+		{
+			struct mxcfb_info *mxc_fbi =
+				(struct mxcfb_info *)fbi->par;
+			__u32 cached;
+
+			if (get_user(cached, argp))
+				return -EFAULT;
+			mxc_fbi->mmap_cached = !!cached;
+			break;
+		}
+	case MXCFB_CPU_ACCESS_BEGIN:
+	case MXCFB_CPU_ACCESS_END:
+		{
+			struct mxcfb_cpu_access access;
+
+			if (copy_from_user(&access, (void *)arg,
+					   sizeof(access))) {
+				retval = -EFAULT;
+				break;
+			}
+			retval = contig_cpu_access(access.vaddr, access.size,
+					cmd == MXCFB_CPU_ACCESS_BEGIN,
+					access.flags & MXCFB_CPU_ACCESS_WRITE);
+			break;
+		}
 	default:
 		retval = -EINVAL;
 	}
@@ -1229,6 +1722,7 @@ static int mxcfb_blank(int blank, struct fb_info *info)
 	case FB_BLANK_VSYNC_SUSPEND:
 	case FB_BLANK_HSYNC_SUSPEND:
 	case FB_BLANK_NORMAL:
+		mxcfb_flip_flush(mxc_fbi);
 		ipu_disable_channel(mxc_fbi->ipu_ch, true);
 		ipu_uninit_sync_panel(mxc_fbi->ipu_di);
 		ipu_uninit_channel(mxc_fbi->ipu_ch);
@@ -1256,6 +1750,7 @@ mxcfb_pan_display(struct fb_var_screeninfo *var, struct fb_info *info)
 			  *mxc_graphic_fbi = NULL;
 	u_int y_bottom;
 	unsigned long base, active_alpha_phy_addr = 0;
+	unsigned long lock_flags;
 	bool loc_alpha_en = false;
 	int i = 0;
 
@@ -1323,6 +1818,11 @@ mxcfb_pan_display(struct fb_var_screeninfo *var, struct fb_info *info)
 	dev_dbg(info->device, "Updating SDC %s buf %d address=0x%08lX\n",
 		info->fix.id, mxc_fbi->cur_ipu_buf, base);
 
+	/* the next eof hands flip_sem back, see mxcfb_irq_handler() */
+	spin_lock_irqsave(&mxc_fbi->flip_lock, lock_flags);
+	mxc_fbi->pan_busy = true;
+	spin_unlock_irqrestore(&mxc_fbi->flip_lock, lock_flags);
+
 	if (ipu_update_channel_buffer(mxc_fbi->ipu_ch, IPU_INPUT_BUFFER,
 				      mxc_fbi->cur_ipu_buf, base) == 0) {
 		/* Update the DP local alpha buffer only for graphic plane */
@@ -1368,6 +1868,29 @@ mxcfb_pan_display(struct fb_var_screeninfo *var, struct fb_info *info)
 	return 0;
 }
 
+/*
+ * Readable when flip events are pending, writable when the flip queue
+ * has room.
+ */
+static unsigned int mxcfb_poll(struct fb_info *fbi, struct file *file,
+			       poll_table *wait)
+{
+	struct mxcfb_info *mxc_fbi = (struct mxcfb_info *)fbi->par;
+	unsigned long lock_flags;
+	unsigned int mask = 0;
+
+	poll_wait(file, &mxc_fbi->flip_wq, wait);
+
+	spin_lock_irqsave(&mxc_fbi->flip_lock, lock_flags);
+	if (mxc_fbi->event_count)
+		mask |= POLLIN | POLLRDNORM;
+	if (mxc_fbi->flip_count < MXCFB_FLIP_QUEUE_LEN)
+		mask |= POLLOUT | POLLWRNORM;
+	spin_unlock_irqrestore(&mxc_fbi->flip_lock, lock_flags);
+
+	return mask;
+}
+
 /*
  * Function to handle custom mmap for MXC framebuffer.
  *
@@ -1408,8 +1931,9 @@ static int mxcfb_mmap(struct fb_info *fbi, struct vm_area_struct *vma)
 	if (vma->vm_end - vma->vm_start > len)
 		return -EINVAL;
 
-	/* make buffers bufferable */
-	vma->vm_page_prot = pgprot_writecombine(vma->vm_page_prot);
+	/* make buffers bufferable, or cached if userspace syncs them itself */
+	if (!mxc_fbi->mmap_cached)
+		vma->vm_page_prot = pgprot_writecombine(vma->vm_page_prot);
 
 	vma->vm_flags |= VM_IO | VM_RESERVED;
 
@@ -1435,6 +1959,7 @@ static struct fb_ops mxcfb_ops = {
 	.fb_pan_display = mxcfb_pan_display,
 	.fb_ioctl = mxcfb_ioctl,
 	.fb_mmap = mxcfb_mmap,
+	.fb_poll = mxcfb_poll,
 	.fb_fillrect = cfb_fillrect,
 	.fb_copyarea = cfb_copyarea,
 	.fb_imageblit = cfb_imageblit,
@@ -1446,14 +1971,36 @@ static irqreturn_t mxcfb_irq_handler(int irq, void *dev_id)
 	struct fb_info *fbi = dev_id;
 	struct mxcfb_info *mxc_fbi = fbi->par;
 
+	spin_lock(&mxc_fbi->flip_lock);
 	if (mxc_fbi->wait4vsync) {
 		complete(&mxc_fbi->vsync_complete);
-		ipu_disable_irq(irq);
 		mxc_fbi->wait4vsync = 0;
-	} else {
+	}
+	if (mxc_fbi->pan_busy) {
+		mxc_fbi->pan_busy = false;
 		up(&mxc_fbi->flip_sem);
-		ipu_disable_irq(irq);
 	}
+
+	if (mxc_fbi->flip_busy) {
+		/* this eof moved the channel onto the latched buffer */
+		mxc_fbi->flip_busy = false;
+		fbi->var.yoffset = mxc_fbi->flip_latched.flip.yoffset;
+		mxcfb_flip_post(mxc_fbi, &mxc_fbi->flip_latched, 0);
+		mxcfb_flip_latch(fbi);
+	} else if (mxc_fbi->flip_count && !down_trylock(&mxc_fbi->flip_sem)) {
+		/* a pan_display flip was holding the buffers */
+		mxcfb_flip_latch(fbi);
+	}
+
+	if (mxc_fbi->planes_pending) {
+		mxc_fbi->planes_pending = false;
+		mxcfb_planes_apply(fbi);
+		complete(&mxc_fbi->planes_done);
+	}
+
+	if (!mxc_fbi->flip_busy && !mxc_fbi->pan_busy)
+		ipu_disable_irq(irq);
+	spin_unlock(&mxc_fbi->flip_lock);
 	return IRQ_HANDLED;
 }
 
@@ -1593,6 +2140,9 @@ static struct fb_info *mxcfb_init_fbinfo(struct device *dev, struct fb_ops *ops)
 	fbi->flags = FBINFO_FLAG_DEFAULT;
 	fbi->pseudo_palette = mxcfbi->pseudo_palette;
 
+	spin_lock_init(&mxcfbi->flip_lock);
+	init_waitqueue_head(&mxcfbi->flip_wq);
+
 	/*
 	 * Allocate colormap
 	 */
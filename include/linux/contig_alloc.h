@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2011 Freescale Semiconductor, Inc. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef __LINUX_CONTIG_ALLOC_H
+#define __LINUX_CONTIG_ALLOC_H
+
+#include <linux/dma-mapping.h>
+
+/*
+ * Physically contiguous, coherent buffers shared by the multimedia drivers.
+ * owner is any cookie identifying the client (usually its struct file
+ * data); contig_free_owner() returns everything a client still holds.
+ *
+ * contig_cpu_access() brackets CPU access to a cached user mapping of such
+ * a buffer (or any other remap_pfn_range() mapping): begin invalidates
+ * what the device may have written, end cleans what the CPU wrote.
+ */
+#ifdef CONFIG_MXC_CONTIG_ALLOC
+void *contig_alloc(void *owner, size_t size, dma_addr_t *dma_addr);
+int contig_free(void *vaddr, dma_addr_t dma_addr, size_t size);
+void contig_free_owner(void *owner);
+int contig_cpu_access(unsigned long uaddr, size_t size, bool begin, bool wrote);
+#else
+static inline void *contig_alloc(void *owner, size_t size, dma_addr_t *dma_addr)
+{
+	return dma_alloc_coherent(NULL, PAGE_ALIGN(size), dma_addr,
+				  GFP_DMA | GFP_KERNEL);
+}
+static inline int contig_free(void *vaddr, dma_addr_t dma_addr, size_t size)
+{
+	dma_free_coherent(NULL, PAGE_ALIGN(size), vaddr, dma_addr);
+	return 0;
+}
+static inline void contig_free_owner(void *owner) {}
+static inline int contig_cpu_access(unsigned long uaddr, size_t size,
+				    bool begin, bool wrote)
+{
+	return -ENOSYS;
+}
+#endif
+
+#endif /* __LINUX_CONTIG_ALLOC_H */
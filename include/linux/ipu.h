@@ -1239,6 +1239,64 @@ typedef struct _ipu_csc_update {
 	int **param;
 } ipu_csc_update;
 
+/*!
+ * Rectangle of a task buffer to operate on, in pixels. A zero width or
+ * height selects the whole frame.
+ */
+typedef struct _ipu_task_crop {
+	uint32_t x;
+	uint32_t y;
+	uint32_t w;
+	uint32_t h;
+} ipu_task_crop;
+
+typedef struct _ipu_task_buf {
+	dma_addr_t paddr;
+	uint32_t width;		/* full frame, also sets the stride */
+	uint32_t height;
+	uint32_t format;
+	ipu_task_crop crop;
+} ipu_task_buf;
+
+/*!
+ * One colour conversion/resize/rotation job for IPU_QUEUE_TASK. The output
+ * crop is given after rotation. id is handed back untouched by
+ * IPU_DEQUEUE_TASK together with the completion status.
+ */
+typedef struct _ipu_task {
+	ipu_task_buf input;
+	ipu_task_buf output;
+	ipu_rotate_mode_t rotate;
+	uint32_t id;
+	int status;
+} ipu_task;
+
+/*!
+ * Streaming deinterlace for the tasks queued on one open file, set with
+ * IPU_SET_DEINTERLACE. While enabled each task input is an interlaced
+ * frame and the output its deinterlaced version. Except in HIGH_MOTION the
+ * driver takes the previous field from the input of the task queued before
+ * on the same file, so that buffer must stay untouched until this task
+ * completes. field_fmt is V4L2_FIELD_INTERLACED_TB or _BT.
+ */
+typedef struct _ipu_deinterlace {
+	uint32_t enable;
+	ipu_motion_sel motion;
+	uint32_t field_fmt;
+} ipu_deinterlace;
+
+/*!
+ * CPU access window on a buffer mapped cached (IPU_SET_MMAP_CACHED) through
+ * this device; vaddr is the caller's own mapping.
+ */
+#define IPU_CPU_ACCESS_WRITE	0x1	/* on end: the cpu wrote, clean */
+
+typedef struct _ipu_cpu_access {
+	unsigned long vaddr;
+	uint32_t size;
+	uint32_t flags;
+} ipu_cpu_access;
+
 /* IOCTL commands */
 
 #define IPU_INIT_CHANNEL              _IOW('I', 0x1, ipu_channel_parm)
@@ -1283,6 +1341,12 @@ typedef struct _ipu_csc_update {
 #define IPU_UPDATE_BUF_OFFSET         _IOW('I', 0x28, ipu_buf_offset_parm)
 #define IPU_CSC_UPDATE                _IOW('I', 0x29, ipu_csc_update)
 #define IPU_SELECT_MULTI_VDI_BUFFER   _IOW('I', 0x2A, uint32_t)
+#define IPU_QUEUE_TASK                _IOW('I', 0x2B, ipu_task)
+#define IPU_DEQUEUE_TASK              _IOR('I', 0x2C, ipu_task)
+#define IPU_SET_MMAP_CACHED           _IOW('I', 0x2D, uint32_t)
+#define IPU_CPU_ACCESS_BEGIN          _IOW('I', 0x2E, ipu_cpu_access)
+#define IPU_CPU_ACCESS_END            _IOW('I', 0x2F, ipu_cpu_access)
+#define IPU_SET_DEINTERLACE           _IOW('I', 0x30, ipu_deinterlace)
 
 int ipu_calc_stripes_sizes(const unsigned int input_frame_width,
 				unsigned int output_frame_width,
@@ -17,10 +17,47 @@
  * MA 02110-1301, USA.
  */
 
+#ifndef __LINUX_IRAM_ALLOC_H
+#define __LINUX_IRAM_ALLOC_H
+
+#include <linux/list.h>
+
+#define IRAM_PRIO_LOW		0	/* opportunistic, e.g. caches */
+#define IRAM_PRIO_NORMAL	1
+#define IRAM_PRIO_HIGH		2	/* real time, e.g. audio rings */
+
+/*
+ * A subsystem that takes IRAM only while it is active. iram_request() may
+ * evict lower priority clients: their reclaim callback is called (process
+ * context, may sleep, must not call back into the allocator) and has to
+ * stop all use of the region before returning, after which the region is
+ * freed for them. Clients without reclaim are never evicted.
+ */
+struct iram_client {
+	const char *name;
+	int priority;
+	void (*reclaim)(struct iram_client *client);
+
+	/* valid while granted */
+	unsigned long dma_addr;
+	void *virt;
+	unsigned int size;
+
+	/* private to the allocator */
+	struct list_head list;
+	unsigned long requests;
+	unsigned long failures;
+	unsigned long evictions;
+};
+
 #ifdef CONFIG_IRAM_ALLOC
 int __init iram_init(unsigned long base, unsigned long size);
 void *iram_alloc(unsigned int size, unsigned long *dma_addr);
 void iram_free(unsigned long dma_addr, unsigned int size);
+void iram_client_register(struct iram_client *client);
+void iram_client_unregister(struct iram_client *client);
+int iram_request(struct iram_client *client, unsigned int size);
+void iram_release(struct iram_client *client);
 #else
 static inline int __init iram_init(unsigned long base, unsigned long size)
 {
@@ -31,5 +68,13 @@ static inline void *iram_alloc(unsigned int size, unsigned long *dma_addr)
 	return NULL;
 }
 static inline void iram_free(unsigned long base, unsigned long size) {}
+static inline void iram_client_register(struct iram_client *client) {}
+static inline void iram_client_unregister(struct iram_client *client) {}
+static inline int iram_request(struct iram_client *client, unsigned int size)
+{
+	return -ENOMEM;
+}
+static inline void iram_release(struct iram_client *client) {}
 #endif
 
+#endif /* __LINUX_IRAM_ALLOC_H */
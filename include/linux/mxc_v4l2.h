@@ -30,6 +30,11 @@
 #define V4L2_CID_MXC_FLASH		(V4L2_CID_PRIVATE_BASE + 1)
 #define V4L2_CID_MXC_VF_ROT		(V4L2_CID_PRIVATE_BASE + 2)
 #define V4L2_CID_MXC_MOTION     (V4L2_CID_PRIVATE_BASE + 3)
+/*
+ * Scan the primary (background) overlay out straight from the IPU when the
+ * window covers the whole frame buffer, instead of copying every frame.
+ */
+#define V4L2_CID_MXC_VF_LINK		(V4L2_CID_PRIVATE_BASE + 4)
 
 #define V4L2_MXC_ROTATE_NONE			0
 #define V4L2_MXC_ROTATE_VERT_FLIP		1
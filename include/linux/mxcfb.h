@@ -67,6 +67,60 @@ struct mxcfb_rect {
 	__u32 height;
 };
 
+/* MXCFB_QUEUE_FLIP: offsets as for FBIOPAN_DISPLAY, id is returned */
+struct mxcfb_flip {
+	__u32 xoffset;
+	__u32 yoffset;
+	__u32 id;
+};
+
+#define MXCFB_FLIP_EVENT_ERROR	0x1	/* the ipu refused the buffer */
+
+/* MXCFB_GET_FLIP_EVENT: a queued flip reached the screen */
+struct mxcfb_flip_event {
+	__u32 id;
+	__u32 flags;
+	__u32 yoffset;
+	__u32 timestamp_sec;	/* monotonic time of the latching vsync */
+	__u32 timestamp_usec;
+};
+
+#define MXCFB_PLANE_BG		0
+#define MXCFB_PLANE_FG		1
+
+#define MXCFB_PLANES_ALPHA	0x01	/* global alpha of gw_plane */
+#define MXCFB_PLANES_CLR_KEY	0x02	/* colour key of gw_plane */
+#define MXCFB_PLANES_FG_POS	0x04
+#define MXCFB_PLANES_BG_OFFSET	0x08
+#define MXCFB_PLANES_FG_OFFSET	0x10
+
+/*
+ * MXCFB_SET_PLANES: everything selected in flags reaches the display at
+ * the same vsync. Alpha and colour key belong to the graphic window,
+ * gw_plane says which plane that is; offsets are pan offsets into each
+ * plane's framebuffer. fg_pos is returned clipped to the background.
+ */
+struct mxcfb_planes {
+	__u32 flags;
+	__u32 gw_plane;
+	struct mxcfb_gbl_alpha alpha;
+	struct mxcfb_color_key key;
+	struct mxcfb_pos fg_pos;
+	__u32 bg_xoffset;
+	__u32 bg_yoffset;
+	__u32 fg_xoffset;
+	__u32 fg_yoffset;
+};
+
+#define MXCFB_CPU_ACCESS_WRITE	0x1
+
+/* range of a cached mmap for MXCFB_CPU_ACCESS_BEGIN/END */
+struct mxcfb_cpu_access {
+	unsigned long vaddr;
+	__u32 size;
+	__u32 flags;
+};
+
 #define GRAYSCALE_8BIT				0x1
 #define GRAYSCALE_8BIT_INVERTED			0x2
 
@@ -133,6 +187,12 @@ struct mxcfb_waveform_modes {
 #define MXCFB_GET_DIFMT	       _IOR('F', 0x2A, u_int32_t)
 #define MXCFB_GET_FB_BLANK     _IOR('F', 0x2B, u_int32_t)
 #define MXCFB_SET_DIFMT		_IOW('F', 0x2C, u_int32_t)
+#define MXCFB_SET_MMAP_CACHED	_IOW('F', 0x33, __u32)
+#define MXCFB_CPU_ACCESS_BEGIN	_IOW('F', 0x34, struct mxcfb_cpu_access)
+#define MXCFB_CPU_ACCESS_END	_IOW('F', 0x35, struct mxcfb_cpu_access)
+#define MXCFB_QUEUE_FLIP	_IOWR('F', 0x36, struct mxcfb_flip)
+#define MXCFB_GET_FLIP_EVENT	_IOR('F', 0x37, struct mxcfb_flip_event)
+#define MXCFB_SET_PLANES	_IOWR('F', 0x38, struct mxcfb_planes)
 
 /* IOCTLs for E-ink panel updates */
 #define MXCFB_SET_WAVEFORM_MODES	_IOW('F', 0x2B, struct mxcfb_waveform_modes)
@@ -21,6 +21,10 @@
 #include <linux/platform_device.h>
 #include <linux/slab.h>
 #include <linux/dmaengine.h>
+#include <linux/iram_alloc.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/mm.h>
 
 #include <sound/core.h>
 #include <sound/initval.h>
@@ -32,6 +36,17 @@
 
 #include "imx-ssi.h"
 
+/*
+ * Ring buffers up to this size are placed in internal RAM while the stream
+ * is set up, so that the SDMA does not compete with the rest of the system
+ * for external memory bandwidth.
+ */
+#define IMX_PCM_IRAM_MAX	(16 * 1024)
+
+static int use_iram = 1;
+module_param(use_iram, int, 0644);
+MODULE_PARM_DESC(use_iram, "Place small ring buffers in internal RAM");
+
 struct imx_pcm_runtime_data {
 	int period_bytes;
 	int periods;
@@ -43,6 +58,9 @@ struct imx_pcm_runtime_data {
 	struct dma_async_tx_descriptor *desc;
 	struct dma_chan *dma_chan;
 	struct imx_dma_data dma_data;
+	int sdma;
+	struct iram_client iram;
+	struct snd_dma_buffer iram_buf;
 };
 
 static void audio_dma_irq(void *data)
@@ -87,6 +105,12 @@ static int imx_ssi_dma_alloc(struct snd_pcm_substream *substream,
 	iprtd->dma_data.priority = DMA_PRIO_HIGH;
 	iprtd->dma_data.dma_request = dma_params->dma;
 
+	/* hw_params may be called again without hw_free in between */
+	if (iprtd->dma_chan) {
+		dma_release_channel(iprtd->dma_chan);
+		iprtd->dma_chan = NULL;
+	}
+
 	/* Try to grab a DMA channel */
 	dma_cap_zero(mask);
 	dma_cap_set(DMA_SLAVE, mask);
@@ -94,6 +118,8 @@ static int imx_ssi_dma_alloc(struct snd_pcm_substream *substream,
 	if (!iprtd->dma_chan)
 		return -EINVAL;
 
+	iprtd->sdma = imx_dma_is_sdma(iprtd->dma_chan);
+
 	switch (params_format(params)) {
 	case SNDRV_PCM_FORMAT_S16_LE:
 		buswidth = DMA_SLAVE_BUSWIDTH_2_BYTES;
@@ -128,19 +154,13 @@ static int imx_ssi_dma_alloc(struct snd_pcm_substream *substream,
 static int snd_imx_pcm_hw_params(struct snd_pcm_substream *substream,
 				struct snd_pcm_hw_params *params)
 {
-	struct snd_soc_pcm_runtime *rtd = substream->private_data;
 	struct snd_pcm_runtime *runtime = substream->runtime;
 	struct imx_pcm_runtime_data *iprtd = runtime->private_data;
-	unsigned long dma_addr;
-	struct dma_chan *chan;
-	struct imx_pcm_dma_params *dma_params;
 	int ret;
 
-	dma_params = snd_soc_dai_get_dma_data(rtd->cpu_dai, substream);
 	ret = imx_ssi_dma_alloc(substream, params);
 	if (ret)
 		return ret;
-	chan = iprtd->dma_chan;
 
 	iprtd->size = params_buffer_bytes(params);
 	iprtd->periods = params_periods(params);
@@ -149,24 +169,19 @@ static int snd_imx_pcm_hw_params(struct snd_pcm_substream *substream,
 	iprtd->period_time = HZ / (params_rate(params) /
 			params_period_size(params));
 
-	snd_pcm_set_runtime_buffer(substream, &substream->dma_buffer);
-
-	dma_addr = runtime->dma_addr;
-
-	iprtd->buf = (unsigned int *)substream->dma_buffer.area;
-
-	iprtd->desc = chan->device->device_prep_dma_cyclic(chan, dma_addr,
-			iprtd->period_bytes * iprtd->periods,
-			iprtd->period_bytes,
-			substream->stream == SNDRV_PCM_STREAM_PLAYBACK ?
-			DMA_TO_DEVICE : DMA_FROM_DEVICE);
-	if (!iprtd->desc) {
-		dev_err(&chan->dev->device, "cannot prepare slave dma\n");
-		return -EINVAL;
+	iram_release(&iprtd->iram);
+	if (use_iram && iprtd->size <= IMX_PCM_IRAM_MAX &&
+	    !iram_request(&iprtd->iram, iprtd->size)) {
+		iprtd->iram_buf = substream->dma_buffer;
+		iprtd->iram_buf.area = iprtd->iram.virt;
+		iprtd->iram_buf.addr = iprtd->iram.dma_addr;
+		iprtd->iram_buf.bytes = iprtd->iram.size;
+		snd_pcm_set_runtime_buffer(substream, &iprtd->iram_buf);
+	} else {
+		snd_pcm_set_runtime_buffer(substream, &substream->dma_buffer);
 	}
 
-	iprtd->desc->callback = audio_dma_irq;
-	iprtd->desc->callback_param = substream;
+	iprtd->buf = (unsigned int *)runtime->dma_area;
 
 	return 0;
 }
@@ -181,15 +196,39 @@ static int snd_imx_pcm_hw_free(struct snd_pcm_substream *substream)
 		iprtd->dma_chan = NULL;
 	}
 
+	snd_pcm_set_runtime_buffer(substream, NULL);
+	iram_release(&iprtd->iram);
+
 	return 0;
 }
 
+/*
+ * The cyclic descriptor is set up here rather than in hw_params so that
+ * the engine restarts at the beginning of the buffer after a stop, as the
+ * core expects after prepare.
+ */
 static int snd_imx_pcm_prepare(struct snd_pcm_substream *substream)
 {
-	struct snd_soc_pcm_runtime *rtd = substream->private_data;
-	struct imx_pcm_dma_params *dma_params;
+	struct snd_pcm_runtime *runtime = substream->runtime;
+	struct imx_pcm_runtime_data *iprtd = runtime->private_data;
+	struct dma_chan *chan = iprtd->dma_chan;
 
-	dma_params = snd_soc_dai_get_dma_data(rtd->cpu_dai, substream);
+	dmaengine_terminate_all(chan);
+
+	iprtd->offset = 0;
+	iprtd->desc = chan->device->device_prep_dma_cyclic(chan,
+			runtime->dma_addr,
+			iprtd->period_bytes * iprtd->periods,
+			iprtd->period_bytes,
+			substream->stream == SNDRV_PCM_STREAM_PLAYBACK ?
+			DMA_TO_DEVICE : DMA_FROM_DEVICE);
+	if (!iprtd->desc) {
+		dev_err(&chan->dev->device, "cannot prepare slave dma\n");
+		return -EINVAL;
+	}
+
+	iprtd->desc->callback = audio_dma_irq;
+	iprtd->desc->callback_param = substream;
 
 	return 0;
 }
@@ -224,11 +263,52 @@ static snd_pcm_uframes_t snd_imx_pcm_pointer(struct snd_pcm_substream *substream
 {
 	struct snd_pcm_runtime *runtime = substream->runtime;
 	struct imx_pcm_runtime_data *iprtd = runtime->private_data;
+	struct imx_dma_period_stamp ps;
+	unsigned long offset = iprtd->offset;
+	unsigned long bytes;
+	s64 ns;
+
+	/*
+	 * On the SDMA the last completed period and the time its interrupt
+	 * was serviced are known. Start from there and add what has been
+	 * played since at the stream rate, but never run into the period
+	 * the engine has not finished yet.
+	 */
+	if (iprtd->sdma &&
+	    !imx_sdma_get_period_stamp(iprtd->dma_chan, &ps) && ps.count) {
+		offset = ((ps.period + 1) % iprtd->periods) *
+			iprtd->period_bytes;
+
+		ns = ktime_to_ns(ktime_sub(ktime_get(), ps.stamp));
+		if (ns > 0) {
+			bytes = frames_to_bytes(runtime,
+				div_u64(ns * runtime->rate, NSEC_PER_SEC));
+			bytes = min_t(unsigned long, bytes,
+				iprtd->period_bytes - frames_to_bytes(runtime, 1));
+			offset += bytes;
+		}
+	}
+
+	pr_debug("%s: %ld %ld\n", __func__, offset,
+			bytes_to_frames(runtime, offset));
+
+	return bytes_to_frames(runtime, offset);
+}
+
+static int snd_imx_pcm_mmap_iram(struct snd_pcm_substream *substream,
+		struct vm_area_struct *vma)
+{
+	struct snd_pcm_runtime *runtime = substream->runtime;
+	struct imx_pcm_runtime_data *iprtd = runtime->private_data;
+
+	if (!iprtd->iram.size)
+		return snd_imx_pcm_mmap(substream, vma);
 
-	pr_debug("%s: %ld %ld\n", __func__, iprtd->offset,
-			bytes_to_frames(substream->runtime, iprtd->offset));
+	vma->vm_page_prot = pgprot_writecombine(vma->vm_page_prot);
 
-	return bytes_to_frames(substream->runtime, iprtd->offset);
+	return remap_pfn_range(vma, vma->vm_start,
+			runtime->dma_addr >> PAGE_SHIFT,
+			vma->vm_end - vma->vm_start, vma->vm_page_prot);
 }
 
 static struct snd_pcm_hardware snd_imx_hardware = {
@@ -268,6 +348,11 @@ static int snd_imx_open(struct snd_pcm_substream *substream)
 		return ret;
 	}
 
+	iprtd->iram.name = substream->stream == SNDRV_PCM_STREAM_PLAYBACK ?
+		"pcm playback" : "pcm capture";
+	iprtd->iram.priority = IRAM_PRIO_HIGH;
+	iram_client_register(&iprtd->iram);
+
 	snd_soc_set_runtime_hwparams(substream, &snd_imx_hardware);
 
 	return 0;
@@ -278,6 +363,7 @@ static int snd_imx_close(struct snd_pcm_substream *substream)
 	struct snd_pcm_runtime *runtime = substream->runtime;
 	struct imx_pcm_runtime_data *iprtd = runtime->private_data;
 
+	iram_client_unregister(&iprtd->iram);
 	kfree(iprtd);
 
 	return 0;
@@ -292,7 +378,7 @@ static struct snd_pcm_ops imx_pcm_ops = {
 	.prepare	= snd_imx_pcm_prepare,
 	.trigger	= snd_imx_pcm_trigger,
 	.pointer	= snd_imx_pcm_pointer,
-	.mmap		= snd_imx_pcm_mmap,
+	.mmap		= snd_imx_pcm_mmap_iram,
 };
 
 static struct snd_soc_platform_driver imx_soc_platform_mx2 = {
@@ -681,6 +681,7 @@ static int imx_ssi_probe(struct platform_device *pdev)
 		goto failed_register;
 	}
 
+#if defined(CONFIG_SND_MXC_SOC_FIQ) || defined(CONFIG_SND_MXC_SOC_FIQ_MODULE)
 	ssi->soc_platform_pdev_fiq = platform_device_alloc("imx-fiq-pcm-audio", pdev->id);
 	if (!ssi->soc_platform_pdev_fiq) {
 		ret = -ENOMEM;
@@ -693,6 +694,7 @@ static int imx_ssi_probe(struct platform_device *pdev)
 		dev_err(&pdev->dev, "failed to add platform device\n");
 		goto failed_pdev_fiq_add;
 	}
+#endif
 
 	ssi->soc_platform_pdev = platform_device_alloc("imx-pcm-audio", pdev->id);
 	if (!ssi->soc_platform_pdev) {
@@ -712,10 +714,12 @@ static int imx_ssi_probe(struct platform_device *pdev)
 failed_pdev_add:
 	platform_device_put(ssi->soc_platform_pdev);
 failed_pdev_alloc:
+#if defined(CONFIG_SND_MXC_SOC_FIQ) || defined(CONFIG_SND_MXC_SOC_FIQ_MODULE)
 	platform_device_del(ssi->soc_platform_pdev_fiq);
 failed_pdev_fiq_add:
 	platform_device_put(ssi->soc_platform_pdev_fiq);
 failed_pdev_fiq_alloc:
+#endif
 	snd_soc_unregister_dai(&pdev->dev);
 failed_register:
 failed_ac97:
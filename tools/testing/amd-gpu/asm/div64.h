@@ -0,0 +1,11 @@
+#ifndef ASM_DIV64_H
+#define ASM_DIV64_H
+#include <linux/kernel.h>
+
+#define do_div(n, base) ({				\
+	u32 __base = (base);				\
+	u32 __rem = (u32)((n) % __base);		\
+	(n) = (n) / __base;				\
+	__rem;						\
+})
+#endif
@@ -0,0 +1,4 @@
+#ifndef ASM_SYSTEM_H
+#define ASM_SYSTEM_H
+#include <linux/kernel.h>
+#endif
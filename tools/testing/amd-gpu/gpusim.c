@@ -0,0 +1,383 @@
+/*
+ * Simulated i.MX5 z430: a HAL backed by host memory and a command
+ * processor thread that walks the ringbuffer the way the real CP does.
+ *
+ * Register space and the EMEM aperture are anonymous mappings below 4GB,
+ * with gpu addresses equal to host addresses, so the unmodified core can
+ * keep casting pointers to unsigned int.  The CP honours type0 register
+ * writes, the scratch/timestamp shadow, CACHE_FLUSH_TS event writes and
+ * PM4_INTERRUPT, which it delivers through kgsl_intr_isr() from its own
+ * thread, running as the hard interrupt would.  Indirect buffers are not
+ * executed, only checked: the test fills each one with a pattern derived
+ * from its address and registers it, and the CP complains if a registered
+ * buffer whose timestamp has not retired holds anything else, i.e. if it
+ * was freed and reused too early.  Buffers the driver submits itself, the
+ * context save/restore IBs, are not registered and go unchecked, and so
+ * do addresses whose registered timestamp has retired, since the memory
+ * may legitimately belong to someone else by then.
+ */
+#define _GNU_SOURCE
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "gsl.h"
+#include "gsl_hal.h"
+#include "gpusim.h"
+
+#define SIM_EMEM_SIZE		(16 << 20)
+/* the arena never hands out less than 32 byte alignment */
+#define SIM_IB_SHIFT		5
+#define SIM_IB_SLOTS		(SIM_EMEM_SIZE >> SIM_IB_SHIFT)
+
+static unsigned char *sim_regs;
+static unsigned char *sim_emem;
+static pthread_t sim_cp;
+static volatile int sim_running;
+static unsigned int sim_gpu_delay_us;
+
+// module parameter in gsl_kmod.c, only the z160 reads it
+int z160_version;
+
+unsigned long gpusim_irqs;
+unsigned long gpusim_ibs;
+
+/*
+ * Registered test IBs, one slot per possible start address, holding the
+ * submission timestamp in the upper half (0 until it is known) and the
+ * size in dwords in the lower half.  Written by the test threads, read
+ * by the CP, so slots are only ever accessed whole.
+ */
+static u64 *sim_ib_slots;
+static unsigned int sim_eop_ts;
+
+static void *sim_map(size_t size)
+{
+	void *p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		       MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+
+	assert(p != MAP_FAILED);
+	return p;
+}
+
+static unsigned int sim_reg(unsigned int offsetwords)
+{
+	return __raw_readl(sim_regs + (offsetwords << 2));
+}
+
+static void sim_setreg(unsigned int offsetwords, unsigned int value)
+{
+	__raw_writel(value, sim_regs + (offsetwords << 2));
+}
+
+static void sim_memwrite(unsigned int gpuaddr, unsigned int value)
+{
+	__sync_synchronize();
+	*(volatile unsigned int *)(unsigned long)gpuaddr = value;
+}
+
+unsigned int gpusim_ib_pattern(unsigned int gpuaddr, int i)
+{
+	return gpuaddr ^ (i * 0x9e3779b9u);
+}
+
+static u64 *sim_ib_slot(unsigned int gpuaddr)
+{
+	unsigned int offset = gpuaddr - (unsigned int)(unsigned long)sim_emem;
+
+	if (offset >= SIM_EMEM_SIZE || offset & ((1 << SIM_IB_SHIFT) - 1))
+		return NULL;
+	return &sim_ib_slots[offset >> SIM_IB_SHIFT];
+}
+
+void gpusim_ib_register(unsigned int gpuaddr, unsigned int sizedwords)
+{
+	u64 *slot = sim_ib_slot(gpuaddr);
+
+	assert(slot);
+	__atomic_store_n(slot, (u64)sizedwords, __ATOMIC_SEQ_CST);
+}
+
+void gpusim_ib_submitted(unsigned int gpuaddr, unsigned int sizedwords,
+			 unsigned int timestamp)
+{
+	u64 *slot = sim_ib_slot(gpuaddr);
+
+	__atomic_store_n(slot, (u64)timestamp << 32 | sizedwords, __ATOMIC_SEQ_CST);
+}
+
+static void sim_check_ib(unsigned int ibaddr, unsigned int sizedwords)
+{
+	unsigned int *ib = (unsigned int *)(unsigned long)ibaddr;
+	unsigned int i, ts;
+	u64 *slot = sim_ib_slot(ibaddr), v;
+
+	if (!slot)
+		return;
+	v = __atomic_load_n(slot, __ATOMIC_SEQ_CST);
+	if (!v)
+		return;
+	ts = v >> 32;
+	// a retired registration says nothing about who owns the memory now
+	if (ts && (int)(ts - sim_eop_ts) <= 0)
+		return;
+
+	gpusim_ibs++;
+	if ((unsigned int)v != sizedwords) {
+		kshim_report("IB at 0x%08x submitted with %u dwords, registered with %u",
+			     ibaddr, sizedwords, (unsigned int)v);
+		return;
+	}
+	if (ib[0] != pm4_nop_packet(sizedwords - 1)) {
+		kshim_report("IB at 0x%08x overwritten before it retired", ibaddr);
+		return;
+	}
+	for (i = 1; i < sizedwords; i++) {
+		if (ib[i] != gpusim_ib_pattern(ibaddr, i)) {
+			kshim_report("IB at 0x%08x overwritten before it retired", ibaddr);
+			return;
+		}
+	}
+}
+
+static void sim_interrupt(void)
+{
+	gsl_device_t *device = &gsl_driver.device[GSL_DEVICE_YAMATO - 1];
+
+	sim_setreg(mmCP_INT_STATUS, sim_reg(mmCP_INT_STATUS) | CP_INT_CNTL__RB_INT_MASK);
+	sim_setreg(mmMASTER_INT_SIGNAL, MASTER_INT_SIGNAL__CP_INT_STAT_MASK);
+
+	kshim_irq_enter();
+	kgsl_intr_isr(device);
+	kshim_irq_exit();
+
+	sim_setreg(mmMASTER_INT_SIGNAL, 0);
+	sim_setreg(mmCP_INT_STATUS, 0);
+	gpusim_irqs++;
+}
+
+/* execute one packet at rptr, return its size in dwords */
+static unsigned int sim_packet(unsigned int *ring, unsigned int size, unsigned int rptr)
+{
+	unsigned int hdr = ring[rptr], count, opcode, reg, i;
+	unsigned int d[4];
+
+	count = ((hdr >> 16) & 0x3fff) + 1;
+	for (i = 0; i < 4 && i < count; i++)
+		d[i] = ring[(rptr + 1 + i) & (size - 1)];
+
+	switch (hdr >> 30) {
+	case 0:
+		reg = hdr & 0x7fff;
+		for (i = 0; i < count; i++) {
+			sim_setreg(reg + i, ring[(rptr + 1 + i) & (size - 1)]);
+			// scratch register 0 carries the start-of-pipeline timestamp
+			if (reg + i == mmSCRATCH_REG0 && (sim_reg(mmSCRATCH_UMSK) & 1))
+				sim_memwrite(sim_reg(mmSCRATCH_ADDR), ring[(rptr + 1 + i) & (size - 1)]);
+		}
+		return 1 + count;
+	case 1:
+		return 3;
+	case 2:
+		return 1;
+	}
+
+	opcode = (hdr >> 8) & 0xff;
+	switch (opcode) {
+	case PM4_INDIRECT_BUFFER:
+	case PM4_INDIRECT_BUFFER_PFD:
+		sim_check_ib(d[0], d[1]);
+		if (sim_gpu_delay_us)
+			usleep(rand() % sim_gpu_delay_us);
+		break;
+	case PM4_EVENT_WRITE:
+		if (count == 3) {
+			sim_memwrite(d[1], d[2]);
+			if ((d[0] & 0x3f) == CACHE_FLUSH_TS)
+				sim_eop_ts = d[2];
+		}
+		break;
+	case PM4_MEM_WRITE:
+		for (i = 1; i < count; i++)
+			sim_memwrite(d[0] + 4 * (i - 1), ring[(rptr + 1 + i) & (size - 1)]);
+		break;
+	case PM4_INTERRUPT:
+		sim_interrupt();
+		break;
+	}
+	return 1 + count;
+}
+
+static void *sim_cp_thread(void *arg)
+{
+	unsigned int *ring, size, rptr = 0, wptr;
+
+	kshim_set_current(0, "gpu");
+	while (sim_running) {
+		if (sim_reg(mmCP_ME_CNTL) & 0x10000000 || !sim_reg(mmCP_RB_BASE)) {
+			// halted, the ring restarts from zero
+			rptr = 0;
+			usleep(50);
+			continue;
+		}
+		ring = (unsigned int *)(unsigned long)sim_reg(mmCP_RB_BASE);
+		size = 2 << (sim_reg(mmCP_RB_CNTL) & 0x3f);
+		wptr = sim_reg(mmCP_RB_WPTR);
+		if (rptr == wptr) {
+			usleep(20);
+			continue;
+		}
+		__sync_synchronize();
+		while (rptr != wptr) {
+			rptr = (rptr + sim_packet(ring, size, rptr)) & (size - 1);
+			sim_memwrite(sim_reg(mmCP_RB_RPTR_ADDR), rptr);
+		}
+	}
+	return arg;
+}
+
+void gpusim_start(unsigned int gpu_delay_us)
+{
+	sim_gpu_delay_us = gpu_delay_us;
+	sim_regs = sim_map(GSL_HAL_SIZE_REG_YDX);
+	sim_emem = sim_map(SIM_EMEM_SIZE);
+	sim_ib_slots = calloc(SIM_IB_SLOTS, sizeof(*sim_ib_slots));
+	sim_running = 1;
+	pthread_create(&sim_cp, NULL, sim_cp_thread, NULL);
+}
+
+void gpusim_stop(void)
+{
+	sim_running = 0;
+	pthread_join(sim_cp, NULL);
+	munmap(sim_emem, SIM_EMEM_SIZE);
+	free(sim_ib_slots);
+	munmap(sim_regs, GSL_HAL_SIZE_REG_YDX);
+}
+
+//----------------------------------------------------------------------------
+// HAL, mirrors gsl_hal.c for a z430-only part with the gpu mmu off
+
+int
+kgsl_hal_init(void)
+{
+    gsl_hal_t *hal;
+
+    if (gsl_driver.hal)
+    {
+        return GSL_FAILURE_ALREADYINITIALIZED;
+    }
+
+    gsl_driver.hal = kzalloc(sizeof(gsl_hal_t), GFP_KERNEL);
+    if (!gsl_driver.hal)
+    {
+        return GSL_FAILURE_OUTOFMEM;
+    }
+    hal = (gsl_hal_t *) gsl_driver.hal;
+
+    hal->has_z430 = 1;
+    hal->has_z160 = 0;
+    gsl_driver.enable_mmu = 0;
+
+    hal->z430_regspace.mmio_virt_base = sim_regs;
+    hal->z430_regspace.mmio_phys_base = (unsigned int)(unsigned long)sim_regs;
+    hal->z430_regspace.sizebytes      = GSL_HAL_SIZE_REG_YDX;
+
+    hal->memchunk.mmio_virt_base = sim_emem;
+    hal->memchunk.mmio_phys_base = (unsigned int)(unsigned long)sim_emem;
+    hal->memchunk.sizebytes      = SIM_EMEM_SIZE;
+
+    return GSL_SUCCESS;
+}
+
+int
+kgsl_hal_close(void)
+{
+    kfree(gsl_driver.hal);
+    gsl_driver.hal = NULL;
+
+    return GSL_SUCCESS;
+}
+
+int
+kgsl_hal_getshmemconfig(gsl_shmemconfig_t *config)
+{
+    gsl_hal_t *hal = (gsl_hal_t *) gsl_driver.hal;
+
+    memset(config, 0, sizeof(gsl_shmemconfig_t));
+    if (!hal)
+    {
+        return GSL_FAILURE_DEVICEERROR;
+    }
+    config->emem_hostbase  = (unsigned int)(unsigned long)hal->memchunk.mmio_virt_base;
+    config->emem_gpubase   = hal->memchunk.mmio_phys_base;
+    config->emem_sizebytes = hal->memchunk.sizebytes;
+
+    return GSL_SUCCESS;
+}
+
+int
+kgsl_hal_getdevconfig(gsl_deviceid_t device_id, gsl_devconfig_t *config)
+{
+    gsl_hal_t       *hal = (gsl_hal_t *) gsl_driver.hal;
+    mh_mmu_config_u mmu_config = {0};
+
+    memset(config, 0, sizeof(gsl_devconfig_t));
+    if (!hal || device_id != GSL_DEVICE_YAMATO)
+    {
+        return GSL_FAILURE_DEVICEERROR;
+    }
+
+    config->regspace.mmio_virt_base = hal->z430_regspace.mmio_virt_base;
+    config->regspace.mmio_phys_base = hal->z430_regspace.mmio_phys_base;
+    config->regspace.sizebytes      = GSL_HAL_SIZE_REG_YDX;
+
+    mmu_config.f.mmu_enable = 1;
+    config->mmu_config      = mmu_config.val;
+    config->va_base         = 0x00000000;
+    config->va_range        = 0x00000000;
+    config->mpu_base        = 0x00000000;
+    config->mpu_range       = 0xFFFFF000;
+
+    return GSL_SUCCESS;
+}
+
+gsl_chipid_t
+kgsl_hal_getchipid(gsl_deviceid_t device_id)
+{
+    return (device_id == GSL_DEVICE_YAMATO) ? 0x02000000 : 0;
+}
+
+int
+kgsl_hal_setpowerstate(gsl_deviceid_t device_id, int state, unsigned int value)
+{
+    return GSL_SUCCESS;
+}
+
+int
+kgsl_clock(gsl_deviceid_t dev, int enable)
+{
+    return GSL_SUCCESS;
+}
+
+// no clock autogating in the simulator
+int
+kgsl_device_active(gsl_device_t *dev)
+{
+    return 0;
+}
+
+// the linux map is only used with the gpu mmu on
+void *gsl_linux_map_read(void *dst, unsigned int gpuoffset, unsigned int sizebytes, unsigned int touserspace)
+{
+    return NULL;
+}
+
+void *gsl_linux_map_write(void *src, unsigned int gpuoffset, unsigned int sizebytes, unsigned int fromuserspace)
+{
+    return NULL;
+}
+
+void *gsl_linux_map_set(unsigned int gpuoffset, unsigned int value, unsigned int sizebytes)
+{
+    return NULL;
+}
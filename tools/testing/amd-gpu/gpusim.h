@@ -0,0 +1,14 @@
+#ifndef GPUSIM_H
+#define GPUSIM_H
+
+void gpusim_start(unsigned int gpu_delay_us);
+void gpusim_stop(void);
+unsigned int gpusim_ib_pattern(unsigned int gpuaddr, int i);
+void gpusim_ib_register(unsigned int gpuaddr, unsigned int sizedwords);
+void gpusim_ib_submitted(unsigned int gpuaddr, unsigned int sizedwords,
+			 unsigned int timestamp);
+
+extern unsigned long gpusim_irqs;
+extern unsigned long gpusim_ibs;
+
+#endif
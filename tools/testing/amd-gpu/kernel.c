@@ -0,0 +1,403 @@
+/*
+ * User space runtime behind linux/kernel.h: lock checking, time, wait
+ * queues and a single shared workqueue thread standing in for keventd.
+ */
+#define _GNU_SOURCE
+#include <linux/kernel.h>
+#include <stdarg.h>
+#include <time.h>
+#include <unistd.h>
+#include <sched.h>
+
+#define KSHIM_HELD_MAX		16
+#define KSHIM_CLASS_MAX		64
+#define KSHIM_THREAD_MAX	64
+
+int kshim_verbose;
+int kshim_errors;
+
+struct kshim_thread {
+	struct task_struct task;
+	struct kshim_lock *held[KSHIM_HELD_MAX];
+	int nheld;
+	int nspin;
+	struct kshim_lock *waiting;
+};
+
+static __thread struct kshim_thread *self;
+static struct kshim_thread *threads[KSHIM_THREAD_MAX];
+static int nthreads;
+
+/* lock classes are keyed by the expression that initialised the lock */
+static const char *classes[KSHIM_CLASS_MAX];
+static int nclasses;
+static unsigned char order[KSHIM_CLASS_MAX][KSHIM_CLASS_MAX];
+static pthread_mutex_t shim_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void kshim_report(const char *fmt, ...)
+{
+	va_list ap;
+
+	pthread_mutex_lock(&shim_lock);
+	fprintf(stderr, "BUG: [%s] ", self ? self->task.comm : "?");
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	fputc('\n', stderr);
+	kshim_errors++;
+	pthread_mutex_unlock(&shim_lock);
+}
+
+static struct kshim_thread *this_thread(void)
+{
+	if (!self) {
+		self = calloc(1, sizeof(*self));
+		self->task.pid = self->task.tgid = 1;
+		self->task.comm = "main";
+		pthread_mutex_lock(&shim_lock);
+		if (nthreads < KSHIM_THREAD_MAX)
+			threads[nthreads++] = self;
+		pthread_mutex_unlock(&shim_lock);
+	}
+	return self;
+}
+
+struct task_struct *kshim_current(void)
+{
+	return &this_thread()->task;
+}
+
+void kshim_set_current(int tgid, const char *comm)
+{
+	struct kshim_thread *t = this_thread();
+
+	t->task.tgid = tgid;
+	t->task.pid = tgid;
+	t->task.comm = comm;
+}
+
+/* the simulated gpu interrupt runs in atomic context */
+void kshim_irq_enter(void)
+{
+	this_thread()->nspin++;
+}
+
+void kshim_irq_exit(void)
+{
+	this_thread()->nspin--;
+}
+
+void kshim_might_sleep(const char *what)
+{
+	struct kshim_thread *t = this_thread();
+	int i;
+
+	if (!t->nspin)
+		return;
+	for (i = t->nheld - 1; i >= 0; i--)
+		if (t->held[i]->spin)
+			break;
+	kshim_report("%s may sleep but %s is held", what,
+		     i >= 0 ? t->held[i]->name : "interrupt context");
+}
+
+static int class_of(const char *name)
+{
+	int i;
+
+	for (i = 0; i < nclasses; i++)
+		if (!strcmp(classes[i], name))
+			return i;
+	assert(nclasses < KSHIM_CLASS_MAX);
+	classes[nclasses] = name;
+	return nclasses++;
+}
+
+void kshim_lock_init(struct kshim_lock *l, const char *name, int spin)
+{
+	pthread_mutex_init(&l->m, NULL);
+	l->name = name;
+	l->held = 0;
+	l->spin = spin;
+}
+
+/* record that every lock held now nests outside l, and catch inversions */
+static void check_order(struct kshim_thread *t, struct kshim_lock *l)
+{
+	int i, c, h;
+
+	pthread_mutex_lock(&shim_lock);
+	c = class_of(l->name);
+	for (i = 0; i < t->nheld; i++) {
+		h = class_of(t->held[i]->name);
+		if (h == c) {
+			pthread_mutex_unlock(&shim_lock);
+			kshim_report("nested %s locking", l->name);
+			pthread_mutex_lock(&shim_lock);
+			continue;
+		}
+		if (order[c][h] == 1) {
+			order[c][h] = 2;
+			pthread_mutex_unlock(&shim_lock);
+			kshim_report("lock inversion: %s taken inside %s, elsewhere the other way round",
+				     l->name, t->held[i]->name);
+			pthread_mutex_lock(&shim_lock);
+		}
+		if (!order[h][c])
+			order[h][c] = 1;
+	}
+	pthread_mutex_unlock(&shim_lock);
+}
+
+static void acquired(struct kshim_thread *t, struct kshim_lock *l)
+{
+	l->owner = pthread_self();
+	l->held = 1;
+	assert(t->nheld < KSHIM_HELD_MAX);
+	t->held[t->nheld++] = l;
+	if (l->spin)
+		t->nspin++;
+}
+
+void kshim_lock(struct kshim_lock *l)
+{
+	struct kshim_thread *t = this_thread();
+
+	if (!l->spin)
+		kshim_might_sleep(l->name);
+	if (l->held && pthread_equal(l->owner, pthread_self())) {
+		kshim_report("recursive locking of %s", l->name);
+		abort();
+	}
+	check_order(t, l);
+	t->waiting = l;
+	pthread_mutex_lock(&l->m);
+	t->waiting = NULL;
+	acquired(t, l);
+}
+
+int kshim_trylock(struct kshim_lock *l)
+{
+	if (pthread_mutex_trylock(&l->m))
+		return 0;
+	acquired(this_thread(), l);
+	return 1;
+}
+
+void kshim_unlock(struct kshim_lock *l)
+{
+	struct kshim_thread *t = this_thread();
+	int i;
+
+	for (i = t->nheld - 1; i >= 0; i--)
+		if (t->held[i] == l)
+			break;
+	if (i < 0 || !l->held) {
+		kshim_report("unlocking %s which this thread does not hold", l->name);
+		abort();
+	}
+	memmove(&t->held[i], &t->held[i + 1], (t->nheld - i - 1) * sizeof(t->held[0]));
+	t->nheld--;
+	if (l->spin)
+		t->nspin--;
+	l->held = 0;
+	pthread_mutex_unlock(&l->m);
+}
+
+/* print who holds what, for the deadlock watchdog */
+void kshim_dump_locks(void)
+{
+	struct kshim_thread *t;
+	int i, j;
+
+	for (i = 0; i < nthreads; i++) {
+		t = threads[i];
+		if (!t->nheld && !t->waiting)
+			continue;
+		fprintf(stderr, "  %s:", t->task.comm);
+		for (j = 0; j < t->nheld; j++)
+			fprintf(stderr, " holds %s", t->held[j]->name);
+		if (t->waiting)
+			fprintf(stderr, " waits for %s", t->waiting->name);
+		fputc('\n', stderr);
+	}
+}
+
+static u64 now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+unsigned long kshim_jiffies(void)
+{
+	return (unsigned long)(now_ns() / 1000000) + 100000;
+}
+
+ktime_t ktime_get(void)
+{
+	ktime_t k = { .tv64 = (s64)now_ns() };
+	return k;
+}
+
+void udelay(unsigned long usecs)
+{
+	u64 end = now_ns() + usecs * 1000;
+
+	while (now_ns() < end)
+		;
+}
+
+void msleep(unsigned int msecs)
+{
+	kshim_might_sleep("msleep");
+	usleep(msecs * 1000);
+}
+
+void init_waitqueue_head(wait_queue_head_t *q)
+{
+	pthread_condattr_t a;
+
+	pthread_condattr_init(&a);
+	pthread_condattr_setclock(&a, CLOCK_MONOTONIC);
+	pthread_mutex_init(&q->m, NULL);
+	pthread_cond_init(&q->c, &a);
+}
+
+void wake_up_all(wait_queue_head_t *q)
+{
+	pthread_mutex_lock(&q->m);
+	pthread_cond_broadcast(&q->c);
+	pthread_mutex_unlock(&q->m);
+}
+
+void kshim_wait_tick(wait_queue_head_t *q)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	ts.tv_nsec += 1000000;
+	if (ts.tv_nsec >= 1000000000) {
+		ts.tv_sec++;
+		ts.tv_nsec -= 1000000000;
+	}
+	pthread_mutex_lock(&q->m);
+	pthread_cond_timedwait(&q->c, &q->m, &ts);
+	pthread_mutex_unlock(&q->m);
+}
+
+/* keventd */
+static pthread_mutex_t wq_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wq_cond = PTHREAD_COND_INITIALIZER;
+static struct work_struct *wq_head, *wq_tail, *wq_running;
+static pthread_t wq_thread;
+static int wq_stop;
+
+int schedule_work(struct work_struct *work)
+{
+	pthread_mutex_lock(&wq_lock);
+	if (work->pending) {
+		pthread_mutex_unlock(&wq_lock);
+		return 0;
+	}
+	work->pending = 1;
+	work->next = NULL;
+	if (wq_tail)
+		wq_tail->next = work;
+	else
+		wq_head = work;
+	wq_tail = work;
+	pthread_cond_broadcast(&wq_cond);
+	pthread_mutex_unlock(&wq_lock);
+	return 1;
+}
+
+struct workqueue_struct *create_singlethread_workqueue(const char *name)
+{
+	struct workqueue_struct *wq = malloc(sizeof(*wq));
+
+	wq->name = name;
+	return wq;
+}
+
+int cancel_work_sync(struct work_struct *work)
+{
+	struct work_struct **pp, *prev = NULL;
+	int ret = 0;
+
+	kshim_might_sleep("cancel_work_sync");
+	pthread_mutex_lock(&wq_lock);
+	for (pp = &wq_head; *pp; prev = *pp, pp = &(*pp)->next) {
+		if (*pp == work) {
+			*pp = work->next;
+			if (wq_tail == work)
+				wq_tail = prev;
+			work->pending = 0;
+			ret = 1;
+			break;
+		}
+	}
+	while (wq_running == work)
+		pthread_cond_wait(&wq_cond, &wq_lock);
+	pthread_mutex_unlock(&wq_lock);
+	return ret;
+}
+
+void flush_scheduled_work(void)
+{
+	kshim_might_sleep("flush_scheduled_work");
+	pthread_mutex_lock(&wq_lock);
+	while (wq_head || wq_running)
+		pthread_cond_wait(&wq_cond, &wq_lock);
+	pthread_mutex_unlock(&wq_lock);
+}
+
+static void *worker(void *arg)
+{
+	struct work_struct *work;
+
+	kshim_set_current(0, "kworker");
+	pthread_mutex_lock(&wq_lock);
+	while (!wq_stop || wq_head) {
+		work = wq_head;
+		if (!work) {
+			pthread_cond_wait(&wq_cond, &wq_lock);
+			continue;
+		}
+		wq_head = work->next;
+		if (!wq_head)
+			wq_tail = NULL;
+		work->pending = 0;
+		wq_running = work;
+		pthread_mutex_unlock(&wq_lock);
+
+		work->func(work);
+		if (this_thread()->nheld)
+			kshim_report("work %p returned with %s held", work,
+				     this_thread()->held[0]->name);
+
+		pthread_mutex_lock(&wq_lock);
+		wq_running = NULL;
+		pthread_cond_broadcast(&wq_cond);
+	}
+	pthread_mutex_unlock(&wq_lock);
+	return arg;
+}
+
+void kshim_start(void)
+{
+	this_thread();
+	wq_stop = 0;
+	pthread_create(&wq_thread, NULL, worker, NULL);
+}
+
+void kshim_stop(void)
+{
+	pthread_mutex_lock(&wq_lock);
+	wq_stop = 1;
+	pthread_cond_broadcast(&wq_cond);
+	pthread_mutex_unlock(&wq_lock);
+	pthread_join(wq_thread, NULL);
+}
@@ -0,0 +1,4 @@
+#ifndef LINUX_COMPLETION_H
+#define LINUX_COMPLETION_H
+#include <linux/kernel.h>
+#endif
@@ -0,0 +1,6 @@
+#ifndef LINUX_IO_H
+#define LINUX_IO_H
+#include <linux/kernel.h>
+/* the ARM io.h pulls these in through mach/hardware.h */
+#include "../../../../arch/arm/include/asm/sizes.h"
+#endif
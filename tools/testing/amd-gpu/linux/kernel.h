@@ -0,0 +1,294 @@
+#ifndef LINUX_KERNEL_H
+#define LINUX_KERNEL_H
+
+/*
+ * Just enough of the kernel API to run the amd-gpu core in user space.
+ * Mutexes and spinlocks are pthread mutexes that remember which thread
+ * holds them, so the shim can catch what lockdep would: lock order
+ * inversions, recursive locking, unlocking a lock we don't hold and
+ * sleeping with a spinlock held.  Every such report bumps kshim_errors.
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <assert.h>
+#include <pthread.h>
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef unsigned long long u64;
+typedef int8_t s8;
+typedef int16_t s16;
+typedef int32_t s32;
+typedef long long s64;
+typedef uint8_t __u8;
+typedef uint16_t __u16;
+typedef uint32_t __u32;
+typedef unsigned long long __u64;
+typedef int32_t __s32;
+typedef long long __s64;
+
+#define __iomem
+#define __user
+#define __init
+#define __exit
+#define EXPORT_SYMBOL(sym)
+#define likely(x)		__builtin_expect(!!(x), 1)
+#define unlikely(x)		__builtin_expect(!!(x), 0)
+
+#define container_of(ptr, type, member) \
+	((type *)((char *)(ptr) - offsetof(type, member)))
+#define ARRAY_SIZE(a)		(sizeof(a) / sizeof((a)[0]))
+#define min(x, y)		((x) < (y) ? (x) : (y))
+#define max(x, y)		((x) > (y) ? (x) : (y))
+
+#define BUG_ON(c)		assert(!(c))
+#define WARN_ON(c)		({ int __c = !!(c); if (__c) kshim_report("WARN_ON(%s) at %s:%d", #c, __FILE__, __LINE__); __c; })
+
+static inline int fls(int x)
+{
+	return x ? 32 - __builtin_clz(x) : 0;
+}
+
+#define ilog2(n)		(63 - __builtin_clzll((unsigned long long)(n)))
+
+/* printk */
+#define KERN_EMERG		""
+#define KERN_ALERT		""
+#define KERN_CRIT		""
+#define KERN_ERR		""
+#define KERN_WARNING		""
+#define KERN_NOTICE		""
+#define KERN_INFO		""
+#define KERN_DEBUG		""
+extern int kshim_verbose;
+#define printk(fmt, ...)	({ if (kshim_verbose) fprintf(stderr, fmt, ##__VA_ARGS__); 0; })
+#define pr_info(fmt, ...)	printk(fmt, ##__VA_ARGS__)
+#define pr_err(fmt, ...)	printk(fmt, ##__VA_ARGS__)
+#define printk_ratelimit()	1
+
+extern int kshim_errors;
+void kshim_report(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+/* tasks: each test thread pretends to belong to a process */
+struct task_struct {
+	int pid;
+	int tgid;
+	const char *comm;
+};
+struct task_struct *kshim_current(void);
+void kshim_set_current(int tgid, const char *comm);
+#define current			kshim_current()
+
+/* allocation */
+#define GFP_KERNEL		0x10u
+#define GFP_NOWAIT		0x00u
+#define GFP_ATOMIC		0x20u
+void kshim_might_sleep(const char *what);
+static inline void *kmalloc(size_t size, unsigned int flags)
+{
+	if (flags & GFP_KERNEL)
+		kshim_might_sleep("kmalloc(GFP_KERNEL)");
+	return malloc(size);
+}
+static inline void *kzalloc(size_t size, unsigned int flags)
+{
+	if (flags & GFP_KERNEL)
+		kshim_might_sleep("kzalloc(GFP_KERNEL)");
+	return calloc(1, size);
+}
+#define kfree(p)		free((void *)(p))
+static inline void *vmalloc(size_t size)
+{
+	kshim_might_sleep("vmalloc");
+	return malloc(size);
+}
+#define vfree(p)		free(p)
+
+/* time, HZ is 1000 so a jiffy is a millisecond */
+#define HZ			1000
+unsigned long kshim_jiffies(void);
+#define jiffies			kshim_jiffies()
+#define msecs_to_jiffies(ms)	((unsigned long)(ms))
+#define jiffies_to_msecs(j)	((unsigned int)(j))
+#define jiffies_to_usecs(j)	((unsigned int)(j) * 1000u)
+#define time_after(a, b)	((long)((b) - (a)) < 0)
+
+typedef union {
+	s64 tv64;
+} ktime_t;
+ktime_t ktime_get(void);
+static inline ktime_t ktime_set(long secs, unsigned long nsecs)
+{
+	ktime_t k = { .tv64 = (s64)secs * 1000000000LL + nsecs };
+	return k;
+}
+static inline ktime_t ktime_sub(ktime_t a, ktime_t b)
+{
+	ktime_t k = { .tv64 = a.tv64 - b.tv64 };
+	return k;
+}
+#define ktime_to_ns(k)		((k).tv64)
+#define ktime_to_us(k)		((k).tv64 / 1000)
+#define ktime_us_delta(a, b)	(ktime_to_us(ktime_sub(a, b)))
+
+void udelay(unsigned long usecs);
+void msleep(unsigned int msecs);
+#define mdelay(ms)		udelay((ms) * 1000)
+#define cpu_relax()		sched_yield()
+int sched_yield(void);
+
+/* barriers and mmio: register space is plain memory */
+#define mb()			__sync_synchronize()
+#define rmb()			__sync_synchronize()
+#define wmb()			__sync_synchronize()
+#define dsb()			__sync_synchronize()
+#define readl(a)		({ u32 __v = *(volatile u32 *)(a); rmb(); __v; })
+#define writel(v, a)		({ wmb(); *(volatile u32 *)(a) = (v); })
+#define __raw_readl(a)		(*(volatile u32 *)(a))
+#define __raw_writel(v, a)	(*(volatile u32 *)(a) = (v))
+
+static inline unsigned long copy_to_user(void *to, const void *from, unsigned long n)
+{
+	memcpy(to, from, n);
+	return 0;
+}
+static inline unsigned long copy_from_user(void *to, const void *from, unsigned long n)
+{
+	memcpy(to, from, n);
+	return 0;
+}
+
+/* locks */
+struct kshim_lock {
+	pthread_mutex_t m;
+	const char *name;
+	pthread_t owner;
+	int held;
+	int spin;
+};
+
+struct mutex {
+	struct kshim_lock l;
+};
+typedef struct {
+	struct kshim_lock l;
+} spinlock_t;
+
+#define KSHIM_LOCK_INIT(n, s)	{ PTHREAD_MUTEX_INITIALIZER, n, 0, 0, s }
+
+void kshim_lock_init(struct kshim_lock *l, const char *name, int spin);
+void kshim_lock(struct kshim_lock *l);
+int kshim_trylock(struct kshim_lock *l);
+void kshim_unlock(struct kshim_lock *l);
+
+#define DEFINE_MUTEX(x)		struct mutex x = { KSHIM_LOCK_INIT(#x, 0) }
+#define mutex_init(x)		kshim_lock_init(&(x)->l, #x, 0)
+#define mutex_lock(x)		kshim_lock(&(x)->l)
+#define mutex_lock_interruptible(x) (kshim_lock(&(x)->l), 0)
+#define mutex_trylock(x)	kshim_trylock(&(x)->l)
+#define mutex_unlock(x)		kshim_unlock(&(x)->l)
+#define mutex_is_locked(x)	((x)->l.held)
+
+#define DEFINE_SPINLOCK(x)	spinlock_t x = { KSHIM_LOCK_INIT(#x, 1) }
+#define spin_lock_init(x)	kshim_lock_init(&(x)->l, #x, 1)
+#define spin_lock(x)		kshim_lock(&(x)->l)
+#define spin_unlock(x)		kshim_unlock(&(x)->l)
+#define spin_lock_bh(x)		kshim_lock(&(x)->l)
+#define spin_unlock_bh(x)	kshim_unlock(&(x)->l)
+#define spin_lock_irq(x)	kshim_lock(&(x)->l)
+#define spin_unlock_irq(x)	kshim_unlock(&(x)->l)
+#define spin_lock_irqsave(x, f)	do { (f) = 0; kshim_lock(&(x)->l); } while (0)
+#define spin_unlock_irqrestore(x, f) do { (void)(f); kshim_unlock(&(x)->l); } while (0)
+
+/* wait queues, completions and the shared workqueue */
+typedef struct {
+	pthread_mutex_t m;
+	pthread_cond_t c;
+} wait_queue_head_t;
+
+void init_waitqueue_head(wait_queue_head_t *q);
+void wake_up_all(wait_queue_head_t *q);
+#define wake_up(q)			wake_up_all(q)
+#define wake_up_interruptible(q)	wake_up_all(q)
+#define wake_up_interruptible_all(q)	wake_up_all(q)
+/* wait at most a jiffy at a time, wakeups that race the check cost a tick */
+void kshim_wait_tick(wait_queue_head_t *q);
+
+#define wait_event_interruptible_timeout(q, cond, timeout)		\
+({									\
+	unsigned long __end = jiffies + (timeout);			\
+	long __ret = 0;							\
+	kshim_might_sleep("wait_event");				\
+	for (;;) {							\
+		if (cond) {						\
+			__ret = (long)(__end - jiffies);		\
+			__ret = __ret > 0 ? __ret : 1;			\
+			break;						\
+		}							\
+		if (time_after(jiffies, __end))				\
+			break;						\
+		kshim_wait_tick(&(q));					\
+	}								\
+	__ret;								\
+})
+#define wait_event_timeout(q, cond, timeout) \
+	wait_event_interruptible_timeout(q, cond, timeout)
+#define wait_event_interruptible(q, cond) \
+	({ while (!(wait_event_interruptible_timeout(q, cond, HZ))) ; 0; })
+#define wait_event(q, cond)	((void)wait_event_interruptible(q, cond))
+
+struct completion {
+	unsigned int done;
+	wait_queue_head_t wait;
+};
+static inline void init_completion(struct completion *x)
+{
+	x->done = 0;
+	init_waitqueue_head(&x->wait);
+}
+#define INIT_COMPLETION(x)	((x).done = 0)
+static inline void complete_all(struct completion *x)
+{
+	__sync_lock_test_and_set(&x->done, UINT_MAX / 2);
+	wake_up_all(&x->wait);
+}
+#define complete(x)		complete_all(x)
+#define wait_for_completion_timeout(x, t) \
+	wait_event_interruptible_timeout((x)->wait, (x)->done, t)
+#define wait_for_completion_interruptible_timeout(x, t) \
+	wait_for_completion_timeout(x, t)
+#define wait_for_completion(x)	((void)wait_event_interruptible((x)->wait, (x)->done))
+
+struct work_struct;
+typedef void (*work_func_t)(struct work_struct *work);
+struct work_struct {
+	work_func_t func;
+	struct work_struct *next;
+	int pending;
+};
+#define INIT_WORK(w, f)		do { (w)->func = (f); (w)->next = NULL; (w)->pending = 0; } while (0)
+int schedule_work(struct work_struct *work);
+/* every workqueue is the shared one */
+struct workqueue_struct {
+	const char *name;
+};
+struct workqueue_struct *create_singlethread_workqueue(const char *name);
+#define destroy_workqueue(wq)	free(wq)
+#define queue_work(wq, work)	schedule_work(work)
+int cancel_work_sync(struct work_struct *work);
+void flush_scheduled_work(void);
+void kshim_start(void);
+void kshim_stop(void);
+void kshim_irq_enter(void);
+void kshim_irq_exit(void);
+void kshim_dump_locks(void);
+
+#endif
@@ -0,0 +1,4 @@
+#ifndef LINUX_KTIME_H
+#define LINUX_KTIME_H
+#include <linux/kernel.h>
+#endif
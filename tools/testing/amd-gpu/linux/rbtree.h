@@ -0,0 +1,5 @@
+#ifndef LINUX_RBTREE_SHIM_H
+#define LINUX_RBTREE_SHIM_H
+#include <linux/kernel.h>
+#include "../../../../include/linux/rbtree.h"
+#endif
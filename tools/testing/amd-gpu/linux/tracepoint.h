@@ -0,0 +1,9 @@
+#ifndef LINUX_TRACEPOINT_H
+#define LINUX_TRACEPOINT_H
+#include <linux/kernel.h>
+
+#define TP_PROTO(args...)	args
+#define TP_ARGS(args...)	args
+#define TRACE_EVENT(name, proto, args, tstruct, assign, print) \
+	static inline void trace_##name(proto) { }
+#endif
@@ -0,0 +1,4 @@
+#ifndef LINUX_TYPES_H
+#define LINUX_TYPES_H
+#include <linux/kernel.h>
+#endif
@@ -0,0 +1,4 @@
+#ifndef LINUX_UACCESS_H
+#define LINUX_UACCESS_H
+#include <linux/kernel.h>
+#endif
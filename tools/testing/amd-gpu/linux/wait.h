@@ -0,0 +1,4 @@
+#ifndef LINUX_WAIT_H
+#define LINUX_WAIT_H
+#include <linux/kernel.h>
+#endif
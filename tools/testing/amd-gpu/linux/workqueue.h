@@ -0,0 +1,4 @@
+#ifndef LINUX_WORKQUEUE_H
+#define LINUX_WORKQUEUE_H
+#include <linux/kernel.h>
+#endif
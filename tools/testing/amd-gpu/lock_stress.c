@@ -0,0 +1,345 @@
+/*
+ * Locking stress test for the amd-gpu core.
+ *
+ * Each thread plays a process with its own tgid.  It opens the driver,
+ * starts the z430, creates a draw context and then mixes submissions
+ * (single and batched), timestamp waits, deferred frees, direct shared
+ * memory alloc/free, gmem shadow binds on its context and context
+ * recreation, while the simulated CP retires work and raises timestamp
+ * interrupts from its own thread.  That covers the driver lock, the
+ * per-device lock, the per-context locks, the memqueue and latency
+ * spinlocks, the arena lock and the retire work all at once.
+ *
+ * The run fails if the lock checker in linux/kernel.h reports anything,
+ * if a thread makes no progress for the watchdog period (the held locks
+ * are dumped), if a timestamp never retires, if timestamps go backwards,
+ * if two live allocations overlap, if the CP finds an indirect buffer
+ * reused before it retired, or if shared memory leaks over the run.
+ *
+ *	make check
+ *	./lock_stress -t 16 -s 30 -d 50
+ */
+#define _GNU_SOURCE
+#include <getopt.h>
+#include <unistd.h>
+
+#include "gsl.h"
+#include "gsl_hal.h"
+#include "gpusim.h"
+
+#define DEV		GSL_DEVICE_YAMATO
+#define LIVE_MAX	16
+#define WATCHDOG_SECS	10
+
+struct worker {
+	pthread_t thread;
+	int index;
+	char comm[16];
+	unsigned int seed;
+	unsigned long submits, waits, frees, allocs, binds, sessions;
+};
+
+static DEFINE_MUTEX(open_mutex);	/* gsl_mutex in gsl_kmod.c */
+static volatile int stop;
+static unsigned long progress;
+
+static int nthreads = 8;
+static int seconds = 5;
+static int gpu_delay_us = 100;
+
+static void fill(gsl_memdesc_t *m, unsigned int tag)
+{
+	unsigned int *p = m->hostptr;
+	unsigned int i;
+
+	for (i = 0; i < m->size / 4; i++)
+		p[i] = tag ^ i;
+}
+
+static void check(gsl_memdesc_t *m, unsigned int tag)
+{
+	unsigned int *p = m->hostptr;
+	unsigned int i;
+
+	for (i = 0; i < m->size / 4; i++) {
+		if (p[i] != (tag ^ i)) {
+			kshim_report("allocation at 0x%08x was overwritten by another owner", m->gpuaddr);
+			return;
+		}
+	}
+}
+
+/* an indirect buffer the simulated CP will check, see gpusim.c */
+static int ib_alloc(gsl_memdesc_t *m, unsigned int sizedwords)
+{
+	unsigned int *p, i;
+
+	if (kgsl_sharedmem_alloc(DEV, 0, sizedwords * 4, m) != GSL_SUCCESS)
+		return -1;
+	/* the arena rounds the size up, use all of it */
+	sizedwords = m->size / 4;
+	p = m->hostptr;
+	p[0] = pm4_nop_packet(sizedwords - 1);
+	for (i = 1; i < sizedwords; i++)
+		p[i] = gpusim_ib_pattern(m->gpuaddr, i);
+	gpusim_ib_register(m->gpuaddr, sizedwords);
+	return 0;
+}
+
+static int ts_before(gsl_timestamp_t a, gsl_timestamp_t b)
+{
+	return (int)(a - b) < 0;
+}
+
+static void submit(struct worker *w, unsigned int ctx, gsl_timestamp_t *last)
+{
+	gsl_ibdesc_t ibdesc[4];
+	gsl_memdesc_t ib[4];
+	gsl_timestamp_t ts;
+	int n, i, status;
+
+	n = 1 + rand_r(&w->seed) % 4;
+	for (i = 0; i < n; i++) {
+		if (ib_alloc(&ib[i], 4 + rand_r(&w->seed) % 60))
+			break;
+		ibdesc[i].ibaddr = ib[i].gpuaddr;
+		ibdesc[i].sizedwords = ib[i].size / 4;
+		ibdesc[i].flags = GSL_IBDESC_FLAGS_NONE;
+	}
+	n = i;
+	if (!n)
+		return;
+
+	if (n == 1)
+		status = kgsl_cmdstream_issueibcmds(DEV, ctx, ibdesc[0].ibaddr,
+						    ibdesc[0].sizedwords, &ts, 0);
+	else
+		status = kgsl_cmdstream_issueibcmds_multi(DEV, ctx, ibdesc, n, &ts, 0);
+
+	if (status != GSL_SUCCESS) {
+		kshim_report("submission of %d IBs failed: %d", n, status);
+		for (i = 0; i < n; i++) {
+			gpusim_ib_register(ib[i].gpuaddr, 0);
+			kgsl_sharedmem_free(&ib[i]);
+		}
+		return;
+	}
+	if (*last && !ts_before(*last, ts))
+		kshim_report("timestamp went from %u to %u", *last, ts);
+	*last = ts;
+	w->submits++;
+
+	/* the gpu may still be reading them, let the retire work free them */
+	for (i = 0; i < n; i++) {
+		gpusim_ib_submitted(ib[i].gpuaddr, ibdesc[i].sizedwords, ts);
+		kgsl_cmdstream_freememontimestamp(DEV, &ib[i], ts, GSL_TIMESTAMP_RETIRED);
+		w->frees++;
+	}
+
+	if (rand_r(&w->seed) % 4 == 0) {
+		if (kgsl_cmdstream_waittimestamp(DEV, ts, 2000) != GSL_SUCCESS)
+			kshim_report("timestamp %u did not retire within 2s", ts);
+		else if (ts_before(kgsl_cmdstream_readtimestamp(DEV, GSL_TIMESTAMP_RETIRED), ts))
+			kshim_report("waited for %u but retired is behind", ts);
+		w->waits++;
+	}
+}
+
+static void bind_shadow(struct worker *w, unsigned int ctx)
+{
+	gsl_buffer_desc_t buf;
+	gsl_rect_t rect;
+
+	memset(&buf, 0, sizeof(buf));
+	memset(&rect, 0, sizeof(rect));
+	buf.enabled = 0;
+	kgsl_drawctxt_bind_gmem_shadow(DEV, ctx, &rect, 0, 0, &buf, rand_r(&w->seed) % 2);
+	w->binds++;
+}
+
+static void session(struct worker *w)
+{
+	gsl_memdesc_t live[LIVE_MAX];
+	unsigned int tags[LIVE_MAX];
+	gsl_timestamp_t last = 0;
+	unsigned int ctx;
+	int nlive = 0, i, op, ops;
+
+	mutex_lock(&open_mutex);
+	if (kgsl_driver_entry(0) != GSL_SUCCESS) {
+		mutex_unlock(&open_mutex);
+		kshim_report("kgsl_driver_entry failed");
+		return;
+	}
+	mutex_unlock(&open_mutex);
+
+	if (kgsl_device_start(DEV, 0) != GSL_SUCCESS)
+		kshim_report("kgsl_device_start failed");
+	if (kgsl_context_create(DEV, GSL_CONTEXT_TYPE_OPENGL, &ctx, 0) != GSL_SUCCESS) {
+		kshim_report("kgsl_context_create failed");
+		goto out;
+	}
+
+	ops = 200 + rand_r(&w->seed) % 800;
+	while (ops-- && !stop) {
+		op = rand_r(&w->seed) % 100;
+		if (op < 60) {
+			submit(w, ctx, &last);
+		} else if (op < 80 && nlive < LIVE_MAX) {
+			if (kgsl_sharedmem_alloc(DEV, 0, 64 + rand_r(&w->seed) % 16384, &live[nlive]) == GSL_SUCCESS) {
+				tags[nlive] = rand_r(&w->seed);
+				fill(&live[nlive], tags[nlive]);
+				nlive++;
+				w->allocs++;
+			}
+		} else if (op < 90 && nlive) {
+			i = rand_r(&w->seed) % nlive;
+			check(&live[i], tags[i]);
+			kgsl_sharedmem_free(&live[i]);
+			live[i] = live[--nlive];
+			tags[i] = tags[nlive];
+		} else if (op < 97) {
+			bind_shadow(w, ctx);
+		} else {
+			kgsl_context_destroy(DEV, ctx);
+			if (kgsl_context_create(DEV, GSL_CONTEXT_TYPE_OPENGL, &ctx, 0) != GSL_SUCCESS) {
+				kshim_report("kgsl_context_create failed");
+				break;
+			}
+		}
+		__sync_fetch_and_add(&progress, 1);
+	}
+
+	while (nlive--) {
+		check(&live[nlive], tags[nlive]);
+		kgsl_sharedmem_free(&live[nlive]);
+	}
+	kgsl_context_destroy(DEV, ctx);
+out:
+	kgsl_device_stop(DEV);
+
+	mutex_lock(&open_mutex);
+	if (kgsl_driver_exit() != GSL_SUCCESS)
+		kshim_report("kgsl_driver_exit failed");
+	mutex_unlock(&open_mutex);
+	w->sessions++;
+}
+
+static void *worker(void *arg)
+{
+	struct worker *w = arg;
+
+	kshim_set_current(100 + w->index, w->comm);
+	while (!stop)
+		session(w);
+	return NULL;
+}
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr, "usage: %s [-t threads] [-s seconds] [-d max gpu us per IB] [-v]\n", argv0);
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	struct worker *workers;
+	unsigned long last_progress = 0, total[6] = { 0 };
+	unsigned int free_before, free_after;
+	gsl_device_t *device = &gsl_driver.device[DEV - 1];
+	int i, c, idle = 0;
+
+	while ((c = getopt(argc, argv, "t:s:d:v")) != -1) {
+		switch (c) {
+		case 't':
+			nthreads = atoi(optarg);
+			break;
+		case 's':
+			seconds = atoi(optarg);
+			break;
+		case 'd':
+			gpu_delay_us = atoi(optarg);
+			break;
+		case 'v':
+			kshim_verbose = 1;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	/* one draw context each */
+	if (nthreads < 1 || nthreads > GSL_CONTEXT_MAX)
+		usage(argv[0]);
+
+	kshim_start();
+	gpusim_start(gpu_delay_us);
+
+	/* keep the driver and the z430 up for the whole run */
+	kgsl_driver_init();
+	if (kgsl_driver_entry(0) != GSL_SUCCESS || kgsl_device_start(DEV, 0) != GSL_SUCCESS) {
+		fprintf(stderr, "could not bring up the simulated z430\n");
+		return 1;
+	}
+	free_before = kgsl_sharedmem_largestfreeblock(DEV, 0);
+
+	workers = calloc(nthreads, sizeof(*workers));
+	for (i = 0; i < nthreads; i++) {
+		workers[i].index = i;
+		workers[i].seed = i + 1;
+		snprintf(workers[i].comm, sizeof(workers[i].comm), "proc%d", i);
+		pthread_create(&workers[i].thread, NULL, worker, &workers[i]);
+	}
+
+	for (i = 0; i < seconds; i++) {
+		sleep(1);
+		if (progress == last_progress) {
+			if (++idle >= WATCHDOG_SECS) {
+				fprintf(stderr, "no progress for %d seconds, deadlock?\n", idle);
+				kshim_dump_locks();
+				return 1;
+			}
+		} else {
+			idle = 0;
+		}
+		last_progress = progress;
+	}
+	stop = 1;
+	for (i = 0; i < nthreads; i++) {
+		pthread_join(workers[i].thread, NULL);
+		total[0] += workers[i].submits;
+		total[1] += workers[i].waits;
+		total[2] += workers[i].frees;
+		total[3] += workers[i].allocs;
+		total[4] += workers[i].binds;
+		total[5] += workers[i].sessions;
+	}
+
+	/* everything queued has to come back once the gpu idles */
+	kgsl_device_idle(DEV, GSL_TIMEOUT_DEFAULT);
+	kgsl_cmdstream_waittimestamp(DEV, kgsl_cmdstream_lastissued(DEV), 2000);
+	flush_scheduled_work();
+	kgsl_cmdstream_memqueue_drain(device);
+	if (device->memqueue_stats.queued_nodes)
+		kshim_report("%lld deferred frees never reclaimed", device->memqueue_stats.queued_nodes);
+	free_after = kgsl_sharedmem_largestfreeblock(DEV, 0);
+	if (free_after != free_before)
+		kshim_report("shared memory leaked: largest free block %u before, %u after",
+			     free_before, free_after);
+
+	kgsl_device_stop(DEV);
+	kgsl_driver_exit();
+	kgsl_driver_close();
+	gpusim_stop();
+	kshim_stop();
+
+	printf("%d threads, %d s: %lu submits (%lu IBs), %lu waits, %lu deferred frees, "
+	       "%lu allocs, %lu shadow binds, %lu sessions, %lu gpu interrupts\n",
+	       nthreads, seconds, total[0], gpusim_ibs, total[1], total[2],
+	       total[3], total[4], total[5], gpusim_irqs);
+	if (kshim_errors) {
+		printf("FAIL: %d problems\n", kshim_errors);
+		return 1;
+	}
+	printf("PASS\n");
+	return 0;
+}
@@ -0,0 +1,264 @@
+/*
+ * Replay an allocation trace against the amd-gpu memarena and report
+ * per-call latency and fragmentation.
+ *
+ * A trace is a text file of operations on numbered slots:
+ *
+ *	a <slot> <bytes> <flags>	allocate into an empty slot
+ *	f <slot>			free the slot
+ *
+ * flags is passed to kgsl_memarena_alloc() as is (hex is fine), so the
+ * alignment request sits in GSL_MEMFLAGS_ALIGN_MASK.  Without -r a
+ * synthetic trace is generated: the arena is filled with -n live blocks
+ * and then churned with -o random alloc/free operations, 80% of the
+ * sizes under 16KB, 18% up to 256KB and 2% up to 1MB, a third of them
+ * asking for 32B..4KB alignment.  -w saves that trace so the same
+ * sequence can be replayed against another tree's gsl_memmgr.c:
+ *
+ *	./memarena_bench -n 4000 -w churn.trace
+ *	./memarena_bench -r churn.trace
+ *
+ * Only the arena calls are timed.  The arena is 256MB unless -m says
+ * otherwise; allocations that do not fit are counted, not fatal.
+ */
+#define _GNU_SOURCE
+#include <getopt.h>
+#include <time.h>
+
+#include "gsl.h"
+
+#define ARENA_GPUBASE	0x80000000u
+
+struct op {
+	unsigned int slot;
+	unsigned int size;	/* 0 for a free */
+	unsigned int flags;
+};
+
+static struct op *ops;
+static unsigned int nops, maxops, nslots;
+
+static void add_op(unsigned int slot, unsigned int size, unsigned int flags)
+{
+	if (nops == maxops) {
+		maxops = maxops ? maxops * 2 : 4096;
+		ops = realloc(ops, maxops * sizeof(*ops));
+		assert(ops);
+	}
+	ops[nops].slot = slot;
+	ops[nops].size = size;
+	ops[nops].flags = flags;
+	nops++;
+	if (slot >= nslots)
+		nslots = slot + 1;
+}
+
+static unsigned int rnd_size(unsigned int *seed)
+{
+	int r = rand_r(seed) % 100;
+
+	if (r < 80)
+		return 64 + rand_r(seed) % (16 << 10);
+	if (r < 98)
+		return (16 << 10) + rand_r(seed) % (240 << 10);
+	return (256 << 10) + rand_r(seed) % (768 << 10);
+}
+
+static void synthesize(unsigned int live, unsigned int churn, unsigned int seed)
+{
+	char *used = calloc(live, 1);
+	unsigned int i, s, flags;
+
+	for (i = 0; i < live + churn; i++) {
+		s = i < live ? i : rand_r(&seed) % live;
+		if (used[s]) {
+			add_op(s, 0, 0);
+			used[s] = 0;
+			continue;
+		}
+		flags = 0;
+		if (rand_r(&seed) % 3 == 0)
+			flags = (rand_r(&seed) % 8 + 5) << GSL_MEMFLAGS_ALIGN_SHIFT;
+		add_op(s, rnd_size(&seed), flags);
+		used[s] = 1;
+	}
+	free(used);
+}
+
+static void load(const char *path)
+{
+	FILE *f = fopen(path, "r");
+	unsigned int slot, size;
+	char line[128], c;
+	int n, flags;
+
+	if (!f) {
+		perror(path);
+		exit(1);
+	}
+	while (fgets(line, sizeof(line), f)) {
+		n = sscanf(line, " %c %u %u %i", &c, &slot, &size, &flags);
+		if (n >= 2 && c == 'f')
+			add_op(slot, 0, 0);
+		else if (n == 4 && c == 'a' && size)
+			add_op(slot, size, flags);
+		else if (line[0] != '#' && line[0] != '\n')
+			fprintf(stderr, "%s: ignoring '%s'", path, line);
+	}
+	fclose(f);
+}
+
+static void save(const char *path)
+{
+	FILE *f = fopen(path, "w");
+	unsigned int i;
+
+	if (!f) {
+		perror(path);
+		exit(1);
+	}
+	for (i = 0; i < nops; i++) {
+		if (ops[i].size)
+			fprintf(f, "a %u %u 0x%x\n", ops[i].slot, ops[i].size, ops[i].flags);
+		else
+			fprintf(f, "f %u\n", ops[i].slot);
+	}
+	fclose(f);
+}
+
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int cmp_uint(const void *a, const void *b)
+{
+	unsigned int x = *(const unsigned int *)a, y = *(const unsigned int *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void report(const char *what, unsigned int *ns, unsigned int n)
+{
+	unsigned long long sum = 0;
+	unsigned int i;
+
+	if (!n)
+		return;
+	for (i = 0; i < n; i++)
+		sum += ns[i];
+	qsort(ns, n, sizeof(*ns), cmp_uint);
+	printf("%-6s %8u calls  mean %6llu ns  p50 %6u  p99 %6u  max %8u\n", what, n,
+	       sum / n, ns[n / 2], ns[n - 1 - n / 100], ns[n - 1]);
+}
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr, "usage: %s [-n live] [-o churn ops] [-s seed] [-m arena MB] "
+		"[-r trace | -w trace]\n", argv0);
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int live = 2000, churn = 1000000, seed = 12345, arena_mb = 256;
+	const char *in = NULL, *out = NULL;
+	unsigned int *alloc_ns, *free_ns, nalloc = 0, nfree = 0, failed = 0;
+	unsigned long long t, used = 0, arena_bytes;
+	gsl_memarena_t *arena;
+	gsl_memdesc_t *desc;
+	unsigned int i, largest;
+	char *busy;
+	int c;
+
+	while ((c = getopt(argc, argv, "n:o:s:m:r:w:")) != -1) {
+		switch (c) {
+		case 'n':
+			live = atoi(optarg);
+			break;
+		case 'o':
+			churn = atoi(optarg);
+			break;
+		case 's':
+			seed = atoi(optarg);
+			break;
+		case 'm':
+			arena_mb = atoi(optarg);
+			break;
+		case 'r':
+			in = optarg;
+			break;
+		case 'w':
+			out = optarg;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (!live || !arena_mb || (in && out))
+		usage(argv[0]);
+
+	if (in)
+		load(in);
+	else
+		synthesize(live, churn, seed);
+	if (out) {
+		save(out);
+		return 0;
+	}
+
+	arena_bytes = (unsigned long long)arena_mb << 20;
+	arena = kgsl_memarena_create(0, 0, ARENA_GPUBASE, arena_bytes);
+	desc = calloc(nslots, sizeof(*desc));
+	busy = calloc(nslots, 1);
+	alloc_ns = malloc(nops * sizeof(*alloc_ns));
+	free_ns = malloc(nops * sizeof(*free_ns));
+	assert(arena && desc && busy && alloc_ns && free_ns);
+
+	for (i = 0; i < nops; i++) {
+		struct op *op = &ops[i];
+
+		if (!op->size) {
+			/* the alloc may have failed, or a recorded trace double frees */
+			if (!busy[op->slot])
+				continue;
+			t = now_ns();
+			kgsl_memarena_free(arena, &desc[op->slot]);
+			free_ns[nfree++] = now_ns() - t;
+			busy[op->slot] = 0;
+			continue;
+		}
+		if (busy[op->slot]) {
+			kgsl_memarena_free(arena, &desc[op->slot]);
+			busy[op->slot] = 0;
+		}
+		t = now_ns();
+		c = kgsl_memarena_alloc(arena, op->flags, op->size, &desc[op->slot]);
+		alloc_ns[nalloc++] = now_ns() - t;
+		if (c == GSL_SUCCESS)
+			busy[op->slot] = 1;
+		else
+			failed++;
+	}
+
+	for (i = 0; i < nslots; i++)
+		if (busy[i])
+			used += desc[i].size;
+	largest = kgsl_memarena_getlargestfreeblock(arena, 0);
+
+	printf("%u ops on %u slots, %u MB arena\n", nops, nslots, arena_mb);
+	report("alloc", alloc_ns, nalloc);
+	report("free", free_ns, nfree);
+	printf("failed %u of %u allocs, %llu KB live, "
+	       "largest free block %.1f%% of free space\n", failed, nalloc, used >> 10,
+	       100.0 * largest / (arena_bytes - used));
+
+	for (i = 0; i < nslots; i++)
+		if (busy[i])
+			kgsl_memarena_free(arena, &desc[i]);
+	kgsl_memarena_destroy(arena);
+	return 0;
+}
@@ -0,0 +1 @@
+/* tracepoints compile to nothing here, see linux/tracepoint.h */
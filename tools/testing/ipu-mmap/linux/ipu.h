@@ -0,0 +1,10 @@
+#ifndef LINUX_IPU_H
+#define LINUX_IPU_H
+
+/*
+ * The user space half of the real header, with the host's linux/types.h
+ * and videodev2.h underneath it.
+ */
+#include "../../../../include/linux/ipu.h"
+
+#endif
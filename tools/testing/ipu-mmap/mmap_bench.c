@@ -0,0 +1,204 @@
+/*
+ * Time CPU access to an IPU_ALOC_MEM buffer through a write-combined and
+ * a cached mapping.  Each pass
+ *
+ *	- writes the buffer through the mapping under test, then for a
+ *	  cached mapping issues IPU_CPU_ACCESS_END with the write flag,
+ *	- checks through a second, write-combined mapping that every page
+ *	  reached memory,
+ *	- stands in for the device by rewriting the buffer through that
+ *	  second mapping,
+ *	- for a cached mapping issues IPU_CPU_ACCESS_BEGIN, then reads the
+ *	  buffer back through the mapping under test and counts the words
+ *	  that are stale.
+ *
+ * The copies and the two ioctls are timed separately, so the cost of the
+ * cache maintenance can be set against what the cached mapping saves:
+ *
+ *	./mmap_bench -s 8192 -n 20
+ *
+ * A non-zero stale or unflushed count means the cache maintenance is
+ * broken, and the exit status says so.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <linux/ipu.h>
+
+struct result {
+	double write_ns, end_ns, begin_ns, read_ns;
+	unsigned long unflushed, stale;
+};
+
+static int fd;
+static volatile uint32_t sink;
+
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint32_t *map(ipu_mem_info *mem, uint32_t cached)
+{
+	void *p;
+
+	/* only later mmaps see the mode */
+	if (ioctl(fd, IPU_SET_MMAP_CACHED, &cached) < 0) {
+		perror("IPU_SET_MMAP_CACHED");
+		exit(1);
+	}
+	/* the offset is the physical address, which dma_addr_t holds signed */
+	p = mmap(NULL, mem->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+		 (off_t)(uint32_t)mem->paddr);
+	if (p == MAP_FAILED) {
+		perror("mmap");
+		exit(1);
+	}
+	return p;
+}
+
+static void cpu_access(unsigned long cmd, uint32_t *p, uint32_t size,
+		       uint32_t flags)
+{
+	ipu_cpu_access access = {
+		.vaddr = (unsigned long)p,
+		.size = size,
+		.flags = flags,
+	};
+
+	if (ioctl(fd, cmd, &access) < 0) {
+		perror(cmd == IPU_CPU_ACCESS_BEGIN ? "IPU_CPU_ACCESS_BEGIN" :
+		       "IPU_CPU_ACCESS_END");
+		exit(1);
+	}
+}
+
+static void run(ipu_mem_info *mem, int cached, int passes, struct result *r)
+{
+	unsigned int words = mem->size / 4, page = getpagesize() / 4;
+	uint32_t *buf = map(mem, cached), *dev = map(mem, 0);
+	unsigned long long t;
+	uint32_t sum = 0;
+	unsigned int i;
+	int pass;
+
+	memset(r, 0, sizeof(*r));
+	for (pass = 0; pass < passes; pass++) {
+		uint32_t cpu_tag = pass << 24, dev_tag = (pass << 24) | 0x800000;
+
+		t = now_ns();
+		for (i = 0; i < words; i++)
+			buf[i] = cpu_tag | i;
+		r->write_ns += now_ns() - t;
+		if (cached) {
+			t = now_ns();
+			cpu_access(IPU_CPU_ACCESS_END, buf, mem->size,
+				   IPU_CPU_ACCESS_WRITE);
+			r->end_ns += now_ns() - t;
+		}
+
+		/* the last word of each page, the one most likely still dirty */
+		for (i = page - 1; i < words; i += page)
+			if (dev[i] != (cpu_tag | i))
+				r->unflushed++;
+
+		for (i = 0; i < words; i++)
+			dev[i] = dev_tag | i;
+
+		if (cached) {
+			t = now_ns();
+			cpu_access(IPU_CPU_ACCESS_BEGIN, buf, mem->size, 0);
+			r->begin_ns += now_ns() - t;
+		}
+		t = now_ns();
+		for (i = 0; i < words; i++)
+			sum += buf[i];
+		r->read_ns += now_ns() - t;
+		for (i = 0; i < words; i++)
+			if (buf[i] != (dev_tag | i))
+				r->stale++;
+	}
+	sink = sum;
+
+	munmap(buf, mem->size);
+	munmap(dev, mem->size);
+}
+
+static void report(const char *what, ipu_mem_info *mem, int passes,
+		   struct result *r)
+{
+	double mb = (double)mem->size * passes / (1 << 20);
+
+	printf("%-8s write %7.1f MB/s  read %7.1f MB/s", what,
+	       mb / (r->write_ns / 1e9), mb / (r->read_ns / 1e9));
+	if (r->end_ns)
+		printf("  end %6.0f us  begin %6.0f us",
+		       r->end_ns / passes / 1e3, r->begin_ns / passes / 1e3);
+	printf("  unflushed %lu  stale %lu\n", r->unflushed, r->stale);
+}
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr, "usage: %s [-d device] [-s size KB] [-n passes]\n", argv0);
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	const char *dev = "/dev/mxc_ipu";
+	int size_kb = 4096, passes = 10, c;
+	struct result wc, cached;
+	ipu_mem_info mem;
+
+	while ((c = getopt(argc, argv, "d:s:n:")) != -1) {
+		switch (c) {
+		case 'd':
+			dev = optarg;
+			break;
+		case 's':
+			size_kb = atoi(optarg);
+			break;
+		case 'n':
+			passes = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (size_kb <= 0 || passes <= 0)
+		usage(argv[0]);
+
+	fd = open(dev, O_RDWR);
+	if (fd < 0) {
+		perror(dev);
+		return 1;
+	}
+	memset(&mem, 0, sizeof(mem));
+	mem.size = size_kb << 10;
+	if (ioctl(fd, IPU_ALOC_MEM, &mem) < 0) {
+		perror("IPU_ALOC_MEM");
+		return 1;
+	}
+
+	run(&mem, 0, passes, &wc);
+	run(&mem, 1, passes, &cached);
+
+	printf("%d KB buffer, %d passes\n", size_kb, passes);
+	report("wc", &mem, passes, &wc);
+	report("cached", &mem, passes, &cached);
+
+	ioctl(fd, IPU_FREE_MEM, &mem);
+	close(fd);
+	return wc.unflushed + wc.stale + cached.unflushed + cached.stale ? 1 : 0;
+}
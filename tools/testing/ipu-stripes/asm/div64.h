@@ -0,0 +1,6 @@
+#ifndef ASM_DIV64_H
+#define ASM_DIV64_H
+
+#define do_div(n, base)	({ uint32_t __r = (n) % (base); (n) /= (base); __r; })
+
+#endif
@@ -0,0 +1,13 @@
+#ifndef LINUX_MODULE_H
+#define LINUX_MODULE_H
+
+/* what ipu_calc_stripes_sizes.c needs from the kernel headers */
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint64_t u64;
+
+#define EXPORT_SYMBOL(sym)
+#define ARRAY_SIZE(a)	(sizeof(a) / sizeof((a)[0]))
+
+#endif
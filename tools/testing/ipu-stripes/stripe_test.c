@@ -0,0 +1,149 @@
+/*
+ * Check the IC stripe calculator the way ipu_task_stripes uses it:
+ * equal stripes, no forced overlap and a 1024 column limit, so every
+ * output from 1025 to 2048 columns is split in two.  Every input width
+ * from 64 to 2048 in steps of 8 is tried against each such output for
+ * a few format pairs.  A split the task path accepts must
+ *
+ *	- write every output column, with no gap between the stripes,
+ *	- keep both stripes within the IC limit,
+ *	- sample nothing past the input crop, and
+ *	- sample each output column within a few pixels of where a
+ *	  full frame scaler would, x * (in - 1) / (out - 1).
+ *
+ * Splits the task path has to reject are checked separately.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <linux/module.h>
+#include <linux/ipu.h>
+
+#define MAX_WIDTH	1024
+
+/* keep in step with ipu_task_stripes_ok() in drivers/mxc/ipu3/ipu_device.c */
+static int stripes_ok(struct stripe_param *s, unsigned int out)
+{
+	return (s[1].output_column + s[1].output_width == out) &&
+	       (s[0].output_width <= MAX_WIDTH) && (s[1].output_width <= MAX_WIDTH);
+}
+
+/* what ipu_task_stripes does before running a split */
+static int split(unsigned int in, unsigned int out, u32 infmt, u32 outfmt,
+		 struct stripe_param *s)
+{
+	if (ipu_calc_stripes_sizes(in, out, MAX_WIDTH, 1ULL << 32, 1,
+				   infmt, outfmt, &s[0], &s[1]) & 1)
+		return -1;
+	return stripes_ok(s, out) ? 0 : -1;
+}
+
+static const struct pair {
+	const char *name;
+	u32 in, out;
+	double maxerr;	/* planar input columns are aligned to 16 */
+} pairs[] = {
+	{ "YUV420P->RGB565", IPU_PIX_FMT_YUV420P, IPU_PIX_FMT_RGB565, 17.0 },
+	{ "YUV420P->YUV420P", IPU_PIX_FMT_YUV420P, IPU_PIX_FMT_YUV420P, 17.0 },
+	{ "UYVY->UYVY", IPU_PIX_FMT_UYVY, IPU_PIX_FMT_UYVY, 2.5 },
+	{ "RGB565->RGB24", IPU_PIX_FMT_RGB565, IPU_PIX_FMT_RGB24, 2.5 },
+};
+
+static int failures;
+
+#define FAIL(p, in, out, fmt, ...)					\
+	do {								\
+		if (failures++ < 20)					\
+			printf("FAIL %s %u->%u: " fmt "\n", (p)->name,	\
+			       in, out, ##__VA_ARGS__);			\
+	} while (0)
+
+static void sweep(const struct pair *p)
+{
+	unsigned long cases = 0, rejected = 0;
+	unsigned int in, out, x, X;
+	struct stripe_param s[2];
+	double got, ref, e, maxerr = 0;
+	int i;
+
+	for (in = 64; in <= 2048; in += 8) {
+		for (out = MAX_WIDTH + 1; out <= 2 * MAX_WIDTH; out++) {
+			cases++;
+			memset(s, 0, sizeof(s));
+			if (split(in, out, p->in, p->out, s)) {
+				rejected++;
+				continue;
+			}
+			if (s[1].output_column > s[0].output_width)
+				FAIL(p, in, out, "columns %u..%u not written",
+				     s[0].output_width, s[1].output_column - 1);
+			if (s[1].output_column + s[1].output_width != out)
+				FAIL(p, in, out, "output ends at column %u",
+				     s[1].output_column + s[1].output_width);
+			for (i = 0; i < 2; i++) {
+				if (s[i].output_width > MAX_WIDTH)
+					FAIL(p, in, out, "stripe %d is %u wide", i,
+					     s[i].output_width);
+				if (s[i].input_column + 1 + (double)(s[i].output_width - 1) *
+				    s[i].irr / 8192.0 > in)
+					FAIL(p, in, out, "stripe %d samples past the input", i);
+				for (x = 0; x < s[i].output_width; x++) {
+					X = s[i].output_column + x;
+					got = s[i].input_column + (double)x * s[i].irr / 8192.0;
+					ref = (double)X * (in - 1) / (out - 1);
+					e = got > ref ? got - ref : ref - got;
+					if (e > maxerr)
+						maxerr = e;
+				}
+			}
+		}
+	}
+	printf("%-18s %lu cases, %lu rejected, max error %.2f px\n",
+	       p->name, cases, rejected, maxerr);
+	if (maxerr > p->maxerr)
+		FAIL(p, 0, 0, "source position off by %.2f px", maxerr);
+	if (rejected == cases)
+		FAIL(p, 0, 0, "every split rejected");
+}
+
+/* splits the calculator gets wrong, and a few it gets right */
+static const struct {
+	unsigned int in, out;
+	u32 infmt, outfmt;
+	int ok;
+} fixed[] = {
+	/* trimmed to the planar write alignment, column 1024 is lost */
+	{ 1024, 1025, IPU_PIX_FMT_YUV420P, IPU_PIX_FMT_YUV420P, 0 },
+	/* trimmed to the packed write alignment */
+	{ 1024, 2047, IPU_PIX_FMT_UYVY, IPU_PIX_FMT_UYVY, 0 },
+	/* equal stripes come out 1040 wide */
+	{ 1024, 2040, IPU_PIX_FMT_YUV420P, IPU_PIX_FMT_RGB565, 0 },
+	{ 1024, 2048, IPU_PIX_FMT_UYVY, IPU_PIX_FMT_UYVY, 0 },
+	/* too narrow an input for two planar stripes */
+	{ 24, 1280, IPU_PIX_FMT_YUV420P, IPU_PIX_FMT_RGB565, 0 },
+	{ 720, 1280, IPU_PIX_FMT_YUV420P, IPU_PIX_FMT_RGB565, 1 },
+	{ 1024, 2016, IPU_PIX_FMT_UYVY, IPU_PIX_FMT_UYVY, 1 },
+	{ 1920, 1920, IPU_PIX_FMT_RGB565, IPU_PIX_FMT_RGB24, 1 },
+};
+
+int main(void)
+{
+	struct stripe_param s[2];
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(pairs); i++)
+		sweep(&pairs[i]);
+
+	for (i = 0; i < ARRAY_SIZE(fixed); i++) {
+		memset(s, 0, sizeof(s));
+		if ((split(fixed[i].in, fixed[i].out, fixed[i].infmt,
+			   fixed[i].outfmt, s) == 0) == fixed[i].ok)
+			continue;
+		printf("FAIL %u->%u: split %s\n", fixed[i].in, fixed[i].out,
+		       fixed[i].ok ? "rejected" : "accepted");
+		failures++;
+	}
+
+	printf("%s\n", failures ? "FAIL" : "PASS");
+	return failures ? 1 : 0;
+}